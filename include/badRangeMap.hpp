@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace estoraged
+{
+
+/** @brief What went wrong in a bad range. */
+enum class BadRangeKind
+{
+    /** @brief The device failed to read it. */
+    Read,
+    /** @brief The device failed to write it. */
+    Write,
+    /** @brief It read back different from what the erase wrote. */
+    Mismatch,
+};
+
+/** @brief A run of bad bytes on the device. */
+struct BadRange
+{
+    /** @brief Offset of the first bad byte. */
+    uint64_t offset;
+    /** @brief Number of bytes in the run. */
+    uint64_t length;
+
+    bool operator==(const BadRange&) const = default;
+};
+
+/** @class BadRangeMap
+ *  @brief Collects the bad ranges of a tolerant erase, which keeps going
+ *  past read, write and compare failures instead of stopping at the first.
+ *  @details Overlapping and touching ranges are joined. The map holds at
+ *  most limit ranges: when it would hold more, the two ranges with the
+ *  smallest gap between them are joined, so the map still covers every bad
+ *  byte, plus some good ones, in bounded memory however badly the device
+ *  fails. Safe to use from several threads.
+ */
+class BadRangeMap
+{
+  public:
+    /** @brief Creates an empty map.
+     *
+     *  @param[in] limit - most ranges the map holds, at least 1.
+     */
+    explicit BadRangeMap(size_t limit = defaultLimit);
+
+    /** @brief Records a bad range.
+     *
+     *  @param[in] kind - what went wrong.
+     *  @param[in] offset - offset of the range on the device.
+     *  @param[in] length - bytes in the range, 0 to only count the failure.
+     */
+    void add(BadRangeKind kind, uint64_t offset, uint64_t length);
+
+    /** @brief Get the ranges, in offset order. */
+    std::vector<BadRange> ranges() const;
+
+    /** @brief Check if nothing was recorded. */
+    bool empty() const;
+
+    /** @brief Get the number of failures recorded of a kind. */
+    uint64_t count(BadRangeKind kind) const;
+
+    /** @brief Get the bytes the ranges cover. Once ranges were joined to
+     *  stay within the limit, this includes the good bytes between them.
+     */
+    uint64_t badBytes() const;
+
+    /** @brief Check if ranges were joined to stay within the limit. */
+    bool coarsened() const;
+
+    /** @brief Default most ranges a map holds. */
+    static constexpr size_t defaultLimit = 1024;
+
+  private:
+    /** @brief Joins the two closest ranges. The mutex must be held. */
+    void joinClosest();
+
+    /** @brief Most ranges the map holds. */
+    size_t limit;
+
+    /** @brief Serializes the fields below. */
+    mutable std::mutex mutex;
+
+    /** @brief End of every range, by its offset. */
+    std::map<uint64_t, uint64_t> runs;
+
+    /** @brief Failures recorded of every kind. */
+    std::array<uint64_t, 3> counts{};
+
+    /** @brief Set once ranges were joined to stay within the limit. */
+    bool joined = false;
+};
+
+/** @brief Finds the first wrong byte of a chunk.
+ *
+ *  @param[in] offset - offset of the data on the device.
+ *  @param[in] data - the bytes to check.
+ *  @return index of the first wrong byte, or data.size() if all of it is
+ *  correct.
+ */
+using MismatchFinder =
+    std::function<size_t(uint64_t offset, std::span<const std::byte> data)>;
+
+/** @brief Records every wrong sector of a chunk as a mismatch.
+ *  @details The chunk is only checked sector by sector from its first
+ *  wrong byte, and runs of wrong sectors are recorded as one range.
+ *
+ *  @param[in] map - map to record the sectors in.
+ *  @param[in] offset - offset of the chunk on the device, a multiple of
+ *  sectorSize.
+ *  @param[in] data - the bytes read from the device.
+ *  @param[in] first - index of the first wrong byte in data.
+ *  @param[in] find - checks part of the chunk.
+ *  @param[in] sectorSize - size of the sectors, usually 512.
+ */
+void recordMismatches(BadRangeMap& map, uint64_t offset,
+                      std::span<const std::byte> data, size_t first,
+                      const MismatchFinder& find, size_t sectorSize);
+
+} // namespace estoraged
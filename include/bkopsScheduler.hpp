@@ -0,0 +1,203 @@
+#pragma once
+
+#include "deviceWorker.hpp"
+#include "extCsd.hpp"
+#include "mmcChannel.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace estoraged
+{
+
+/** @brief I/O counters of a block device, from /sys/block/<dev>/stat. */
+struct BlockStat
+{
+    /** @brief Reads, writes and discards completed. */
+    uint64_t ios = 0;
+    /** @brief Requests in flight. */
+    uint64_t inFlight = 0;
+};
+
+/** @brief Parses the contents of a block device stat file.
+ *
+ *  @param[in] text - the contents, see Documentation/block/stat.rst.
+ *  @return the counters, or nullopt if the text is not a stat file.
+ */
+std::optional<BlockStat> parseBlockStat(std::string_view text);
+
+/** @class IdleDetector
+ *  @brief Tells when a block device has been idle for some time.
+ */
+class IdleDetector
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /** @brief Creates a detector.
+     *
+     *  @param[in] idleTime - time without any I/O that makes the device
+     *    idle.
+     */
+    explicit IdleDetector(Clock::duration idleTime) : idleTime(idleTime) {}
+
+    /** @brief Feeds a sample of the counters.
+     *  @details The device is busy until a full idle time passes without
+     *  any request completing or in flight, including right after the
+     *  first sample.
+     *
+     *  @param[in] stat - the counters.
+     *  @param[in] now - time of the sample.
+     *  @return whether the device is idle.
+     */
+    bool update(const BlockStat& stat, Clock::time_point now);
+
+  private:
+    /** @brief Time without I/O that makes the device idle. */
+    Clock::duration idleTime;
+
+    /** @brief Previous sample, nullopt before the first. */
+    std::optional<BlockStat> last;
+
+    /** @brief Time the counters last moved. */
+    Clock::time_point lastActivity;
+};
+
+/** @brief Decides whether to start the background operations.
+ *  @details A critical level can not wait for the host to go idle, the
+ *  device would otherwise stall writes on its own. Lower levels wait for
+ *  an idle window, so the operations don't add to the I/O latency.
+ *
+ *  @param[in] level - BKOPS_STATUS of the device.
+ *  @param[in] idle - the device is idle.
+ */
+bool shouldStartBkops(BkopsStatus level, bool idle);
+
+/** @brief Get the D-Bus name of a BKOPS level, e.g. Critical. */
+std::string bkopsLevelName(BkopsStatus level);
+
+/** @class BkopsScheduler
+ *  @brief Runs the manual background operations of an eMMC device.
+ *  @details Once the device is in manual BKOPS mode, nothing but the host
+ *  starts its background operations, and the ones it puts off end up as
+ *  write latency spikes. The scheduler polls the device on the io_context,
+ *  checks the block device stat file for an idle window, and reads
+ *  BKOPS_STATUS and writes BKOPS_START on the worker of the drive, so the
+ *  commands queue behind any erase and never block the D-Bus thread. The
+ *  xyz.openbmc_project.eStoraged.BackgroundOperations interface on the
+ *  drive shows the last level read and how many times the operations were
+ *  started, while idle or because they were urgent, and failed.
+ */
+class BkopsScheduler : public std::enable_shared_from_this<BkopsScheduler>
+{
+  public:
+    /** @brief Constructor for BkopsScheduler
+     *
+     *  @param[in] io - io_context of the D-Bus connection
+     *  @param[in] server - sdbusplus asio object server
+     *  @param[in] objectPath - D-Bus path of the drive
+     *  @param[in] worker - worker running the operations on the drive
+     *  @param[in] mmc - command channel of the device
+     *  @param[in] statPath - stat file of the block device
+     *  @param[in] pollInterval - time between two polls
+     *  @param[in] idleTime - time without I/O that makes the device idle
+     */
+    BkopsScheduler(boost::asio::io_context& io,
+                   sdbusplus::asio::object_server& server,
+                   const std::string& objectPath, DeviceWorker& worker,
+                   std::shared_ptr<MmcChannel> mmc,
+                   std::filesystem::path statPath,
+                   std::chrono::steady_clock::duration pollInterval,
+                   std::chrono::steady_clock::duration idleTime);
+
+    /** @brief Destructor for BkopsScheduler, stops the polls. */
+    ~BkopsScheduler();
+
+    BkopsScheduler(const BkopsScheduler&) = delete;
+    BkopsScheduler& operator=(const BkopsScheduler&) = delete;
+    BkopsScheduler(BkopsScheduler&&) = delete;
+    BkopsScheduler& operator=(BkopsScheduler&&) = delete;
+
+    /** @brief Starts polling.
+     *  @details The scheduler must be owned by a shared_ptr.
+     */
+    void start();
+
+    /** @brief Longest a BKOPS_START may keep the device busy, in ms, the
+     *  same as the kernel.
+     */
+    static constexpr uint32_t bkopsTimeoutMs = 120000;
+
+  private:
+    /** @brief Outcome of a poll on the worker. */
+    struct PollResult
+    {
+        std::optional<BkopsStatus> level;
+        bool started = false;
+        bool failed = false;
+    };
+
+    /** @brief Arms the timer for the next poll. */
+    void schedule();
+
+    /** @brief Checks for idle and queues the device poll, on the D-Bus
+     *  thread.
+     */
+    void poll();
+
+    /** @brief Reads the level and starts the operations if needed, on the
+     *  worker.
+     *
+     *  @param[in] mmc - command channel of the device.
+     *  @param[in] idle - the device is idle.
+     */
+    static PollResult pollDevice(MmcChannel& mmc, bool idle);
+
+    /** @brief Publishes a poll, on the D-Bus thread. */
+    void publish(const PollResult& result, bool idle);
+
+    /** @brief D-Bus object server. */
+    sdbusplus::asio::object_server& objectServer;
+
+    /** @brief BackgroundOperations interface of the drive. */
+    std::shared_ptr<sdbusplus::asio::dbus_interface> bkopsInterface;
+
+    /** @brief Worker running the operations on the drive. */
+    DeviceWorker& worker;
+
+    /** @brief Command channel of the device. */
+    std::shared_ptr<MmcChannel> mmc;
+
+    /** @brief Stat file of the block device. */
+    std::filesystem::path statPath;
+
+    /** @brief Time between two polls. */
+    std::chrono::steady_clock::duration pollInterval;
+
+    /** @brief Timer of the next poll. */
+    boost::asio::steady_timer timer;
+
+    /** @brief Tracks the I/O of the block device. */
+    IdleDetector idleDetector;
+
+    /** @brief Set while a poll is queued on the worker. */
+    bool pending = false;
+
+    /** @brief Times the operations were started while idle, because they
+     *  were critical, and failed to start.
+     */
+    uint64_t idleRuns = 0;
+    uint64_t urgentRuns = 0;
+    uint64_t failures = 0;
+};
+
+} // namespace estoraged
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "eraseOptions.hpp"
+#include "util.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace estoraged
+{
+
+/** @class AlignedBuffer
+ *  @brief Zero initialized heap buffer with a fixed alignment, suitable for
+ *  O_DIRECT I/O.
+ */
+class AlignedBuffer
+{
+  public:
+    /** @brief Allocates the buffer.
+     *
+     *  @param[in] size - size of the buffer in bytes.
+     *  @param[in] alignment - alignment of the buffer, a power of two.
+     */
+    AlignedBuffer(size_t size, size_t alignment);
+
+    /** @brief Get the full buffer. */
+    std::span<std::byte> span()
+    {
+        return {data.get(), size};
+    }
+
+  private:
+    struct Free
+    {
+        void operator()(std::byte* ptr) const
+        {
+            std::free(ptr); // NOLINT(cppcoreguidelines-no-malloc)
+        }
+    };
+
+    /** @brief Size of the buffer in bytes. */
+    size_t size;
+
+    /** @brief Start of the buffer. */
+    std::unique_ptr<std::byte, Free> data;
+};
+
+/** @class BufferPool
+ *  @brief Set of equally sized aligned buffers that the erase engines reuse
+ *  across every chunk of a write or verify pass.
+ */
+class BufferPool
+{
+  public:
+    /** @brief Allocates the buffers.
+     *
+     *  @param[in] count - number of buffers.
+     *  @param[in] bufferSize - size of each buffer in bytes.
+     *  @param[in] alignment - alignment of each buffer.
+     */
+    BufferPool(size_t count, size_t bufferSize, size_t alignment);
+
+    /** @brief Creates a pool sized for an erase of a device.
+     *
+     *  @param[in] count - number of buffers.
+     *  @param[in] options - erase options, selecting direct I/O and chunking.
+     *  @param[in] geometry - block geometry of the device.
+     *  @param[in] bufferedSize - chunk size to use without direct I/O.
+     */
+    static BufferPool forErase(size_t count, const EraseOptions& options,
+                               const util::BlockGeometry& geometry,
+                               size_t bufferedSize);
+
+    /** @brief Get one of the buffers.
+     *
+     *  @param[in] index - index of the buffer, less than count().
+     */
+    std::span<std::byte> get(size_t index)
+    {
+        return buffers.at(index).span();
+    }
+
+    /** @brief Number of buffers in the pool. */
+    size_t count() const
+    {
+        return buffers.size();
+    }
+
+    /** @brief Size of each buffer in bytes. */
+    size_t bufferSize() const
+    {
+        return size;
+    }
+
+  private:
+    /** @brief Size of each buffer in bytes. */
+    size_t size;
+
+    /** @brief The buffers. */
+    std::vector<AlignedBuffer> buffers;
+};
+
+/** @brief Alignment required for direct I/O on a device.
+ *
+ *  @param[in] geometry - block geometry of the device.
+ *  @return the buffer, offset and length alignment in bytes.
+ */
+size_t directIoAlignment(const util::BlockGeometry& geometry);
+
+/** @brief Size of each read and write done by the erase engines.
+ *  @details Without direct I/O, bufferedSize is used unless the options
+ *  override it. With direct I/O, chunks are at least minDirectIoChunk bytes,
+ *  at least the optimal I/O size, and rounded to the direct I/O alignment.
+ *
+ *  @param[in] options - erase options.
+ *  @param[in] geometry - block geometry of the device.
+ *  @param[in] bufferedSize - default chunk size without direct I/O.
+ *  @return chunk size in bytes.
+ */
+size_t eraseChunkSize(const EraseOptions& options,
+                      const util::BlockGeometry& geometry, size_t bufferedSize);
+
+/** @brief Number of buffers the erase engines need.
+ *  @details One buffer per request or pipelined chunk in flight, plus one
+ *  scratch buffer for the expected data of a verify, which is always the
+ *  last one. A parallel verify needs a read and an expected buffer per
+ *  thread.
+ *
+ *  @param[in] options - erase options.
+ *  @return number of buffers.
+ */
+size_t erasePoolSize(const EraseOptions& options);
+
+/** @brief Smallest chunk used for direct I/O, 1 MiB. */
+constexpr size_t minDirectIoChunk = 1024 * 1024;
+
+} // namespace estoraged
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/spawn.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace estoraged
+{
+
+/** @class DeviceWorker
+ *  @brief Thread for the blocking operations on one drive.
+ *  @details mkfs, fsck, the key derivation in cryptsetup and the erase
+ *  commands can take from seconds to hours. Running them here keeps the
+ *  D-Bus thread free to answer property reads and other method calls in the
+ *  meantime. Each drive has its own worker with a single thread, so the
+ *  operations on one drive run one at a time, in the order they were
+ *  requested, while different drives don't wait for each other.
+ */
+class DeviceWorker
+{
+  public:
+    DeviceWorker() = default;
+
+    /** @brief Destructor for DeviceWorker, waits for the running operation
+     *  and drops the queued ones, unless a stop with a timeout gave up on
+     *  it.
+     */
+    ~DeviceWorker();
+
+    DeviceWorker(const DeviceWorker&) = delete;
+    DeviceWorker& operator=(const DeviceWorker&) = delete;
+    DeviceWorker(DeviceWorker&&) = delete;
+    DeviceWorker& operator=(DeviceWorker&&) = delete;
+
+    /** @brief Waits for the running operation and drops the queued ones.
+     *  @details Tasks posted afterwards never run.
+     */
+    void stop();
+
+    /** @brief Like stop, but gives up on the running operation after
+     *  timeout.
+     *  @details A device command such as a sanitize can not be interrupted.
+     *  If it still runs after timeout, the thread is left to finish it and
+     *  is never joined, so that the process can exit. The operation must not
+     *  use anything the caller destroys afterwards.
+     *
+     *  @param[in] timeout - how long to wait for the running operation.
+     *  @returns true if the worker stopped, false if it was left running.
+     */
+    bool stop(std::chrono::milliseconds timeout);
+
+    /** @brief Queues a task and returns right away.
+     *
+     *  @param[in] task - the task to run on the worker thread.
+     */
+    void post(std::function<void()> task);
+
+    /** @brief Runs a function on the worker thread and suspends the calling
+     *  coroutine until it returns.
+     *  @details This is for D-Bus method handlers taking a yield_context, so
+     *  the reply is only sent once the function is done, while the D-Bus
+     *  thread goes on serving other requests. An exception thrown by the
+     *  function is rethrown in the coroutine.
+     *
+     *  @param[in] yield - context of the calling coroutine.
+     *  @param[in] func - the function to run.
+     */
+    template <typename Func>
+    void run(boost::asio::yield_context yield, Func&& func)
+    {
+        // the coroutine stays suspended until the handler runs, so the
+        // worker can use its locals
+        std::exception_ptr error;
+        boost::asio::async_initiate<boost::asio::yield_context, void()>(
+            [this, &func, &error](auto handler) {
+                auto work = boost::asio::make_work_guard(handler);
+                boost::asio::post(*pool, [state = state, &func, &error,
+                                          handler = std::move(handler),
+                                          work = std::move(work)]() mutable {
+                    {
+                        Running running(state);
+                        try
+                        {
+                            std::forward<Func>(func)();
+                        }
+                        catch (...)
+                        {
+                            error = std::current_exception();
+                        }
+                    }
+                    boost::asio::post(work.get_executor(), std::move(handler));
+                });
+            },
+            yield);
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+  private:
+    /** @brief Whether an operation runs, shared with the running operation
+     *  so that it outlives a worker that gave up on it.
+     */
+    struct State
+    {
+        std::mutex mutex;
+        /* signalled when the running operation returns */
+        std::condition_variable idle;
+        bool busy = false;
+    };
+
+    /** @brief Marks the worker busy while an operation runs. */
+    class Running
+    {
+      public:
+        explicit Running(std::shared_ptr<State> state);
+        ~Running();
+
+        Running(const Running&) = delete;
+        Running& operator=(const Running&) = delete;
+
+      private:
+        std::shared_ptr<State> state;
+    };
+
+    /** @brief The worker thread, leaked once a stop gave up on it. */
+    std::unique_ptr<boost::asio::thread_pool> pool =
+        std::make_unique<boost::asio::thread_pool>(1);
+
+    std::shared_ptr<State> state = std::make_shared<State>();
+
+    /** @brief Whether a stop gave up on the running operation. */
+    bool abandoned = false;
+};
+
+} // namespace estoraged
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "eraseOptions.hpp"
+#include "extCsd.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace estoraged
+{
+
+/** @brief Erase geometry of an eMMC device. */
+struct EmmcEraseGeometry
+{
+    /** @brief Bytes per unit of the erase addresses: 512 for a sector
+     *  addressed device, larger than 2 GB, or 1 for a byte addressed one.
+     */
+    uint64_t addressUnit = 512;
+
+    /** @brief Bytes in an erase group, 0 if not known. */
+    uint64_t groupSize = 0;
+
+    /** @brief Most time erasing one group takes, in ms, 0 if not known. */
+    uint32_t groupTimeoutMs = 0;
+};
+
+/** @brief Reads the erase geometry from the EXT_CSD register.
+ *  @details SEC_COUNT tells sector from byte addressing. The erase group
+ *  size, HC_ERASE_GRP_SIZE units of 512 KiB, and its timeout,
+ *  ERASE_TIMEOUT_MULT units of 300 ms, only apply when ERASE_GROUP_DEF
+ *  enables them, which the kernel does for high capacity devices. Without
+ *  them, the group size and timeout are left 0.
+ *
+ *  @param[in] extCsd - contents of the EXT_CSD register.
+ *  @return the geometry.
+ */
+EmmcEraseGeometry
+    parseEraseGeometry(std::span<const uint8_t, extCsdSize> extCsd);
+
+/** @brief Erase commands an eMMC device supports, and their timeouts. */
+struct EmmcEraseCapabilities
+{
+    /** @brief Addressing and erase groups. */
+    EmmcEraseGeometry geometry;
+
+    /** @brief TRIM, from SEC_GB_CL_EN of SEC_FEATURE_SUPPORT. */
+    bool trim = false;
+
+    /** @brief DISCARD, from EXT_CSD_REV 6, eMMC 4.5, on. */
+    bool discard = false;
+
+    /** @brief Secure erase and, with trim, secure trim, from SECURE_ER_EN
+     *  of SEC_FEATURE_SUPPORT.
+     */
+    bool secureErase = false;
+
+    /** @brief SANITIZE, from SEC_SANITIZE of SEC_FEATURE_SUPPORT. */
+    bool sanitize = false;
+
+    /** @brief Most time a trim or discard of one group takes, in ms, from
+     *  TRIM_MULT.
+     */
+    uint32_t trimTimeoutMs = 0;
+
+    /** @brief Secure erase timeouts are the erase ones times this, from
+     *  SEC_ERASE_MULT.
+     */
+    uint32_t secureEraseMult = 0;
+
+    /** @brief Secure trim timeouts are the trim ones times this, from
+     *  SEC_TRIM_MULT.
+     */
+    uint32_t secureTrimMult = 0;
+};
+
+/** @brief Reads the erase capabilities from the EXT_CSD register.
+ *
+ *  @param[in] extCsd - contents of the EXT_CSD register.
+ *  @return the capabilities.
+ */
+EmmcEraseCapabilities
+    parseEraseCapabilities(std::span<const uint8_t, extCsdSize> extCsd);
+
+/** @brief One step of an eMMC media erase. */
+enum class EmmcEraseStep
+{
+    /** @brief Unmaps the user area, which may still read back. */
+    Discard,
+    /** @brief Unmaps the user area, which reads back erased. */
+    Trim,
+    /** @brief Erases the user area by erase group. */
+    Erase,
+    /** @brief Trims the user area and purges its old copies. Deprecated
+     *  since eMMC 4.51.
+     */
+    SecureTrim,
+    /** @brief Erases the user area and purges its old copies. Deprecated
+     *  since eMMC 4.51.
+     */
+    SecureErase,
+    /** @brief Purges every unmapped block of the device. */
+    Sanitize,
+};
+
+/** @brief Get the name of a step, as in the logs and on D-Bus. */
+std::string eraseStepName(EmmcEraseStep step);
+
+/** @brief Get the CMD38 arguments of a step, one per pass over the user
+ *  area. Sanitize has none, it is a SWITCH.
+ */
+std::vector<uint32_t> eraseStepArgs(EmmcEraseStep step);
+
+/** @brief Get the most time a step takes per erase group, in ms, 0 if not
+ *  known. Sanitize has no timeout per group.
+ */
+uint64_t eraseStepGroupTimeoutMs(const EmmcEraseCapabilities& capabilities,
+                                 EmmcEraseStep step);
+
+/** @brief Steps of an eMMC media erase, in order. */
+struct EmmcErasePlan
+{
+    /** @brief The steps. */
+    std::vector<EmmcEraseStep> steps;
+
+    /** @brief Worst case duration from the timeouts in EXT_CSD, 0 if not
+     *  known.
+     */
+    std::chrono::milliseconds estimate{0};
+
+    /** @brief Get the step names joined by '+', e.g. Discard+Sanitize. */
+    std::string name() const;
+};
+
+/** @brief Time a sanitize is expected to take at most. EXT_CSD has no
+ *  timeout for it, so this is the one the kernel uses.
+ */
+constexpr std::chrono::milliseconds sanitizeEstimate{240000};
+
+/** @brief Picks the fastest erase the device supports that meets a
+ *  policy.
+ *  @details Legacy always runs Erase+Sanitize. Purge picks from
+ *  Discard+Sanitize, Trim+Sanitize, Erase+Sanitize, SecureErase and
+ *  SecureTrim. Clear also accepts Trim and Erase alone. The plans compare
+ *  by their worst case duration. A plan whose duration is not known, for
+ *  lack of an erase group or a timeout, is not picked.
+ *
+ *  @param[in] capabilities - what the device supports.
+ *  @param[in] policy - what the erase must achieve.
+ *  @param[in] driveSize - bytes in the user area.
+ *  @return the plan, or nullopt if none meets the policy.
+ */
+std::optional<EmmcErasePlan>
+    planErase(const EmmcEraseCapabilities& capabilities,
+              EmmcErasePolicy policy, uint64_t driveSize);
+
+} // namespace estoraged
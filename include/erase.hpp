@@ -1,4 +1,12 @@
 #pragma once
+#include "badRangeMap.hpp"
+#include "eraseProgress.hpp"
+#include "eraseThrottle.hpp"
+
+#include <phosphor-logging/lg2.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
+#include <cstdint>
 #include <string>
 
 namespace estoraged
@@ -14,9 +22,184 @@ class Erase
      */
     Erase(std::string_view inDevPath) : devPath(inDevPath) {}
 
+    /** @brief reports the progress of the erase to a tracker
+     *  @param inProgress the tracker, which must outlive the erase, or
+     * nullptr to stop reporting
+     */
+    void setProgress(EraseProgress* inProgress)
+    {
+        progress = inProgress;
+    }
+
+    /** @brief resumes the overwrite passes from an offset instead of 0.
+     * The offset is rounded down to a 4096 byte boundary, so every I/O mode
+     * can continue from it. Verify passes always start from 0.
+     *  @param offset every byte below this offset has been written already
+     */
+    void setStartOffset(uint64_t offset)
+    {
+        startOffset = offset / resumeAlignment * resumeAlignment;
+    }
+
+    /** @brief makes the erase tolerant: read, write and compare failures
+     * are recorded in a map and the pass keeps going, then fails at the
+     * end if anything was recorded. Only the sequential synchronous engines
+     * can do this, so the io_uring, pipelined, parallel and sampled ones are
+     * skipped.
+     *  @param inBadRanges the map, which must outlive the erase, or nullptr
+     * to fail on the first error
+     */
+    void setBadRanges(BadRangeMap* inBadRanges)
+    {
+        badRanges = inBadRanges;
+    }
+
+    /** @brief paces the erase, to leave the device to the other services
+     *  @param inThrottle the throttle, which must outlive the erase, or
+     * nullptr to go as fast as the device allows
+     */
+    void setThrottle(EraseThrottle* inThrottle)
+    {
+        throttle = inThrottle;
+    }
+
   protected:
+    /** @brief starts a pass over the drive, if progress is tracked
+     *  @param totalBytes the bytes the pass will write or verify
+     *  @param doneBytes the bytes done by an earlier run
+     */
+    void progressStart(uint64_t totalBytes, uint64_t doneBytes = 0)
+    {
+        if (progress != nullptr)
+        {
+            progress->start(totalBytes, doneBytes);
+        }
+    }
+
+    /** @brief adds processed bytes, if progress is tracked, then sleeps
+     * as long as the throttle asks. It throws EraseCancelled if the erase
+     * was cancelled, so the engines call it at chunk boundaries.
+     *  @param bytes the bytes just written or verified
+     */
+    void progressAdvance(uint64_t bytes)
+    {
+        if (progress != nullptr)
+        {
+            progress->advance(bytes);
+        }
+        if (throttle != nullptr)
+        {
+            throttle->pace(bytes);
+        }
+    }
+
+    /** @brief reports the device busy with a command that has no
+     * progress of its own, or done with it, if progress is tracked
+     *  @param busy the device runs the command
+     */
+    void progressBusy(bool busy)
+    {
+        if (progress != nullptr)
+        {
+            progress->setDeviceBusy(busy);
+        }
+    }
+
+    /** @brief reports the device busy for its lifetime, so the device is
+     * reported done with the command however the wait for it ends
+     */
+    class BusyScope
+    {
+      public:
+        explicit BusyScope(Erase& erase) : erase(erase)
+        {
+            erase.progressBusy(true);
+        }
+
+        ~BusyScope()
+        {
+            erase.progressBusy(false);
+        }
+
+        BusyScope(const BusyScope&) = delete;
+        BusyScope& operator=(const BusyScope&) = delete;
+
+      private:
+        Erase& erase;
+    };
+
+    /** @brief reports the steps picked for the erase and their estimated
+     * duration, if progress is tracked
+     *  @param steps the steps, e.g. Discard+Sanitize
+     *  @param seconds worst case duration, 0 if not known
+     */
+    void progressPlan(const std::string& steps, uint64_t seconds)
+    {
+        if (progress != nullptr)
+        {
+            progress->setPlan(steps, seconds);
+        }
+    }
+
+    /** @brief reports the end of the erase, if progress is tracked */
+    void progressFinish()
+    {
+        if (progress != nullptr)
+        {
+            progress->finish();
+        }
+    }
+
+    /** @brief check if failures are recorded instead of thrown */
+    bool tolerant() const
+    {
+        return badRanges != nullptr;
+    }
+
+    /** @brief fails a tolerant pass that recorded bad ranges, after
+     * logging a summary of them
+     *  @param pass the name of the pass in the log
+     */
+    void checkBadRanges(const std::string& pass)
+    {
+        if (badRanges == nullptr || badRanges->empty())
+        {
+            return;
+        }
+        lg2::error("Estoraged erase {PASS} found {RANGES} bad ranges, "
+                   "{BYTES} bytes: {READS} read errors, {WRITES} write "
+                   "errors, {MISMATCHES} mismatches",
+                   "PASS", pass, "RANGES", badRanges->ranges().size(),
+                   "BYTES", badRanges->badBytes(), "READS",
+                   badRanges->count(BadRangeKind::Read), "WRITES",
+                   badRanges->count(BadRangeKind::Write), "MISMATCHES",
+                   badRanges->count(BadRangeKind::Mismatch),
+                   "REDFISH_MESSAGE_ID",
+                   std::string("eStorageD.1.0.EraseFailure"));
+        using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+        throw InternalFailure();
+    }
+
     /* The linux path for the block device */
     std::string devPath;
+
+    /* Where to report progress, if anywhere */
+    EraseProgress* progress = nullptr;
+
+    /* What paces the erase, if anything */
+    EraseThrottle* throttle = nullptr;
+
+    /* Offset the overwrite passes start from */
+    uint64_t startOffset = 0;
+
+    /* Where a tolerant erase records failures, nullptr if not tolerant */
+    BadRangeMap* badRanges = nullptr;
+
+    /* Bad ranges and offload requests are in units of 512 byte sectors */
+    static constexpr uint64_t sectorSize = 512;
+
+    /* Resume offsets are aligned for O_DIRECT and offload requests */
+    static constexpr uint64_t resumeAlignment = 4096;
 };
 
 } // namespace estoraged
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "patternGenerator.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace estoraged
+{
+
+/** @brief What an interrupted overwrite needs to resume. */
+struct CheckpointData
+{
+    /** @brief D-Bus name of the erase method. */
+    std::string method;
+    /** @brief Generator of the pattern overwrite. */
+    PatternType patternType = PatternType::Philox;
+    /** @brief Seed of the pattern overwrite. */
+    uint64_t seed = 0;
+    /** @brief Size of the drive when the erase started. */
+    uint64_t driveSize = 0;
+    /** @brief Every byte below this offset has been written. */
+    uint64_t offset = 0;
+
+    bool operator==(const CheckpointData&) const = default;
+};
+
+/** @class EraseCheckpoint
+ *  @brief Small file recording how far an overwrite got, so it can resume
+ *  after a restart of the daemon or the BMC.
+ *  @details The file holds one key=value line per field of CheckpointData.
+ *  Saving first syncs the device, so the recorded offset is never ahead of
+ *  the data on it, then atomically replaces the file.
+ */
+class EraseCheckpoint
+{
+  public:
+    /** @brief Creates a checkpoint for a device.
+     *
+     *  @param[in] file - path of the checkpoint file.
+     *  @param[in] devPath - path of the device the offsets refer to.
+     */
+    EraseCheckpoint(std::filesystem::path file, std::string devPath);
+
+    /** @brief Saves the checkpoint. Errors are logged, not thrown, since
+     *  the erase itself can go on without it.
+     *
+     *  @param[in] data - the checkpoint to save.
+     *  @return true if the checkpoint was saved.
+     */
+    bool save(const CheckpointData& data) const;
+
+    /** @brief Loads the checkpoint.
+     *
+     *  @return the checkpoint, or std::nullopt if there is none or it is
+     *  not valid.
+     */
+    std::optional<CheckpointData> load() const;
+
+    /** @brief Removes the checkpoint, e.g. once the erase completed. */
+    void remove() const;
+
+    /** @brief Minimum time between checkpoints of a running erase. */
+    static constexpr std::chrono::seconds interval{10};
+
+  private:
+    /** @brief Path of the checkpoint file. */
+    std::filesystem::path file;
+
+    /** @brief Path of the device the offsets refer to. */
+    std::string devPath;
+};
+
+} // namespace estoraged
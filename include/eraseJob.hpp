@@ -0,0 +1,153 @@
+#pragma once
+
+#include "badRangeMap.hpp"
+#include "deviceWorker.hpp"
+#include "eraseProgress.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+namespace estoraged
+{
+
+/** @class EraseJob
+ *  @brief D-Bus job object for erases running on the drive's worker.
+ *  @details The job has the xyz.openbmc_project.Common.Progress interface
+ *  for the status, start and completion times, and
+ *  xyz.openbmc_project.eStoraged.EraseJob for the method, bytes processed,
+ *  percent, throughput, estimated time remaining, whether the device is
+ *  busy with a command that has no progress of its own and the steps an
+ *  engine picked with their estimated duration, with the Cancel and Resume
+ *  methods. The erase runs on the DeviceWorker of the drive, after
+ *  any operation queued before it, and posts its updates to the io_context,
+ *  so the properties only change on the D-Bus thread. When it ends, the job
+ *  also publishes the bad ranges a tolerant erase recorded, as offset and
+ *  length pairs, with the failure counts. There is one job object per
+ *  drive, it keeps the final status of an erase until the next one starts.
+ */
+class EraseJob : public std::enable_shared_from_this<EraseJob>
+{
+  public:
+    /** @brief The erase itself, reporting to the given tracker. A
+     *  tolerant erase records its failures in the given map.
+     */
+    using Work = std::function<void(EraseProgress&, BadRangeMap&)>;
+
+    /** @brief Constructor for EraseJob
+     *
+     *  @param[in] io - io_context of the D-Bus connection
+     *  @param[in] server - sdbusplus asio object server
+     *  @param[in] objectPath - D-Bus path of the job object
+     *  @param[in] worker - worker running the operations on the drive
+     *  @param[in] resume - handler of the Resume method, runs on the D-Bus
+     *    thread
+     *  @param[in] finished - called on the D-Bus thread once the final
+     *    status of an erase is published
+     */
+    EraseJob(boost::asio::io_context& io,
+             sdbusplus::asio::object_server& server,
+             const std::string& objectPath, DeviceWorker& worker,
+             std::function<void()> resume, std::function<void()> finished);
+
+    /** @brief Destructor for EraseJob, cancels a running erase without
+     *  waiting for it. The erase stops on the worker, which the owner of
+     *  the job drains.
+     */
+    ~EraseJob();
+
+    EraseJob(const EraseJob&) = delete;
+    EraseJob& operator=(const EraseJob&) = delete;
+    EraseJob(EraseJob&&) = delete;
+    EraseJob& operator=(EraseJob&&) = delete;
+
+    /** @brief Queues an erase on the worker and returns.
+     *  @details The job must be owned by a shared_ptr and not be running.
+     *  StartTime is 0 until the worker starts the erase, which then
+     *  publishes the InProgress status.
+     *
+     *  @param[in] method - D-Bus name of the erase method.
+     *  @param[in] work - the erase to run.
+     *  @param[in] badRangeLimit - (optional) most ranges the map of the
+     *    erase holds.
+     */
+    void start(const std::string& method, Work work,
+               size_t badRangeLimit = BadRangeMap::defaultLimit);
+
+    /** @brief Publishes an erase that a restart interrupted, as aborted.
+     *
+     *  @param[in] method - D-Bus name of the erase method.
+     *  @param[in] status - how far the erase got.
+     */
+    void interrupted(const std::string& method,
+                     const EraseProgressStatus& status);
+
+    /** @brief Asks the running erase to stop at its next chunk boundary. */
+    void cancel();
+
+    /** @brief Check if the erase has not completed yet. */
+    bool isRunning() const;
+
+    /** @brief Minimum time between progress updates. */
+    static constexpr std::chrono::seconds progressInterval{1};
+
+  private:
+    /** @brief Publishes that the erase runs, on the D-Bus thread.
+     *
+     *  @param[in] startTime - when the worker started the erase, in ms
+     *    since the epoch.
+     */
+    void started(uint64_t startTime);
+
+    /** @brief Publishes a progress report, on the D-Bus thread. */
+    void publish(const EraseProgressStatus& status);
+
+    /** @brief Publishes the bad ranges and failure counts of the map. */
+    void publishBadRanges();
+
+    /** @brief Publishes the final status, on the D-Bus thread.
+     *
+     *  @param[in] status - OperationStatus the erase ended with.
+     */
+    void complete(const std::string& status);
+
+    /** @brief io_context of the D-Bus connection. */
+    boost::asio::io_context& io;
+
+    /** @brief D-Bus object server. */
+    sdbusplus::asio::object_server& objectServer;
+
+    /** @brief Common.Progress interface of the job. */
+    std::shared_ptr<sdbusplus::asio::dbus_interface> progressInterface;
+
+    /** @brief Erase details and methods of the job. */
+    std::shared_ptr<sdbusplus::asio::dbus_interface> jobInterface;
+
+    /** @brief Worker running the operations on the drive. */
+    DeviceWorker& worker;
+
+    /** @brief Called once the final status of an erase is published. */
+    std::function<void()> finished;
+
+    /** @brief Tracker the running erase reports to, shared with the erase
+     *  so that it can outlive the job.
+     */
+    std::shared_ptr<EraseProgress> progress;
+
+    /** @brief Bad ranges of the last erase, shared with the erase. */
+    std::shared_ptr<BadRangeMap> badRanges;
+
+    /** @brief Set until the final status is published. */
+    std::atomic<bool> running{false};
+
+    /** @brief Ready once the erase has returned. */
+    std::future<void> done;
+};
+
+} // namespace estoraged
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "badRangeMap.hpp"
+#include "extCsd.hpp"
+#include "patternGenerator.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace estoraged
+{
+
+/** @brief I/O scheduling class of the erase thread. */
+enum class IoClass
+{
+    /** @brief Keep the class of the daemon. */
+    Unchanged,
+    /** @brief Best effort, at ioLevel. */
+    BestEffort,
+    /** @brief Only get the disk when no other task uses it. */
+    Idle,
+};
+
+/** @brief What the eMMC media erase of VendorSanitize must achieve. */
+enum class EmmcErasePolicy
+{
+    /** @brief Always erase, then sanitize. */
+    Legacy,
+    /** @brief The fastest erase that makes the user area read back erased.
+     */
+    Clear,
+    /** @brief The fastest erase that also purges the old copies of the
+     *  data from the flash.
+     */
+    Purge,
+};
+
+/** @brief State the volatile cache of an eMMC is expected in at startup.
+ *  @details The kernel owns CACHE_CTRL: it sets it when it probes the
+ *  device and restores it on resume, so the daemon never switches it and
+ *  only logs a device that differs from the policy.
+ */
+enum class EmmcCachePolicy
+{
+    /** @brief Accept CACHE_CTRL as the kernel set it. */
+    Keep,
+    /** @brief Expect the cache on. */
+    Enable,
+    /** @brief Expect the cache off, or no cache at all. */
+    Disable,
+};
+
+/** @struct EraseOptions
+ *  @brief Tunables for the overwrite and verify erase engines.
+ *  @details The defaults match the original I/O behavior of the engines.
+ *  The values can be overridden by the Entity Manager config object.
+ */
+struct EraseOptions
+{
+    /** @brief Open the device with O_DIRECT, bypassing the page cache. */
+    bool directIo = false;
+
+    /** @brief Size of each read or write in bytes, 0 to derive it from the
+     *  device geometry.
+     */
+    size_t chunkSize = 0;
+
+    /** @brief Number of reads or writes kept in flight with io_uring, 1 to
+     *  use synchronous I/O.
+     */
+    size_t queueDepth = 1;
+
+    /** @brief Largest queueDepth. Every request in flight holds a chunk
+     *  buffer registered with the io_uring ring.
+     */
+    static constexpr size_t maxQueueDepth = 128;
+
+    /** @brief Let the kernel zero the device with BLKZEROOUT, when the
+     *  device can write zeroes itself.
+     */
+    bool zeroOffload = false;
+
+    /** @brief Number of chunks in flight in a synchronous pattern write or
+     *  verify. With 2 or more, a second thread generates the pattern ahead
+     *  of the writes, or reads ahead of the compares. 1 to do both in turn
+     *  on one thread.
+     */
+    size_t pipelineDepth = 1;
+
+    /** @brief Largest pipelineDepth. Every chunk in flight holds a buffer
+     *  of the pool, so the pipeline allocates depth times the chunk size.
+     */
+    static constexpr size_t maxPipelineDepth = 16;
+
+    /** @brief Number of threads a verify splits the device between, 1 to
+     *  verify in order on the calling thread.
+     */
+    size_t verifyThreads = 1;
+
+    /** @brief Confidence of a sampled verify, which reads random chunks
+     *  instead of the whole device. 0 to verify every chunk.
+     */
+    double verifySampleConfidence = 0;
+
+    /** @brief Smallest fraction of chunks left unerased that a sampled
+     *  verify detects with verifySampleConfidence.
+     */
+    double verifySampleDefectRate = 0.001;
+
+    /** @brief Generator of the pattern erase. Minstd writes the pattern of
+     *  older versions, which is much slower.
+     */
+    PatternType patternType = PatternType::Philox;
+
+    /** @brief Keep going past read, write and compare failures, and fail
+     *  at the end of the pass with every bad range in the erase job. Only
+     *  the sequential synchronous engines can, so the io_uring, pipelined,
+     *  parallel and sampled options are ignored. false to stop at the first
+     *  failure.
+     */
+    bool tolerant = false;
+
+    /** @brief Most ranges a tolerant erase reports. Past it, the closest
+     *  ranges are joined into one.
+     */
+    size_t badRangeLimit = BadRangeMap::defaultLimit;
+
+    /** @brief I/O scheduling class the erase runs with, so that it leaves
+     *  the device to the other services sharing it.
+     */
+    IoClass ioClass = IoClass::Unchanged;
+
+    /** @brief Priority within the best effort class, from 0, the highest,
+     *  to 7.
+     */
+    int ioLevel = 4;
+
+    /** @brief Run the erase with the SCHED_IDLE CPU scheduling policy. */
+    bool schedIdle = false;
+
+    /** @brief Nice value the erase runs with, 0 to keep the one of the
+     *  daemon.
+     */
+    int nice = 0;
+
+    /** @brief Most MB/s the erase writes or verifies, 0 for no limit. */
+    double maxThroughput = 0;
+
+    /** @brief Percent of the time tasks may stall on I/O, read from
+     *  ioPressurePath, before the erase backs off. 0 to ignore the I/O
+     *  pressure.
+     */
+    double ioPressureLimit = 0;
+
+    /** @brief PSI file the I/O pressure is read from. The system wide file
+     *  includes the stalls of the erase itself, so the io.pressure file of
+     *  the cgroup of the services to protect is more precise.
+     */
+    std::string ioPressurePath = "/proc/pressure/io";
+
+    /** @brief Start the eMMC sanitize without waiting for it in the ioctl,
+     *  then poll the card status until it is done or sanitizeTimeout
+     *  passes. Since Linux 5.10 the kernel waits inside the ioctl for
+     *  sanitizeTimeout instead. false to wait inside the ioctl for up to an
+     *  hour.
+     */
+    bool sanitizePolling = false;
+
+    /** @brief Seconds a polled sanitize may take before the erase fails. */
+    uint64_t sanitizeTimeout = 3600;
+
+    /** @brief How VendorSanitize picks the eMMC erase commands it runs. */
+    EmmcErasePolicy emmcErasePolicy = EmmcErasePolicy::Legacy;
+
+    /** @brief Seconds between two checks for pending eMMC background
+     *  operations, 0 to never start them from the daemon.
+     */
+    uint64_t bkopsPollInterval = 10;
+
+    /** @brief Seconds without I/O on the eMMC device before the background
+     *  operations that are not critical start.
+     */
+    uint64_t bkopsIdleTime = 30;
+
+    /** @brief State the volatile cache of the eMMC is expected in at
+     *  startup. The cache is flushed on lock and on shutdown either way.
+     */
+    EmmcCachePolicy emmcCachePolicy = EmmcCachePolicy::Keep;
+
+    /** @brief Fastest eMMC bus timing the host supports. The daemon then
+     *  switches to the fastest timing in DEVICE_TYPE up to it. nullopt to
+     *  only switch the parts listed at build time to HS400.
+     */
+    std::optional<HsTiming> emmcMaxBusMode;
+};
+
+} // namespace estoraged
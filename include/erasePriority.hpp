@@ -0,0 +1,54 @@
+#pragma once
+
+#include "eraseOptions.hpp"
+
+#include <sched.h>
+
+#include <optional>
+
+namespace estoraged
+{
+
+/** @class ErasePriority
+ *  @brief Lowers the I/O priority, CPU scheduling policy and nice value of
+ *  the calling thread for the lifetime of the object, as the erase options
+ *  ask, then restores them.
+ *  @details All three are per thread on Linux, so the other work of the
+ *  daemon keeps its priority. Threads the erase engines start inherit
+ *  them. A setting the kernel refuses is logged and skipped, the erase
+ *  still runs.
+ */
+class ErasePriority
+{
+  public:
+    /** @brief Applies the priority of the options to the calling thread.
+     *
+     *  @param[in] options - the erase options.
+     */
+    explicit ErasePriority(const EraseOptions& options);
+
+    /** @brief Restores what the constructor changed. It must run on the
+     *  same thread.
+     */
+    ~ErasePriority();
+
+    ErasePriority(const ErasePriority&) = delete;
+    ErasePriority& operator=(const ErasePriority&) = delete;
+    ErasePriority(ErasePriority&&) = delete;
+    ErasePriority& operator=(ErasePriority&&) = delete;
+
+  private:
+    /** @brief I/O priority before, if it was changed. */
+    std::optional<int> oldIoPriority;
+
+    /** @brief Scheduling policy before, if it was changed. */
+    std::optional<int> oldPolicy;
+
+    /** @brief Scheduling parameters before the policy was changed. */
+    sched_param oldParam{};
+
+    /** @brief Nice value before, if it was changed. */
+    std::optional<int> oldNice;
+};
+
+} // namespace estoraged
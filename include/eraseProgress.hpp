@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace estoraged
+{
+
+/** @brief Thrown at the next chunk boundary after an erase is cancelled. */
+class EraseCancelled : public std::runtime_error
+{
+  public:
+    EraseCancelled() : std::runtime_error("Erase cancelled") {}
+};
+
+/** @brief Snapshot of an erase pass in progress. */
+struct EraseProgressStatus
+{
+    /** @brief Bytes written or verified so far. */
+    uint64_t bytesProcessed = 0;
+    /** @brief Bytes the pass will write or verify. */
+    uint64_t totalBytes = 0;
+    /** @brief Percent complete, 0 to 100. */
+    uint8_t percent = 0;
+    /** @brief Throughput since the previous report, in MB/s. */
+    double throughput = 0;
+    /** @brief Estimated time left from the average throughput, 0 if not
+     *  known yet.
+     */
+    uint64_t secondsRemaining = 0;
+    /** @brief The device runs a command that reports no progress of its
+     *  own, such as a sanitize.
+     */
+    bool deviceBusy = false;
+    /** @brief Steps of the erase, e.g. Discard+Sanitize, empty if the
+     *  engine plans none.
+     */
+    std::string eraseSteps;
+    /** @brief Worst case duration of the planned steps, 0 if not known. */
+    uint64_t estimatedSeconds = 0;
+};
+
+/** @class EraseProgress
+ *  @brief Tracks the bytes processed by an erase pass and reports them at a
+ *  bounded interval.
+ *  @details The erase engines call advance for every chunk, possibly from
+ *  several threads. The callback runs on the thread that crosses the
+ *  interval, so it should only hand the status off, e.g. post it to an
+ *  io_context. The tracker also carries the cancel request for the engines
+ *  and an optional checkpoint hook with its own interval.
+ */
+class EraseProgress
+{
+  public:
+    using Callback = std::function<void(const EraseProgressStatus&)>;
+
+    /** @brief Saves the bytes processed, every one below it being done. */
+    using Checkpoint = std::function<void(uint64_t processed)>;
+
+    /** @brief Creates a progress tracker.
+     *
+     *  @param[in] callback - called with every report.
+     *  @param[in] interval - minimum time between reports while advancing.
+     */
+    explicit EraseProgress(Callback callback,
+                           std::chrono::steady_clock::duration interval =
+                               std::chrono::seconds(1));
+
+    /** @brief Starts a new pass and reports it.
+     *
+     *  @param[in] totalBytes - bytes the pass will write or verify.
+     *  @param[in] doneBytes - (optional) bytes already done by an earlier
+     *  run that this one resumes.
+     */
+    void start(uint64_t totalBytes, uint64_t doneBytes = 0);
+
+    /** @brief Adds to the bytes processed, and reports if the interval has
+     *  passed since the previous report. Safe to call from several threads.
+     *
+     *  @param[in] bytes - bytes just written or verified.
+     *  @throw EraseCancelled if cancel was called.
+     */
+    void advance(uint64_t bytes);
+
+    /** @brief Asks the erase to stop at its next chunk boundary. */
+    void cancel()
+    {
+        cancelled = true;
+    }
+
+    /** @brief Check if cancel was called. */
+    bool isCancelled() const
+    {
+        return cancelled;
+    }
+
+    /** @brief Calls a checkpoint hook on reports at least an interval apart.
+     *  @details The hook runs on the thread making the report. It should
+     *  only be set for passes that process the device in offset order, so
+     *  the bytes processed are also the offset everything below is done.
+     *
+     *  @param[in] hook - called with the bytes processed.
+     *  @param[in] hookInterval - minimum time between calls.
+     */
+    void setCheckpoint(Checkpoint hook,
+                       std::chrono::steady_clock::duration hookInterval);
+
+    /** @brief Reports the end of the erase, regardless of the interval. */
+    void finish();
+
+    /** @brief Reports that the device started or finished a command that
+     *  reports no progress of its own, regardless of the interval.
+     *
+     *  @param[in] busy - the device runs the command.
+     */
+    void setDeviceBusy(bool busy);
+
+    /** @brief Reports the steps an engine picked for the erase and their
+     *  estimated duration, regardless of the interval. Later reports keep
+     *  them.
+     *
+     *  @param[in] steps - the steps, e.g. Discard+Sanitize.
+     *  @param[in] seconds - worst case duration, 0 if not known.
+     */
+    void setPlan(std::string steps, uint64_t seconds);
+
+    /** @brief Get the bytes processed in the current pass. */
+    uint64_t bytesProcessed() const
+    {
+        return processed.load();
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    /** @brief Builds the status and moves the throughput window.
+     *  @details The mutex must be held.
+     */
+    EraseProgressStatus update(Clock::time_point now);
+
+    /** @brief Called with every report. */
+    Callback callback;
+
+    /** @brief Minimum time between reports while advancing. */
+    Clock::duration interval;
+
+    /** @brief Bytes processed in the current pass. */
+    std::atomic<uint64_t> processed{0};
+
+    /** @brief Set by cancel. */
+    std::atomic<bool> cancelled{false};
+
+    /** @brief Earliest time of the next report, in clock ticks. */
+    std::atomic<Clock::rep> nextReport{0};
+
+    /** @brief Serializes reports and the fields below. */
+    std::mutex mutex;
+
+    /** @brief Bytes the current pass will process. */
+    uint64_t total = 0;
+
+    /** @brief Start time and bytes already done of the current pass. */
+    Clock::time_point startTime;
+    uint64_t startBytes = 0;
+
+    /** @brief Time and bytes processed at the previous report. */
+    Clock::time_point lastTime;
+    uint64_t lastBytes = 0;
+
+    /** @brief Set while the device runs a command without progress. */
+    bool deviceBusy = false;
+
+    /** @brief Planned steps and their estimated duration. */
+    std::string planSteps;
+    uint64_t planSeconds = 0;
+
+    /** @brief Checkpoint hook, its interval and next due time. */
+    Checkpoint checkpoint;
+    Clock::duration checkpointInterval{};
+    Clock::time_point nextCheckpoint;
+};
+
+} // namespace estoraged
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "eraseOptions.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace estoraged
+{
+
+/** @class EraseThrottle
+ *  @brief Paces an erase so it leaves the device to the other services
+ *  sharing it.
+ *  @details Two limits, each off when 0:
+ *  - maxThroughput caps the MB/s of the erase. Bytes are paced as they are
+ *    reported, with at most burst of unused time credited after a pause.
+ *  - ioPressureLimit watches the "some" line of the PSI file in
+ *    ioPressurePath every pressureInterval. When tasks stalled on I/O for
+ *    more than that percent of the interval, the erase pauses, twice as
+ *    long every interval the pressure stays up, from minBackoff to
+ *    maxBackoff. Once it is back down, the pause halves every interval.
+ *  The erase engines report their bytes at chunk boundaries through pace,
+ *  which sleeps the calling thread as long as needed. Safe to use from
+ *  several threads, a pause holds them all.
+ */
+class EraseThrottle
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /** @brief How the throttle tells and spends time, for tests. */
+    struct Timer
+    {
+        std::function<Clock::time_point()> now = Clock::now;
+        std::function<void(Clock::duration)> sleep =
+            [](Clock::duration duration) {
+                std::this_thread::sleep_for(duration);
+            };
+    };
+
+    /** @brief Creates a throttle for the limits of the options.
+     *
+     *  @param[in] options - the erase options.
+     */
+    explicit EraseThrottle(const EraseOptions& options);
+
+    /** @brief Creates a throttle that uses its own clock and sleep.
+     *
+     *  @param[in] options - the erase options.
+     *  @param[in] timer - the clock and sleep to use.
+     */
+    EraseThrottle(const EraseOptions& options, Timer timer);
+
+    /** @brief Logs how often the erase backed off, if it did. */
+    ~EraseThrottle();
+
+    EraseThrottle(const EraseThrottle&) = delete;
+    EraseThrottle& operator=(const EraseThrottle&) = delete;
+    EraseThrottle(EraseThrottle&&) = delete;
+    EraseThrottle& operator=(EraseThrottle&&) = delete;
+
+    /** @brief Check if any limit is set. */
+    bool enabled() const;
+
+    /** @brief Accounts for processed bytes, and sleeps until the erase may
+     *  go on.
+     *
+     *  @param[in] bytes - bytes just written or verified.
+     */
+    void pace(uint64_t bytes);
+
+    /** @brief Get the number of times the erase backed off for I/O
+     *  pressure.
+     */
+    uint64_t backoffs() const;
+
+    /** @brief Time between two reads of the I/O pressure. */
+    static constexpr Clock::duration pressureInterval =
+        std::chrono::milliseconds(250);
+
+    /** @brief First pause for I/O pressure. */
+    static constexpr Clock::duration minBackoff =
+        std::chrono::milliseconds(50);
+
+    /** @brief Longest pause for I/O pressure. */
+    static constexpr Clock::duration maxBackoff = std::chrono::seconds(2);
+
+    /** @brief Most unused time a paced erase catches up on. */
+    static constexpr Clock::duration burst = std::chrono::milliseconds(100);
+
+  private:
+    /** @brief Reads the I/O pressure and adjusts the pause. The mutex must
+     *  be held.
+     */
+    void samplePressure(Clock::time_point now);
+
+    /** @brief Reads the total microseconds tasks stalled on I/O. */
+    std::optional<uint64_t> readStallTotal() const;
+
+    /** @brief Clock and sleep. */
+    Timer timer;
+
+    /** @brief Byte cap, in bytes per second, 0 for none. */
+    double bytesPerSecond;
+
+    /** @brief Percent of stall time that makes the erase back off, 0 to
+     *  not read the pressure.
+     */
+    double pressureLimit;
+
+    /** @brief File of the pressure. */
+    std::string pressurePath;
+
+    /** @brief Serializes the fields below. */
+    mutable std::mutex mutex;
+
+    /** @brief When the bytes paced so far are due at the byte cap. */
+    Clock::time_point due;
+
+    /** @brief When the next pressure read is due. */
+    Clock::time_point nextSample;
+
+    /** @brief Time and stall total of the previous pressure read. */
+    Clock::time_point lastSample;
+    std::optional<uint64_t> lastTotal;
+
+    /** @brief Current pause for I/O pressure, 0 if none. */
+    Clock::duration backoff{};
+
+    /** @brief End of the current pause for I/O pressure. */
+    Clock::time_point resumeAt;
+
+    /** @brief Times the erase backed off for I/O pressure. */
+    uint64_t backoffCount = 0;
+};
+
+} // namespace estoraged
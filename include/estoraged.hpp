@@ -1,11 +1,19 @@
 #pragma once
 
+#include "bkopsScheduler.hpp"
 #include "cryptsetupInterface.hpp"
+#include "deviceWorker.hpp"
+#include "eraseCheckpoint.hpp"
+#include "eraseJob.hpp"
+#include "eraseOptions.hpp"
 #include "filesystemInterface.hpp"
+#include "mmcChannel.hpp"
 #include "util.hpp"
 
 #include <libcryptsetup.h>
 
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/spawn.hpp>
 #include <sdbusplus/asio/object_server.hpp>
 #include <sdbusplus/bus.hpp>
 #include <sdbusplus/exception.hpp>
@@ -16,8 +24,10 @@
 #include <xyz/openbmc_project/Inventory/Item/Drive/server.hpp>
 #include <xyz/openbmc_project/Inventory/Item/Volume/server.hpp>
 
+#include <chrono>
 #include <filesystem>
 #include <format>
+#include <functional>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -52,6 +62,19 @@ class BkopsIoctlFailure : public BkopsError
     {}
 };
 
+class CacheError : public std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+class CacheFlushFailure : public CacheError
+{
+  public:
+    CacheFlushFailure(std::string_view dev) :
+        CacheError(std::format("Failed to flush the cache on {}", dev))
+    {}
+};
+
 class HsModeError : public std::runtime_error
 {
   public:
@@ -62,6 +85,9 @@ class HsModeError : public std::runtime_error
 
 /** @class eStoraged
  *  @brief eStoraged object to manage a LUKS encrypted storage device.
+ *  @details The D-Bus methods that block, e.g. formatting or unlocking the
+ *  device, run on the DeviceWorker of the drive and reply once they are
+ *  done, so the D-Bus thread keeps serving requests meanwhile.
  */
 class EStoraged
 {
@@ -69,6 +95,7 @@ class EStoraged
     /** @brief Constructor for eStoraged
      *
      *  @param[in] fd - mmc ioc fd
+     *  @param[in] io - io_context of the D-Bus connection, for erase jobs
      *  @param[in] server - sdbusplus asio object server
      *  @param[in] configPath - path of the config object from Entity Manager
      *  @param[in] devPath - path to device file, e.g. /dev/mmcblk0
@@ -82,12 +109,13 @@ class EStoraged
      *  @param[in] eraseMinGeometry - min geometry to erase if it's specified
      *  @param[in] driveType - type of drive, e.g. HDD vs SSD
      *  @param[in] driveProtocol - protocol used to communicate with drive
+     *  @param[in] eraseOptions - I/O options for the overwrite erase methods
      *  @param[in] cryptInterface - (optional) pointer to CryptsetupInterface
      *    object
      *  @param[in] fsInterface - (optional) pointer to FilesystemInterface
      *    object
      */
-    EStoraged(std::unique_ptr<stdplus::Fd> fd,
+    EStoraged(std::unique_ptr<stdplus::Fd> fd, boost::asio::io_context& io,
               sdbusplus::asio::object_server& server,
               const std::string& configPath, const std::string& devPath,
               const std::string& luksName, uint64_t size, uint8_t lifeTime,
@@ -95,6 +123,7 @@ class EStoraged
               const std::string& locationCode, uint64_t eraseMaxGeometry,
               uint64_t eraseMinGeometry, const std::string& driveType,
               const std::string& driveProtocol,
+              const EraseOptions& eraseOptions,
               std::unique_ptr<CryptsetupInterface> cryptInterface =
                   std::make_unique<Cryptsetup>(),
               std::unique_ptr<FilesystemInterface> fsInterface =
@@ -117,11 +146,21 @@ class EStoraged
                     Volume::FilesystemType type);
 
     /** @brief Erase the contents of the storage device.
+     *  @details The overwrite, verify and sanitize methods run as an erase
+     *  job on the drive's worker and return right away. The job object under
+     *  the drive path reports their progress and final status. The
+     *  overwrites save a checkpoint while they run, so they can be resumed.
      *
      *  @param[in] eraseType - type of erase operation.
      */
     void erase(Volume::EraseMethod eraseType);
 
+    /** @brief Resume the overwrite recorded in the erase checkpoint.
+     *
+     *  @throw ResourceNotFound if there is no checkpoint for this drive
+     */
+    void resumeErase();
+
     /** @brief Unmount filesystem and lock the LUKS device.
      */
     void lock();
@@ -164,6 +203,20 @@ class EStoraged
     static bool enableBackgroundOperation(std::unique_ptr<stdplus::Fd> fd,
                                           std::string_view devPath);
 
+    /** @brief Enable eMMC background operations
+     *  @param[in] mmc - command channel of the device
+     *  @param[in] devPath - mmc device path
+     *
+     *  @details Same as above, with the EXT_CSD cached by the channel.
+     *
+     * @throw BkopsIoctlFailure EXT_CSD can not be read
+     * @throw BkopsEnableFailure Failed to enable BKOPS on the MMC
+     *
+     * @returns true if we enabled the BKOPS on the MMC
+     */
+    static bool enableBackgroundOperation(MmcChannel& mmc,
+                                          std::string_view devPath);
+
     /** @brief Enable eMMC HS Timing Mode
      *  @param[in] fd - mmc ioc fd
      *  @param[in] devPath - mmc device path
@@ -177,6 +230,16 @@ class EStoraged
      */
     static bool changeHsTiming(stdplus::Fd* fd, std::string_view devPath);
 
+    /** @brief Enable eMMC HS Timing Mode
+     *  @param[in] mmc - command channel of the device
+     *  @param[in] devPath - mmc device path
+     *
+     * @throw HsModeError HS timing mode is not set properly
+     *
+     * @returns true if we enabled the HS timing mode on the MMC
+     */
+    static bool changeHsTiming(MmcChannel& mmc, std::string_view devPath);
+
     /** @brief Enable eMMC HS Timing Mode if it is the applied parts
      *  @param[in] fd - mmc ioc fd
      *  @param[in] devPath - mmc device path
@@ -193,6 +256,75 @@ class EStoraged
     static bool changeHsTimingIfNeeded(
         stdplus::Fd* fd, std::string_view devPath, std::string_view partNumber);
 
+    /** @brief Enable eMMC HS Timing Mode if it is the applied parts
+     *  @param[in] mmc - command channel of the device
+     *  @param[in] devPath - mmc device path
+     *  @param[in] partNumber - part number to check if this feature should be
+     * enabled
+     *
+     * @throw HsModeError HS timing mode is not set properly
+     *
+     * @returns true if we enabled the HS timing mode on the MMC
+     */
+    static bool changeHsTimingIfNeeded(MmcChannel& mmc,
+                                       std::string_view devPath,
+                                       std::string_view partNumber);
+
+    /** @brief Switch the eMMC to the fastest bus timing it and the host
+     * support
+     *  @param[in] mmc - command channel of the device
+     *  @param[in] devPath - mmc device path
+     *  @param[in] hostMax - fastest timing the host supports
+     *
+     *  @details Picks the timing from DEVICE_TYPE, and only switches if it
+     * is faster than the current HS_TIMING. The switch is checked by
+     * reading EXT_CSD again.
+     *
+     * @throw HsModeError EXT_CSD can not be read, or the switch failed
+     *
+     * @returns the timing in use
+     */
+    static HsTiming negotiateHsTiming(MmcChannel& mmc,
+                                      std::string_view devPath,
+                                      HsTiming hostMax);
+
+    /** @brief Check the eMMC volatile cache against the cache policy
+     *  @param[in] mmc - command channel of the device
+     *  @param[in] devPath - mmc device path
+     *  @param[in] policy - whether the cache is expected on or off
+     *
+     *  @details Logs the cache size, and a warning if CACHE_CTRL is not in
+     * the state the policy expects. CACHE_CTRL is left to the kernel. A
+     * device without a cache counts as one with the cache off.
+     *
+     * @returns true if the cache is as the policy expects
+     */
+    static bool checkCache(MmcChannel& mmc, std::string_view devPath,
+                               EmmcCachePolicy policy);
+
+    /** @brief Write the eMMC volatile cache back to the flash
+     *  @param[in] mmc - command channel of the device
+     *  @param[in] devPath - mmc device path
+     *
+     *  @details Does nothing when the cache is off or missing.
+     *
+     * @throw CacheFlushFailure FLUSH_CACHE failed
+     *
+     * @returns true if we flushed the cache
+     */
+    static bool flushCache(MmcChannel& mmc, std::string_view devPath);
+
+    /** @brief Longest a cache flush may keep the device busy, in ms, the
+     *  same as the kernel.
+     */
+    static constexpr uint32_t cacheFlushTimeoutMs = 30000;
+
+    /** @brief Longest the destructor waits for a running erase job. It
+     *  leaves time for the flush of every drive within the 90 s stop
+     *  timeout of systemd.
+     */
+    static constexpr std::chrono::milliseconds workerStopTimeout{10000};
+
   private:
     /** @brief Full path of the device file, e.g. /dev/mmcblk0. */
     std::string devPath;
@@ -209,6 +341,14 @@ class EStoraged
     /** @brief Min geometry to erase. */
     uint64_t eraseMinGeometry;
 
+    /** @brief I/O options for the overwrite erase methods. */
+    EraseOptions eraseOptions;
+
+    /** @brief Command channel of the eMMC, shared with the erases, nullptr
+     *  if the device could not be opened.
+     */
+    std::shared_ptr<MmcChannel> mmc;
+
     /** @brief Indicates whether the LUKS device is currently locked. */
     bool lockedProperty{false};
 
@@ -225,15 +365,43 @@ class EStoraged
     /** @brief Path where the mapped crypt device gets created. */
     const std::string cryptDevicePath;
 
+    /** @brief io_context of the D-Bus connection. */
+    boost::asio::io_context& io;
+
     /** @brief D-Bus object server. */
     sdbusplus::asio::object_server& objectServer;
 
+    /** @brief D-Bus path of the erase job object. */
+    std::string eraseJobPath;
+
+    /** @brief Worker running the blocking operations on the drive.
+     *  @details Declared before the erase job, which waits for its erase
+     *  to stop on destruction.
+     */
+    DeviceWorker worker;
+
+    /** @brief Erase job object, created with the first erase job. */
+    std::shared_ptr<EraseJob> eraseJob;
+
+    /** @brief Runs the manual background operations of the eMMC, nullptr
+     *  if the device does not need them or they are disabled.
+     */
+    std::shared_ptr<BkopsScheduler> bkopsScheduler;
+
+    /** @brief Progress of an interrupted overwrite. */
+    EraseCheckpoint checkpoint;
+
     /** @brief D-Bus interface for the logical volume. */
     std::shared_ptr<sdbusplus::asio::dbus_interface> volumeInterface;
 
     /** @brief D-Bus interface for the physical drive. */
     std::shared_ptr<sdbusplus::asio::dbus_interface> driveInterface;
 
+    /** @brief D-Bus interface for the eMMC bus mode, nullptr if the device
+     *  could not be opened.
+     */
+    std::shared_ptr<sdbusplus::asio::dbus_interface> emmcInterface;
+
     /** @brief D-Bus interface for the location type of the drive. */
     std::shared_ptr<sdbusplus::asio::dbus_interface> embeddedLocationInterface;
 
@@ -246,10 +414,76 @@ class EStoraged
     /** @brief Association between chassis and drive. */
     std::shared_ptr<sdbusplus::asio::dbus_interface> association;
 
-    /** @brief Indicates whether the LUKS header is on the disk. */
+    /** @brief Indicates whether the LUKS header is on the disk, Unknown
+     *  until the header is first loaded.
+     *  @details Only read and written on the D-Bus thread.
+     */
     Drive::DriveEncryptionState encryptionStatus{
         Drive::DriveEncryptionState::Unknown};
 
+    /** @brief Run a blocking D-Bus method on the worker.
+     *  @details Fails with Unavailable while an erase job runs, instead of
+     *  holding the method call until the erase is done.
+     *
+     *  @param[in] yield - context of the D-Bus method handler.
+     *  @param[in] operation - the method.
+     */
+    void runOnWorker(boost::asio::yield_context yield,
+                     const std::function<void()>& operation);
+
+    /** @brief Run a D-Bus method that may rewrite the LUKS header on the
+     *  worker, then reload the header and publish the encryption status.
+     *  @details The status is reloaded even if the method fails.
+     *
+     *  @param[in] yield - context of the D-Bus method handler.
+     *  @param[in] operation - the method.
+     */
+    void runChangingHeader(boost::asio::yield_context yield,
+                           const std::function<void()>& operation);
+
+    /** @brief Update the cached encryption status, on the D-Bus thread.
+     *  @details Emits PropertiesChanged if the status changed.
+     *
+     *  @param[in] status - the status of the loaded header.
+     */
+    void setEncryptionStatus(Drive::DriveEncryptionState status);
+
+    /** @brief Reload the header on the worker once an erase job is done,
+     *  then publish the encryption status on the D-Bus thread.
+     */
+    void reloadEncryptionStatus();
+
+    /** @brief Run an erase method that does not run as a job.
+     *
+     *  @param[in] eraseType - type of erase operation.
+     */
+    void eraseNow(Volume::EraseMethod eraseType);
+
+    /** @brief Get the erase job object, creating it if needed. */
+    EraseJob& getEraseJob();
+
+    /** @brief Start the BKOPS scheduler if the eMMC is in manual BKOPS mode.
+     *
+     *  @param[in] objectPath - D-Bus path of the drive.
+     */
+    void startBkopsScheduler(const std::string& objectPath);
+
+    /** @brief Run an erase as a job on a worker thread.
+     *
+     *  @param[in] eraseType - type of erase operation.
+     *  @param[in] work - the erase, reporting to the job's tracker.
+     */
+    void startEraseJob(Volume::EraseMethod eraseType, EraseJob::Work work);
+
+    /** @brief Run a zero or pattern overwrite as a job, saving checkpoints.
+     *
+     *  @param[in] eraseType - LogicalOverWrite or ZeroOverWrite.
+     *  @param[in] options - I/O options for the overwrite.
+     *  @param[in] startOffset - offset to resume from, 0 for a new erase.
+     */
+    void startOverwriteJob(Volume::EraseMethod eraseType,
+                           const EraseOptions& options, uint64_t startOffset);
+
     /** @brief Format LUKS encrypted device.
      *
      *  @param[in] password - password to set for the LUKS device.
@@ -262,13 +496,18 @@ class EStoraged
      */
     CryptHandle loadLuksHeader();
 
-    /** @brief Unlock the device.
+    /** @brief Load the LUKS header to find whether the device is encrypted.
+     *  @details This reads the disk, so the result is cached in
+     *  encryptionStatus.
      *
-     *  @param[in] password - password to activate the LUKS device.
+     *  @returns Encrypted if the header loads, Unencrypted otherwise.
      */
-
     Drive::DriveEncryptionState findEncryptionStatus();
 
+    /** @brief Unlock the device.
+     *
+     *  @param[in] password - password to activate the LUKS device.
+     */
     void activateLuksDev(std::vector<uint8_t> password);
 
     /** @brief Create the filesystem on the LUKS device.
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace estoraged
+{
+
+/** @brief Size of the EXT_CSD register in bytes. */
+constexpr size_t extCsdSize = 512;
+
+/** @brief Byte offsets of the EXT_CSD fields eStoraged uses, see eMMC spec
+ *  7.4.
+ */
+namespace extcsd
+{
+constexpr size_t flushCache = 32;
+constexpr size_t cacheCtrl = 33;
+constexpr size_t bkopsEn = 163;
+constexpr size_t bkopsStart = 164;
+constexpr size_t sanitizeStart = 165;
+constexpr size_t eraseGroupDef = 175;
+constexpr size_t hsTiming = 185;
+constexpr size_t rev = 192;
+constexpr size_t deviceType = 196;
+constexpr size_t secCount = 212;
+constexpr size_t eraseTimeoutMult = 223;
+constexpr size_t hcEraseGrpSize = 224;
+constexpr size_t secTrimMult = 229;
+constexpr size_t secEraseMult = 230;
+constexpr size_t secFeatureSupport = 231;
+constexpr size_t trimMult = 232;
+constexpr size_t bkopsStatus = 246;
+constexpr size_t cacheSize = 249;
+constexpr size_t preEolInfo = 267;
+constexpr size_t lifeTimeEstA = 268;
+constexpr size_t lifeTimeEstB = 269;
+constexpr size_t bkopsSupport = 502;
+} // namespace extcsd
+
+/** @brief Bus timing selected in HS_TIMING. */
+enum class HsTiming : uint8_t
+{
+    Legacy = 0,
+    HighSpeed = 1,
+    Hs200 = 2,
+    Hs400 = 3,
+};
+
+/** @brief Urgency of the background operations the device has pending, from
+ *  BKOPS_STATUS.
+ */
+enum class BkopsStatus : uint8_t
+{
+    None = 0,
+    NonCritical = 1,
+    PerformanceImpacted = 2,
+    Critical = 3,
+};
+
+/** @brief Wear of the reserved blocks, from PRE_EOL_INFO. */
+enum class PreEolInfo : uint8_t
+{
+    Undefined = 0,
+    Normal = 1,
+    Warning = 2,
+    Urgent = 3,
+};
+
+/** @brief Converts the two DEVICE_LIFE_TIME_EST estimates into the life
+ *  left of the more worn memory type.
+ *  @details The estimates are 0x01 for 0% - 10% of the life used, up to
+ *  0x0A for 90% - 100% and 0x0B past the estimated life.
+ *
+ *  @param[in] estA - estimate for type A memory.
+ *  @param[in] estB - estimate for type B memory.
+ *  @return percent of the life left, or 255 if an estimate is not valid.
+ */
+uint8_t lifeLeftPercent(uint8_t estA, uint8_t estB);
+
+/** @brief Picks the fastest bus timing that the device and the host support.
+ *  @details HS400 and HS200 need the host to tune the bus or drive an 8 bit
+ *  bus, so the host limit must come from the board, EXT_CSD can't tell.
+ *
+ *  @param[in] deviceType - DEVICE_TYPE of the device.
+ *  @param[in] hostMax - fastest timing the host supports.
+ *  @return the timing, Legacy if the device supports no high speed mode.
+ */
+HsTiming fastestHsTiming(uint8_t deviceType, HsTiming hostMax);
+
+/** @brief Get the name of a bus timing, e.g. HS400. */
+std::string hsTimingName(HsTiming timing);
+
+/** @class ExtCsd
+ *  @brief Typed view of a copy of the EXT_CSD register.
+ */
+class ExtCsd
+{
+  public:
+    using Raw = std::array<uint8_t, extCsdSize>;
+
+    /** @brief Creates a register of zeroes. */
+    ExtCsd() = default;
+
+    /** @brief Creates the view of a register read from the device. */
+    explicit ExtCsd(std::span<const uint8_t, extCsdSize> bytes)
+    {
+        std::ranges::copy(bytes, raw.begin());
+    }
+
+    /** @brief Get the raw register, for the parsers of whole features. */
+    std::span<const uint8_t, extCsdSize> bytes() const
+    {
+        return raw;
+    }
+
+    /** @brief Get one byte of the register. */
+    uint8_t byte(size_t offset) const
+    {
+        return raw.at(offset);
+    }
+
+    /** @brief Get EXT_CSD_REV, e.g. 8 for eMMC 5.1. */
+    uint8_t revision() const
+    {
+        return raw[extcsd::rev];
+    }
+
+    /** @brief Get SEC_COUNT, the user area size in sectors of 512 bytes, 0
+     *  for a byte addressed device of 2 GB or less.
+     */
+    uint32_t sectorCount() const;
+
+    /** @brief Get the user area size in bytes, 0 if SEC_COUNT is not set. */
+    uint64_t capacity() const
+    {
+        return uint64_t{sectorCount()} * 512;
+    }
+
+    /** @brief Get CACHE_SIZE in bytes, 0 if the device has no cache. */
+    uint64_t cacheSize() const;
+
+    /** @brief Check CACHE_CTRL, whether the cache is on. */
+    bool cacheEnabled() const
+    {
+        return (raw[extcsd::cacheCtrl] & 0x1) != 0;
+    }
+
+    /** @brief Check BKOPS_SUPPORT. */
+    bool bkopsSupported() const
+    {
+        return (raw[extcsd::bkopsSupport] & 0x1) != 0;
+    }
+
+    /** @brief Get BKOPS_EN, the manual and auto enable bits. */
+    uint8_t bkopsEnabled() const
+    {
+        return raw[extcsd::bkopsEn];
+    }
+
+    /** @brief Get BKOPS_STATUS. */
+    BkopsStatus bkopsStatus() const
+    {
+        return static_cast<BkopsStatus>(raw[extcsd::bkopsStatus] & 0x3);
+    }
+
+    /** @brief Get the timing interface of HS_TIMING, without the driver
+     *  strength.
+     */
+    HsTiming hsTiming() const
+    {
+        return static_cast<HsTiming>(raw[extcsd::hsTiming] & 0xF);
+    }
+
+    /** @brief Get DEVICE_TYPE, the bus modes the device supports. */
+    uint8_t deviceType() const
+    {
+        return raw[extcsd::deviceType];
+    }
+
+    /** @brief Get PRE_EOL_INFO. */
+    PreEolInfo preEolInfo() const
+    {
+        return static_cast<PreEolInfo>(raw[extcsd::preEolInfo] & 0x3);
+    }
+
+    /** @brief Get the life left from DEVICE_LIFE_TIME_EST_TYP_A and B, 255
+     *  if not reported.
+     */
+    uint8_t lifeLeftPercent() const
+    {
+        return estoraged::lifeLeftPercent(raw[extcsd::lifeTimeEstA],
+                                          raw[extcsd::lifeTimeEstB]);
+    }
+
+  private:
+    /** @brief The register. */
+    Raw raw{};
+};
+
+} // namespace estoraged
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "extCsd.hpp"
+
+#include <linux/mmc/ioctl.h>
+#include <sys/ioctl.h>
+
+#include <stdplus/fd/intf.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace estoraged
+{
+
+// can't use the real mmc_ioc_multi_cmd b/c of zero length array
+// see uapi/linux/mmc/ioctl.h
+struct MmcIoMultiCmdErase
+{
+    uint64_t num_of_cmds;
+    struct mmc_ioc_cmd cmds[3]; // NOLINT (c arrays usage)
+};
+
+class IOCTLWrapperInterface
+{
+  public:
+    /** @brief Wrapper around ioctl
+     *  @details Used for mocking purposes.
+     *
+     * @param[in] devPath - File name of block device
+     * @param[in] request - Device-dependent request code
+     * @param[in] mmc_ioc_cmd - eMMC cmd
+     */
+    virtual int doIoctl(std::string_view devPath, unsigned long request,
+                        struct mmc_ioc_cmd data) = 0;
+
+    /** @brief Wrapper around ioctl, returning the response of the command
+     *  @details Used for mocking purposes.
+     *
+     * @param[in] devPath - File name of block device
+     * @param[in] request - Device-dependent request code
+     * @param[in,out] mmc_ioc_cmd - eMMC cmd, with its response on return
+     */
+    virtual int doIoctlResponse(std::string_view devPath,
+                                unsigned long request,
+                                struct mmc_ioc_cmd& data) = 0;
+
+    /** @brief Wrapper around ioctl
+     *  @details Used for mocking purposes.
+     *
+     * @param[in] devPath - File name of block device
+     * @param[in] request - Device-dependent request code
+     * @param[in] mmc_io_mutli_cmd - many eMMC cmd
+     */
+    virtual int doIoctlMulti(std::string_view devPath, unsigned long request,
+                             struct MmcIoMultiCmdErase data) = 0;
+
+    virtual ~IOCTLWrapperInterface() = default;
+    IOCTLWrapperInterface() = default;
+    IOCTLWrapperInterface(const IOCTLWrapperInterface&) = delete;
+    IOCTLWrapperInterface& operator=(const IOCTLWrapperInterface&) = delete;
+
+    IOCTLWrapperInterface(IOCTLWrapperInterface&&) = delete;
+    IOCTLWrapperInterface& operator=(IOCTLWrapperInterface&&) = delete;
+};
+
+// mockIOCTLWapper also inherits from IOCTLWrapperInterface
+class IOCTLWrapperImpl : public IOCTLWrapperInterface
+{
+  public:
+    int doIoctl(std::string_view devPath, unsigned long request,
+                struct mmc_ioc_cmd data) override;
+    int doIoctlResponse(std::string_view devPath, unsigned long request,
+                        struct mmc_ioc_cmd& data) override;
+    int doIoctlMulti(std::string_view devPath, unsigned long request,
+                     struct MmcIoMultiCmdErase data) override;
+    ~IOCTLWrapperImpl() override = default;
+
+    /** @brief Opens the device on the first ioctl, and keeps it open */
+    IOCTLWrapperImpl() = default;
+
+    /** @brief Sends the ioctls to a device already open
+     *
+     * @param[in] inFd - the device, owned by the wrapper
+     */
+    explicit IOCTLWrapperImpl(std::unique_ptr<stdplus::Fd> inFd) :
+        ownedFd(std::move(inFd)), fd(ownedFd.get())
+    {}
+
+    /** @brief Sends the ioctls to a device already open
+     *
+     * @param[in] inFd - the device, which must outlive the wrapper
+     */
+    explicit IOCTLWrapperImpl(stdplus::Fd& inFd) : fd(&inFd) {}
+
+    IOCTLWrapperImpl(const IOCTLWrapperImpl&) = delete;
+    IOCTLWrapperImpl& operator=(const IOCTLWrapperImpl&) = delete;
+
+    IOCTLWrapperImpl(IOCTLWrapperImpl&&) = delete;
+    IOCTLWrapperImpl& operator=(IOCTLWrapperImpl&&) = delete;
+
+  private:
+    /** @brief Get the open device, opening devPath the first time. */
+    stdplus::Fd& device(std::string_view devPath);
+
+    /** @brief Device opened or given to the wrapper. */
+    std::unique_ptr<stdplus::Fd> ownedFd;
+
+    /** @brief Device the ioctls go to, nullptr until opened. */
+    stdplus::Fd* fd = nullptr;
+};
+
+/** @class MmcChannel
+ *  @brief Sends the commands of one eMMC device and caches its EXT_CSD.
+ *  @details Every subsystem that talks to the device goes through its
+ *  channel, so the device stays open and the commands are serialized. The
+ *  EXT_CSD register is read on first use and kept until a SWITCH command,
+ *  the only one that changes it, after which the next use reads it again.
+ */
+class MmcChannel
+{
+  public:
+    /** @brief Creates the channel of a device.
+     *
+     * @param[in] inDevPath - the linux device path for the block device.
+     * @param[in] inIOCTL - ioctl wrapper, it can be used for testing
+     */
+    explicit MmcChannel(std::string_view inDevPath,
+                        std::unique_ptr<IOCTLWrapperInterface> inIOCTL =
+                            std::make_unique<IOCTLWrapperImpl>()) :
+        devPath(inDevPath), ioctlWrapper(std::move(inIOCTL))
+    {}
+
+    /** @brief Get the device path. */
+    std::string_view path() const
+    {
+        return devPath;
+    }
+
+    /** @brief Get the EXT_CSD register, reading it if the cached copy is
+     * missing or stale
+     *  @return the register, or nullopt if it can not be read
+     */
+    std::optional<ExtCsd> extCsd();
+
+    /** @brief Drops the cached EXT_CSD, so the next use reads it again */
+    void invalidate();
+
+    /** @brief Sends a command without data
+     *  @details A SWITCH makes the cached EXT_CSD stale.
+     *
+     * @param[in] cmd - the command
+     * @return the ioctl result, 0 on success
+     */
+    int command(const struct mmc_ioc_cmd& cmd);
+
+    /** @brief Sends a command and returns its response in cmd
+     *  @details A SWITCH makes the cached EXT_CSD stale.
+     *
+     * @param[in,out] cmd - the command, with its response on return
+     * @return the ioctl result, 0 on success
+     */
+    int commandResponse(struct mmc_ioc_cmd& cmd);
+
+    /** @brief Sends a sequence of commands
+     *
+     * @param[in] cmds - the commands
+     * @return the ioctl result, 0 on success
+     */
+    int multiCommand(const struct MmcIoMultiCmdErase& cmds);
+
+    /** @brief Get how many times EXT_CSD was read from the device. */
+    uint64_t extCsdReads() const
+    {
+        return reads;
+    }
+
+  private:
+    /** @brief Reads EXT_CSD into the cache, with the mutex held. */
+    void readExtCsd();
+
+    /* Device path */
+    std::string devPath;
+
+    /* Wrapper for ioctl */
+    std::unique_ptr<IOCTLWrapperInterface> ioctlWrapper;
+
+    /* Serializes the commands and the cache */
+    std::mutex mutex;
+
+    /* Cached EXT_CSD, nullopt if not read or stale */
+    std::optional<ExtCsd> cached;
+
+    /* EXT_CSD reads from the device */
+    std::atomic<uint64_t> reads{0};
+};
+
+} // namespace estoraged
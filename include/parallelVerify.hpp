@@ -0,0 +1,58 @@
+#pragma once
+
+#include "bufferPool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+
+namespace estoraged
+{
+
+/** @brief Checks one chunk of a verify.
+ *
+ *  @param[in] worker - index of the thread doing the check.
+ *  @param[in] offset - offset of the chunk on the device.
+ *  @param[in] data - the bytes read from the device.
+ *  @param[in] scratch - a buffer of the same size owned by the worker, e.g.
+ *  for the expected data.
+ *  @return index of the first byte of data that is wrong, or data.size()
+ *  if the chunk is correct.
+ */
+using VerifyCheck =
+    std::function<size_t(size_t worker, uint64_t offset,
+                         std::span<const std::byte> data,
+                         std::span<std::byte> scratch)>;
+
+/** @brief Reads a full buffer with pread, retrying short reads.
+ *  @details Throws InternalFailure on errors or if the device keeps
+ *  returning short reads.
+ *
+ *  @param[in] fd - file descriptor of the device.
+ *  @param[out] buf - buffer to fill.
+ *  @param[in] offset - offset on the device to read from.
+ */
+void readAt(int fd, std::span<std::byte> buf, uint64_t offset);
+
+/** @brief Verifies a device with several threads.
+ *  @details The device is split into one contiguous range per thread, in
+ *  whole chunks of the pool buffer size. Each thread reads its range with
+ *  pread, so the threads share fd. Worker w uses pool buffers 2w and
+ *  2w + 1. Threads stop early once a mismatch before their position is
+ *  found. Read errors throw InternalFailure after all threads are done.
+ *
+ *  @param[in] fd - file descriptor of the device.
+ *  @param[in] size - number of bytes to verify from offset 0.
+ *  @param[in] threads - number of threads.
+ *  @param[in] pool - buffers for the threads, at least 2 * threads.
+ *  @param[in] check - called for every chunk, from the worker threads.
+ *  @return offset of the first wrong byte on the device, or nullopt if the
+ *  whole range is correct.
+ */
+std::optional<uint64_t> parallelVerify(int fd, uint64_t size, size_t threads,
+                                       BufferPool& pool,
+                                       const VerifyCheck& check);
+
+} // namespace estoraged
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "eraseOptions.hpp"
+#include "extCsd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace estoraged
+{
+
+/** @struct PartProfile
+ *  @brief Tuning of one eMMC part, every field unset keeps the default.
+ */
+struct PartProfile
+{
+    std::optional<HsTiming> emmcMaxBusMode;
+    std::optional<size_t> chunkSize;
+    std::optional<size_t> queueDepth;
+    std::optional<uint64_t> bkopsPollInterval;
+    std::optional<uint64_t> bkopsIdleTime;
+    std::optional<EmmcCachePolicy> emmcCachePolicy;
+    std::optional<uint64_t> eraseMaxGeometry;
+    std::optional<uint64_t> eraseMinGeometry;
+
+    /** @brief Sets the options the profile holds.
+     *
+     *  @param[in,out] options - the options to tune.
+     */
+    void apply(EraseOptions& options) const;
+};
+
+/** @class PartProfileTable
+ *  @brief Tuning profiles of the eMMC parts, loaded once at startup.
+ *  @details The JSON file holds a "Profiles" array. Each profile names the
+ *  part with the sysfs "Name" of the device and, optionally, its
+ *  "Manufacturer" id as in the sysfs manfid file, e.g. "0x000015". The
+ *  other keys are the ones of the Entity Manager config: EmmcMaxBusMode,
+ *  EraseChunkSize, EraseQueueDepth, BkopsPollInterval, BkopsIdleTime,
+ *  EmmcCachePolicy, EraseMaxGeometry and EraseMinGeometry. The Entity
+ *  Manager config of the drive overrides its profile.
+ */
+class PartProfileTable
+{
+  public:
+    /** @brief Creates an empty table. */
+    PartProfileTable() = default;
+
+    /** @brief Parses the profiles from JSON text.
+     *  @details Malformed profiles and values are logged and skipped.
+     *
+     *  @param[in] json - the text of the file.
+     *  @return the table, empty if the text is not valid JSON.
+     */
+    static PartProfileTable parse(std::string_view json);
+
+    /** @brief Loads the profiles from a file.
+     *
+     *  @param[in] path - the JSON file.
+     *  @return the table, empty if the file is missing or not valid.
+     */
+    static PartProfileTable load(const std::filesystem::path& path);
+
+    /** @brief Finds the profile of a part.
+     *  @details A profile for the manufacturer and name wins over one for
+     *  the name only.
+     *
+     *  @param[in] manufacturer - the sysfs manfid of the device.
+     *  @param[in] name - the sysfs name of the device.
+     *  @return the profile, or nullptr if the part has none.
+     */
+    const PartProfile* find(std::string_view manufacturer,
+                            std::string_view name) const;
+
+    /** @brief Get the number of profiles. */
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+  private:
+    struct Entry
+    {
+        std::string name;
+        std::string manufacturer;
+        PartProfile profile;
+    };
+
+    /** @brief Profiles sorted by name, then manufacturer. */
+    std::vector<Entry> entries;
+};
+
+} // namespace estoraged
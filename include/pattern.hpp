@@ -1,12 +1,16 @@
 #pragma once
 
+#include "bufferPool.hpp"
 #include "erase.hpp"
+#include "eraseOptions.hpp"
+#include "patternGenerator.hpp"
 #include "util.hpp"
 
 #include <stdplus/fd/create.hpp>
 #include <stdplus/fd/managed.hpp>
 
 #include <chrono>
+#include <memory>
 #include <span>
 #include <string>
 
@@ -20,18 +24,19 @@ class Pattern : public Erase
     /** @brief Creates a pattern erase object.
      *
      *  @param[in] inDevPath - the linux device path for the block device.
+     *  @param[in] inOptions - (optional) I/O options for the erase.
      */
-    Pattern(std::string_view inDevPath) : Erase(inDevPath) {}
+    Pattern(std::string_view inDevPath, const EraseOptions& inOptions = {}) :
+        Erase(inDevPath), options(inOptions),
+        pool(BufferPool::forErase(erasePoolSize(options), options, {},
+                                  blockSize)),
+        generator(makePatternGenerator(options.patternType, seed))
+    {}
 
     /** @brief writes an incompressible random pattern to the drive, using
      * default parameters. It also throws errors accordingly.
      */
-    void writePattern()
-    {
-        stdplus::fd::Fd&& fd =
-            stdplus::fd::open(devPath, stdplus::fd::OpenAccess::WriteOnly);
-        writePattern(util::findSizeOfBlockDevice(devPath), fd);
-    }
+    void writePattern();
 
     /** @brief writes an incompressible random pattern to the drive
      * and throws errors accordingly.
@@ -44,12 +49,7 @@ class Pattern : public Erase
     /** @brief verifies the incompressible random pattern is on the drive, using
      * default parameters. It also throws errors accordingly.
      */
-    void verifyPattern()
-    {
-        stdplus::fd::Fd&& fd =
-            stdplus::fd::open(devPath, stdplus::fd::OpenAccess::ReadOnly);
-        verifyPattern(util::findSizeOfBlockDevice(devPath), fd);
-    }
+    void verifyPattern();
 
     /** @brief verifies the incompressible random pattern is on the drive
      * and throws errors accordingly.
@@ -59,12 +59,71 @@ class Pattern : public Erase
      */
     void verifyPattern(uint64_t driveSize, Fd& fd);
 
-  private:
+    /** @brief writes the pattern to the drive with io_uring, keeping the
+     * queue depth from the options in flight. It throws errors accordingly.
+     *
+     *  @param[in] driveSize - Size of the block device
+     *  @param[in] fd - the file descriptor of the block device
+     *  @return false if io_uring is not enabled or not available, in which
+     * case nothing was written
+     */
+    bool writePatternUring(uint64_t driveSize, int fd);
+
+    /** @brief verifies the pattern is on the drive with io_uring, keeping the
+     * queue depth from the options in flight. It throws errors accordingly.
+     *
+     *  @param[in] driveSize - Size of the block device
+     *  @param[in] fd - the file descriptor of the block device
+     *  @return false if io_uring is not enabled or not available, in which
+     * case nothing was verified
+     */
+    bool verifyPatternUring(uint64_t driveSize, int fd);
+
+    /** @brief verifies the pattern is on the drive with the number of
+     * threads from the options, each reading its own range. It throws
+     * errors accordingly.
+     *
+     *  @param[in] driveSize - Size of the block device
+     *  @param[in] fd - the file descriptor of the block device
+     *  @return false if only one verify thread is configured, in which case
+     * nothing was verified
+     */
+    bool verifyPatternParallel(uint64_t driveSize, int fd);
+
+    /** @brief verifies the pattern is on a random sample of the drive, sized
+     * from the confidence in the options. The sample size and coverage are
+     * logged. It throws errors accordingly.
+     *
+     *  @param[in] driveSize - Size of the block device
+     *  @param[in] fd - the file descriptor of the block device
+     *  @return false if sampling is not enabled, in which case nothing was
+     * verified
+     */
+    bool verifyPatternSampled(uint64_t driveSize, int fd);
+
+    /* @brief the fixed seed of the pattern, so it can be verified later */
     static constexpr uint32_t seed = 0x6a656272;
+
+  private:
+    /** @brief opens the device, with O_DIRECT and buffers sized from the
+     * device geometry if direct I/O is enabled.
+     *  @param[in] access - the access mode to open the device with
+     */
+    stdplus::fd::ManagedFd openDevice(stdplus::fd::OpenAccess access);
+
+    /* the chunk size when not using direct I/O */
     static constexpr size_t blockSize = 4096;
-    static constexpr size_t blockSizeUsing32 = blockSize / sizeof(uint32_t);
     static constexpr size_t maxRetry = 32;
     static constexpr std::chrono::duration delay = std::chrono::milliseconds(1);
+
+    /* I/O options for the erase */
+    EraseOptions options;
+
+    /* Buffers reused by every chunk of the write and verify */
+    BufferPool pool;
+
+    /* Source of the pattern, seeded with the fixed seed */
+    std::unique_ptr<PatternGenerator> generator;
 };
 
 } // namespace estoraged
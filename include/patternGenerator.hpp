@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace estoraged
+{
+
+/** @brief Generators available for the pattern erase. */
+enum class PatternType
+{
+    /** @brief Philox4x32-10 counter based generator, seekable. */
+    Philox,
+    /** @brief std::minstd_rand0, the original sequential generator. */
+    Minstd,
+};
+
+/** @class PatternGenerator
+ *  @brief Produces the incompressible pattern written and verified by the
+ *  pattern erase. The pattern is a fixed function of the byte offset, so
+ *  chunks can be generated in any order and with any size.
+ */
+class PatternGenerator
+{
+  public:
+    virtual ~PatternGenerator() = default;
+
+    /** @brief Fills a buffer with the pattern.
+     *
+     *  @param[in] offset - byte offset of the start of buf on the drive.
+     *  @param[out] buf - buffer to fill.
+     */
+    virtual void fill(uint64_t offset, std::span<std::byte> buf) = 0;
+
+    /** @brief Compares data read from the drive with the pattern.
+     *  @details The default generates the pattern a few hundred bytes at a
+     *  time into a buffer on the stack, so the expected data stays in L1
+     *  instead of being written out for the whole chunk and read back.
+     *
+     *  @param[in] offset - byte offset of the start of data on the drive.
+     *  @param[in] data - the bytes to check.
+     *  @return index of the first byte of data that is wrong, or
+     *  data.size() if all of it matches.
+     */
+    virtual size_t mismatch(uint64_t offset, std::span<const std::byte> data);
+};
+
+/** @class PhiloxGenerator
+ *  @brief Philox4x32-10 from "Parallel Random Numbers: As Easy as 1, 2, 3"
+ *  (Salmon et al., SC11). Each 16 byte block of the pattern is the
+ *  encryption of its block index, so any offset is computed directly and
+ *  independent blocks vectorize.
+ */
+class PhiloxGenerator : public PatternGenerator
+{
+  public:
+    /** @brief Creates the generator.
+     *
+     *  @param[in] seed - key of the generator.
+     */
+    explicit PhiloxGenerator(uint64_t seed);
+
+    void fill(uint64_t offset, std::span<std::byte> buf) override;
+
+    /** @brief Compares with the find kernel, which generates the expected
+     *  blocks in registers and stops at the first wrong one.
+     */
+    size_t mismatch(uint64_t offset, std::span<const std::byte> data) override;
+
+    /** @brief Size of one block of output in bytes. */
+    static constexpr size_t blockSize = 16;
+
+    /** @brief Computes one block of output.
+     *
+     *  @param[in] counter - the four counter words.
+     *  @param[in] key - the two key words.
+     *  @return the four output words.
+     */
+    static std::array<uint32_t, 4> block(std::array<uint32_t, 4> counter,
+                                         std::array<uint32_t, 2> key);
+
+  private:
+    std::array<uint32_t, 2> key;
+};
+
+/** @brief One implementation of the Philox block loop. */
+struct PhiloxKernel
+{
+    /** @brief Instruction set the kernel uses, e.g. "avx2". */
+    std::string_view name;
+    /** @brief Writes buf.size() / 16 whole blocks, the first one being
+     *  block index.
+     */
+    void (*fill)(uint64_t index, std::array<uint32_t, 2> key,
+                 std::span<std::byte> buf);
+    /** @brief Compares the data.size() / 16 whole blocks of data with the
+     *  blocks starting at index, and returns how many of them match
+     *  before the first wrong one.
+     */
+    size_t (*find)(uint64_t index, std::array<uint32_t, 2> key,
+                   std::span<const std::byte> data);
+};
+
+/** @brief Lists the Philox kernels this CPU can run, the scalar one first
+ *  and the one PhiloxGenerator uses last.
+ */
+std::vector<PhiloxKernel> philoxKernels();
+
+/** @class MinstdGenerator
+ *  @brief The std::minstd_rand0 sequence the pattern erase originally used,
+ *  one 32 bit word after another. Seeking runs the generator forward, so
+ *  this is only fast when the drive is filled in order.
+ */
+class MinstdGenerator : public PatternGenerator
+{
+  public:
+    /** @brief Creates the generator.
+     *
+     *  @param[in] seed - seed of std::minstd_rand0.
+     */
+    explicit MinstdGenerator(uint32_t seed);
+
+    void fill(uint64_t offset, std::span<std::byte> buf) override;
+
+  private:
+    /** @brief Returns word index of the sequence. */
+    uint32_t word(uint64_t index);
+
+    uint32_t seed;
+    std::minstd_rand0 engine;
+    /* index of the word the engine returns next */
+    uint64_t nextWord = 0;
+    /* the last word returned, at index nextWord - 1 */
+    uint32_t lastWord = 0;
+};
+
+/** @brief Creates a pattern generator.
+ *
+ *  @param[in] type - the generator to use.
+ *  @param[in] seed - seed of the generator.
+ */
+std::unique_ptr<PatternGenerator> makePatternGenerator(PatternType type,
+                                                       uint32_t seed);
+
+} // namespace estoraged
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "bufferPool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+
+namespace estoraged
+{
+
+/** @brief Works on one chunk of a pipelined pass.
+ *
+ *  @param[in] offset - offset of the chunk on the device.
+ *  @param[in] chunk - the pool buffer of the chunk, sized to it.
+ */
+using PipelineStage =
+    std::function<void(uint64_t offset, std::span<std::byte> chunk)>;
+
+/** @brief Runs a pass over a range of the device in two overlapping stages.
+ *  @details The range is split into chunks of the pool buffer size. The
+ *  produce stage runs on a second thread and works up to slots chunks ahead
+ *  of the consume stage, which runs on the calling thread. Both see the
+ *  chunks in order, and chunk i uses pool buffer i % slots. For a write,
+ *  produce generates the data while consume writes it; for a verify,
+ *  produce reads while consume compares. An exception from either stage
+ *  stops both, and is rethrown once the second thread is done.
+ *
+ *  @param[in] pool - buffers of the chunks in flight, at least slots.
+ *  @param[in] slots - number of chunks the stages can hold, at least 2.
+ *  @param[in] start - offset of the first chunk.
+ *  @param[in] end - offset the pass ends at.
+ *  @param[in] produce - first stage of every chunk.
+ *  @param[in] consume - second stage of every chunk.
+ */
+void pipelinedPass(BufferPool& pool, size_t slots, uint64_t start,
+                   uint64_t end, const PipelineStage& produce,
+                   const PipelineStage& consume);
+
+} // namespace estoraged
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "bufferPool.hpp"
+#include "eraseProgress.hpp"
+#include "eraseThrottle.hpp"
+#include "parallelVerify.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace estoraged
+{
+
+/** @brief Outcome of a sampled verify. */
+struct SampleResult
+{
+    /** @brief Number of chunks read. */
+    uint64_t samples = 0;
+    /** @brief Number of chunks on the device. */
+    uint64_t chunks = 0;
+    /** @brief Fraction of the device that was read, 0 to 1. */
+    double coverage = 0;
+    /** @brief Offset of the first wrong byte found, if any. */
+    std::optional<uint64_t> firstMismatch;
+};
+
+/** @brief Number of chunks to sample to find a bad device.
+ *  @details If a fraction defectRate of the chunks were not erased, a
+ *  uniform sample of n = ceil(ln(1 - confidence) / ln(1 - defectRate))
+ *  chunks contains at least one of them with probability confidence.
+ *
+ *  @param[in] confidence - probability of detection, between 0 and 1.
+ *  @param[in] defectRate - smallest fraction of bad chunks to detect,
+ *  between 0 and 1.
+ *  @param[in] chunks - number of chunks on the device.
+ *  @return the sample size, at most chunks. All chunks if the parameters
+ *  are out of range.
+ */
+uint64_t sampleSize(double confidence, double defectRate, uint64_t chunks);
+
+/** @brief Picks distinct random chunk indexes.
+ *  @details The indexes come from OpenSSL RAND_bytes, so the sample can't
+ *  be predicted by a device that only erases the blocks it expects to be
+ *  read.
+ *
+ *  @param[in] count - number of indexes, at most chunks.
+ *  @param[in] chunks - number of chunks to pick from.
+ *  @return the indexes in increasing order.
+ */
+std::vector<uint64_t> sampleChunks(uint64_t count, uint64_t chunks);
+
+/** @brief Verifies a random sample of the chunks of a device.
+ *  @details The chunk size is the pool buffer size. Chunks are read in
+ *  increasing offset order with pool buffer 0 and checked with buffer 1 as
+ *  scratch. Read errors throw InternalFailure.
+ *
+ *  @param[in] fd - file descriptor of the device.
+ *  @param[in] size - number of bytes on the device.
+ *  @param[in] pool - buffers for the reads, at least 2.
+ *  @param[in] confidence - probability of detection, see sampleSize.
+ *  @param[in] defectRate - smallest fraction of bad chunks to detect.
+ *  @param[in] check - called for every chunk read, with worker 0.
+ *  @param[in] progress - (optional) tracker to start with the sampled bytes
+ *  and advance for every chunk read.
+ *  @param[in] throttle - (optional) paces the reads.
+ *  @return the sample size, coverage and first mismatch.
+ */
+SampleResult sampledVerify(int fd, uint64_t size, BufferPool& pool,
+                           double confidence, double defectRate,
+                           const VerifyCheck& check,
+                           EraseProgress* progress = nullptr,
+                           EraseThrottle* throttle = nullptr);
+
+} // namespace estoraged
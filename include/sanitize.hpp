@@ -1,72 +1,27 @@
 #pragma once
 
+#include "emmcErasePlan.hpp"
 #include "erase.hpp"
+#include "eraseOptions.hpp"
+#include "mmcChannel.hpp"
 
 #include <linux/mmc/ioctl.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 
-#include <stdplus/fd/managed.hpp>
 #include <util.hpp>
 
-#include <array>
+#include <chrono>
 #include <cstddef>
-#include <span>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string_view>
+#include <utility>
 
 namespace estoraged
 {
 
-class IOCTLWrapperInterface
-{
-  public:
-    /** @brief Wrapper around ioctl
-     *  @details Used for mocking purposes.
-     *
-     * @param[in] devPath - File name of block device
-     * @param[in] request - Device-dependent request code
-     * @param[in] mmc_ioc_cmd - eMMC cmd
-     */
-    virtual int doIoctl(std::string_view devPath, unsigned long request,
-                        struct mmc_ioc_cmd data) = 0;
-
-    /** @brief Wrapper around ioctl
-     *  @details Used for mocking purposes.
-     *
-     * @param[in] devPath - File name of block device
-     * @param[in] request - Device-dependent request code
-     * @param[in] mmc_io_mutli_cmd - many eMMC cmd
-     */
-    virtual int doIoctlMulti(std::string_view devPath, unsigned long request,
-                             struct MmcIoMultiCmdErase data) = 0;
-
-    virtual ~IOCTLWrapperInterface() = default;
-    IOCTLWrapperInterface() = default;
-    IOCTLWrapperInterface(const IOCTLWrapperInterface&) = delete;
-    IOCTLWrapperInterface& operator=(const IOCTLWrapperInterface&) = delete;
-
-    IOCTLWrapperInterface(IOCTLWrapperInterface&&) = delete;
-    IOCTLWrapperInterface& operator=(IOCTLWrapperInterface&&) = delete;
-};
-
-// mockIOCTLWapper also inherits from IOCTLWrapperInterface
-class IOCTLWrapperImpl : public IOCTLWrapperInterface
-{
-  public:
-    int doIoctl(std::string_view devPath, unsigned long request,
-                struct mmc_ioc_cmd data) override;
-    int doIoctlMulti(std::string_view devPath, unsigned long request,
-                     struct MmcIoMultiCmdErase data) override;
-    ~IOCTLWrapperImpl() override = default;
-    IOCTLWrapperImpl() = default;
-
-    IOCTLWrapperImpl(const IOCTLWrapperImpl&) = delete;
-    IOCTLWrapperImpl& operator=(const IOCTLWrapperImpl&) = delete;
-
-    IOCTLWrapperImpl(IOCTLWrapperImpl&&) = delete;
-    IOCTLWrapperImpl& operator=(IOCTLWrapperImpl&&) = delete;
-};
-
 class Sanitize : public Erase
 {
   public:
@@ -79,7 +34,17 @@ class Sanitize : public Erase
     Sanitize(std::string_view inDevPath,
              std::unique_ptr<IOCTLWrapperInterface> inIOCTL =
                  std::make_unique<IOCTLWrapperImpl>()) :
-        Erase(inDevPath), ioctlWrapper(std::move(inIOCTL))
+        Erase(inDevPath),
+        channel(std::make_shared<MmcChannel>(inDevPath, std::move(inIOCTL)))
+    {}
+
+    /** @brief Creates a sanitize erase object sharing the command channel,
+     * and the EXT_CSD it caches, of the drive
+     *
+     * @param[in] inChannel - the command channel of the drive
+     */
+    explicit Sanitize(std::shared_ptr<MmcChannel> inChannel) :
+        Erase(inChannel->path()), channel(std::move(inChannel))
     {}
 
     /** @brief sanitize the drive, using eMMC specified erase commands
@@ -89,34 +54,131 @@ class Sanitize : public Erase
     void doSanitize(uint64_t driveSize);
 
     /** @brief sanitize the drive, using eMMC specified erase commands
-     *   This function uses the built in utils to call sanitize
+     *   The size of the drive comes from EXT_CSD, or from the block device
+     *   if EXT_CSD does not have it
+     */
+    void doSanitize();
+
+    /** @brief starts the sanitize without waiting for the device in the
+     * ioctl, then polls the card status with CMD13 until the device is
+     * done. The erase job shows the device as busy meanwhile. Since Linux
+     * 5.10 the kernel waits inside the ioctl anyway, up to the timeout, so
+     * the polling only runs on older kernels.
+     *  @param inTimeout how long the sanitize may take before the erase
+     * fails, 0 to wait for it inside the ioctl for sanitizeTimeoutMs instead
+     *  @param inInterval time between two status polls
      */
-    void doSanitize()
+    void setStatusPolling(std::chrono::milliseconds inTimeout,
+                          std::chrono::milliseconds inInterval = pollInterval)
     {
-        doSanitize(util::findSizeOfBlockDevice(devPath));
+        pollTimeout = inTimeout;
+        pollEvery = inInterval;
     }
 
+    /** @brief sets how the erase before the sanitize is picked
+     *  @param inPolicy what the erase must achieve
+     */
+    void setPolicy(EmmcErasePolicy inPolicy)
+    {
+        policy = inPolicy;
+    }
+
+    /** @brief Default time between two status polls. */
+    static constexpr std::chrono::milliseconds pollInterval{1000};
+
+    /** @brief Longest an erase command is expected to take, in ms. The
+     * erase is split into commands of as many whole erase groups as their
+     * per group timeout from EXT_CSD allows in this time, with at least
+     * one group per command.
+     */
+    static constexpr uint32_t maxEraseCommandMs = 60000;
+
+    /** @brief Timeout of the single erase command of a device whose erase
+     * geometry is not known.
+     */
+    static constexpr uint32_t legacyEraseTimeoutMs = 0x0FFFFFFF;
+
+    /** @brief Timeout of a sanitize waited for inside the ioctl, without
+     * status polling, in ms. The same hour as the default
+     * EraseSanitizeTimeout.
+     */
+    static constexpr uint32_t sanitizeTimeoutMs = 3600000;
+
   private:
-    /* Wrapper for ioctl*/
-    std::unique_ptr<IOCTLWrapperInterface> ioctlWrapper;
+    /* Command channel of the drive */
+    std::shared_ptr<MmcChannel> channel;
+
+    /* How long a polled sanitize may take, 0 to wait inside the ioctl */
+    std::chrono::milliseconds pollTimeout{0};
+
+    /* Time between two status polls */
+    std::chrono::milliseconds pollEvery = pollInterval;
+
+    /* What the media erase must achieve */
+    EmmcErasePolicy policy = EmmcErasePolicy::Legacy;
 
     /** @brief uses the eMMC defined sanitize command, it is not the same as
      * vendor_sanitize  */
     void emmcSanitize();
 
-    /** @brief uses the eMMC defined erase command
+    /** @brief polls the card status until the device leaves the
+     * programming state, or the timeout passes. This is a fallback for
+     * kernels before 5.10, newer ones only return from the sanitize ioctl
+     * once the device is done.
+     */
+    void waitForSanitize();
+
+    /** @brief reads the card status with CMD13
+     *  @return the R1 card status
+     */
+    uint32_t readCardStatus();
+
+    /** @brief reads the erase capabilities from EXT_CSD
+     *  @return the capabilities, or nullopt if EXT_CSD can not be read
+     */
+    std::optional<EmmcEraseCapabilities> readCapabilities();
+
+    /** @brief picks the erase commands to run under the policy. Without
+     * EXT_CSD only the legacy policy has a plan, other policies throw
+     * InternalFailure.
      *
      * param[in] driveSize - size of the drive in bytes
+     * @return the plan and the capabilities it was made from
      */
-    void emmcErase(uint64_t driveSize);
-};
+    std::pair<EmmcErasePlan, EmmcEraseCapabilities>
+        choosePlan(uint64_t driveSize);
 
-// can't use the real mmc_ioc_multi_cmd b/c of zero length array
-// see uapi/linux/mmc/ioctl.h
-struct MmcIoMultiCmdErase
-{
-    uint64_t num_of_cmds;
-    struct mmc_ioc_cmd cmds[3]; // NOLINT (c arrays usage)
+    /** @brief runs the steps of a plan in order
+     *
+     * param[in] plan - the plan
+     * param[in] capabilities - the capabilities the plan was made from
+     * param[in] driveSize - size of the drive in bytes
+     */
+    void runPlan(const EmmcErasePlan& plan,
+                 const EmmcEraseCapabilities& capabilities,
+                 uint64_t driveSize);
+
+    /** @brief runs one CMD38 pass over the drive, in chunks of whole erase
+     * groups if the geometry is known, reporting progress and checking for
+     * a cancel between them
+     *
+     * param[in] geometry - erase geometry of the drive
+     * param[in] arg - CMD38 argument selecting the kind of erase
+     * param[in] groupTimeoutMs - most time one group takes, 0 if not known
+     * param[in] driveSize - size of the drive in bytes
+     */
+    void erasePass(const EmmcEraseGeometry& geometry, uint32_t arg,
+                   uint64_t groupTimeoutMs, uint64_t driveSize);
+
+    /** @brief erases a range with one CMD35, CMD36, CMD38 sequence
+     *
+     * param[in] first - address of the first unit to erase
+     * param[in] last - address of the last unit to erase
+     * param[in] arg - CMD38 argument selecting the kind of erase
+     * param[in] timeoutMs - timeout of the erase command
+     */
+    void eraseRange(uint64_t first, uint64_t last, uint32_t arg,
+                    uint32_t timeoutMs);
 };
 
 } // namespace estoraged
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "bufferPool.hpp"
+#include "eraseOptions.hpp"
+
+#include <linux/io_uring.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+
+namespace estoraged
+{
+
+/** @class Uring
+ *  @brief Minimal io_uring submission and completion queue, used by the
+ *  erase engines to keep several reads or writes in flight.
+ */
+class Uring
+{
+  public:
+    /** @brief Sets up the io_uring instance.
+     *  @details Throws std::system_error if io_uring is not available, for
+     *  example on older kernels or when it is disabled by sysctl or seccomp.
+     *
+     *  @param[in] entries - size of the submission queue.
+     */
+    explicit Uring(unsigned entries);
+    ~Uring();
+
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+    Uring(Uring&&) = delete;
+    Uring& operator=(Uring&&) = delete;
+
+    /** @brief Registers the pool buffers as fixed buffers.
+     *  @details If the kernel refuses, e.g. because of RLIMIT_MEMLOCK, the
+     *  queue keeps working with unregistered buffers.
+     *
+     *  @param[in] pool - buffers to register, index i is buffer i.
+     */
+    void registerBuffers(BufferPool& pool);
+
+    /** @brief Queues a read into a pool buffer.
+     *
+     *  @param[in] fd - file descriptor to read from.
+     *  @param[in] bufIndex - index of the pool buffer that holds buf.
+     *  @param[in] buf - destination, within pool buffer bufIndex.
+     *  @param[in] offset - offset in the file to read from.
+     *  @param[in] userData - value returned with the completion.
+     */
+    void prepRead(int fd, unsigned bufIndex, std::span<std::byte> buf,
+                  uint64_t offset, uint64_t userData);
+
+    /** @brief Queues a write from a pool buffer.
+     *
+     *  @param[in] fd - file descriptor to write to.
+     *  @param[in] bufIndex - index of the pool buffer that holds buf.
+     *  @param[in] buf - source, within pool buffer bufIndex.
+     *  @param[in] offset - offset in the file to write to.
+     *  @param[in] userData - value returned with the completion.
+     */
+    void prepWrite(int fd, unsigned bufIndex, std::span<const std::byte> buf,
+                   uint64_t offset, uint64_t userData);
+
+    struct Completion
+    {
+        uint64_t userData;
+        /* bytes transferred, or a negative errno */
+        int32_t result;
+    };
+
+    /** @brief Submits the queued requests and waits for one completion. */
+    Completion submitAndWait();
+
+    /** @brief Waits until the kernel is done with every request.
+     *  @details Queued requests that were not submitted yet are dropped. If
+     *  waiting fails, the error is logged and the rest are left in flight.
+     */
+    void drain() noexcept;
+
+    /** @brief Number of requests queued or in flight. */
+    unsigned pending() const
+    {
+        return inFlight;
+    }
+
+    /** @brief Size of the submission queue, which may be more than asked
+     *  for. At most this many requests may be in flight.
+     */
+    unsigned entries() const
+    {
+        return params.sq_entries;
+    }
+
+  private:
+    /** @brief Unmaps the rings and closes the io_uring fd. */
+    void release();
+
+    /** @brief Passes the queued requests to the kernel without waiting. */
+    void submit();
+
+    /** @brief Fills the next submission queue entry.
+     *  @details Submits the queued requests first if the queue is full, and
+     *  throws InternalFailure if the kernel still holds every entry.
+     */
+    void prep(uint8_t opcode, int fd, unsigned bufIndex, const void* addr,
+              uint32_t len, uint64_t offset, uint64_t userData);
+
+    int ringFd = -1;
+    io_uring_params params{};
+
+    /* Mapped submission queue ring and entries */
+    void* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    /* Mapped completion queue ring, may be the same mapping as sqRing */
+    void* cqRing = nullptr;
+    size_t cqRingSize = 0;
+
+    /* Number of queued requests not yet passed to io_uring_enter */
+    unsigned toSubmit = 0;
+
+    /* Number of queued requests whose completion was not read yet */
+    unsigned inFlight = 0;
+
+    /* Whether the pool buffers are registered */
+    bool fixedBuffers = false;
+};
+
+/** @brief Sets up io_uring for an erase, if the options ask for it.
+ *
+ *  @param[in] options - erase options, queueDepth selects io_uring.
+ *  @param[in] pool - buffers to register with the ring.
+ *  @return the ring, or nullptr if the queue depth is 1 or io_uring is not
+ *  available, in which case the engines use synchronous I/O.
+ */
+std::unique_ptr<Uring> makeEraseUring(const EraseOptions& options,
+                                      BufferPool& pool);
+
+/** @brief Writes a range with several requests in flight.
+ *  @details Pool buffers 0 to slots - 1 are used for the requests. Short
+ *  writes are resubmitted, and errors throw InternalFailure. If fill or
+ *  written throw, the requests in flight complete before the exception is
+ *  passed on.
+ *
+ *  @param[in] ring - the io_uring instance.
+ *  @param[in] fd - file descriptor to write to.
+ *  @param[in] pool - buffers registered with the ring.
+ *  @param[in] slots - maximum number of requests in flight, limited to the
+ *  entries() of the ring.
+ *  @param[in] size - offset to write up to.
+ *  @param[in] fill - called in offset order to fill each chunk.
+ *  @param[in] written - (optional) called after every completion with the
+ *  offset below which every chunk has been written.
+ *  @param[in] start - (optional) offset to start writing from.
+ */
+void uringWrite(
+    Uring& ring, int fd, BufferPool& pool, size_t slots, uint64_t size,
+    const std::function<void(uint64_t, std::span<std::byte>)>& fill,
+    const std::function<void(uint64_t)>& written = {}, uint64_t start = 0);
+
+/** @brief Reads a range with several requests in flight.
+ *  @details Pool buffers 0 to slots - 1 are used for the requests. Chunks
+ *  are handed to check in offset order, even if they complete out of order.
+ *  Short reads are resubmitted, and errors throw InternalFailure. If check
+ *  throws, the requests in flight complete before the exception is passed
+ *  on.
+ *
+ *  @param[in] ring - the io_uring instance.
+ *  @param[in] fd - file descriptor to read from.
+ *  @param[in] pool - buffers registered with the ring.
+ *  @param[in] slots - maximum number of requests in flight, limited to the
+ *  entries() of the ring.
+ *  @param[in] size - number of bytes to read from offset 0.
+ *  @param[in] check - called in offset order with each chunk read.
+ */
+void uringRead(
+    Uring& ring, int fd, BufferPool& pool, size_t slots, uint64_t size,
+    const std::function<void(uint64_t, std::span<const std::byte>)>& check);
+
+} // namespace estoraged
@@ -1,5 +1,7 @@
 #pragma once
+#include "eraseOptions.hpp"
 #include "getConfig.hpp"
+#include "partProfile.hpp"
 
 #include <filesystem>
 #include <optional>
@@ -20,25 +22,65 @@ struct DeviceInfo
     uint64_t eraseMinGeometry;
     std::string driveType;
     std::string driveProtocol;
+    EraseOptions eraseOptions;
 
     DeviceInfo(std::filesystem::path& deviceFile,
                std::filesystem::path& sysfsDir, std::string& luksName,
                std::string& locationCode, uint64_t eraseMaxGeometry,
                uint64_t eraseMinGeometry, std::string& driveType,
-               std::string& driveProtocol) :
+               std::string& driveProtocol, const EraseOptions& eraseOptions) :
         deviceFile(deviceFile), sysfsDir(sysfsDir), luksName(luksName),
         locationCode(locationCode), eraseMaxGeometry(eraseMaxGeometry),
         eraseMinGeometry(eraseMinGeometry), driveType(driveType),
-        driveProtocol(driveProtocol)
+        driveProtocol(driveProtocol), eraseOptions(eraseOptions)
     {}
 };
 
+/** @brief Block sizes the kernel reports for a block device. */
+struct BlockGeometry
+{
+    /** @brief Smallest unit the device can address, BLKSSZGET. */
+    size_t logicalBlockSize = 512;
+    /** @brief Smallest unit the device can write atomically, BLKPBSZGET. */
+    size_t physicalBlockSize = 4096;
+    /** @brief Preferred I/O size, from queue/optimal_io_size, 0 if unset. */
+    size_t optimalIoSize = 0;
+};
+
+/** @brief Range zeroing the kernel can do for a block device, from the
+ *  queue directory in sysfs.
+ */
+struct ZeroOffload
+{
+    /** @brief Largest BLKZEROOUT request, queue/write_zeroes_max_bytes, 0 if
+     *  the device cannot write zeroes.
+     */
+    uint64_t writeZeroesMaxBytes = 0;
+    /** @brief Discard alignment, the erase group size on eMMC,
+     *  queue/discard_granularity.
+     */
+    uint64_t discardGranularity = 0;
+};
+
 /** @brief finds the size of the linux block device in bytes
  *  @param[in] devpath - the name of the linux block device
  *  @return size of a block device using the devPath
  */
 uint64_t findSizeOfBlockDevice(const std::string& devPath);
 
+/** @brief finds the logical, physical and optimal I/O sizes of a block device
+ *  @param[in] devPath - the name of the linux block device
+ *  @return the geometry of the block device
+ */
+BlockGeometry findBlockGeometry(const std::string& devPath);
+
+/** @brief finds which zeroing offloads a block device supports
+ *  @param[in] queueDir - the sysfs queue directory of the block device, e.g.
+ *    /sys/class/block/mmcblk0/queue
+ *  @return the offload limits, all zero if nothing is supported
+ */
+ZeroOffload findZeroOffload(const std::filesystem::path& queueDir);
+
 /** @brief finds the predicted life left for a eMMC device
  *  @param[in] sysfsPath - The path to the linux sysfs interface
  *  @return the life remaining for the emmc, as a percentage.
@@ -57,6 +99,13 @@ std::string getPartNumber(const std::filesystem::path& sysfsPath);
  */
 std::string getSerialNumber(const std::filesystem::path& sysfsPath);
 
+/** @brief Get the manufacturer id for the storage device
+ *  @param[in] sysfsPath - The path to the linux sysfs interface.
+ *  @return manfid as a string, e.g. "0x000015" (or "unknown" if it couldn't
+ *  be retrieved)
+ */
+std::string getManufacturerId(const std::filesystem::path& sysfsPath);
+
 /** @brief Look for the device described by the provided StorageData.
  *  @details Currently, this function assumes that there's only one eMMC.
  *    When we need to support multiple eMMCs, we will put more information in
@@ -67,11 +116,14 @@ std::string getSerialNumber(const std::filesystem::path& sysfsPath);
  *  @param[in] data - map of properties from the config object.
  *  @param[in] searchDir - directory to search for devices in sysfs, e.g.
  *    /sys/block
+ *  @param[in] profiles - tuning profiles of the parts, which the config
+ *    overrides.
  *  @return DeviceInfo - metadata for the device if device is found. Null
  *  otherwise.
  */
-std::optional<DeviceInfo> findDevice(const StorageData& data,
-                                     const std::filesystem::path& searchDir);
+std::optional<DeviceInfo> findDevice(
+    const StorageData& data, const std::filesystem::path& searchDir,
+    const PartProfileTable& profiles = PartProfileTable());
 
 } // namespace util
 
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "bufferPool.hpp"
 #include "erase.hpp"
+#include "eraseOptions.hpp"
 #include "util.hpp"
 
 #include <stdplus/fd/create.hpp>
@@ -19,8 +21,13 @@ class Zero : public Erase
     /** @brief Creates a zero erase object.
      *
      *  @param[in] inDevPath - the linux device path for the block device.
+     *  @param[in] inOptions - (optional) I/O options for the erase.
      */
-    Zero(std::string_view inDevPath) : Erase(inDevPath) {}
+    Zero(std::string_view inDevPath, const EraseOptions& inOptions = {}) :
+        Erase(inDevPath), options(inOptions),
+        pool(BufferPool::forErase(erasePoolSize(options), options, {},
+                                  blockSize))
+    {}
     /** @brief writes zero to the drive
      * and throws errors accordingly.
      *  @param[in] driveSize - the size of the block device in bytes
@@ -28,15 +35,31 @@ class Zero : public Erase
      */
     void writeZero(uint64_t driveSize, Fd& fd);
 
+    /** @brief writes zero to the drive with io_uring, keeping the queue
+     * depth from the options in flight. It throws errors accordingly.
+     *  @param[in] driveSize - the size of the block device in bytes
+     *  @param[in] fd - the file descriptor of the block device
+     *  @return false if io_uring is not enabled or not available, in which
+     * case nothing was written
+     */
+    bool writeZeroUring(uint64_t driveSize, int fd);
+
+    /** @brief zeros the drive with BLKZEROOUT, if the device can write
+     * zeroes itself. Requests are split at the offload limit and kept
+     * aligned to the erase group size. It throws errors accordingly.
+     *  @param[in] driveSize - the size of the block device in bytes
+     *  @param[in] fd - the stdplus file descriptor
+     *  @param[in] offload - what the device supports
+     *  @return false if the device has no offload or rejects the first
+     * request, in which case nothing was written
+     */
+    bool writeZeroOffload(uint64_t driveSize, Fd& fd,
+                          const util::ZeroOffload& offload);
+
     /** @brief writes zero to the drive using default parameters,
      * and throws errors accordingly.
      */
-    void writeZero()
-    {
-        stdplus::fd::Fd&& fd =
-            stdplus::fd::open(devPath, stdplus::fd::OpenAccess::WriteOnly);
-        writeZero(util::findSizeOfBlockDevice(devPath), fd);
-    }
+    void writeZero();
 
     /** @brief verifies the drive has only zeros on it,
      * and throws errors accordingly.
@@ -45,23 +68,61 @@ class Zero : public Erase
      */
     void verifyZero(uint64_t driveSize, Fd& fd);
 
+    /** @brief verifies the drive has only zeros on it with io_uring,
+     * keeping the queue depth from the options in flight. It throws errors
+     * accordingly.
+     *  @param[in] driveSize - the size of the block device in bytes
+     *  @param[in] fd - the file descriptor of the block device
+     *  @return false if io_uring is not enabled or not available, in which
+     * case nothing was verified
+     */
+    bool verifyZeroUring(uint64_t driveSize, int fd);
+
+    /** @brief verifies the drive has only zeros on it with the number of
+     * threads from the options, each reading its own range. It throws
+     * errors accordingly.
+     *  @param[in] driveSize - the size of the block device in bytes
+     *  @param[in] fd - the file descriptor of the block device
+     *  @return false if only one verify thread is configured, in which case
+     * nothing was verified
+     */
+    bool verifyZeroParallel(uint64_t driveSize, int fd);
+
+    /** @brief verifies a random sample of the drive has only zeros on it,
+     * sized from the confidence in the options. The sample size and
+     * coverage are logged. It throws errors accordingly.
+     *  @param[in] driveSize - the size of the block device in bytes
+     *  @param[in] fd - the file descriptor of the block device
+     *  @return false if sampling is not enabled, in which case nothing was
+     * verified
+     */
+    bool verifyZeroSampled(uint64_t driveSize, int fd);
+
     /** @brief verifies the drive has only zeros on it,
      * using the default parameters. It also throws errors accordingly.
      */
-    void verifyZero()
-    {
-        stdplus::fd::Fd&& fd =
-            stdplus::fd::open(devPath, stdplus::fd::OpenAccess::ReadOnly);
-        verifyZero(util::findSizeOfBlockDevice(devPath), fd);
-    }
+    void verifyZero();
 
   private:
-    /* @brief the size of the blocks in bytes used for write and verify.
+    /** @brief opens the device, with O_DIRECT and buffers sized from the
+     * device geometry if direct I/O is enabled.
+     *  @param[in] access - the access mode to open the device with
+     */
+    stdplus::fd::ManagedFd openDevice(stdplus::fd::OpenAccess access);
+
+    /* @brief the size of the blocks in bytes used for write and verify,
+     * when not using direct I/O.
      * 32768 was also tested. It had almost identical performance.
      */
     static constexpr size_t blockSize = 4096;
     static constexpr size_t maxRetry = 32;
     static constexpr std::chrono::duration delay = std::chrono::milliseconds(1);
+
+    /* I/O options for the erase */
+    EraseOptions options;
+
+    /* Buffers reused by every chunk of the write and verify */
+    BufferPool pool;
 };
 
 } // namespace estoraged
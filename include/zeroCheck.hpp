@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace estoraged
+{
+
+/** @brief Finds the first non-zero byte in a buffer.
+ *  @details Uses the widest vector kernel the CPU supports, chosen once at
+ *  runtime.
+ *
+ *  @param[in] data - the buffer to check.
+ *  @return offset of the first non-zero byte, or data.size() if the buffer
+ *  is all zeros.
+ */
+size_t findNonZero(std::span<const std::byte> data);
+
+/** @brief One implementation of findNonZero. */
+struct ZeroCheckKernel
+{
+    /** @brief Instruction set the kernel uses, e.g. "avx2". */
+    std::string_view name;
+    /** @brief The kernel, with the same contract as findNonZero. */
+    size_t (*find)(std::span<const std::byte> data);
+};
+
+/** @brief Lists the kernels this CPU can run, the scalar one first and the
+ *  one findNonZero uses last.
+ */
+std::vector<ZeroCheckKernel> zeroCheckKernels();
+
+} // namespace estoraged
@@ -0,0 +1,159 @@
+#include "cryptsetupInterface.hpp"
+#include "eraseOptions.hpp"
+#include "estoraged.hpp"
+#include "estoraged_conf.hpp"
+
+#include <libcryptsetup.h>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+#include <sdbusplus/bus.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <variant>
+
+namespace estoraged_bench
+{
+
+using estoraged::CryptHandle;
+using estoraged::Cryptsetup;
+
+/* File standing in for the drive, named like a device so that it gives a
+ * valid D-Bus object path
+ */
+const char* luksFile = "encryptionStatusBench";
+
+/* Large enough for the LUKS2 header and its metadata areas */
+constexpr uint64_t luksFileSize = 32 << 20;
+
+const char* serviceName = "xyz.openbmc_project.eStoraged.bench";
+
+/* Writes a LUKS2 header to a new file, without a keyslot */
+bool createLuksFile()
+{
+    std::ofstream file(luksFile,
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+    file.close();
+    if (file.fail())
+    {
+        return false;
+    }
+    std::filesystem::resize_file(luksFile, luksFileSize);
+
+    Cryptsetup crypt;
+    CryptHandle handle(luksFile);
+    std::array<char, 64> volumeKey{};
+    return crypt.cryptFormat(handle.get(), CRYPT_LUKS2, "aes", "xts-plain64",
+                             nullptr, volumeKey.data(), volumeKey.size(),
+                             nullptr) == 0;
+}
+
+/* The header load every Get of EncryptionStatus used to run */
+void encryptionStatusHeaderLoad(benchmark::State& state)
+{
+    if (!createLuksFile())
+    {
+        state.SkipWithError("could not format the LUKS file");
+        return;
+    }
+    Cryptsetup crypt;
+    for (auto _ : state)
+    {
+        CryptHandle handle(luksFile);
+        benchmark::DoNotOptimize(
+            crypt.cryptLoad(handle.get(), CRYPT_LUKS2, nullptr));
+    }
+    std::filesystem::remove(luksFile);
+}
+
+/* Creates the drive under test, with the status not loaded yet */
+std::unique_ptr<estoraged::EStoraged>
+    makeDrive(boost::asio::io_context& io,
+              sdbusplus::asio::object_server& objectServer)
+{
+    std::string devPath = std::filesystem::absolute(luksFile).string();
+    return std::make_unique<estoraged::EStoraged>(
+        nullptr, io, objectServer,
+        "/xyz/openbmc_project/inventory/system/board/bench/emmc", devPath,
+        std::string(luksFile) + "_luksDev", luksFileSize, 100, "", "", "",
+        ERASE_MAX_GEOMETRY, ERASE_MIN_GEOMETRY, "SSD", "eMMC",
+        estoraged::EraseOptions{});
+}
+
+/* Get of EncryptionStatus from another connection, through the bus. With
+ * state.range(0) at 0, the drive is created again before each Get, untimed,
+ * so that every Get loads the header as all of them used to.
+ */
+void encryptionStatusGet(benchmark::State& state)
+{
+    if (!createLuksFile())
+    {
+        state.SkipWithError("could not format the LUKS file");
+        return;
+    }
+    bool cached = state.range(0) != 0;
+
+    boost::asio::io_context io;
+    auto conn = std::make_shared<sdbusplus::asio::connection>(io);
+    conn->request_name(serviceName);
+    sdbusplus::asio::object_server objectServer(conn);
+    auto drive = makeDrive(io, objectServer);
+
+    auto work = boost::asio::make_work_guard(io);
+    std::thread server([&io]() { io.run(); });
+
+    auto bus = sdbusplus::bus::new_default();
+    std::string objectPath =
+        std::string("/xyz/openbmc_project/inventory/storage/") + luksFile;
+    for (auto _ : state)
+    {
+        if (!cached)
+        {
+            // the drive is only touched on the thread of io, so it is
+            // replaced while io is stopped
+            state.PauseTiming();
+            io.stop();
+            server.join();
+            drive.reset();
+            drive = makeDrive(io, objectServer);
+            io.restart();
+            server = std::thread([&io]() { io.run(); });
+            state.ResumeTiming();
+        }
+        auto method =
+            bus.new_method_call(serviceName, objectPath.c_str(),
+                                "org.freedesktop.DBus.Properties", "Get");
+        method.append("xyz.openbmc_project.Inventory.Item.Drive",
+                      "EncryptionStatus");
+        std::variant<std::string> value;
+        bus.call(method).read(value);
+        benchmark::DoNotOptimize(value);
+    }
+
+    work.reset();
+    io.stop();
+    server.join();
+    drive.reset();
+    std::filesystem::remove(luksFile);
+}
+
+BENCHMARK(encryptionStatusHeaderLoad)->Unit(benchmark::kMicrosecond);
+BENCHMARK(encryptionStatusGet)
+    ->ArgName("cached")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace estoraged_bench
+
+BENCHMARK_MAIN();
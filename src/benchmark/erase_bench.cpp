@@ -0,0 +1,379 @@
+#include "eraseOptions.hpp"
+#include "eraseProgress.hpp"
+#include "pattern.hpp"
+#include "util.hpp"
+#include "zero.hpp"
+
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <sys/resource.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+#include <stdplus/fd/create.hpp>
+#include <stdplus/fd/managed.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace estoraged_bench
+{
+
+using estoraged::EraseOptions;
+using estoraged::EraseProgress;
+using estoraged::EraseProgressStatus;
+using estoraged::Pattern;
+using estoraged::Zero;
+
+/* Size of a pass over a file target */
+constexpr uint64_t fileSize = 64 << 20;
+
+/* Size of a pass over a real device, at the start of it */
+constexpr uint64_t deviceSize = 1 << 30;
+
+/** @brief File or device an engine runs against. */
+struct Target
+{
+    /** @brief Name in the benchmark name. */
+    std::string name;
+    /** @brief Path of the file or device. */
+    std::string path;
+    /** @brief Bytes each pass writes or verifies. */
+    uint64_t size;
+    /** @brief The file is recreated as a hole before every write pass. */
+    bool sparse;
+};
+
+/** @brief One way to run an erase pass. */
+struct Engine
+{
+    /** @brief Name in the benchmark name. */
+    std::string name;
+    /** @brief Options of the engine. */
+    EraseOptions options;
+    /** @brief The pass writes the device, instead of verifying it. */
+    bool writes;
+    /** @brief The pass submits its I/O through io_uring, which
+     *  /proc/self/io does not count. */
+    bool uring;
+    /** @brief Runs a pass, returns the bytes it read or wrote, or nothing if
+     *  the mode is not available. */
+    std::function<std::optional<uint64_t>(const EraseOptions&, const Target&)>
+        pass;
+};
+
+/** @brief CPU time and syscalls of the process so far. */
+struct Usage
+{
+    double cpuSeconds = 0;
+    /** @brief read and write syscalls, from /proc/self/io if readable */
+    std::optional<uint64_t> syscalls;
+
+    static Usage now()
+    {
+        Usage usage;
+        rusage ru{};
+        getrusage(RUSAGE_SELF, &ru);
+        usage.cpuSeconds = static_cast<double>(ru.ru_utime.tv_sec +
+                                               ru.ru_stime.tv_sec) +
+                           static_cast<double>(ru.ru_utime.tv_usec +
+                                               ru.ru_stime.tv_usec) /
+                               1e6;
+
+        std::ifstream io("/proc/self/io");
+        std::string key;
+        uint64_t value = 0;
+        uint64_t total = 0;
+        int found = 0;
+        while (io >> key >> value)
+        {
+            if (key == "syscr:" || key == "syscw:")
+            {
+                total += value;
+                found++;
+            }
+        }
+        if (found == 2)
+        {
+            usage.syscalls = total;
+        }
+        return usage;
+    }
+};
+
+stdplus::fd::ManagedFd openTarget(const Target& target,
+                                  stdplus::fd::OpenAccess access)
+{
+    return stdplus::fd::open(target.path, access);
+}
+
+/* Bytes of a pass over the whole target, if the mode ran */
+std::optional<uint64_t> wholePass(bool ran, const Target& target)
+{
+    if (!ran)
+    {
+        return std::nullopt;
+    }
+    return target.size;
+}
+
+/* Bytes a sampled verify read, if sampling ran */
+std::optional<uint64_t> sampledPass(bool ran, const EraseProgress& progress)
+{
+    if (!ran)
+    {
+        return std::nullopt;
+    }
+    return progress.bytesProcessed();
+}
+
+/* Rewrites the file as a single hole of the target size */
+void makeSparse(const Target& target)
+{
+    int fd = open(target.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0600);
+    if (fd < 0 || ftruncate(fd, static_cast<off_t>(target.size)) != 0)
+    {
+        std::abort();
+    }
+    close(fd);
+}
+
+std::vector<Engine> engines()
+{
+    using stdplus::fd::OpenAccess;
+
+    EraseOptions sync;
+    EraseOptions uring;
+    uring.chunkSize = 1 << 20;
+    uring.queueDepth = 32;
+    EraseOptions pipelined;
+    pipelined.chunkSize = 1 << 20;
+    pipelined.pipelineDepth = 3;
+    EraseOptions parallel;
+    parallel.chunkSize = 1 << 20;
+    parallel.verifyThreads = 4;
+    EraseOptions sampled;
+    sampled.chunkSize = 1 << 20;
+    sampled.verifySampleConfidence = 0.99;
+    sampled.verifySampleDefectRate = 0.01;
+
+    auto zeroWrite = [](const EraseOptions& options, const Target& target) {
+        stdplus::fd::ManagedFd fd = openTarget(target, OpenAccess::WriteOnly);
+        Zero(target.path, options).writeZero(target.size, fd);
+        return wholePass(true, target);
+    };
+    auto zeroVerify = [](const EraseOptions& options, const Target& target) {
+        stdplus::fd::ManagedFd fd = openTarget(target, OpenAccess::ReadOnly);
+        Zero(target.path, options).verifyZero(target.size, fd);
+        return wholePass(true, target);
+    };
+    auto patternWrite = [](const EraseOptions& options, const Target& target) {
+        stdplus::fd::ManagedFd fd = openTarget(target, OpenAccess::WriteOnly);
+        Pattern(target.path, options).writePattern(target.size, fd);
+        return wholePass(true, target);
+    };
+    auto patternVerify = [](const EraseOptions& options,
+                            const Target& target) {
+        stdplus::fd::ManagedFd fd = openTarget(target, OpenAccess::ReadOnly);
+        Pattern(target.path, options).verifyPattern(target.size, fd);
+        return wholePass(true, target);
+    };
+
+    return {
+        {"zeroWrite", sync, true, false, zeroWrite},
+        {"zeroWrite/uring", uring, true, true,
+         [](const EraseOptions& options, const Target& target) {
+             stdplus::fd::ManagedFd fd =
+                 openTarget(target, OpenAccess::WriteOnly);
+             return wholePass(Zero(target.path, options)
+                                  .writeZeroUring(target.size, fd.get()),
+                              target);
+         }},
+        {"zeroVerify", sync, false, false, zeroVerify},
+        {"zeroVerify/uring", uring, false, true,
+         [](const EraseOptions& options, const Target& target) {
+             stdplus::fd::ManagedFd fd =
+                 openTarget(target, OpenAccess::ReadOnly);
+             return wholePass(Zero(target.path, options)
+                                  .verifyZeroUring(target.size, fd.get()),
+                              target);
+         }},
+        {"zeroVerify/parallel", parallel, false, false,
+         [](const EraseOptions& options, const Target& target) {
+             stdplus::fd::ManagedFd fd =
+                 openTarget(target, OpenAccess::ReadOnly);
+             return wholePass(Zero(target.path, options)
+                                  .verifyZeroParallel(target.size, fd.get()),
+                              target);
+         }},
+        {"zeroVerify/sampled", sampled, false, false,
+         [](const EraseOptions& options, const Target& target) {
+             stdplus::fd::ManagedFd fd =
+                 openTarget(target, OpenAccess::ReadOnly);
+             EraseProgress progress([](const EraseProgressStatus&) {});
+             Zero zero(target.path, options);
+             zero.setProgress(&progress);
+             return sampledPass(zero.verifyZeroSampled(target.size, fd.get()),
+                                progress);
+         }},
+        {"patternWrite", sync, true, false, patternWrite},
+        {"patternWrite/pipelined", pipelined, true, false, patternWrite},
+        {"patternWrite/uring", uring, true, true,
+         [](const EraseOptions& options, const Target& target) {
+             stdplus::fd::ManagedFd fd =
+                 openTarget(target, OpenAccess::WriteOnly);
+             return wholePass(Pattern(target.path, options)
+                                  .writePatternUring(target.size, fd.get()),
+                              target);
+         }},
+        {"patternVerify", sync, false, false, patternVerify},
+        {"patternVerify/pipelined", pipelined, false, false, patternVerify},
+        {"patternVerify/uring", uring, false, true,
+         [](const EraseOptions& options, const Target& target) {
+             stdplus::fd::ManagedFd fd =
+                 openTarget(target, OpenAccess::ReadOnly);
+             return wholePass(Pattern(target.path, options)
+                                  .verifyPatternUring(target.size, fd.get()),
+                              target);
+         }},
+        {"patternVerify/parallel", parallel, false, false,
+         [](const EraseOptions& options, const Target& target) {
+             stdplus::fd::ManagedFd fd =
+                 openTarget(target, OpenAccess::ReadOnly);
+             return wholePass(Pattern(target.path, options)
+                                  .verifyPatternParallel(target.size, fd.get()),
+                              target);
+         }},
+        {"patternVerify/sampled", sampled, false, false,
+         [](const EraseOptions& options, const Target& target) {
+             stdplus::fd::ManagedFd fd =
+                 openTarget(target, OpenAccess::ReadOnly);
+             EraseProgress progress([](const EraseProgressStatus&) {});
+             Pattern pattern(target.path, options);
+             pattern.setProgress(&progress);
+             return sampledPass(pattern.verifyPatternSampled(target.size, fd.get()),
+                                progress);
+         }},
+    };
+}
+
+void erasePass(benchmark::State& state, const Target& target,
+               const Engine& engine)
+{
+    if (!std::filesystem::is_block_file(target.path))
+    {
+        makeSparse(target);
+    }
+    /* a verify needs what the matching write leaves behind */
+    if (!engine.writes)
+    {
+        EraseOptions options;
+        stdplus::fd::ManagedFd fd =
+            openTarget(target, stdplus::fd::OpenAccess::WriteOnly);
+        if (engine.name.starts_with("pattern"))
+        {
+            Pattern(target.path, options).writePattern(target.size, fd);
+        }
+        else
+        {
+            Zero(target.path, options).writeZero(target.size, fd);
+        }
+    }
+
+    /* a sampled verify reads less than the target */
+    double bytes = 0;
+    Usage before = Usage::now();
+    for (auto _ : state)
+    {
+        if (target.sparse && engine.writes)
+        {
+            state.PauseTiming();
+            makeSparse(target);
+            state.ResumeTiming();
+        }
+        std::optional<uint64_t> done = engine.pass(engine.options, target);
+        if (!done)
+        {
+            state.SkipWithError("mode not available");
+            break;
+        }
+        bytes += static_cast<double>(*done);
+    }
+    Usage after = Usage::now();
+    if (!std::filesystem::is_block_file(target.path))
+    {
+        std::filesystem::remove(target.path);
+    }
+
+    double gigabytes = bytes / 1e9;
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    /* shown per second */
+    state.counters["MB"] =
+        benchmark::Counter(bytes / 1e6, benchmark::Counter::kIsRate);
+    if (gigabytes > 0)
+    {
+        state.counters["CPU_s/GB"] =
+            (after.cpuSeconds - before.cpuSeconds) / gigabytes;
+        if (!engine.uring && before.syscalls && after.syscalls)
+        {
+            state.counters["syscalls/GB"] =
+                static_cast<double>(*after.syscalls - *before.syscalls) /
+                gigabytes;
+        }
+    }
+}
+
+/* The file target on the filesystem of the working directory, a tmpfs
+ * target if /dev/shm is one, and the device in ESTORAGED_BENCH_DEVICE,
+ * whose first deviceSize bytes get overwritten
+ */
+std::vector<Target> targets()
+{
+    std::vector<Target> list;
+    list.push_back({"file", "erase_bench.img", fileSize, true});
+
+    struct statfs fs{};
+    if (statfs("/dev/shm", &fs) == 0 &&
+        static_cast<uint64_t>(fs.f_type) == TMPFS_MAGIC)
+    {
+        list.push_back({"tmpfs", "/dev/shm/erase_bench.img", fileSize, false});
+    }
+
+    if (const char* device = std::getenv("ESTORAGED_BENCH_DEVICE"))
+    {
+        uint64_t size = std::min(
+            deviceSize, estoraged::util::findSizeOfBlockDevice(device));
+        list.push_back({"device", device, size, false});
+    }
+    return list;
+}
+
+/* One benchmark per engine and target */
+const bool registered = [] {
+    for (const Target& target : targets())
+    {
+        for (const Engine& engine : engines())
+        {
+            std::string name = engine.name + "/" + target.name;
+            benchmark::RegisterBenchmark(name.c_str(), erasePass, target,
+                                         engine)
+                ->Unit(benchmark::kMillisecond)
+                ->UseRealTime();
+        }
+    }
+    return true;
+}();
+
+} // namespace estoraged_bench
+
+BENCHMARK_MAIN();
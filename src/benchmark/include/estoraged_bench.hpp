@@ -0,0 +1,22 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+namespace estoraged_bench
+{
+
+/* Bytes per second and CPU seconds per GB of a kernel, for benchmarks that
+ * process range(0) bytes per iteration
+ */
+inline void setBytes(benchmark::State& state)
+{
+    int64_t bytes = static_cast<int64_t>(state.iterations()) * state.range(0);
+    state.SetBytesProcessed(bytes);
+    state.counters["CPU/GB"] = benchmark::Counter(
+        static_cast<double>(bytes) / 1e9,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+} // namespace estoraged_bench
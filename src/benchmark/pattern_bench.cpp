@@ -0,0 +1,171 @@
+#include "estoraged_bench.hpp"
+#include "pattern.hpp"
+#include "patternGenerator.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace estoraged_bench
+{
+
+using estoraged::MinstdGenerator;
+using estoraged::Pattern;
+using estoraged::PhiloxGenerator;
+using estoraged::philoxKernels;
+
+constexpr uint32_t seed = Pattern::seed;
+
+/* The chunk after the previous one, as the write pass fills them */
+void fillMinstd(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    std::vector<std::byte> buf(size);
+    MinstdGenerator generator(seed);
+    uint64_t offset = 0;
+    for (auto _ : state)
+    {
+        generator.fill(offset, buf);
+        benchmark::DoNotOptimize(buf.data());
+        benchmark::ClobberMemory();
+        offset += size;
+    }
+    setBytes(state);
+}
+
+void fillPhilox(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    std::vector<std::byte> buf(size);
+    PhiloxGenerator generator(seed);
+    uint64_t offset = 0;
+    for (auto _ : state)
+    {
+        generator.fill(offset, buf);
+        benchmark::DoNotOptimize(buf.data());
+        benchmark::ClobberMemory();
+        offset += size;
+    }
+    setBytes(state);
+}
+
+void fillKernel(benchmark::State& state, size_t kernelIndex)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    std::vector<std::byte> buf(size);
+    auto fill = philoxKernels().at(kernelIndex).fill;
+    uint64_t index = 0;
+    for (auto _ : state)
+    {
+        fill(index, {seed, 0}, buf);
+        benchmark::DoNotOptimize(buf.data());
+        benchmark::ClobberMemory();
+        index += size / PhiloxGenerator::blockSize;
+    }
+    setBytes(state);
+}
+
+/* The compare of the verify pass, on a chunk that matches */
+void compareRangesEqual(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    std::vector<std::byte> read(size, std::byte{0x5a});
+    std::vector<std::byte> expected(size, std::byte{0x5a});
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(std::ranges::equal(read, expected));
+    }
+    setBytes(state);
+}
+
+void compareMemcmp(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    std::vector<std::byte> read(size, std::byte{0x5a});
+    std::vector<std::byte> expected(size, std::byte{0x5a});
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(
+            std::memcmp(read.data(), expected.data(), size));
+    }
+    setBytes(state);
+}
+
+/* All the CPU work of the verify pass for one chunk */
+void verifyChunk(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    std::vector<std::byte> read(size);
+    std::vector<std::byte> expected(size);
+    PhiloxGenerator generator(seed);
+    generator.fill(0, read);
+    for (auto _ : state)
+    {
+        generator.fill(0, expected);
+        benchmark::DoNotOptimize(std::ranges::equal(read, expected));
+    }
+    setBytes(state);
+}
+
+/* The same check with the fused kernel, which never stores the expected
+ * chunk
+ */
+void verifyChunkFused(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    std::vector<std::byte> read(size);
+    PhiloxGenerator generator(seed);
+    generator.fill(0, read);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(generator.mismatch(0, read));
+    }
+    setBytes(state);
+}
+
+void findKernel(benchmark::State& state, size_t kernelIndex)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    std::vector<std::byte> read(size);
+    const auto& kernel = philoxKernels().at(kernelIndex);
+    kernel.fill(0, {seed, 0}, read);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(kernel.find(0, {seed, 0}, read));
+    }
+    setBytes(state);
+}
+
+BENCHMARK(fillMinstd)->RangeMultiplier(16)->Range(4096, 4 << 20);
+BENCHMARK(fillPhilox)->RangeMultiplier(16)->Range(4096, 4 << 20);
+BENCHMARK(compareRangesEqual)->RangeMultiplier(16)->Range(4096, 4 << 20);
+BENCHMARK(compareMemcmp)->RangeMultiplier(16)->Range(4096, 4 << 20);
+BENCHMARK(verifyChunk)->RangeMultiplier(16)->Range(4096, 4 << 20);
+BENCHMARK(verifyChunkFused)->RangeMultiplier(16)->Range(4096, 4 << 20);
+
+/* One benchmark per Philox kernel this CPU can run */
+const bool registered = [] {
+    auto kernels = philoxKernels();
+    for (size_t i = 0; i < kernels.size(); i++)
+    {
+        std::string name = "fillPhilox/" + std::string(kernels[i].name);
+        benchmark::RegisterBenchmark(name.c_str(), fillKernel, i)
+            ->RangeMultiplier(16)
+            ->Range(4096, 4 << 20);
+        name = "findPhilox/" + std::string(kernels[i].name);
+        benchmark::RegisterBenchmark(name.c_str(), findKernel, i)
+            ->RangeMultiplier(16)
+            ->Range(4096, 4 << 20);
+    }
+    return true;
+}();
+
+} // namespace estoraged_bench
+
+BENCHMARK_MAIN();
@@ -0,0 +1,59 @@
+#include "estoraged_bench.hpp"
+#include "zeroCheck.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace estoraged_bench
+{
+
+using estoraged::zeroCheckKernels;
+
+/* The previous ZeroVerify check, a memcmp against a zeroed block */
+void zeroCheckMemcmp(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    std::vector<std::byte> data(size, std::byte{0});
+    std::vector<std::byte> zeros(size, std::byte{0});
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(
+            std::memcmp(data.data(), zeros.data(), data.size()));
+    }
+    setBytes(state);
+}
+
+void zeroCheckKernel(benchmark::State& state, size_t kernelIndex)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    std::vector<std::byte> data(size, std::byte{0});
+    auto find = zeroCheckKernels().at(kernelIndex).find;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(find(data));
+    }
+    setBytes(state);
+}
+
+BENCHMARK(zeroCheckMemcmp)->RangeMultiplier(16)->Range(4096, 4 << 20);
+
+/* One benchmark per kernel this CPU can run */
+const bool registered = [] {
+    auto kernels = zeroCheckKernels();
+    for (size_t i = 0; i < kernels.size(); i++)
+    {
+        std::string name = "zeroCheck/" + std::string(kernels[i].name);
+        benchmark::RegisterBenchmark(name.c_str(), zeroCheckKernel, i)
+            ->RangeMultiplier(16)
+            ->Range(4096, 4 << 20);
+    }
+    return true;
+}();
+
+} // namespace estoraged_bench
+
+BENCHMARK_MAIN();
@@ -0,0 +1,256 @@
+#include "bkopsScheduler.hpp"
+
+#include "deviceWorker.hpp"
+#include "extCsd.hpp"
+#include "mmcChannel.hpp"
+
+#include <linux/mmc/core.h>
+#include <linux/mmc/ioctl.h>
+#include <linux/mmc/mmc.h>
+
+#include <boost/asio/post.hpp>
+#include <phosphor-logging/lg2.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace estoraged
+{
+
+std::optional<BlockStat> parseBlockStat(std::string_view text)
+{
+    // read ios, read merges, read sectors, read ticks, write ios, write
+    // merges, write sectors, write ticks, in flight, io ticks, time in
+    // queue, then on newer kernels the same four for discards and flushes
+    constexpr size_t readIos = 0;
+    constexpr size_t writeIos = 4;
+    constexpr size_t inFlight = 8;
+    constexpr size_t discardIos = 11;
+
+    std::array<uint64_t, 15> fields{};
+    size_t count = 0;
+    const char* pos = text.data();
+    const char* end = text.data() + text.size();
+    while (count < fields.size())
+    {
+        while (pos != end && (*pos == ' ' || *pos == '\n'))
+        {
+            pos++;
+        }
+        if (pos == end)
+        {
+            break;
+        }
+        auto [next, ec] = std::from_chars(pos, end, fields[count]);
+        if (ec != std::errc())
+        {
+            return std::nullopt;
+        }
+        pos = next;
+        count++;
+    }
+    if (count <= inFlight)
+    {
+        return std::nullopt;
+    }
+
+    BlockStat stat;
+    stat.ios = fields[readIos] + fields[writeIos] + fields[discardIos];
+    stat.inFlight = fields[inFlight];
+    return stat;
+}
+
+bool IdleDetector::update(const BlockStat& stat, Clock::time_point now)
+{
+    if (!last || stat.ios != last->ios || stat.inFlight != 0)
+    {
+        lastActivity = now;
+    }
+    last = stat;
+    return now - lastActivity >= idleTime;
+}
+
+bool shouldStartBkops(BkopsStatus level, bool idle)
+{
+    if (level == BkopsStatus::Critical)
+    {
+        return true;
+    }
+    return level != BkopsStatus::None && idle;
+}
+
+std::string bkopsLevelName(BkopsStatus level)
+{
+    switch (level)
+    {
+        case BkopsStatus::None:
+            return "None";
+        case BkopsStatus::NonCritical:
+            return "NonCritical";
+        case BkopsStatus::PerformanceImpacted:
+            return "PerformanceImpacted";
+        case BkopsStatus::Critical:
+            return "Critical";
+    }
+    return "Unknown";
+}
+
+BkopsScheduler::BkopsScheduler(
+    boost::asio::io_context& io, sdbusplus::asio::object_server& server,
+    const std::string& objectPath, DeviceWorker& worker,
+    std::shared_ptr<MmcChannel> mmc, std::filesystem::path statPath,
+    std::chrono::steady_clock::duration pollInterval,
+    std::chrono::steady_clock::duration idleTime) :
+    objectServer(server), worker(worker), mmc(std::move(mmc)),
+    statPath(std::move(statPath)), pollInterval(pollInterval), timer(io),
+    idleDetector(idleTime)
+{
+    bkopsInterface = objectServer.add_interface(
+        objectPath, "xyz.openbmc_project.eStoraged.BackgroundOperations");
+    bkopsInterface->register_property("Level", std::string("Unknown"));
+    bkopsInterface->register_property("Idle", false);
+    bkopsInterface->register_property("IdleRuns", uint64_t{0});
+    bkopsInterface->register_property("UrgentRuns", uint64_t{0});
+    bkopsInterface->register_property("Failures", uint64_t{0});
+    bkopsInterface->initialize();
+}
+
+BkopsScheduler::~BkopsScheduler()
+{
+    timer.cancel();
+    objectServer.remove_interface(bkopsInterface);
+}
+
+void BkopsScheduler::start()
+{
+    lg2::info("Scheduling background operations for {DEV}", "DEV",
+              mmc->path());
+    schedule();
+}
+
+void BkopsScheduler::schedule()
+{
+    timer.expires_after(pollInterval);
+    timer.async_wait([weak = weak_from_this()](
+                         const boost::system::error_code& ec) {
+        if (ec)
+        {
+            return;
+        }
+        if (std::shared_ptr<BkopsScheduler> scheduler = weak.lock())
+        {
+            scheduler->poll();
+            scheduler->schedule();
+        }
+    });
+}
+
+void BkopsScheduler::poll()
+{
+    std::ifstream file(statPath);
+    std::string text((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+    std::optional<BlockStat> stat = parseBlockStat(text);
+    // without the stat file, only urgent operations run
+    bool idle = stat && idleDetector.update(*stat,
+                                            std::chrono::steady_clock::now());
+
+    // a poll still queued behind an erase is enough
+    if (pending)
+    {
+        return;
+    }
+    pending = true;
+    auto executor = timer.get_executor();
+    worker.post([weak = weak_from_this(), mmc = mmc, executor, idle]() {
+        PollResult result = pollDevice(*mmc, idle);
+        boost::asio::post(executor, [weak, result, idle]() {
+            if (std::shared_ptr<BkopsScheduler> scheduler = weak.lock())
+            {
+                scheduler->publish(result, idle);
+            }
+        });
+    });
+}
+
+BkopsScheduler::PollResult BkopsScheduler::pollDevice(MmcChannel& mmc,
+                                                      bool idle)
+{
+    PollResult result;
+    // the device changes BKOPS_STATUS on its own, the cached copy is stale
+    mmc.invalidate();
+    std::optional<ExtCsd> extCsd = mmc.extCsd();
+    if (!extCsd)
+    {
+        result.failed = true;
+        return result;
+    }
+    result.level = extCsd->bkopsStatus();
+    if (!shouldStartBkops(*result.level, idle))
+    {
+        return result;
+    }
+
+    struct mmc_ioc_cmd idata = {};
+    idata.write_flag = 1;
+    idata.opcode = MMC_SWITCH;
+    idata.arg = (MMC_SWITCH_MODE_WRITE_BYTE << 24) |
+                (EXT_CSD_BKOPS_START << 16) | (1 << 8) |
+                EXT_CSD_CMD_SET_NORMAL;
+    idata.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+    idata.cmd_timeout_ms = bkopsTimeoutMs;
+    try
+    {
+        result.started = mmc.command(idata) == 0;
+    }
+    catch (const std::exception& e)
+    {
+        lg2::error("BKOPS_START failed on {DEV}: {ERROR}", "DEV", mmc.path(),
+                   "ERROR", e.what());
+    }
+    result.failed = !result.started;
+    return result;
+}
+
+void BkopsScheduler::publish(const PollResult& result, bool idle)
+{
+    pending = false;
+    bkopsInterface->set_property("Idle", idle);
+    if (result.level)
+    {
+        bkopsInterface->set_property("Level", bkopsLevelName(*result.level));
+    }
+    if (result.started)
+    {
+        if (*result.level == BkopsStatus::Critical)
+        {
+            urgentRuns++;
+            bkopsInterface->set_property("UrgentRuns", urgentRuns);
+        }
+        else
+        {
+            idleRuns++;
+            bkopsInterface->set_property("IdleRuns", idleRuns);
+        }
+        lg2::info("Ran background operations on {DEV} at level {LEVEL}",
+                  "DEV", mmc->path(), "LEVEL",
+                  bkopsLevelName(*result.level));
+    }
+    if (result.failed)
+    {
+        failures++;
+        bkopsInterface->set_property("Failures", failures);
+    }
+}
+
+} // namespace estoraged
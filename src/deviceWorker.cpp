@@ -0,0 +1,69 @@
+#include "deviceWorker.hpp"
+
+#include <boost/asio/post.hpp>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace estoraged
+{
+
+DeviceWorker::Running::Running(std::shared_ptr<State> state) :
+    state(std::move(state))
+{
+    std::lock_guard lock(this->state->mutex);
+    this->state->busy = true;
+}
+
+DeviceWorker::Running::~Running()
+{
+    std::lock_guard lock(state->mutex);
+    state->busy = false;
+    state->idle.notify_all();
+}
+
+DeviceWorker::~DeviceWorker()
+{
+    if (abandoned)
+    {
+        // the thread still uses the pool, and joining it would hang
+        static_cast<void>(pool.release());
+        return;
+    }
+    stop();
+}
+
+void DeviceWorker::stop()
+{
+    pool->stop();
+    pool->join();
+}
+
+bool DeviceWorker::stop(std::chrono::milliseconds timeout)
+{
+    pool->stop();
+    {
+        std::unique_lock lock(state->mutex);
+        if (!state->idle.wait_for(lock, timeout,
+                                  [this]() { return !state->busy; }))
+        {
+            abandoned = true;
+            return false;
+        }
+    }
+    pool->join();
+    return true;
+}
+
+void DeviceWorker::post(std::function<void()> task)
+{
+    boost::asio::post(*pool, [state = state, task = std::move(task)]() {
+        Running running(state);
+        task();
+    });
+}
+
+} // namespace estoraged
@@ -0,0 +1,140 @@
+#include "badRangeMap.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace estoraged
+{
+
+BadRangeMap::BadRangeMap(size_t limit) : limit(std::max<size_t>(limit, 1)) {}
+
+void BadRangeMap::add(BadRangeKind kind, uint64_t offset, uint64_t length)
+{
+    std::lock_guard lock(mutex);
+    counts.at(static_cast<size_t>(kind))++;
+    if (length == 0)
+    {
+        return;
+    }
+
+    uint64_t end = offset + length;
+    // the first range that could touch the new one
+    auto it = runs.upper_bound(offset);
+    if (it != runs.begin() && std::prev(it)->second >= offset)
+    {
+        --it;
+    }
+    while (it != runs.end() && it->first <= end)
+    {
+        offset = std::min(offset, it->first);
+        end = std::max(end, it->second);
+        it = runs.erase(it);
+    }
+    runs.emplace(offset, end);
+
+    while (runs.size() > limit)
+    {
+        joinClosest();
+    }
+}
+
+void BadRangeMap::joinClosest()
+{
+    auto closest = runs.begin();
+    uint64_t smallest = std::numeric_limits<uint64_t>::max();
+    for (auto it = runs.begin(); std::next(it) != runs.end(); ++it)
+    {
+        uint64_t gap = std::next(it)->first - it->second;
+        if (gap < smallest)
+        {
+            smallest = gap;
+            closest = it;
+        }
+    }
+    auto next = std::next(closest);
+    closest->second = next->second;
+    runs.erase(next);
+    joined = true;
+}
+
+std::vector<BadRange> BadRangeMap::ranges() const
+{
+    std::lock_guard lock(mutex);
+    std::vector<BadRange> list;
+    list.reserve(runs.size());
+    for (const auto& [offset, end] : runs)
+    {
+        list.push_back({offset, end - offset});
+    }
+    return list;
+}
+
+bool BadRangeMap::empty() const
+{
+    std::lock_guard lock(mutex);
+    return std::ranges::all_of(counts, [](uint64_t n) { return n == 0; });
+}
+
+uint64_t BadRangeMap::count(BadRangeKind kind) const
+{
+    std::lock_guard lock(mutex);
+    return counts.at(static_cast<size_t>(kind));
+}
+
+uint64_t BadRangeMap::badBytes() const
+{
+    std::lock_guard lock(mutex);
+    uint64_t bytes = 0;
+    for (const auto& [offset, end] : runs)
+    {
+        bytes += end - offset;
+    }
+    return bytes;
+}
+
+bool BadRangeMap::coarsened() const
+{
+    std::lock_guard lock(mutex);
+    return joined;
+}
+
+void recordMismatches(BadRangeMap& map, uint64_t offset,
+                      std::span<const std::byte> data, size_t first,
+                      const MismatchFinder& find, size_t sectorSize)
+{
+    auto sector = [&](size_t start) {
+        return data.subspan(start, std::min(sectorSize, data.size() - start));
+    };
+
+    size_t wrong = first;
+    while (wrong < data.size())
+    {
+        size_t begin = wrong / sectorSize * sectorSize;
+        size_t end = begin + sector(begin).size();
+        while (end < data.size() &&
+               find(offset + end, sector(end)) != sector(end).size())
+        {
+            end += sector(end).size();
+        }
+        map.add(BadRangeKind::Mismatch, offset + begin, end - begin);
+        if (end == data.size())
+        {
+            break;
+        }
+        // the sector at end is correct, look for the next wrong byte after
+        // it, so a generator behind find only moves forward
+        size_t next = end + sector(end).size();
+        if (next == data.size())
+        {
+            break;
+        }
+        wrong = next + find(offset + next, data.subspan(next));
+    }
+}
+
+} // namespace estoraged
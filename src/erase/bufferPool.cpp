@@ -0,0 +1,91 @@
+#include "bufferPool.hpp"
+
+#include <phosphor-logging/lg2.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace estoraged
+{
+
+using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+
+namespace
+{
+
+/* O_DIRECT buffers are page aligned, even if the sectors are smaller. */
+constexpr size_t pageSize = 4096;
+
+size_t roundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+} // namespace
+
+AlignedBuffer::AlignedBuffer(size_t size, size_t alignment) :
+    size(size),
+    // NOLINTNEXTLINE(cppcoreguidelines-no-malloc)
+    data(static_cast<std::byte*>(
+        std::aligned_alloc(alignment, roundUp(size, alignment))))
+{
+    if (data == nullptr)
+    {
+        lg2::error("Unable to allocate erase buffer of {SIZE} bytes", "SIZE",
+                   size, "REDFISH_MESSAGE_ID",
+                   std::string("eStorageD.1.0.EraseFailure"));
+        throw InternalFailure();
+    }
+    std::memset(data.get(), 0, size);
+}
+
+BufferPool::BufferPool(size_t count, size_t bufferSize, size_t alignment) :
+    size(bufferSize)
+{
+    buffers.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        buffers.emplace_back(bufferSize, alignment);
+    }
+}
+
+BufferPool BufferPool::forErase(size_t count, const EraseOptions& options,
+                                const util::BlockGeometry& geometry,
+                                size_t bufferedSize)
+{
+    return {count, eraseChunkSize(options, geometry, bufferedSize),
+            directIoAlignment(geometry)};
+}
+
+size_t erasePoolSize(const EraseOptions& options)
+{
+    return std::max({std::max<size_t>(options.queueDepth, 1) + 1,
+                     options.pipelineDepth + 1, options.verifyThreads * 2});
+}
+
+size_t directIoAlignment(const util::BlockGeometry& geometry)
+{
+    return std::max(
+        {pageSize, geometry.logicalBlockSize, geometry.physicalBlockSize});
+}
+
+size_t eraseChunkSize(const EraseOptions& options,
+                      const util::BlockGeometry& geometry, size_t bufferedSize)
+{
+    if (!options.directIo)
+    {
+        return options.chunkSize != 0 ? options.chunkSize : bufferedSize;
+    }
+
+    size_t chunk = options.chunkSize;
+    if (chunk == 0)
+    {
+        chunk = std::max(minDirectIoChunk, geometry.optimalIoSize);
+    }
+    return roundUp(chunk, directIoAlignment(geometry));
+}
+
+} // namespace estoraged
@@ -0,0 +1,244 @@
+#include "emmcErasePlan.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/* SEC_FEATURE_SUPPORT bits */
+constexpr uint8_t secureErEn = (1 << 0);
+constexpr uint8_t secGbClEn = (1 << 4);
+constexpr uint8_t secSanitize = (1 << 6);
+
+/* EXT_CSD_REV of eMMC 4.5, which added DISCARD */
+constexpr uint8_t extCsdRevDiscard = 6;
+
+/* HC_ERASE_GRP_SIZE and timeout units, see eMMC spec 7.4 */
+constexpr uint64_t hcEraseGroupUnit = 512 * 1024;
+constexpr uint32_t eraseTimeoutUnitMs = 300;
+
+/* CMD38 arguments */
+constexpr uint32_t eraseArg = 0x00000000;
+constexpr uint32_t trimArg = 0x00000001;
+constexpr uint32_t discardArg = 0x00000003;
+constexpr uint32_t secureEraseArg = 0x80000000;
+constexpr uint32_t secureTrim1Arg = 0x80000001;
+constexpr uint32_t secureTrim2Arg = 0x80008000;
+
+} // namespace
+
+namespace estoraged
+{
+
+EmmcEraseGeometry
+    parseEraseGeometry(std::span<const uint8_t, extCsdSize> extCsd)
+{
+    EmmcEraseGeometry geometry;
+    // only devices larger than 2 GB have a sector count and sector
+    // addressing
+    geometry.addressUnit = ExtCsd(extCsd).sectorCount() != 0 ? 512 : 1;
+    if ((extCsd[extcsd::eraseGroupDef] & 0x1) != 0)
+    {
+        geometry.groupSize = extCsd[extcsd::hcEraseGrpSize] * hcEraseGroupUnit;
+        geometry.groupTimeoutMs =
+            extCsd[extcsd::eraseTimeoutMult] * eraseTimeoutUnitMs;
+    }
+    return geometry;
+}
+
+EmmcEraseCapabilities
+    parseEraseCapabilities(std::span<const uint8_t, extCsdSize> extCsd)
+{
+    EmmcEraseCapabilities capabilities;
+    capabilities.geometry = parseEraseGeometry(extCsd);
+    uint8_t features = extCsd[extcsd::secFeatureSupport];
+    capabilities.trim = (features & secGbClEn) != 0;
+    capabilities.discard = extCsd[extcsd::rev] >= extCsdRevDiscard;
+    capabilities.secureErase = (features & secureErEn) != 0;
+    capabilities.sanitize = (features & secSanitize) != 0;
+    capabilities.trimTimeoutMs = extCsd[extcsd::trimMult] * eraseTimeoutUnitMs;
+    capabilities.secureEraseMult = extCsd[extcsd::secEraseMult];
+    capabilities.secureTrimMult = extCsd[extcsd::secTrimMult];
+    return capabilities;
+}
+
+std::string eraseStepName(EmmcEraseStep step)
+{
+    switch (step)
+    {
+        case EmmcEraseStep::Discard:
+            return "Discard";
+        case EmmcEraseStep::Trim:
+            return "Trim";
+        case EmmcEraseStep::Erase:
+            return "Erase";
+        case EmmcEraseStep::SecureTrim:
+            return "SecureTrim";
+        case EmmcEraseStep::SecureErase:
+            return "SecureErase";
+        case EmmcEraseStep::Sanitize:
+            return "Sanitize";
+    }
+    return "Unknown";
+}
+
+std::vector<uint32_t> eraseStepArgs(EmmcEraseStep step)
+{
+    switch (step)
+    {
+        case EmmcEraseStep::Discard:
+            return {discardArg};
+        case EmmcEraseStep::Trim:
+            return {trimArg};
+        case EmmcEraseStep::Erase:
+            return {eraseArg};
+        // the first pass marks the blocks, the second purges them
+        case EmmcEraseStep::SecureTrim:
+            return {secureTrim1Arg, secureTrim2Arg};
+        case EmmcEraseStep::SecureErase:
+            return {secureEraseArg};
+        case EmmcEraseStep::Sanitize:
+            return {};
+    }
+    return {};
+}
+
+uint64_t eraseStepGroupTimeoutMs(const EmmcEraseCapabilities& capabilities,
+                                 EmmcEraseStep step)
+{
+    // the same timeouts as the kernel, see mmc_mmc_erase_timeout
+    switch (step)
+    {
+        case EmmcEraseStep::Discard:
+        case EmmcEraseStep::Trim:
+            return capabilities.trimTimeoutMs;
+        case EmmcEraseStep::Erase:
+            return capabilities.geometry.groupTimeoutMs;
+        case EmmcEraseStep::SecureTrim:
+            return uint64_t{capabilities.trimTimeoutMs} *
+                   capabilities.secureTrimMult;
+        case EmmcEraseStep::SecureErase:
+            return uint64_t{capabilities.geometry.groupTimeoutMs} *
+                   capabilities.secureEraseMult;
+        case EmmcEraseStep::Sanitize:
+            return 0;
+    }
+    return 0;
+}
+
+std::string EmmcErasePlan::name() const
+{
+    std::string joined;
+    for (EmmcEraseStep step : steps)
+    {
+        if (!joined.empty())
+        {
+            joined += '+';
+        }
+        joined += eraseStepName(step);
+    }
+    return joined;
+}
+
+namespace
+{
+
+/* Worst case duration of the steps, nullopt if a timeout is not known */
+std::optional<std::chrono::milliseconds>
+    estimateSteps(const EmmcEraseCapabilities& capabilities,
+                  const std::vector<EmmcEraseStep>& steps, uint64_t driveSize)
+{
+    const uint64_t groupSize = capabilities.geometry.groupSize;
+    if (groupSize == 0)
+    {
+        return std::nullopt;
+    }
+    const uint64_t groups = (driveSize + groupSize - 1) / groupSize;
+    std::chrono::milliseconds total{0};
+    for (EmmcEraseStep step : steps)
+    {
+        if (step == EmmcEraseStep::Sanitize)
+        {
+            total += sanitizeEstimate;
+            continue;
+        }
+        uint64_t timeout = eraseStepGroupTimeoutMs(capabilities, step);
+        if (timeout == 0)
+        {
+            return std::nullopt;
+        }
+        total += std::chrono::milliseconds(groups * timeout *
+                                           eraseStepArgs(step).size());
+    }
+    return total;
+}
+
+} // namespace
+
+std::optional<EmmcErasePlan>
+    planErase(const EmmcEraseCapabilities& capabilities,
+              EmmcErasePolicy policy, uint64_t driveSize)
+{
+    using enum EmmcEraseStep;
+
+    if (policy == EmmcErasePolicy::Legacy)
+    {
+        EmmcErasePlan plan{{Erase, Sanitize}};
+        plan.estimate = estimateSteps(capabilities, plan.steps, driveSize)
+                            .value_or(std::chrono::milliseconds(0));
+        return plan;
+    }
+
+    // in order of preference when the estimates tie
+    std::vector<std::vector<EmmcEraseStep>> candidates;
+    if (capabilities.sanitize && capabilities.discard)
+    {
+        candidates.push_back({Discard, Sanitize});
+    }
+    if (capabilities.sanitize && capabilities.trim)
+    {
+        candidates.push_back({Trim, Sanitize});
+    }
+    if (capabilities.sanitize)
+    {
+        candidates.push_back({Erase, Sanitize});
+    }
+    if (capabilities.secureErase)
+    {
+        candidates.push_back({SecureErase});
+    }
+    if (capabilities.secureErase && capabilities.trim)
+    {
+        candidates.push_back({SecureTrim});
+    }
+    if (policy == EmmcErasePolicy::Clear)
+    {
+        // a discarded block may still read back, so discard alone is not
+        // enough
+        if (capabilities.trim)
+        {
+            candidates.push_back({Trim});
+        }
+        candidates.push_back({Erase});
+    }
+
+    std::optional<EmmcErasePlan> best;
+    for (const std::vector<EmmcEraseStep>& steps : candidates)
+    {
+        std::optional<std::chrono::milliseconds> estimate =
+            estimateSteps(capabilities, steps, driveSize);
+        if (estimate && (!best || *estimate < best->estimate))
+        {
+            best = EmmcErasePlan{steps, *estimate};
+        }
+    }
+    return best;
+}
+
+} // namespace estoraged
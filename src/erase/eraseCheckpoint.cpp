@@ -0,0 +1,167 @@
+#include "eraseCheckpoint.hpp"
+
+#include "patternGenerator.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <phosphor-logging/lg2.hpp>
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace estoraged
+{
+
+namespace
+{
+
+std::string_view patternName(PatternType type)
+{
+    return type == PatternType::Minstd ? "Minstd" : "Philox";
+}
+
+bool parseNumber(std::string_view value, uint64_t& number)
+{
+    auto [end, ec] =
+        std::from_chars(value.data(), value.data() + value.size(), number);
+    return ec == std::errc() && end == value.data() + value.size();
+}
+
+/* Flushes the device, so the data below the checkpoint is durable */
+bool syncDevice(const std::string& devPath)
+{
+    int fd = open(devPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool synced = fdatasync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+} // namespace
+
+EraseCheckpoint::EraseCheckpoint(std::filesystem::path file,
+                                 std::string devPath) :
+    file(std::move(file)), devPath(std::move(devPath))
+{}
+
+bool EraseCheckpoint::save(const CheckpointData& data) const
+{
+    if (!syncDevice(devPath))
+    {
+        lg2::error("Unable to sync {DEV} for the erase checkpoint: {ERROR}",
+                   "DEV", devPath, "ERROR", std::strerror(errno));
+        return false;
+    }
+
+    std::string contents =
+        "method=" + data.method + "\npattern=" +
+        std::string(patternName(data.patternType)) +
+        "\nseed=" + std::to_string(data.seed) +
+        "\nsize=" + std::to_string(data.driveSize) +
+        "\noffset=" + std::to_string(data.offset) + "\n";
+
+    std::error_code ec;
+    std::filesystem::create_directories(file.parent_path(), ec);
+    std::filesystem::path temp = file;
+    temp += ".tmp";
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0600);
+    bool saved = fd >= 0;
+    if (saved)
+    {
+        saved = write(fd, contents.data(), contents.size()) ==
+                    static_cast<ssize_t>(contents.size()) &&
+                fsync(fd) == 0;
+        saved = close(fd) == 0 && saved;
+    }
+    if (!saved || rename(temp.c_str(), file.c_str()) != 0)
+    {
+        lg2::error("Unable to save the erase checkpoint {FILE}: {ERROR}",
+                   "FILE", file, "ERROR", std::strerror(errno));
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+std::optional<CheckpointData> EraseCheckpoint::load() const
+{
+    std::ifstream input(file);
+    if (!input)
+    {
+        return std::nullopt;
+    }
+
+    CheckpointData data;
+    bool hasMethod = false;
+    bool hasSize = false;
+    bool hasOffset = false;
+    std::string line;
+    while (std::getline(input, line))
+    {
+        size_t equals = line.find('=');
+        if (equals == std::string::npos)
+        {
+            continue;
+        }
+        std::string_view key = std::string_view(line).substr(0, equals);
+        std::string_view value = std::string_view(line).substr(equals + 1);
+        bool valid = true;
+        if (key == "method")
+        {
+            data.method = value;
+            hasMethod = !value.empty();
+        }
+        else if (key == "pattern")
+        {
+            valid = value == "Philox" || value == "Minstd";
+            data.patternType =
+                value == "Minstd" ? PatternType::Minstd : PatternType::Philox;
+        }
+        else if (key == "seed")
+        {
+            valid = parseNumber(value, data.seed);
+        }
+        else if (key == "size")
+        {
+            valid = hasSize = parseNumber(value, data.driveSize);
+        }
+        else if (key == "offset")
+        {
+            valid = hasOffset = parseNumber(value, data.offset);
+        }
+        if (!valid)
+        {
+            lg2::error("Invalid erase checkpoint {FILE} entry: {LINE}", "FILE",
+                       file, "LINE", line);
+            return std::nullopt;
+        }
+    }
+
+    if (!hasMethod || !hasSize || !hasOffset || data.offset > data.driveSize)
+    {
+        lg2::error("Incomplete erase checkpoint {FILE}", "FILE", file);
+        return std::nullopt;
+    }
+    return data;
+}
+
+void EraseCheckpoint::remove() const
+{
+    std::error_code ec;
+    std::filesystem::remove(file, ec);
+}
+
+} // namespace estoraged
@@ -0,0 +1,115 @@
+#include "erasePriority.hpp"
+
+#include <linux/ioprio.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <phosphor-logging/lg2.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace estoraged
+{
+
+namespace
+{
+
+/* glibc has no wrappers for these */
+int getIoPriority()
+{
+    return static_cast<int>(syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0));
+}
+
+int setIoPriority(int priority)
+{
+    return static_cast<int>(
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, priority));
+}
+
+} // namespace
+
+ErasePriority::ErasePriority(const EraseOptions& options)
+{
+    if (options.ioClass != IoClass::Unchanged)
+    {
+        int priority =
+            options.ioClass == IoClass::Idle
+                ? IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)
+                : IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE,
+                                    std::clamp(options.ioLevel, 0,
+                                               IOPRIO_NR_LEVELS - 1));
+        int old = getIoPriority();
+        if (old >= 0 && setIoPriority(priority) == 0)
+        {
+            oldIoPriority = old;
+        }
+        else
+        {
+            lg2::error("Failed to set the I/O priority of the erase: {ERROR}",
+                       "ERROR", std::strerror(errno));
+        }
+    }
+
+    if (options.schedIdle)
+    {
+        int policy = sched_getscheduler(0);
+        sched_param idle{};
+        if (policy >= 0 && sched_getparam(0, &oldParam) == 0 &&
+            sched_setscheduler(0, SCHED_IDLE, &idle) == 0)
+        {
+            oldPolicy = policy;
+        }
+        else
+        {
+            lg2::error("Failed to schedule the erase as idle: {ERROR}",
+                       "ERROR", std::strerror(errno));
+        }
+    }
+
+    if (options.nice != 0)
+    {
+        // -1 is a valid nice value, so errors only show in errno
+        errno = 0;
+        int old = getpriority(PRIO_PROCESS, static_cast<id_t>(gettid()));
+        if (errno == 0 && setpriority(PRIO_PROCESS,
+                                      static_cast<id_t>(gettid()),
+                                      options.nice) == 0)
+        {
+            oldNice = old;
+        }
+        else
+        {
+            lg2::error("Failed to set the nice value of the erase: {ERROR}",
+                       "ERROR", std::strerror(errno));
+        }
+    }
+}
+
+ErasePriority::~ErasePriority()
+{
+    if (oldNice &&
+        setpriority(PRIO_PROCESS, static_cast<id_t>(gettid()), *oldNice) != 0)
+    {
+        lg2::error("Failed to restore the nice value after the erase: "
+                   "{ERROR}",
+                   "ERROR", std::strerror(errno));
+    }
+    if (oldPolicy && sched_setscheduler(0, *oldPolicy, &oldParam) != 0)
+    {
+        lg2::error("Failed to restore the scheduling policy after the erase: "
+                   "{ERROR}",
+                   "ERROR", std::strerror(errno));
+    }
+    if (oldIoPriority && setIoPriority(*oldIoPriority) != 0)
+    {
+        lg2::error("Failed to restore the I/O priority after the erase: "
+                   "{ERROR}",
+                   "ERROR", std::strerror(errno));
+    }
+}
+
+} // namespace estoraged
@@ -0,0 +1,124 @@
+#include "eraseProgress.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace estoraged
+{
+
+EraseProgress::EraseProgress(Callback callback, Clock::duration interval) :
+    callback(std::move(callback)), interval(interval)
+{}
+
+void EraseProgress::start(uint64_t totalBytes, uint64_t doneBytes)
+{
+    std::lock_guard lock(mutex);
+    Clock::time_point now = Clock::now();
+    processed = doneBytes;
+    total = totalBytes;
+    startTime = now;
+    startBytes = doneBytes;
+    lastTime = now;
+    lastBytes = doneBytes;
+    nextCheckpoint = now + checkpointInterval;
+    callback(update(now));
+}
+
+void EraseProgress::setCheckpoint(Checkpoint hook,
+                                  Clock::duration hookInterval)
+{
+    std::lock_guard lock(mutex);
+    checkpoint = std::move(hook);
+    checkpointInterval = hookInterval;
+    nextCheckpoint = Clock::now() + checkpointInterval;
+}
+
+void EraseProgress::advance(uint64_t bytes)
+{
+    if (cancelled)
+    {
+        throw EraseCancelled();
+    }
+    processed.fetch_add(bytes, std::memory_order_relaxed);
+    Clock::time_point now = Clock::now();
+    if (now.time_since_epoch().count() <
+        nextReport.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    // another thread is already reporting this interval
+    std::unique_lock lock(mutex, std::try_to_lock);
+    if (!lock || now.time_since_epoch().count() < nextReport.load())
+    {
+        return;
+    }
+    callback(update(now));
+}
+
+void EraseProgress::finish()
+{
+    std::lock_guard lock(mutex);
+    callback(update(Clock::now()));
+}
+
+void EraseProgress::setDeviceBusy(bool busy)
+{
+    std::lock_guard lock(mutex);
+    deviceBusy = busy;
+    callback(update(Clock::now()));
+}
+
+void EraseProgress::setPlan(std::string steps, uint64_t seconds)
+{
+    std::lock_guard lock(mutex);
+    planSteps = std::move(steps);
+    planSeconds = seconds;
+    callback(update(Clock::now()));
+}
+
+EraseProgressStatus EraseProgress::update(Clock::time_point now)
+{
+    using Seconds = std::chrono::duration<double>;
+    constexpr double bytesPerMb = 1000.0 * 1000.0;
+
+    EraseProgressStatus status;
+    status.bytesProcessed = std::min(processed.load(), total);
+    status.totalBytes = total;
+    status.deviceBusy = deviceBusy;
+    status.eraseSteps = planSteps;
+    status.estimatedSeconds = planSeconds;
+    status.percent =
+        total == 0 ? 100
+                   : static_cast<uint8_t>(status.bytesProcessed * 100 / total);
+
+    double window = Seconds(now - lastTime).count();
+    if (window > 0)
+    {
+        status.throughput =
+            static_cast<double>(status.bytesProcessed - lastBytes) /
+            bytesPerMb / window;
+    }
+    double elapsed = Seconds(now - startTime).count();
+    if (elapsed > 0 && status.bytesProcessed > startBytes)
+    {
+        double average =
+            static_cast<double>(status.bytesProcessed - startBytes) / elapsed;
+        status.secondsRemaining = static_cast<uint64_t>(
+            static_cast<double>(total - status.bytesProcessed) / average);
+    }
+
+    lastTime = now;
+    lastBytes = status.bytesProcessed;
+    nextReport = (now + interval).time_since_epoch().count();
+    if (checkpoint && now >= nextCheckpoint)
+    {
+        checkpoint(status.bytesProcessed);
+        nextCheckpoint = now + checkpointInterval;
+    }
+    return status;
+}
+
+} // namespace estoraged
@@ -0,0 +1,149 @@
+#include "eraseThrottle.hpp"
+
+#include <phosphor-logging/lg2.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace estoraged
+{
+
+EraseThrottle::EraseThrottle(const EraseOptions& options) :
+    EraseThrottle(options, Timer{})
+{}
+
+EraseThrottle::EraseThrottle(const EraseOptions& options, Timer timer) :
+    timer(std::move(timer)),
+    bytesPerSecond(std::max(options.maxThroughput, 0.0) * 1e6),
+    pressureLimit(std::max(options.ioPressureLimit, 0.0)),
+    pressurePath(options.ioPressurePath)
+{
+    Clock::time_point now = this->timer.now();
+    due = now;
+    nextSample = now;
+    resumeAt = now;
+}
+
+EraseThrottle::~EraseThrottle()
+{
+    if (backoffCount != 0)
+    {
+        lg2::info("Erase backed off {COUNT} times for I/O pressure", "COUNT",
+                  backoffCount);
+    }
+}
+
+bool EraseThrottle::enabled() const
+{
+    std::lock_guard lock(mutex);
+    return bytesPerSecond > 0 || pressureLimit > 0;
+}
+
+void EraseThrottle::pace(uint64_t bytes)
+{
+    Clock::duration wait{};
+    {
+        std::lock_guard lock(mutex);
+        Clock::time_point now = timer.now();
+        if (bytesPerSecond > 0)
+        {
+            std::chrono::duration<double> cost(static_cast<double>(bytes) /
+                                               bytesPerSecond);
+            due = std::max(due, now - burst) +
+                  std::chrono::duration_cast<Clock::duration>(cost);
+        }
+        if (pressureLimit > 0 && now >= nextSample)
+        {
+            samplePressure(now);
+        }
+        Clock::time_point until = std::max(due, resumeAt);
+        if (until > now)
+        {
+            wait = until - now;
+        }
+    }
+    // sleep unlocked, so the other threads see the same pause
+    if (wait > Clock::duration::zero())
+    {
+        timer.sleep(wait);
+    }
+}
+
+uint64_t EraseThrottle::backoffs() const
+{
+    std::lock_guard lock(mutex);
+    return backoffCount;
+}
+
+void EraseThrottle::samplePressure(Clock::time_point now)
+{
+    nextSample = now + pressureInterval;
+    std::optional<uint64_t> total = readStallTotal();
+    if (!total)
+    {
+        lg2::error("Failed to read the I/O pressure from {FILE}, the erase "
+                   "ignores it",
+                   "FILE", pressurePath);
+        pressureLimit = 0;
+        return;
+    }
+
+    if (lastTotal && now > lastSample && *total >= *lastTotal)
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            now - lastSample);
+        double percent = static_cast<double>(*total - *lastTotal) * 100 /
+                         static_cast<double>(elapsed.count());
+        if (percent > pressureLimit)
+        {
+            backoff = std::clamp(backoff * 2, minBackoff, maxBackoff);
+            resumeAt = now + backoff;
+            backoffCount++;
+        }
+        else
+        {
+            backoff /= 2;
+            if (backoff < minBackoff)
+            {
+                backoff = Clock::duration::zero();
+            }
+        }
+    }
+    lastSample = now;
+    lastTotal = total;
+}
+
+std::optional<uint64_t> EraseThrottle::readStallTotal() const
+{
+    // some avg10=0.00 avg60=0.00 avg300=0.00 total=12345
+    std::ifstream file(pressurePath);
+    std::string word;
+    bool some = false;
+    while (file >> word)
+    {
+        if (word == "some" || word == "full")
+        {
+            some = word == "some";
+        }
+        else if (some && word.starts_with("total="))
+        {
+            try
+            {
+                return std::stoull(word.substr(6));
+            }
+            catch (const std::exception&)
+            {
+                return std::nullopt;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace estoraged
@@ -0,0 +1,85 @@
+#include "extCsd.hpp"
+
+#include <linux/mmc/mmc.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace estoraged
+{
+
+uint8_t lifeLeftPercent(uint8_t estA, uint8_t estB)
+{
+    // 0x0B is past the estimated life, anything else is not defined
+    if ((estA == 0) || (estA > 11) || (estB == 0) || (estB > 11))
+    {
+        return 255;
+    }
+    // we are returning lowest LifeLeftPercent
+    uint8_t maxLifeUsed = std::max(estA, estB);
+    return static_cast<uint8_t>((11 - maxLifeUsed) * 10);
+}
+
+HsTiming fastestHsTiming(uint8_t deviceType, HsTiming hostMax)
+{
+    if (hostMax >= HsTiming::Hs400 &&
+        (deviceType & (EXT_CSD_CARD_TYPE_HS400_1_8V |
+                       EXT_CSD_CARD_TYPE_HS400_1_2V)) != 0)
+    {
+        return HsTiming::Hs400;
+    }
+    if (hostMax >= HsTiming::Hs200 &&
+        (deviceType & (EXT_CSD_CARD_TYPE_HS200_1_8V |
+                       EXT_CSD_CARD_TYPE_HS200_1_2V)) != 0)
+    {
+        return HsTiming::Hs200;
+    }
+    if (hostMax >= HsTiming::HighSpeed &&
+        (deviceType & (EXT_CSD_CARD_TYPE_HS_26 | EXT_CSD_CARD_TYPE_HS_52)) !=
+            0)
+    {
+        return HsTiming::HighSpeed;
+    }
+    return HsTiming::Legacy;
+}
+
+std::string hsTimingName(HsTiming timing)
+{
+    switch (timing)
+    {
+        case HsTiming::Legacy:
+            return "Legacy";
+        case HsTiming::HighSpeed:
+            return "HS";
+        case HsTiming::Hs200:
+            return "HS200";
+        case HsTiming::Hs400:
+            return "HS400";
+    }
+    return "Unknown";
+}
+
+uint32_t ExtCsd::sectorCount() const
+{
+    uint32_t sectors = 0;
+    for (size_t i = 0; i < 4; i++)
+    {
+        sectors |= static_cast<uint32_t>(raw[extcsd::secCount + i]) << (8 * i);
+    }
+    return sectors;
+}
+
+uint64_t ExtCsd::cacheSize() const
+{
+    uint64_t kilobits = 0;
+    for (size_t i = 0; i < 4; i++)
+    {
+        kilobits |= static_cast<uint64_t>(raw[extcsd::cacheSize + i])
+                    << (8 * i);
+    }
+    return kilobits * 1024 / 8;
+}
+
+} // namespace estoraged
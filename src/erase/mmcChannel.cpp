@@ -0,0 +1,119 @@
+#include "mmcChannel.hpp"
+
+#include "extCsd.hpp"
+
+#include <linux/mmc/core.h>
+#include <linux/mmc/ioctl.h>
+#include <linux/mmc/mmc.h>
+#include <sys/ioctl.h>
+
+#include <phosphor-logging/lg2.hpp>
+#include <stdplus/fd/create.hpp>
+#include <stdplus/fd/managed.hpp>
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace estoraged
+{
+
+std::optional<ExtCsd> MmcChannel::extCsd()
+{
+    std::lock_guard lock(mutex);
+    if (!cached)
+    {
+        readExtCsd();
+    }
+    return cached;
+}
+
+void MmcChannel::invalidate()
+{
+    std::lock_guard lock(mutex);
+    cached.reset();
+}
+
+void MmcChannel::readExtCsd()
+{
+    // Extended Device Specific Data. Contains information about the Device
+    // capabilities and selected modes.
+    ExtCsd::Raw raw{};
+    struct mmc_ioc_cmd idata = {};
+    idata.write_flag = 0;
+    idata.opcode = MMC_SEND_EXT_CSD;
+    idata.arg = 0;
+    idata.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+    idata.blksz = raw.size();
+    idata.blocks = 1;
+    mmc_ioc_cmd_set_data(idata, raw.data());
+    reads++;
+    if (ioctlWrapper->doIoctl(devPath, MMC_IOC_CMD, idata) != 0)
+    {
+        lg2::info("eStorageD unable to read EXT_CSD of {DEV}", "DEV",
+                  devPath);
+        return;
+    }
+    cached.emplace(raw);
+}
+
+int MmcChannel::command(const struct mmc_ioc_cmd& cmd)
+{
+    std::lock_guard lock(mutex);
+    if (cmd.opcode == MMC_SWITCH)
+    {
+        cached.reset();
+    }
+    return ioctlWrapper->doIoctl(devPath, MMC_IOC_CMD, cmd);
+}
+
+int MmcChannel::commandResponse(struct mmc_ioc_cmd& cmd)
+{
+    std::lock_guard lock(mutex);
+    if (cmd.opcode == MMC_SWITCH)
+    {
+        cached.reset();
+    }
+    return ioctlWrapper->doIoctlResponse(devPath, MMC_IOC_CMD, cmd);
+}
+
+int MmcChannel::multiCommand(const struct MmcIoMultiCmdErase& cmds)
+{
+    std::lock_guard lock(mutex);
+    return ioctlWrapper->doIoctlMulti(devPath, MMC_IOC_MULTI_CMD, cmds);
+}
+
+stdplus::Fd& IOCTLWrapperImpl::device(std::string_view devPath)
+{
+    if (fd == nullptr)
+    {
+        ownedFd = std::make_unique<stdplus::ManagedFd>(stdplus::fd::open(
+            std::string(devPath).c_str(), stdplus::fd::OpenAccess::ReadOnly));
+        fd = ownedFd.get();
+    }
+    return *fd;
+}
+
+int IOCTLWrapperImpl::doIoctl(std::string_view devPath, unsigned long request,
+                              struct mmc_ioc_cmd data)
+{
+    return device(devPath).ioctl(request, static_cast<void*>(&data));
+}
+
+int IOCTLWrapperImpl::doIoctlResponse(std::string_view devPath,
+                                      unsigned long request,
+                                      struct mmc_ioc_cmd& data)
+{
+    return device(devPath).ioctl(request, static_cast<void*>(&data));
+}
+
+int IOCTLWrapperImpl::doIoctlMulti(std::string_view devPath,
+                                   unsigned long request,
+                                   struct MmcIoMultiCmdErase data)
+{
+    return device(devPath).ioctl(request, static_cast<void*>(&data));
+}
+
+} // namespace estoraged
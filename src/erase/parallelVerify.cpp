@@ -0,0 +1,144 @@
+#include "parallelVerify.hpp"
+
+#include "bufferPool.hpp"
+
+#include <unistd.h>
+
+#include <phosphor-logging/lg2.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace estoraged
+{
+
+using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+
+namespace
+{
+
+constexpr size_t maxRetry = 32;
+constexpr std::chrono::duration delay = std::chrono::milliseconds(1);
+
+} // namespace
+
+void readAt(int fd, std::span<std::byte> buf, uint64_t offset)
+{
+    size_t read = 0;
+    size_t retry = 0;
+    while (read < buf.size())
+    {
+        ssize_t ret = pread(fd, &buf[read], buf.size() - read,
+                            static_cast<off_t>(offset + read));
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            lg2::error("Estoraged erase verify unable to read at {OFFSET}: "
+                       "{ERROR}",
+                       "OFFSET", offset + read, "ERROR", std::strerror(errno),
+                       "REDFISH_MESSAGE_ID",
+                       std::string("eStorageD.1.0.EraseFailure"));
+            throw InternalFailure();
+        }
+        read += static_cast<size_t>(ret);
+        if (read == buf.size())
+        {
+            break;
+        }
+        retry++;
+        if (retry > maxRetry)
+        {
+            lg2::error("Unable to do full read", "REDFISH_MESSAGE_ID",
+                       std::string("eStorageD.1.0.EraseFailure"));
+            throw InternalFailure();
+        }
+        std::this_thread::sleep_for(delay);
+    }
+}
+
+std::optional<uint64_t> parallelVerify(int fd, uint64_t size, size_t threads,
+                                       BufferPool& pool,
+                                       const VerifyCheck& check)
+{
+    const size_t chunkSize = pool.bufferSize();
+    const uint64_t chunks = (size + chunkSize - 1) / chunkSize;
+    threads = std::max<size_t>(std::min<uint64_t>(threads, chunks), 1);
+    const uint64_t chunksPerThread = (chunks + threads - 1) / threads;
+
+    constexpr uint64_t noMismatch = std::numeric_limits<uint64_t>::max();
+    std::atomic<uint64_t> firstMismatch{noMismatch};
+    std::vector<std::exception_ptr> errors(threads);
+
+    auto worker = [&](size_t index) {
+        std::span<std::byte> readArr = pool.get(2 * index);
+        std::span<std::byte> scratch = pool.get(2 * index + 1);
+        uint64_t offset = std::min(index * chunksPerThread * chunkSize, size);
+        uint64_t end =
+            std::min((index + 1) * chunksPerThread * chunkSize, size);
+        try
+        {
+            // a mismatch before this range already decides the result
+            while (offset < end &&
+                   offset < firstMismatch.load(std::memory_order_relaxed))
+            {
+                size_t readSize = std::min<uint64_t>(chunkSize, end - offset);
+                readAt(fd, readArr.first(readSize), offset);
+                size_t wrong = check(index, offset, readArr.first(readSize),
+                                     scratch.first(readSize));
+                if (wrong != readSize)
+                {
+                    uint64_t found = offset + wrong;
+                    uint64_t current = firstMismatch.load();
+                    while (found < current &&
+                           !firstMismatch.compare_exchange_weak(current, found))
+                    {}
+                    return;
+                }
+                offset += readSize;
+            }
+        }
+        catch (...)
+        {
+            errors[index] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; i++)
+    {
+        workers.emplace_back(worker, i);
+    }
+    for (std::thread& thread : workers)
+    {
+        thread.join();
+    }
+
+    for (const std::exception_ptr& error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+    uint64_t result = firstMismatch.load();
+    if (result == noMismatch)
+    {
+        return std::nullopt;
+    }
+    return result;
+}
+
+} // namespace estoraged
@@ -1,6 +1,12 @@
 #include "pattern.hpp"
 
+#include "badRangeMap.hpp"
+#include "bufferPool.hpp"
 #include "erase.hpp"
+#include "parallelVerify.hpp"
+#include "pipeline.hpp"
+#include "sampledVerify.hpp"
+#include "uring.hpp"
 
 #include <unistd.h>
 
@@ -10,13 +16,14 @@
 #include <xyz/openbmc_project/Common/error.hpp>
 
 #include <algorithm>
-#include <array>
 #include <chrono>
 #include <iostream>
-#include <random>
+#include <memory>
+#include <optional>
 #include <span>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace estoraged
 {
@@ -24,42 +31,69 @@ namespace estoraged
 using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
 using stdplus::fd::Fd;
 
+stdplus::fd::ManagedFd Pattern::openDevice(stdplus::fd::OpenAccess access)
+{
+    if (!options.directIo)
+    {
+        return stdplus::fd::open(devPath, access);
+    }
+    pool = BufferPool::forErase(erasePoolSize(options), options,
+                                util::findBlockGeometry(devPath), blockSize);
+    return stdplus::fd::open(
+        devPath,
+        stdplus::fd::OpenFlags(access).set(stdplus::fd::OpenFlag::Direct));
+}
+
+void Pattern::writePattern()
+{
+    stdplus::fd::ManagedFd fd = openDevice(stdplus::fd::OpenAccess::WriteOnly);
+    uint64_t driveSize = util::findSizeOfBlockDevice(devPath);
+    if (tolerant() || !writePatternUring(driveSize, fd.get()))
+    {
+        writePattern(driveSize, fd);
+    }
+    checkBadRanges("pattern");
+    progressFinish();
+}
+
+void Pattern::verifyPattern()
+{
+    stdplus::fd::ManagedFd fd = openDevice(stdplus::fd::OpenAccess::ReadOnly);
+    uint64_t driveSize = util::findSizeOfBlockDevice(devPath);
+    if (tolerant() || (!verifyPatternSampled(driveSize, fd.get()) &&
+                       !verifyPatternParallel(driveSize, fd.get()) &&
+                       !verifyPatternUring(driveSize, fd.get())))
+    {
+        verifyPattern(driveSize, fd);
+    }
+    checkBadRanges("pattern");
+    progressFinish();
+}
+
 void Pattern::writePattern(const uint64_t driveSize, Fd& fd)
 {
     // static seed defines a fixed prng sequence so it can be verified later,
     // and validated for entropy
-    uint64_t currentIndex = 0;
-
-    // random number generator seeded with a constant value will
-    // generate a predictable sequence of values NOLINTNEXTLINE
-    std::minstd_rand0 generator(seed);
-    std::array<std::byte, blockSize> randArr{};
-
-    while (currentIndex < driveSize)
+    uint64_t currentIndex = std::min(startOffset, driveSize);
+    const size_t chunkSize = pool.bufferSize();
+    std::span<std::byte> randArr = pool.get(0);
+    if (currentIndex != 0)
     {
-        // generate a 4k block of prng
-        std::array<uint32_t, blockSizeUsing32>* randArrFill =
-            reinterpret_cast<std::array<uint32_t, blockSizeUsing32>*>(&randArr);
-        for (uint32_t i = 0; i < blockSizeUsing32; i++)
-        {
-            (*randArrFill)[i] = generator();
-        }
-        // if we can write all 4k bytes do that, else write the remainder
-        size_t writeSize = currentIndex + blockSize < driveSize
-                               ? blockSize
-                               : driveSize - currentIndex;
+        fd.lseek(static_cast<off_t>(currentIndex), stdplus::fd::Whence::Set);
+    }
+    progressStart(driveSize, currentIndex);
+
+    auto writeChunk = [&fd](std::span<std::byte> chunk) {
         size_t written = 0;
         size_t retry = 0;
-        while (written < writeSize)
+        while (written < chunk.size())
         {
-            written += fd.write(std::span{randArr}.subspan(written,
-                                                           writeSize - written))
-                           .size();
-            if (written == writeSize)
+            written += fd.write(chunk.subspan(written)).size();
+            if (written == chunk.size())
             {
                 break;
             }
-            if (written > writeSize)
+            if (written > chunk.size())
             {
                 throw InternalFailure();
             }
@@ -72,45 +106,71 @@ void Pattern::writePattern(const uint64_t driveSize, Fd& fd)
             }
             std::this_thread::sleep_for(delay);
         }
+    };
+
+    if (options.pipelineDepth > 1 && !tolerant())
+    {
+        // the pattern of the next chunks is generated during the writes
+        pipelinedPass(
+            pool, options.pipelineDepth, currentIndex, driveSize,
+            [this](uint64_t offset, std::span<std::byte> chunk) {
+                generator->fill(offset, chunk);
+            },
+            [this, &writeChunk](uint64_t, std::span<std::byte> chunk) {
+                writeChunk(chunk);
+                progressAdvance(chunk.size());
+            });
+        return;
+    }
+
+    while (currentIndex < driveSize)
+    {
+        // if we can write the whole chunk do that, else write the remainder
+        size_t writeSize = currentIndex + chunkSize < driveSize
+                               ? chunkSize
+                               : driveSize - currentIndex;
+        // generate a chunk of prng
+        generator->fill(currentIndex, randArr.first(writeSize));
+        try
+        {
+            writeChunk(randArr.first(writeSize));
+        }
+        catch (...)
+        {
+            if (!tolerant())
+            {
+                throw;
+            }
+            badRanges->add(BadRangeKind::Write, currentIndex, writeSize);
+            // where a failed write left the file offset is unknown
+            fd.lseek(static_cast<off_t>(currentIndex + writeSize),
+                     stdplus::fd::Whence::Set);
+        }
         currentIndex = currentIndex + writeSize;
+        progressAdvance(writeSize);
     }
 }
 
 void Pattern::verifyPattern(const uint64_t driveSize, Fd& fd)
 {
     uint64_t currentIndex = 0;
-    // random number generator seeded with a constant value will
-    // generate a predictable sequence of values NOLINTNEXTLINE
-    std::minstd_rand0 generator(seed);
-    std::array<std::byte, blockSize> randArr{};
-    std::array<std::byte, blockSize> readArr{};
+    const size_t chunkSize = pool.bufferSize();
+    std::span<std::byte> readArr = pool.get(0);
+    progressStart(driveSize);
 
-    while (currentIndex < driveSize)
-    {
-        size_t readSize = currentIndex + blockSize < driveSize
-                              ? blockSize
-                              : driveSize - currentIndex;
+    auto readChunk = [&fd](std::span<std::byte> chunk) {
         try
         {
-            std::array<uint32_t, blockSizeUsing32>* randArrFill =
-                reinterpret_cast<std::array<uint32_t, blockSizeUsing32>*>(
-                    &randArr);
-            for (uint32_t i = 0; i < blockSizeUsing32; i++)
-            {
-                (*randArrFill)[i] = generator();
-            }
             size_t read = 0;
             size_t retry = 0;
-            while (read < readSize)
+            while (read < chunk.size())
             {
-                read +=
-                    fd.read(std::span{readArr}.subspan(read, readSize - read))
-                        .size();
-                if (read == readSize)
+                read += fd.read(chunk.subspan(read)).size();
+                if (read == chunk.size())
                 {
                     break;
                 }
-                if (read > readSize)
+                if (read > chunk.size())
                 {
                     throw InternalFailure();
                 }
@@ -131,17 +191,191 @@ void Pattern::verifyPattern(const uint64_t driveSize, Fd& fd)
                        std::string("eStorageD.1.0.EraseFailure"));
             throw InternalFailure();
         }
+    };
+    auto checkChunk = [this](uint64_t offset,
+                             std::span<const std::byte> chunk) {
+        size_t wrong = generator->mismatch(offset, chunk);
+        if (wrong != chunk.size())
+        {
+            if (!tolerant())
+            {
+                lg2::error("Estoraged erase pattern does not match",
+                           "REDFISH_MESSAGE_ID",
+                           std::string("eStorageD.1.0.EraseFailure"));
+                throw InternalFailure();
+            }
+            recordMismatches(
+                *badRanges, offset, chunk, wrong,
+                [this](uint64_t at, std::span<const std::byte> data) {
+                    return generator->mismatch(at, data);
+                },
+                sectorSize);
+        }
+        progressAdvance(chunk.size());
+    };
+
+    if (options.pipelineDepth > 1 && !tolerant())
+    {
+        // the next chunks are read during the compares
+        pipelinedPass(
+            pool, options.pipelineDepth, 0, driveSize,
+            [&readChunk](uint64_t, std::span<std::byte> chunk) {
+                readChunk(chunk);
+            },
+            checkChunk);
+        return;
+    }
 
-        if (!std::ranges::equal(std::span{randArr}.subspan(0, readSize),
-                                std::span{readArr}.subspan(0, readSize)))
+    while (currentIndex < driveSize)
+    {
+        size_t readSize = currentIndex + chunkSize < driveSize
+                              ? chunkSize
+                              : driveSize - currentIndex;
+        try
         {
-            lg2::error("Estoraged erase pattern does not match",
-                       "REDFISH_MESSAGE_ID",
-                       std::string("eStorageD.1.0.EraseFailure"));
-            throw InternalFailure();
+            readChunk(readArr.first(readSize));
+        }
+        catch (...)
+        {
+            if (!tolerant())
+            {
+                throw;
+            }
+            badRanges->add(BadRangeKind::Read, currentIndex, readSize);
+            fd.lseek(static_cast<off_t>(currentIndex + readSize),
+                     stdplus::fd::Whence::Set);
+            currentIndex = currentIndex + readSize;
+            progressAdvance(readSize);
+            continue;
         }
+        checkChunk(currentIndex, readArr.first(readSize));
         currentIndex = currentIndex + readSize;
     }
 }
 
+bool Pattern::writePatternUring(uint64_t driveSize, int fd)
+{
+    std::unique_ptr<Uring> ring = makeEraseUring(options, pool);
+    if (!ring)
+    {
+        return false;
+    }
+
+    const uint64_t start = std::min(startOffset, driveSize);
+    uint64_t done = start;
+    progressStart(driveSize, start);
+    try
+    {
+        uringWrite(
+            *ring, fd, pool, pool.count() - 1, driveSize,
+            [this](uint64_t offset, std::span<std::byte> chunk) {
+                generator->fill(offset, chunk);
+            },
+            [this, &done](uint64_t written) {
+                progressAdvance(written - done);
+                done = written;
+            },
+            start);
+    }
+    catch (const EraseCancelled&)
+    {
+        throw;
+    }
+    catch (...)
+    {
+        lg2::error("Estoraged erase pattern unable to write",
+                   "REDFISH_MESSAGE_ID",
+                   std::string("eStorageD.1.0.EraseFailure"));
+        throw InternalFailure();
+    }
+    return true;
+}
+
+bool Pattern::verifyPatternUring(uint64_t driveSize, int fd)
+{
+    std::unique_ptr<Uring> ring = makeEraseUring(options, pool);
+    if (!ring)
+    {
+        return false;
+    }
+
+    progressStart(driveSize);
+    uringRead(*ring, fd, pool, pool.count() - 1, driveSize,
+              [this](uint64_t offset, std::span<const std::byte> chunk) {
+                  if (generator->mismatch(offset, chunk) != chunk.size())
+                  {
+                      lg2::error("Estoraged erase pattern does not match",
+                                 "REDFISH_MESSAGE_ID",
+                                 std::string("eStorageD.1.0.EraseFailure"));
+                      throw InternalFailure();
+                  }
+                  progressAdvance(chunk.size());
+              });
+    return true;
+}
+
+bool Pattern::verifyPatternParallel(uint64_t driveSize, int fd)
+{
+    if (options.verifyThreads <= 1)
+    {
+        return false;
+    }
+
+    // generators may keep state, so every worker has its own
+    std::vector<std::unique_ptr<PatternGenerator>> generators;
+    for (size_t i = 0; i < options.verifyThreads; i++)
+    {
+        generators.push_back(makePatternGenerator(options.patternType, seed));
+    }
+
+    progressStart(driveSize);
+    std::optional<uint64_t> mismatch = parallelVerify(
+        fd, driveSize, options.verifyThreads, pool,
+        [this, &generators](size_t worker, uint64_t offset,
+                            std::span<const std::byte> chunk,
+                            std::span<std::byte>) {
+            progressAdvance(chunk.size());
+            return generators[worker]->mismatch(offset, chunk);
+        });
+    if (mismatch)
+    {
+        lg2::error("Estoraged erase pattern does not match at {OFFSET}",
+                   "OFFSET", *mismatch, "REDFISH_MESSAGE_ID",
+                   std::string("eStorageD.1.0.EraseFailure"));
+        throw InternalFailure();
+    }
+    return true;
+}
+
+bool Pattern::verifyPatternSampled(uint64_t driveSize, int fd)
+{
+    if (options.verifySampleConfidence <= 0)
+    {
+        return false;
+    }
+
+    // samples come in increasing offset order, so even the sequential
+    // generator only runs forward
+    SampleResult result = sampledVerify(
+        fd, driveSize, pool, options.verifySampleConfidence,
+        options.verifySampleDefectRate,
+        [this](size_t, uint64_t offset, std::span<const std::byte> chunk,
+               std::span<std::byte>) {
+            return generator->mismatch(offset, chunk);
+        },
+        progress, throttle);
+    lg2::info("Estoraged erase pattern sampled {SAMPLES} of {CHUNKS} chunks, "
+              "{COVERAGE} of the drive",
+              "SAMPLES", result.samples, "CHUNKS", result.chunks, "COVERAGE",
+              result.coverage);
+    if (result.firstMismatch)
+    {
+        lg2::error("Estoraged erase pattern does not match at {OFFSET}",
+                   "OFFSET", *result.firstMismatch, "REDFISH_MESSAGE_ID",
+                   std::string("eStorageD.1.0.EraseFailure"));
+        throw InternalFailure();
+    }
+    return true;
+}
+
 } // namespace estoraged
@@ -0,0 +1,597 @@
+#include "patternGenerator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ESTORAGED_PHILOX_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ESTORAGED_PHILOX_NEON
+#endif
+
+namespace estoraged
+{
+
+namespace
+{
+
+/* Philox4x32 multipliers and Weyl key increments */
+constexpr uint32_t philoxM0 = 0xD2511F53;
+constexpr uint32_t philoxM1 = 0xCD9E8D57;
+constexpr uint32_t philoxW0 = 0x9E3779B9;
+constexpr uint32_t philoxW1 = 0xBB67AE85;
+constexpr int philoxRounds = 10;
+constexpr size_t blockSize = PhiloxGenerator::blockSize;
+
+/* Low and high words of the block counters index to index + N - 1 */
+template <size_t N>
+void philoxCounters(uint64_t index, std::array<uint32_t, N>& low,
+                    std::array<uint32_t, N>& high)
+{
+    for (size_t lane = 0; lane < N; lane++)
+    {
+        low[lane] = static_cast<uint32_t>(index + lane);
+        high[lane] = static_cast<uint32_t>((index + lane) >> 32);
+    }
+}
+
+void philoxFillScalar(uint64_t index, std::array<uint32_t, 2> key,
+                      std::span<std::byte> buf)
+{
+    const size_t blocks = buf.size() / blockSize;
+    for (size_t done = 0; done < blocks; done++)
+    {
+        uint64_t counter = index + done;
+        std::array<uint32_t, 4> out = PhiloxGenerator::block(
+            {static_cast<uint32_t>(counter),
+             static_cast<uint32_t>(counter >> 32), 0, 0},
+            key);
+        std::memcpy(&buf[done * blockSize], out.data(), blockSize);
+    }
+}
+
+size_t philoxFindScalar(uint64_t index, std::array<uint32_t, 2> key,
+                        std::span<const std::byte> data)
+{
+    const size_t blocks = data.size() / blockSize;
+    for (size_t done = 0; done < blocks; done++)
+    {
+        uint64_t counter = index + done;
+        std::array<uint32_t, 4> out = PhiloxGenerator::block(
+            {static_cast<uint32_t>(counter),
+             static_cast<uint32_t>(counter >> 32), 0, 0},
+            key);
+        if (std::memcmp(&data[done * blockSize], out.data(), blockSize) != 0)
+        {
+            return done;
+        }
+    }
+    return blocks;
+}
+
+/*
+ * The vector kernels run one block per lane. Philox needs the high half of
+ * a 32x32 bit multiply, which x86 only has for every other lane, so the
+ * even and odd lanes are multiplied separately and merged. After the rounds
+ * the lanes are transposed so each block is stored contiguously. Blocks
+ * that don't fill a vector are done by the scalar kernel.
+ *
+ * The find kernels compare the transposed registers with the data instead
+ * of storing them, so the expected pattern never goes through memory. A
+ * vector with a wrong block is searched again by the scalar kernel to tell
+ * which block it is.
+ */
+
+#ifdef ESTORAGED_PHILOX_X86
+
+#if defined(__SSE2__)
+void mulHiLo(__m128i a, __m128i m, __m128i& lo, __m128i& hi)
+{
+    const __m128i lowMask = _mm_set1_epi64x(0xffffffff);
+    __m128i even = _mm_mul_epu32(a, m);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+    lo = _mm_or_si128(_mm_and_si128(even, lowMask),
+                      _mm_slli_epi64(odd, 32));
+    hi = _mm_or_si128(_mm_srli_epi64(even, 32),
+                      _mm_andnot_si128(lowMask, odd));
+}
+
+/* Blocks index to index + 3, one block per register */
+inline void philoxBlocksSse2(uint64_t index, std::array<uint32_t, 2> key,
+                             __m128i& b0, __m128i& b1, __m128i& b2,
+                             __m128i& b3)
+{
+    constexpr size_t width = 4;
+    const __m128i m0 = _mm_set1_epi32(static_cast<int>(philoxM0));
+    const __m128i m1 = _mm_set1_epi32(static_cast<int>(philoxM1));
+    const __m128i w0 = _mm_set1_epi32(static_cast<int>(philoxW0));
+    const __m128i w1 = _mm_set1_epi32(static_cast<int>(philoxW1));
+    std::array<uint32_t, width> low{};
+    std::array<uint32_t, width> high{};
+    philoxCounters(index, low, high);
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    __m128i c0 = _mm_loadu_si128(reinterpret_cast<__m128i*>(low.data()));
+    __m128i c1 = _mm_loadu_si128(reinterpret_cast<__m128i*>(high.data()));
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+    __m128i c2 = _mm_setzero_si128();
+    __m128i c3 = _mm_setzero_si128();
+    __m128i k0 = _mm_set1_epi32(static_cast<int>(key[0]));
+    __m128i k1 = _mm_set1_epi32(static_cast<int>(key[1]));
+    for (int round = 0; round < philoxRounds; round++)
+    {
+        __m128i lo0;
+        __m128i hi0;
+        __m128i lo1;
+        __m128i hi1;
+        mulHiLo(c0, m0, lo0, hi0);
+        mulHiLo(c2, m1, lo1, hi1);
+        c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), k0);
+        c1 = lo1;
+        c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), k1);
+        c3 = lo0;
+        k0 = _mm_add_epi32(k0, w0);
+        k1 = _mm_add_epi32(k1, w1);
+    }
+
+    __m128i t0 = _mm_unpacklo_epi32(c0, c1);
+    __m128i t1 = _mm_unpacklo_epi32(c2, c3);
+    __m128i t2 = _mm_unpackhi_epi32(c0, c1);
+    __m128i t3 = _mm_unpackhi_epi32(c2, c3);
+    b0 = _mm_unpacklo_epi64(t0, t1);
+    b1 = _mm_unpackhi_epi64(t0, t1);
+    b2 = _mm_unpacklo_epi64(t2, t3);
+    b3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+void philoxFillSse2(uint64_t index, std::array<uint32_t, 2> key,
+                    std::span<std::byte> buf)
+{
+    constexpr size_t width = 4;
+    const size_t blocks = buf.size() / blockSize;
+    size_t done = 0;
+    for (; done + width <= blocks; done += width)
+    {
+        __m128i b0;
+        __m128i b1;
+        __m128i b2;
+        __m128i b3;
+        philoxBlocksSse2(index + done, key, b0, b1, b2, b3);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto* out = reinterpret_cast<__m128i*>(&buf[done * blockSize]);
+        _mm_storeu_si128(out, b0);
+        _mm_storeu_si128(out + 1, b1);
+        _mm_storeu_si128(out + 2, b2);
+        _mm_storeu_si128(out + 3, b3);
+    }
+    philoxFillScalar(index + done, key, buf.subspan(done * blockSize));
+}
+
+size_t philoxFindSse2(uint64_t index, std::array<uint32_t, 2> key,
+                      std::span<const std::byte> data)
+{
+    constexpr size_t width = 4;
+    const size_t blocks = data.size() / blockSize;
+    size_t done = 0;
+    for (; done + width <= blocks; done += width)
+    {
+        __m128i b0;
+        __m128i b1;
+        __m128i b2;
+        __m128i b3;
+        philoxBlocksSse2(index + done, key, b0, b1, b2, b3);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        const auto* in = reinterpret_cast<const __m128i*>(
+            &data[done * blockSize]);
+        __m128i same01 =
+            _mm_and_si128(_mm_cmpeq_epi32(b0, _mm_loadu_si128(in)),
+                          _mm_cmpeq_epi32(b1, _mm_loadu_si128(in + 1)));
+        __m128i same23 =
+            _mm_and_si128(_mm_cmpeq_epi32(b2, _mm_loadu_si128(in + 2)),
+                          _mm_cmpeq_epi32(b3, _mm_loadu_si128(in + 3)));
+        __m128i same = _mm_and_si128(same01, same23);
+        if (_mm_movemask_epi8(same) != 0xffff)
+        {
+            break;
+        }
+    }
+    return done + philoxFindScalar(index + done, key,
+                                   data.subspan(done * blockSize));
+}
+#endif
+
+__attribute__((target("avx2"), always_inline)) inline void
+    mulHiLo256(__m256i a, __m256i m, __m256i& lo, __m256i& hi)
+{
+    const __m256i lowMask = _mm256_set1_epi64x(0xffffffff);
+    __m256i even = _mm256_mul_epu32(a, m);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+    lo = _mm256_or_si256(_mm256_and_si256(even, lowMask),
+                         _mm256_slli_epi64(odd, 32));
+    hi = _mm256_or_si256(_mm256_srli_epi64(even, 32),
+                         _mm256_andnot_si256(lowMask, odd));
+}
+
+/* Blocks index to index + 7, two blocks per register in order */
+__attribute__((target("avx2"), always_inline)) inline void
+    philoxBlocksAvx2(uint64_t index, std::array<uint32_t, 2> key,
+                     __m256i& b0, __m256i& b1, __m256i& b2, __m256i& b3)
+{
+    constexpr size_t width = 8;
+    const __m256i m0 = _mm256_set1_epi32(static_cast<int>(philoxM0));
+    const __m256i m1 = _mm256_set1_epi32(static_cast<int>(philoxM1));
+    const __m256i w0 = _mm256_set1_epi32(static_cast<int>(philoxW0));
+    const __m256i w1 = _mm256_set1_epi32(static_cast<int>(philoxW1));
+    std::array<uint32_t, width> low{};
+    std::array<uint32_t, width> high{};
+    philoxCounters(index, low, high);
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    __m256i c0 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(low.data()));
+    __m256i c1 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(high.data()));
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+    __m256i c2 = _mm256_setzero_si256();
+    __m256i c3 = _mm256_setzero_si256();
+    __m256i k0 = _mm256_set1_epi32(static_cast<int>(key[0]));
+    __m256i k1 = _mm256_set1_epi32(static_cast<int>(key[1]));
+    for (int round = 0; round < philoxRounds; round++)
+    {
+        __m256i lo0;
+        __m256i hi0;
+        __m256i lo1;
+        __m256i hi1;
+        mulHiLo256(c0, m0, lo0, hi0);
+        mulHiLo256(c2, m1, lo1, hi1);
+        c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), k0);
+        c1 = lo1;
+        c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), k1);
+        c3 = lo0;
+        k0 = _mm256_add_epi32(k0, w0);
+        k1 = _mm256_add_epi32(k1, w1);
+    }
+
+    // transposes within each 128 bit half, so blocks 0 to 3 are in the
+    // low halves and blocks 4 to 7 in the high halves
+    __m256i t0 = _mm256_unpacklo_epi32(c0, c1);
+    __m256i t1 = _mm256_unpacklo_epi32(c2, c3);
+    __m256i t2 = _mm256_unpackhi_epi32(c0, c1);
+    __m256i t3 = _mm256_unpackhi_epi32(c2, c3);
+    __m256i r0 = _mm256_unpacklo_epi64(t0, t1);
+    __m256i r1 = _mm256_unpackhi_epi64(t0, t1);
+    __m256i r2 = _mm256_unpacklo_epi64(t2, t3);
+    __m256i r3 = _mm256_unpackhi_epi64(t2, t3);
+    b0 = _mm256_permute2x128_si256(r0, r1, 0x20);
+    b1 = _mm256_permute2x128_si256(r2, r3, 0x20);
+    b2 = _mm256_permute2x128_si256(r0, r1, 0x31);
+    b3 = _mm256_permute2x128_si256(r2, r3, 0x31);
+}
+
+__attribute__((target("avx2"))) void
+    philoxFillAvx2(uint64_t index, std::array<uint32_t, 2> key,
+                   std::span<std::byte> buf)
+{
+    constexpr size_t width = 8;
+    const size_t blocks = buf.size() / blockSize;
+    size_t done = 0;
+    for (; done + width <= blocks; done += width)
+    {
+        __m256i b0;
+        __m256i b1;
+        __m256i b2;
+        __m256i b3;
+        philoxBlocksAvx2(index + done, key, b0, b1, b2, b3);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto* out = reinterpret_cast<__m256i*>(&buf[done * blockSize]);
+        _mm256_storeu_si256(out, b0);
+        _mm256_storeu_si256(out + 1, b1);
+        _mm256_storeu_si256(out + 2, b2);
+        _mm256_storeu_si256(out + 3, b3);
+    }
+    philoxFillScalar(index + done, key, buf.subspan(done * blockSize));
+}
+
+__attribute__((target("avx2"))) size_t
+    philoxFindAvx2(uint64_t index, std::array<uint32_t, 2> key,
+                   std::span<const std::byte> data)
+{
+    constexpr size_t width = 8;
+    const size_t blocks = data.size() / blockSize;
+    size_t done = 0;
+    for (; done + width <= blocks; done += width)
+    {
+        __m256i b0;
+        __m256i b1;
+        __m256i b2;
+        __m256i b3;
+        philoxBlocksAvx2(index + done, key, b0, b1, b2, b3);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        const auto* in = reinterpret_cast<const __m256i*>(
+            &data[done * blockSize]);
+        __m256i same01 = _mm256_and_si256(
+            _mm256_cmpeq_epi32(b0, _mm256_loadu_si256(in)),
+            _mm256_cmpeq_epi32(b1, _mm256_loadu_si256(in + 1)));
+        __m256i same23 = _mm256_and_si256(
+            _mm256_cmpeq_epi32(b2, _mm256_loadu_si256(in + 2)),
+            _mm256_cmpeq_epi32(b3, _mm256_loadu_si256(in + 3)));
+        __m256i same = _mm256_and_si256(same01, same23);
+        if (_mm256_movemask_epi8(same) != -1)
+        {
+            break;
+        }
+    }
+    return done + philoxFindScalar(index + done, key,
+                                   data.subspan(done * blockSize));
+}
+
+#endif // ESTORAGED_PHILOX_X86
+
+#ifdef ESTORAGED_PHILOX_NEON
+void mulHiLo(uint32x4_t a, uint32_t m, uint32x4_t& lo, uint32x4_t& hi)
+{
+    uint64x2_t p0 = vmull_n_u32(vget_low_u32(a), m);
+    uint64x2_t p1 = vmull_n_u32(vget_high_u32(a), m);
+    lo = vcombine_u32(vmovn_u64(p0), vmovn_u64(p1));
+    hi = vcombine_u32(vshrn_n_u64(p0, 32), vshrn_n_u64(p1, 32));
+}
+
+/* Blocks index to index + 3, word n of every block in val[n] */
+inline uint32x4x4_t philoxBlocksNeon(uint64_t index,
+                                     std::array<uint32_t, 2> key)
+{
+    constexpr size_t width = 4;
+    std::array<uint32_t, width> low{};
+    std::array<uint32_t, width> high{};
+    philoxCounters(index, low, high);
+    uint32x4x4_t c{vld1q_u32(low.data()), vld1q_u32(high.data()),
+                   vdupq_n_u32(0), vdupq_n_u32(0)};
+    uint32x4_t k0 = vdupq_n_u32(key[0]);
+    uint32x4_t k1 = vdupq_n_u32(key[1]);
+    for (int round = 0; round < philoxRounds; round++)
+    {
+        uint32x4_t lo0;
+        uint32x4_t hi0;
+        uint32x4_t lo1;
+        uint32x4_t hi1;
+        mulHiLo(c.val[0], philoxM0, lo0, hi0);
+        mulHiLo(c.val[2], philoxM1, lo1, hi1);
+        c.val[0] = veorq_u32(veorq_u32(hi1, c.val[1]), k0);
+        c.val[1] = lo1;
+        c.val[2] = veorq_u32(veorq_u32(hi0, c.val[3]), k1);
+        c.val[3] = lo0;
+        k0 = vaddq_u32(k0, vdupq_n_u32(philoxW0));
+        k1 = vaddq_u32(k1, vdupq_n_u32(philoxW1));
+    }
+    return c;
+}
+
+void philoxFillNeon(uint64_t index, std::array<uint32_t, 2> key,
+                    std::span<std::byte> buf)
+{
+    constexpr size_t width = 4;
+    const size_t blocks = buf.size() / blockSize;
+    size_t done = 0;
+    for (; done + width <= blocks; done += width)
+    {
+        // interleaving store, so each block is contiguous
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        vst4q_u32(reinterpret_cast<uint32_t*>(&buf[done * blockSize]),
+                  philoxBlocksNeon(index + done, key));
+    }
+    philoxFillScalar(index + done, key, buf.subspan(done * blockSize));
+}
+
+size_t philoxFindNeon(uint64_t index, std::array<uint32_t, 2> key,
+                      std::span<const std::byte> data)
+{
+    constexpr size_t width = 4;
+    const size_t blocks = data.size() / blockSize;
+    size_t done = 0;
+    for (; done + width <= blocks; done += width)
+    {
+        uint32x4x4_t out = philoxBlocksNeon(index + done, key);
+        // the deinterleaving load matches the layout of the registers
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        uint32x4x4_t in = vld4q_u32(
+            reinterpret_cast<const uint32_t*>(&data[done * blockSize]));
+        uint32x4_t same =
+            vandq_u32(vandq_u32(vceqq_u32(out.val[0], in.val[0]),
+                                vceqq_u32(out.val[1], in.val[1])),
+                      vandq_u32(vceqq_u32(out.val[2], in.val[2]),
+                                vceqq_u32(out.val[3], in.val[3])));
+        uint32x2_t half = vand_u32(vget_low_u32(same), vget_high_u32(same));
+        if ((vget_lane_u32(half, 0) & vget_lane_u32(half, 1)) != 0xffffffff)
+        {
+            break;
+        }
+    }
+    return done + philoxFindScalar(index + done, key,
+                                   data.subspan(done * blockSize));
+}
+#endif // ESTORAGED_PHILOX_NEON
+
+} // namespace
+
+size_t PatternGenerator::mismatch(uint64_t offset,
+                                  std::span<const std::byte> data)
+{
+    std::array<std::byte, 256> expected{};
+    for (size_t done = 0; done < data.size(); done += expected.size())
+    {
+        std::span<const std::byte> part =
+            data.subspan(done, std::min(expected.size(), data.size() - done));
+        std::span<std::byte> want = std::span(expected).first(part.size());
+        fill(offset + done, want);
+        if (std::memcmp(part.data(), want.data(), part.size()) != 0)
+        {
+            auto [wrong, unused] = std::ranges::mismatch(part, want);
+            return done + static_cast<size_t>(wrong - part.begin());
+        }
+    }
+    return data.size();
+}
+
+std::vector<PhiloxKernel> philoxKernels()
+{
+    std::vector<PhiloxKernel> kernels{
+        {"scalar", philoxFillScalar, philoxFindScalar}};
+#ifdef ESTORAGED_PHILOX_X86
+#if defined(__SSE2__)
+    kernels.push_back({"sse2", philoxFillSse2, philoxFindSse2});
+#endif
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels.push_back({"avx2", philoxFillAvx2, philoxFindAvx2});
+    }
+#endif
+#ifdef ESTORAGED_PHILOX_NEON
+    kernels.push_back({"neon", philoxFillNeon, philoxFindNeon});
+#endif
+    return kernels;
+}
+
+PhiloxGenerator::PhiloxGenerator(uint64_t seed) :
+    key{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}
+{}
+
+std::array<uint32_t, 4> PhiloxGenerator::block(std::array<uint32_t, 4> counter,
+                                               std::array<uint32_t, 2> key)
+{
+    for (int round = 0; round < philoxRounds; round++)
+    {
+        uint64_t p0 = uint64_t{philoxM0} * counter[0];
+        uint64_t p1 = uint64_t{philoxM1} * counter[2];
+        counter = {static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ key[0],
+                   static_cast<uint32_t>(p1),
+                   static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ key[1],
+                   static_cast<uint32_t>(p0)};
+        key[0] += philoxW0;
+        key[1] += philoxW1;
+    }
+    return counter;
+}
+
+void PhiloxGenerator::fill(uint64_t offset, std::span<std::byte> buf)
+{
+    static const auto fillBlocks = philoxKernels().back().fill;
+    uint64_t index = offset / blockSize;
+    std::array<std::byte, blockSize> partial{};
+
+    // a start in the middle of a block
+    size_t skip = offset % blockSize;
+    if (skip != 0)
+    {
+        philoxFillScalar(index, key, partial);
+        size_t length = std::min(blockSize - skip, buf.size());
+        std::memcpy(buf.data(), &partial[skip], length);
+        buf = buf.subspan(length);
+        index++;
+    }
+
+    size_t whole = buf.size() / blockSize * blockSize;
+    fillBlocks(index, key, buf.first(whole));
+    buf = buf.subspan(whole);
+
+    // an end in the middle of a block
+    if (!buf.empty())
+    {
+        philoxFillScalar(index + whole / blockSize, key, partial);
+        std::memcpy(buf.data(), partial.data(), buf.size());
+    }
+}
+
+size_t PhiloxGenerator::mismatch(uint64_t offset,
+                                 std::span<const std::byte> data)
+{
+    static const auto findBlocks = philoxKernels().back().find;
+    uint64_t index = offset / blockSize;
+    size_t skip = offset % blockSize;
+    size_t checked = 0;
+
+    // compares part of block index with the start of data from checked
+    auto checkPartial = [this, &data, &checked](uint64_t block, size_t from,
+                                                size_t length) {
+        std::array<std::byte, blockSize> expected{};
+        philoxFillScalar(block, key, expected);
+        std::span<const std::byte> part = data.subspan(checked, length);
+        auto [wrong, unused] = std::ranges::mismatch(
+            part, std::span(expected).subspan(from, length));
+        checked += static_cast<size_t>(wrong - part.begin());
+        return wrong == part.end();
+    };
+
+    // a start in the middle of a block
+    if (skip != 0 &&
+        !checkPartial(index++, skip,
+                      std::min(blockSize - skip, data.size())))
+    {
+        return checked;
+    }
+
+    size_t whole = (data.size() - checked) / blockSize;
+    size_t good = findBlocks(index, key,
+                             data.subspan(checked, whole * blockSize));
+    checked += good * blockSize;
+    if (good < whole)
+    {
+        checkPartial(index + good, 0, blockSize);
+        return checked;
+    }
+
+    // an end in the middle of a block
+    if (checked < data.size())
+    {
+        checkPartial(index + whole, 0, data.size() - checked);
+    }
+    return checked;
+}
+
+MinstdGenerator::MinstdGenerator(uint32_t seed) : seed(seed), engine(seed) {}
+
+uint32_t MinstdGenerator::word(uint64_t index)
+{
+    if (index + 1 == nextWord)
+    {
+        return lastWord;
+    }
+    if (index < nextWord)
+    {
+        engine.seed(seed);
+        nextWord = 0;
+    }
+    engine.discard(index - nextWord);
+    lastWord = static_cast<uint32_t>(engine());
+    nextWord = index + 1;
+    return lastWord;
+}
+
+void MinstdGenerator::fill(uint64_t offset, std::span<std::byte> buf)
+{
+    size_t done = 0;
+    while (done < buf.size())
+    {
+        uint64_t position = offset + done;
+        uint32_t value = word(position / sizeof(value));
+        size_t skip = position % sizeof(value);
+        size_t length = std::min(sizeof(value) - skip, buf.size() - done);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        std::memcpy(&buf[done], reinterpret_cast<std::byte*>(&value) + skip,
+                    length);
+        done += length;
+    }
+}
+
+std::unique_ptr<PatternGenerator> makePatternGenerator(PatternType type,
+                                                       uint32_t seed)
+{
+    if (type == PatternType::Minstd)
+    {
+        return std::make_unique<MinstdGenerator>(seed);
+    }
+    return std::make_unique<PhiloxGenerator>(seed);
+}
+
+} // namespace estoraged
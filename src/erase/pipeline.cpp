@@ -0,0 +1,114 @@
+#include "pipeline.hpp"
+
+#include "bufferPool.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <utility>
+
+namespace estoraged
+{
+
+void pipelinedPass(BufferPool& pool, size_t slots, uint64_t start,
+                   uint64_t end, const PipelineStage& produce,
+                   const PipelineStage& consume)
+{
+    if (start >= end)
+    {
+        return;
+    }
+    const size_t chunkSize = pool.bufferSize();
+    const uint64_t chunks = (end - start + chunkSize - 1) / chunkSize;
+    auto chunk = [&](uint64_t index) {
+        uint64_t offset = start + index * chunkSize;
+        std::span<std::byte> buf = pool.get(index % slots);
+        return std::make_pair(
+            offset,
+            buf.first(static_cast<size_t>(
+                std::min<uint64_t>(chunkSize, end - offset))));
+    };
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint64_t produced = 0;
+    uint64_t consumed = 0;
+    bool stopped = false;
+    std::exception_ptr producerError;
+
+    std::thread producer([&]() {
+        for (uint64_t i = 0; i < chunks; i++)
+        {
+            {
+                std::unique_lock lock(mutex);
+                changed.wait(lock, [&]() {
+                    return stopped || i - consumed < slots;
+                });
+                if (stopped)
+                {
+                    return;
+                }
+            }
+            try
+            {
+                auto [offset, buf] = chunk(i);
+                produce(offset, buf);
+            }
+            catch (...)
+            {
+                std::lock_guard lock(mutex);
+                producerError = std::current_exception();
+                changed.notify_all();
+                return;
+            }
+            std::lock_guard lock(mutex);
+            produced = i + 1;
+            changed.notify_all();
+        }
+    });
+
+    std::exception_ptr error;
+    for (uint64_t i = 0; i < chunks; i++)
+    {
+        {
+            std::unique_lock lock(mutex);
+            changed.wait(lock,
+                         [&]() { return producerError || produced > i; });
+            if (produced <= i)
+            {
+                error = producerError;
+                break;
+            }
+        }
+        try
+        {
+            auto [offset, buf] = chunk(i);
+            consume(offset, buf);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+            break;
+        }
+        std::lock_guard lock(mutex);
+        consumed = i + 1;
+        changed.notify_all();
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        stopped = true;
+        changed.notify_all();
+    }
+    producer.join();
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace estoraged
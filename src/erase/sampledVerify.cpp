@@ -0,0 +1,139 @@
+#include "sampledVerify.hpp"
+
+#include "bufferPool.hpp"
+#include "eraseProgress.hpp"
+#include "parallelVerify.hpp"
+
+#include <openssl/rand.h>
+
+#include <phosphor-logging/lg2.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace estoraged
+{
+
+using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+
+namespace
+{
+
+/* Uniform random value in [0, bound), without modulo bias */
+uint64_t randomBelow(uint64_t bound)
+{
+    constexpr uint64_t max = std::numeric_limits<uint64_t>::max();
+    const uint64_t limit = max - max % bound;
+    uint64_t value = 0;
+    do
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        if (RAND_bytes(reinterpret_cast<unsigned char*>(&value),
+                       sizeof(value)) != 1)
+        {
+            lg2::error("Estoraged erase verify unable to get random bytes",
+                       "REDFISH_MESSAGE_ID",
+                       std::string("eStorageD.1.0.EraseFailure"));
+            throw InternalFailure();
+        }
+    } while (value >= limit);
+    return value % bound;
+}
+
+} // namespace
+
+uint64_t sampleSize(double confidence, double defectRate, uint64_t chunks)
+{
+    if (!(confidence > 0 && confidence < 1) ||
+        !(defectRate > 0 && defectRate < 1))
+    {
+        return chunks;
+    }
+    double samples =
+        std::ceil(std::log1p(-confidence) / std::log1p(-defectRate));
+    if (samples >= static_cast<double>(chunks))
+    {
+        return chunks;
+    }
+    return static_cast<uint64_t>(samples);
+}
+
+std::vector<uint64_t> sampleChunks(uint64_t count, uint64_t chunks)
+{
+    if (count >= chunks)
+    {
+        std::vector<uint64_t> all(chunks);
+        for (uint64_t i = 0; i < chunks; i++)
+        {
+            all[i] = i;
+        }
+        return all;
+    }
+
+    // Floyd's algorithm, count draws for count distinct indexes
+    std::set<uint64_t> picked;
+    for (uint64_t j = chunks - count; j < chunks; j++)
+    {
+        uint64_t candidate = randomBelow(j + 1);
+        if (!picked.insert(candidate).second)
+        {
+            picked.insert(j);
+        }
+    }
+    return {picked.begin(), picked.end()};
+}
+
+SampleResult sampledVerify(int fd, uint64_t size, BufferPool& pool,
+                           double confidence, double defectRate,
+                           const VerifyCheck& check, EraseProgress* progress,
+                           EraseThrottle* throttle)
+{
+    const size_t chunkSize = pool.bufferSize();
+    std::span<std::byte> readArr = pool.get(0);
+    std::span<std::byte> scratch = pool.get(1);
+
+    SampleResult result;
+    result.chunks = (size + chunkSize - 1) / chunkSize;
+    std::vector<uint64_t> indexes = sampleChunks(
+        sampleSize(confidence, defectRate, result.chunks), result.chunks);
+    result.samples = indexes.size();
+    if (progress != nullptr)
+    {
+        progress->start(std::min<uint64_t>(result.samples * chunkSize, size));
+    }
+
+    uint64_t bytesRead = 0;
+    for (uint64_t index : indexes)
+    {
+        uint64_t offset = index * chunkSize;
+        size_t readSize = std::min<uint64_t>(chunkSize, size - offset);
+        readAt(fd, readArr.first(readSize), offset);
+        bytesRead += readSize;
+        if (progress != nullptr)
+        {
+            progress->advance(readSize);
+        }
+        if (throttle != nullptr)
+        {
+            throttle->pace(readSize);
+        }
+        size_t wrong =
+            check(0, offset, readArr.first(readSize), scratch.first(readSize));
+        if (wrong != readSize)
+        {
+            result.firstMismatch = offset + wrong;
+            break;
+        }
+    }
+    result.coverage =
+        size == 0 ? 1.0
+                  : static_cast<double>(bytesRead) / static_cast<double>(size);
+    return result;
+}
+
+} // namespace estoraged
@@ -6,23 +6,25 @@
 #include <sys/ioctl.h>
 
 #include <phosphor-logging/lg2.hpp>
-#include <stdplus/fd/create.hpp>
-#include <stdplus/fd/managed.hpp>
-#include <stdplus/handle/managed.hpp>
 #include <xyz/openbmc_project/Common/error.hpp>
 
-#include <array>
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
-#include <span>
+#include <cstdint>
+#include <limits>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <utility>
 
 namespace
 {
 
 constexpr uint32_t mmcSwitch = 6;
+constexpr uint32_t mmcSendStatus = 13;
 constexpr uint32_t mmcSwitchModeWriteByte = 0x03;
-constexpr uint32_t extCsdSanitizeStart = 165;
 constexpr uint32_t extCsdCmdSetNormal = (1 << 0);
 
 constexpr uint32_t mmcRspPresent = (1 << 0);
@@ -46,20 +48,45 @@ constexpr uint32_t mmcRspR1 = (mmcRspPresent | mmcRspCrc | mmcRspOpcode);
 constexpr uint32_t mmcEraseGroupStart = 35;
 constexpr uint32_t mmcEraseGroupEnd = 36;
 constexpr uint32_t mmcErase = 38;
+
+/* Linux gives eMMC devices the relative card address 1 */
+constexpr uint32_t mmcRelativeAddress = 1;
+
+/* R1 card status, see eMMC spec 6.13 */
+constexpr uint32_t r1ErrorBits = 0xFDF98080;
+constexpr uint32_t r1ReadyForData = (1 << 8);
+constexpr uint32_t r1CurrentStateShift = 9;
+constexpr uint32_t r1CurrentStateMask = 0xF;
+constexpr uint32_t r1StatePrg = 7;
 } // namespace
 
 namespace estoraged
 {
 
 using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
-using stdplus::fd::ManagedFd;
+
+void Sanitize::doSanitize()
+{
+    std::optional<ExtCsd> extCsd = channel->extCsd();
+    if (extCsd && extCsd->capacity() != 0)
+    {
+        doSanitize(extCsd->capacity());
+        return;
+    }
+    doSanitize(util::findSizeOfBlockDevice(devPath));
+}
 
 void Sanitize::doSanitize(uint64_t driveSize)
 {
     try
     {
-        emmcErase(driveSize);
-        emmcSanitize();
+        auto [plan, capabilities] = choosePlan(driveSize);
+        runPlan(plan, capabilities, driveSize);
+    }
+    catch (const EraseCancelled&)
+    {
+        lg2::info("eStorageD erase sanitize cancelled");
+        throw;
     }
     catch (...)
     {
@@ -67,39 +94,157 @@ void Sanitize::doSanitize(uint64_t driveSize)
                    std::string("eStorageD.1.0.EraseFailure"));
         throw InternalFailure();
     }
+    progressFinish();
     lg2::info("eStorageD successfully erase sanitize", "REDFISH_MESSAGE_ID",
               std::string("eStorageD.1.0.EraseSuccessful"));
 }
 
-void Sanitize::emmcErase(uint64_t driveSize)
+std::optional<EmmcEraseCapabilities> Sanitize::readCapabilities()
+{
+    std::optional<ExtCsd> extCsd = channel->extCsd();
+    if (!extCsd)
+    {
+        return std::nullopt;
+    }
+    return parseEraseCapabilities(extCsd->bytes());
+}
+
+std::pair<EmmcErasePlan, EmmcEraseCapabilities>
+    Sanitize::choosePlan(uint64_t driveSize)
+{
+    std::optional<EmmcEraseCapabilities> capabilities = readCapabilities();
+    if (!capabilities)
+    {
+        // without EXT_CSD nothing is known, so only the legacy policy, which
+        // erases and sanitizes as always, can go ahead
+        if (policy != EmmcErasePolicy::Legacy)
+        {
+            lg2::error("eStorageD unable to read EXT_CSD of {DEV}, it can not "
+                       "meet the policy",
+                       "DEV", devPath, "REDFISH_MESSAGE_ID",
+                       std::string("eStorageD.1.0.EraseFailure"));
+            throw InternalFailure();
+        }
+        lg2::info("eStorageD unable to read EXT_CSD, erasing {DEV} in one "
+                  "command",
+                  "DEV", devPath);
+        return {EmmcErasePlan{{EmmcEraseStep::Erase, EmmcEraseStep::Sanitize}},
+                EmmcEraseCapabilities{}};
+    }
+    std::optional<EmmcErasePlan> plan =
+        planErase(*capabilities, policy, driveSize);
+    if (!plan)
+    {
+        lg2::error("eStorageD {DEV} supports no erase meeting the policy",
+                   "DEV", devPath, "REDFISH_MESSAGE_ID",
+                   std::string("eStorageD.1.0.EraseFailure"));
+        throw InternalFailure();
+    }
+    return {*plan, *capabilities};
+}
+
+void Sanitize::runPlan(const EmmcErasePlan& plan,
+                       const EmmcEraseCapabilities& capabilities,
+                       uint64_t driveSize)
+{
+    const uint64_t estimatedSeconds =
+        std::chrono::duration_cast<std::chrono::seconds>(plan.estimate)
+            .count();
+    lg2::info("eStorageD erasing {DEV} with {STEPS}, estimated {SECONDS} s",
+              "DEV", devPath, "STEPS", plan.name(), "SECONDS",
+              estimatedSeconds);
+    progressPlan(plan.name(), estimatedSeconds);
+
+    uint64_t passes = 0;
+    for (EmmcEraseStep step : plan.steps)
+    {
+        passes += eraseStepArgs(step).size();
+    }
+    progressStart(driveSize * passes);
+
+    for (EmmcEraseStep step : plan.steps)
+    {
+        if (step == EmmcEraseStep::Sanitize)
+        {
+            emmcSanitize();
+            continue;
+        }
+        uint64_t groupTimeoutMs = eraseStepGroupTimeoutMs(capabilities, step);
+        for (uint32_t arg : eraseStepArgs(step))
+        {
+            erasePass(capabilities.geometry, arg, groupTimeoutMs, driveSize);
+        }
+    }
+}
+
+void Sanitize::eraseRange(uint64_t first, uint64_t last, uint32_t arg,
+                          uint32_t timeoutMs)
 {
-    uint64_t sectorSize = 0x200; // default value see eMMC spec 6.6.34.
-                                 // NOTE: 0x200 is only valid for eMMC greater
-                                 // then 2 GB
     struct MmcIoMultiCmdErase eraseCmd = {};
 
     eraseCmd.num_of_cmds = 3;
     eraseCmd.cmds[0].opcode = mmcEraseGroupStart;
-    eraseCmd.cmds[0].arg = 0;
+    eraseCmd.cmds[0].arg = static_cast<uint32_t>(first);
     eraseCmd.cmds[0].flags = mmcRspSpiR1 | mmcRspR1 | mmcCmdAc;
     eraseCmd.cmds[0].write_flag = 1;
 
     eraseCmd.cmds[1].opcode = mmcEraseGroupEnd;
-    eraseCmd.cmds[1].arg = (driveSize / sectorSize) - 1;
+    eraseCmd.cmds[1].arg = static_cast<uint32_t>(last);
     eraseCmd.cmds[1].flags = mmcRspSpiR1 | mmcRspR1 | mmcCmdAc;
     eraseCmd.cmds[1].write_flag = 1;
 
     /* Send Erase Command */
     eraseCmd.cmds[2].opcode = mmcErase;
-    eraseCmd.cmds[2].arg = 0x00000000;
-    eraseCmd.cmds[2].cmd_timeout_ms = 0x0FFFFFFF;
+    eraseCmd.cmds[2].arg = arg;
+    eraseCmd.cmds[2].cmd_timeout_ms = timeoutMs;
     eraseCmd.cmds[2].flags = mmcRspSpiR1B | mmcRspR1B | mmcCmdAc;
     eraseCmd.cmds[2].write_flag = 1;
 
-    if (ioctlWrapper->doIoctlMulti(devPath, MMC_IOC_MULTI_CMD, eraseCmd) != 0)
+    if (channel->multiCommand(eraseCmd) != 0)
+    {
+        throw InternalFailure();
+    }
+}
+
+void Sanitize::erasePass(const EmmcEraseGeometry& geometry, uint32_t arg,
+                         uint64_t groupTimeoutMs, uint64_t driveSize)
+{
+    const uint64_t units = driveSize / geometry.addressUnit;
+    if (units == 0)
     {
         throw InternalFailure();
     }
+
+    if (geometry.groupSize == 0 || groupTimeoutMs == 0)
+    {
+        lg2::info("eStorageD erase group of {DEV} not known, erasing it in "
+                  "one command",
+                  "DEV", devPath);
+        eraseRange(0, units - 1, arg, legacyEraseTimeoutMs);
+        progressAdvance(driveSize);
+        return;
+    }
+
+    // chunks start on erase group boundaries, so every group is erased by
+    // exactly one command
+    const uint64_t groupUnits = geometry.groupSize / geometry.addressUnit;
+    const uint64_t groupsPerCommand =
+        std::max<uint64_t>(1, maxEraseCommandMs / groupTimeoutMs);
+    const uint64_t chunkUnits = groupUnits * groupsPerCommand;
+    lg2::info("eStorageD erasing {DEV} in chunks of {CHUNK} bytes, erase "
+              "group {GROUP} bytes",
+              "DEV", devPath, "CHUNK", chunkUnits * geometry.addressUnit,
+              "GROUP", geometry.groupSize);
+    for (uint64_t first = 0; first < units; first += chunkUnits)
+    {
+        uint64_t count = std::min(chunkUnits, units - first);
+        uint64_t groups = (count + groupUnits - 1) / groupUnits;
+        uint64_t timeoutMs =
+            std::min<uint64_t>(groups * groupTimeoutMs, legacyEraseTimeoutMs);
+        eraseRange(first, first + count - 1, arg,
+                   static_cast<uint32_t>(timeoutMs));
+        progressAdvance(count * geometry.addressUnit);
+    }
 }
 
 void Sanitize::emmcSanitize()
@@ -107,35 +252,78 @@ void Sanitize::emmcSanitize()
     struct mmc_ioc_cmd idata = {};
     idata.write_flag = 1;
     idata.opcode = mmcSwitch;
-    idata.arg = (mmcSwitchModeWriteByte << 24) | (extCsdSanitizeStart << 16) |
-                (1 << 8) | extCsdCmdSetNormal;
-    idata.flags = mmcRspSpiR1B | mmcRspR1B | mmcCmdAc;
+    idata.arg = (mmcSwitchModeWriteByte << 24) |
+                (extcsd::sanitizeStart << 16) | (1 << 8) | extCsdCmdSetNormal;
+    // without the busy flag older kernels return once the command is
+    // accepted. Since Linux 5.10 the kernel waits for a sanitize inside the
+    // ioctl whatever the flags, for cmd_timeout_ms, or 240 s if it is 0, and
+    // then aborts it with HPI.
+    bool polling = pollTimeout.count() != 0;
+    idata.flags = polling ? mmcRspSpiR1 | mmcRspR1 | mmcCmdAc
+                          : mmcRspSpiR1B | mmcRspR1B | mmcCmdAc;
+    idata.cmd_timeout_ms = sanitizeTimeoutMs;
+    if (polling)
+    {
+        idata.cmd_timeout_ms = static_cast<uint32_t>(
+            std::min<int64_t>(pollTimeout.count(),
+                              std::numeric_limits<uint32_t>::max()));
+    }
 
-    // make the eMMC sanitize ioctl
-    if (ioctlWrapper->doIoctl(devPath, MMC_IOC_CMD, idata) != 0)
+    // the device is busy in the ioctl on newer kernels, or in the status
+    // polling on older ones
+    BusyScope busy(*this);
+    if (channel->command(idata) != 0)
     {
         throw InternalFailure();
     }
+    if (polling)
+    {
+        waitForSanitize();
+    }
 }
 
-int IOCTLWrapperImpl::doIoctl(std::string_view devPath, unsigned long request,
-                              struct mmc_ioc_cmd data)
-
+void Sanitize::waitForSanitize()
 {
-    ManagedFd fd = stdplus::fd::open(std::string(devPath).c_str(),
-                                     stdplus::fd::OpenAccess::ReadOnly);
-
-    return fd.ioctl(request, static_cast<void*>(&data));
+    auto deadline = std::chrono::steady_clock::now() + pollTimeout;
+    while (true)
+    {
+        uint32_t status = readCardStatus();
+        if ((status & r1ErrorBits) != 0)
+        {
+            lg2::error("eStorageD sanitize of {DEV} failed, card status "
+                       "{STATUS}",
+                       "DEV", devPath, "STATUS", lg2::hex, status);
+            throw InternalFailure();
+        }
+        uint32_t state = (status >> r1CurrentStateShift) & r1CurrentStateMask;
+        if (state != r1StatePrg && (status & r1ReadyForData) != 0)
+        {
+            break;
+        }
+        // the device is still busy, there is no way to stop it from here
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            lg2::error("eStorageD sanitize of {DEV} did not finish in "
+                       "{TIMEOUT} ms",
+                       "DEV", devPath, "TIMEOUT", pollTimeout.count());
+            throw InternalFailure();
+        }
+        std::this_thread::sleep_for(pollEvery);
+    }
 }
 
-int IOCTLWrapperImpl::doIoctlMulti(std::string_view devPath,
-                                   unsigned long request,
-                                   struct MmcIoMultiCmdErase data)
+uint32_t Sanitize::readCardStatus()
 {
-    ManagedFd fd = stdplus::fd::open(std::string(devPath).c_str(),
-                                     stdplus::fd::OpenAccess::ReadOnly);
-
-    return fd.ioctl(request, static_cast<void*>(&data));
+    struct mmc_ioc_cmd idata = {};
+    idata.write_flag = 0;
+    idata.opcode = mmcSendStatus;
+    idata.arg = mmcRelativeAddress << 16;
+    idata.flags = mmcRspSpiR1 | mmcRspR1 | mmcCmdAc;
+    if (channel->commandResponse(idata) != 0)
+    {
+        throw InternalFailure();
+    }
+    return idata.response[0];
 }
 
 } // namespace estoraged
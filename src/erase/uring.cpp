@@ -0,0 +1,498 @@
+#include "uring.hpp"
+
+#include "bufferPool.hpp"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <phosphor-logging/lg2.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace estoraged
+{
+
+using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+
+namespace
+{
+
+constexpr size_t maxRetry = 32;
+
+/* io_uring shares the ring indexes with the kernel, see io_uring(7). */
+unsigned* ringField(void* ring, uint32_t offset)
+{
+    return reinterpret_cast<unsigned*>( // NOLINT
+        static_cast<std::byte*>(ring) + offset);
+}
+
+unsigned loadAcquire(unsigned* field)
+{
+    return std::atomic_ref<unsigned>(*field).load(std::memory_order_acquire);
+}
+
+void storeRelease(unsigned* field, unsigned value)
+{
+    std::atomic_ref<unsigned>(*field).store(value, std::memory_order_release);
+}
+
+void* mapRing(int ringFd, size_t size, off_t offset)
+{
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd, offset);
+    if (ptr == MAP_FAILED)
+    {
+        throw std::system_error(errno, std::generic_category(),
+                                "io_uring mmap");
+    }
+    return ptr;
+}
+
+/** @brief State of one request slot. */
+struct Slot
+{
+    uint64_t offset = 0;
+    size_t length = 0;
+    size_t done = 0;
+    size_t retry = 0;
+    bool complete = false;
+};
+
+/** @brief Accounts for a completion, and tells if the slot needs a resubmit.
+ *
+ *  @param[in] slot - the slot that completed.
+ *  @param[in] result - the completion result.
+ *  @param[in] op - "read" or "write", for the log.
+ *  @return true if the slot still has bytes left.
+ */
+bool accountCompletion(Slot& slot, int32_t result, const char* op)
+{
+    if (result < 0)
+    {
+        lg2::error("Estoraged erase io_uring {OP} failed: {ERROR}", "OP", op,
+                   "ERROR", std::strerror(-result), "REDFISH_MESSAGE_ID",
+                   std::string("eStorageD.1.0.EraseFailure"));
+        throw InternalFailure();
+    }
+    slot.done += static_cast<size_t>(result);
+    if (slot.done == slot.length)
+    {
+        return false;
+    }
+    if (slot.done > slot.length)
+    {
+        throw InternalFailure();
+    }
+    slot.retry++;
+    if (slot.retry > maxRetry)
+    {
+        lg2::error("Unable to make full io_uring {OP}", "OP", op,
+                   "REDFISH_MESSAGE_ID",
+                   std::string("eStorageD.1.0.EraseFailure"));
+        throw InternalFailure();
+    }
+    return true;
+}
+
+/** @brief Drains the ring when an erase loop exits early, so that the kernel
+ *  is done with the pool buffers before they are freed, and a cancelled
+ *  erase has no writes left once it reports done.
+ */
+class DrainGuard
+{
+  public:
+    explicit DrainGuard(Uring& ring) : ring(ring) {}
+    ~DrainGuard()
+    {
+        ring.drain();
+    }
+
+    DrainGuard(const DrainGuard&) = delete;
+    DrainGuard& operator=(const DrainGuard&) = delete;
+    DrainGuard(DrainGuard&&) = delete;
+    DrainGuard& operator=(DrainGuard&&) = delete;
+
+  private:
+    Uring& ring;
+};
+
+} // namespace
+
+Uring::Uring(unsigned entries)
+{
+    ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ringFd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(),
+                                "io_uring_setup");
+    }
+
+    try
+    {
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize =
+            params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+        {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+
+        sqRing = mapRing(ringFd, sqRingSize, IORING_OFF_SQ_RING);
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+        {
+            cqRing = sqRing;
+        }
+        else
+        {
+            cqRing = mapRing(ringFd, cqRingSize, IORING_OFF_CQ_RING);
+        }
+
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(
+            mapRing(ringFd, sqesSize, IORING_OFF_SQES));
+    }
+    catch (...)
+    {
+        release();
+        throw;
+    }
+}
+
+Uring::~Uring()
+{
+    release();
+}
+
+void Uring::release()
+{
+    if (sqes != nullptr)
+    {
+        munmap(sqes, sqesSize);
+    }
+    if (cqRing != nullptr && cqRing != sqRing)
+    {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != nullptr)
+    {
+        munmap(sqRing, sqRingSize);
+    }
+    if (ringFd >= 0)
+    {
+        close(ringFd);
+    }
+    sqes = nullptr;
+    cqRing = sqRing = nullptr;
+    ringFd = -1;
+}
+
+void Uring::registerBuffers(BufferPool& pool)
+{
+    std::vector<iovec> iovecs;
+    iovecs.reserve(pool.count());
+    for (size_t i = 0; i < pool.count(); i++)
+    {
+        std::span<std::byte> buffer = pool.get(i);
+        iovecs.push_back({buffer.data(), buffer.size()});
+    }
+    fixedBuffers =
+        syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS,
+                iovecs.data(), static_cast<unsigned>(iovecs.size())) == 0;
+    if (!fixedBuffers)
+    {
+        lg2::info("io_uring buffer registration failed, using unregistered "
+                  "buffers: {ERROR}",
+                  "ERROR", std::strerror(errno));
+    }
+}
+
+void Uring::submit()
+{
+    while (toSubmit > 0)
+    {
+        long ret = syscall(__NR_io_uring_enter, ringFd, toSubmit, 0, 0,
+                           nullptr, 0);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            lg2::error("io_uring_enter failed: {ERROR}", "ERROR",
+                       std::strerror(errno), "REDFISH_MESSAGE_ID",
+                       std::string("eStorageD.1.0.EraseFailure"));
+            throw InternalFailure();
+        }
+        toSubmit -= static_cast<unsigned>(ret);
+    }
+}
+
+void Uring::prep(uint8_t opcode, int fd, unsigned bufIndex, const void* addr,
+                 uint32_t len, uint64_t offset, uint64_t userData)
+{
+    unsigned* head = ringField(sqRing, params.sq_off.head);
+    unsigned* tail = ringField(sqRing, params.sq_off.tail);
+    unsigned mask = *ringField(sqRing, params.sq_off.ring_mask);
+
+    // a full queue would overwrite entries the kernel has not read yet
+    if (*tail - loadAcquire(head) >= params.sq_entries)
+    {
+        submit();
+        if (*tail - loadAcquire(head) >= params.sq_entries)
+        {
+            lg2::error("io_uring submission queue is full",
+                       "REDFISH_MESSAGE_ID",
+                       std::string("eStorageD.1.0.EraseFailure"));
+            throw InternalFailure();
+        }
+    }
+    unsigned index = *tail & mask;
+
+    io_uring_sqe& sqe = sqes[index]; // NOLINT
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(addr); // NOLINT
+    sqe.len = len;
+    sqe.off = offset;
+    sqe.user_data = userData;
+    if (fixedBuffers)
+    {
+        sqe.buf_index = static_cast<uint16_t>(bufIndex);
+    }
+
+    ringField(sqRing, params.sq_off.array)[index] = index; // NOLINT
+    storeRelease(tail, *tail + 1);
+    toSubmit++;
+    inFlight++;
+}
+
+void Uring::prepRead(int fd, unsigned bufIndex, std::span<std::byte> buf,
+                     uint64_t offset, uint64_t userData)
+{
+    prep(fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ, fd, bufIndex,
+         buf.data(), static_cast<uint32_t>(buf.size()), offset, userData);
+}
+
+void Uring::prepWrite(int fd, unsigned bufIndex,
+                      std::span<const std::byte> buf, uint64_t offset,
+                      uint64_t userData)
+{
+    prep(fixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, bufIndex,
+         buf.data(), static_cast<uint32_t>(buf.size()), offset, userData);
+}
+
+Uring::Completion Uring::submitAndWait()
+{
+    unsigned* head = ringField(cqRing, params.cq_off.head);
+    unsigned* tail = ringField(cqRing, params.cq_off.tail);
+    unsigned mask = *ringField(cqRing, params.cq_off.ring_mask);
+
+    while (toSubmit > 0 || *head == loadAcquire(tail))
+    {
+        long ret = syscall(__NR_io_uring_enter, ringFd, toSubmit, 1,
+                           IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            lg2::error("io_uring_enter failed: {ERROR}", "ERROR",
+                       std::strerror(errno), "REDFISH_MESSAGE_ID",
+                       std::string("eStorageD.1.0.EraseFailure"));
+            throw InternalFailure();
+        }
+        toSubmit -= static_cast<unsigned>(ret);
+    }
+
+    const io_uring_cqe* cqes = reinterpret_cast<const io_uring_cqe*>( // NOLINT
+        static_cast<std::byte*>(cqRing) + params.cq_off.cqes);
+    const io_uring_cqe& cqe = cqes[*head & mask]; // NOLINT
+    Completion completion{cqe.user_data, cqe.res};
+    storeRelease(head, *head + 1);
+    inFlight--;
+    return completion;
+}
+
+void Uring::drain() noexcept
+{
+    // without SQPOLL the kernel only reads the tail in io_uring_enter, so
+    // the requests not submitted yet can be taken back
+    unsigned* sqTail = ringField(sqRing, params.sq_off.tail);
+    storeRelease(sqTail, *sqTail - toSubmit);
+    inFlight -= toSubmit;
+    toSubmit = 0;
+
+    unsigned* head = ringField(cqRing, params.cq_off.head);
+    unsigned* tail = ringField(cqRing, params.cq_off.tail);
+    while (inFlight > 0)
+    {
+        if (*head != loadAcquire(tail))
+        {
+            storeRelease(head, *head + 1);
+            inFlight--;
+            continue;
+        }
+        long ret = syscall(__NR_io_uring_enter, ringFd, 0, 1,
+                           IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret < 0 && errno != EINTR)
+        {
+            lg2::error("io_uring_enter failed with {COUNT} requests in "
+                       "flight: {ERROR}",
+                       "COUNT", inFlight, "ERROR", std::strerror(errno));
+            return;
+        }
+    }
+}
+
+std::unique_ptr<Uring> makeEraseUring(const EraseOptions& options,
+                                      BufferPool& pool)
+{
+    if (options.queueDepth <= 1)
+    {
+        return nullptr;
+    }
+    try
+    {
+        auto ring =
+            std::make_unique<Uring>(static_cast<unsigned>(options.queueDepth));
+        ring->registerBuffers(pool);
+        return ring;
+    }
+    catch (const std::system_error& e)
+    {
+        lg2::info("io_uring is not available, using synchronous I/O: {ERROR}",
+                  "ERROR", e.what());
+        return nullptr;
+    }
+}
+
+void uringWrite(
+    Uring& ring, int fd, BufferPool& pool, size_t slots, uint64_t size,
+    const std::function<void(uint64_t, std::span<std::byte>)>& fill,
+    const std::function<void(uint64_t)>& written, uint64_t start)
+{
+    // the completion queue also holds twice the entries, so it can not
+    // overflow either
+    slots = std::min<size_t>(slots, ring.entries());
+    DrainGuard guard(ring);
+    const size_t chunkSize = pool.bufferSize();
+    std::vector<Slot> state(slots, Slot{.complete = true});
+    std::vector<size_t> freeSlots;
+    for (size_t i = slots; i > 0; i--)
+    {
+        freeSlots.push_back(i - 1);
+    }
+
+    auto submit = [&](size_t index) {
+        Slot& slot = state[index];
+        ring.prepWrite(fd, static_cast<unsigned>(index),
+                       pool.get(index).subspan(slot.done,
+                                               slot.length - slot.done),
+                       slot.offset + slot.done, index);
+    };
+
+    uint64_t nextOffset = start;
+    while (nextOffset < size || freeSlots.size() < slots)
+    {
+        while (nextOffset < size && !freeSlots.empty())
+        {
+            size_t index = freeSlots.back();
+            freeSlots.pop_back();
+            size_t length = std::min<uint64_t>(chunkSize, size - nextOffset);
+            state[index] = Slot{nextOffset, length};
+            fill(nextOffset, pool.get(index).first(length));
+            submit(index);
+            nextOffset += length;
+        }
+
+        Uring::Completion completion = ring.submitAndWait();
+        size_t index = completion.userData;
+        if (accountCompletion(state[index], completion.result, "write"))
+        {
+            submit(index);
+            continue;
+        }
+        freeSlots.push_back(index);
+        state[index].complete = true;
+        if (written)
+        {
+            // chunks complete out of order, the oldest in flight holds back
+            uint64_t prefix = nextOffset;
+            for (const Slot& slot : state)
+            {
+                if (!slot.complete)
+                {
+                    prefix = std::min(prefix, slot.offset);
+                }
+            }
+            written(prefix);
+        }
+    }
+}
+
+void uringRead(
+    Uring& ring, int fd, BufferPool& pool, size_t slots, uint64_t size,
+    const std::function<void(uint64_t, std::span<const std::byte>)>& check)
+{
+    slots = std::min<size_t>(slots, ring.entries());
+    DrainGuard guard(ring);
+    const size_t chunkSize = pool.bufferSize();
+    std::vector<Slot> state(slots);
+
+    auto submit = [&](size_t index) {
+        Slot& slot = state[index];
+        ring.prepRead(fd, static_cast<unsigned>(index),
+                      pool.get(index).subspan(slot.done,
+                                              slot.length - slot.done),
+                      slot.offset + slot.done, index);
+    };
+
+    /* Chunk n always uses slot n % slots, so chunks retire in order. */
+    uint64_t nextChunk = 0;
+    uint64_t retireChunk = 0;
+    uint64_t nextOffset = 0;
+    while (nextOffset < size || retireChunk < nextChunk)
+    {
+        while (nextOffset < size && nextChunk - retireChunk < slots)
+        {
+            size_t index = nextChunk % slots;
+            size_t length = std::min<uint64_t>(chunkSize, size - nextOffset);
+            state[index] = Slot{nextOffset, length};
+            submit(index);
+            nextOffset += length;
+            nextChunk++;
+        }
+
+        Uring::Completion completion = ring.submitAndWait();
+        size_t index = completion.userData;
+        if (accountCompletion(state[index], completion.result, "read"))
+        {
+            submit(index);
+            continue;
+        }
+        state[index].complete = true;
+
+        while (retireChunk < nextChunk && state[retireChunk % slots].complete)
+        {
+            Slot& slot = state[retireChunk % slots];
+            check(slot.offset,
+                  pool.get(retireChunk % slots).first(slot.length));
+            slot.complete = false;
+            retireChunk++;
+        }
+    }
+}
+
+} // namespace estoraged
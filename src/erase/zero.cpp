@@ -1,7 +1,14 @@
 #include "zero.hpp"
 
+#include "badRangeMap.hpp"
+#include "bufferPool.hpp"
 #include "erase.hpp"
+#include "parallelVerify.hpp"
+#include "sampledVerify.hpp"
+#include "uring.hpp"
+#include "zeroCheck.hpp"
 
+#include <linux/fs.h>
 #include <unistd.h>
 
 #include <phosphor-logging/lg2.hpp>
@@ -9,9 +16,14 @@
 #include <stdplus/fd/managed.hpp>
 #include <xyz/openbmc_project/Common/error.hpp>
 
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <filesystem>
+#include <memory>
+#include <optional>
 #include <span>
+#include <system_error>
 #include <thread>
 
 namespace estoraged
@@ -20,25 +32,83 @@ namespace estoraged
 using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
 using stdplus::fd::Fd;
 
+stdplus::fd::ManagedFd Zero::openDevice(stdplus::fd::OpenAccess access)
+{
+    if (!options.directIo)
+    {
+        return stdplus::fd::open(devPath, access);
+    }
+    pool = BufferPool::forErase(erasePoolSize(options), options,
+                                util::findBlockGeometry(devPath), blockSize);
+    return stdplus::fd::open(
+        devPath,
+        stdplus::fd::OpenFlags(access).set(stdplus::fd::OpenFlag::Direct));
+}
+
+void Zero::writeZero()
+{
+    stdplus::fd::ManagedFd fd = openDevice(stdplus::fd::OpenAccess::WriteOnly);
+    uint64_t driveSize = util::findSizeOfBlockDevice(devPath);
+    if (options.zeroOffload)
+    {
+        std::filesystem::path queueDir("/sys/class/block");
+        queueDir /= std::filesystem::path(devPath).filename();
+        queueDir /= "queue";
+        if (writeZeroOffload(driveSize, fd, util::findZeroOffload(queueDir)))
+        {
+            checkBadRanges("zeros");
+            progressFinish();
+            return;
+        }
+    }
+    if (tolerant() || !writeZeroUring(driveSize, fd.get()))
+    {
+        writeZero(driveSize, fd);
+    }
+    checkBadRanges("zeros");
+    progressFinish();
+}
+
+void Zero::verifyZero()
+{
+    stdplus::fd::ManagedFd fd = openDevice(stdplus::fd::OpenAccess::ReadOnly);
+    uint64_t driveSize = util::findSizeOfBlockDevice(devPath);
+    if (tolerant() || (!verifyZeroSampled(driveSize, fd.get()) &&
+                       !verifyZeroParallel(driveSize, fd.get()) &&
+                       !verifyZeroUring(driveSize, fd.get())))
+    {
+        verifyZero(driveSize, fd);
+    }
+    checkBadRanges("zeros");
+    progressFinish();
+}
+
 void Zero::writeZero(const uint64_t driveSize, Fd& fd)
 {
-    uint64_t currentIndex = 0;
-    const std::array<const std::byte, blockSize> blockOfZeros{};
+    uint64_t currentIndex = std::min(startOffset, driveSize);
+    const size_t chunkSize = pool.bufferSize();
+    std::span<std::byte> blockOfZeros = pool.get(0);
+    std::ranges::fill(blockOfZeros, std::byte{0});
+    if (currentIndex != 0)
+    {
+        fd.lseek(static_cast<off_t>(currentIndex), stdplus::fd::Whence::Set);
+    }
+    progressStart(driveSize, currentIndex);
 
     while (currentIndex < driveSize)
     {
-        uint32_t writeSize = currentIndex + blockSize < driveSize
-                                 ? blockSize
-                                 : driveSize - currentIndex;
+        size_t writeSize = currentIndex + chunkSize < driveSize
+                               ? chunkSize
+                               : driveSize - currentIndex;
         try
         {
             size_t written = 0;
             size_t retry = 0;
             while (written < writeSize)
             {
-                written += fd.write(std::span{blockOfZeros}.subspan(
-                                        written, writeSize - written))
-                               .size();
+                written +=
+                    fd.write(blockOfZeros.subspan(written, writeSize - written))
+                        .size();
                 if (written == writeSize)
                 {
                     break;
@@ -60,35 +130,42 @@ void Zero::writeZero(const uint64_t driveSize, Fd& fd)
         }
         catch (...)
         {
-            lg2::error("Estoraged erase zeros unable to write size",
-                       "REDFISH_MESSAGE_ID",
-                       std::string("eStorageD.1.0.EraseFailure"));
-            throw InternalFailure();
+            if (!tolerant())
+            {
+                lg2::error("Estoraged erase zeros unable to write size",
+                           "REDFISH_MESSAGE_ID",
+                           std::string("eStorageD.1.0.EraseFailure"));
+                throw InternalFailure();
+            }
+            badRanges->add(BadRangeKind::Write, currentIndex, writeSize);
+            // where a failed write left the file offset is unknown
+            fd.lseek(static_cast<off_t>(currentIndex + writeSize),
+                     stdplus::fd::Whence::Set);
         }
         currentIndex += writeSize;
+        progressAdvance(writeSize);
     }
 }
 
 void Zero::verifyZero(uint64_t driveSize, Fd& fd)
 {
     uint64_t currentIndex = 0;
-    std::array<std::byte, blockSize> readArr{};
-    const std::array<const std::byte, blockSize> blockOfZeros{};
+    const size_t chunkSize = pool.bufferSize();
+    std::span<std::byte> readArr = pool.get(0);
+    progressStart(driveSize);
 
     while (currentIndex < driveSize)
     {
-        uint32_t readSize = currentIndex + blockSize < driveSize
-                                ? blockSize
-                                : driveSize - currentIndex;
+        size_t readSize = currentIndex + chunkSize < driveSize
+                              ? chunkSize
+                              : driveSize - currentIndex;
         try
         {
             size_t read = 0;
             size_t retry = 0;
             while (read < readSize)
             {
-                read +=
-                    fd.read(std::span{readArr}.subspan(read, readSize - read))
-                        .size();
+                read += fd.read(readArr.subspan(read, readSize - read)).size();
                 if (read == readSize)
                 {
                     break;
@@ -109,20 +186,211 @@ void Zero::verifyZero(uint64_t driveSize, Fd& fd)
         }
         catch (...)
         {
-            lg2::error("Estoraged erase zeros block unable to read size",
-                       "REDFISH_MESSAGE_ID",
-                       std::string("eStorageD.1.0.EraseFailure"));
-            throw InternalFailure();
+            if (!tolerant())
+            {
+                lg2::error("Estoraged erase zeros block unable to read size",
+                           "REDFISH_MESSAGE_ID",
+                           std::string("eStorageD.1.0.EraseFailure"));
+                throw InternalFailure();
+            }
+            badRanges->add(BadRangeKind::Read, currentIndex, readSize);
+            fd.lseek(static_cast<off_t>(currentIndex + readSize),
+                     stdplus::fd::Whence::Set);
+            currentIndex += readSize;
+            progressAdvance(readSize);
+            continue;
         }
-        if (memcmp(readArr.data(), blockOfZeros.data(), readSize) != 0)
+        size_t nonZero = findNonZero(readArr.first(readSize));
+        if (nonZero != readSize)
         {
-            lg2::error("Estoraged erase zeros block is not zero",
-                       "REDFISH_MESSAGE_ID",
-                       std::string("eStorageD.1.0.EraseFailure"));
-            throw InternalFailure();
+            if (!tolerant())
+            {
+                lg2::error(
+                    "Estoraged erase zeros block is not zero at {OFFSET}",
+                    "OFFSET", currentIndex + nonZero, "REDFISH_MESSAGE_ID",
+                    std::string("eStorageD.1.0.EraseFailure"));
+                throw InternalFailure();
+            }
+            recordMismatches(
+                *badRanges, currentIndex, readArr.first(readSize), nonZero,
+                [](uint64_t, std::span<const std::byte> data) {
+                    return findNonZero(data);
+                },
+                sectorSize);
         }
         currentIndex += readSize;
+        progressAdvance(readSize);
+    }
+}
+
+bool Zero::writeZeroOffload(uint64_t driveSize, Fd& fd,
+                            const util::ZeroOffload& offload)
+{
+    // without REQ_OP_WRITE_ZEROES the kernel writes the zero pages itself,
+    // which is no faster than the engines
+    uint64_t maxBytes = offload.writeZeroesMaxBytes;
+    if (maxBytes == 0)
+    {
+        lg2::info("Estoraged erase zeros has no offload, writing zeros");
+        return false;
+    }
+
+    // every request starts on an erase group boundary
+    uint64_t alignment = std::max(offload.discardGranularity, sectorSize);
+    uint64_t chunkSize = std::max(alignment, maxBytes / alignment * alignment);
+
+    uint64_t currentIndex = std::min(startOffset, driveSize);
+    currentIndex = currentIndex / alignment * alignment;
+    const uint64_t firstIndex = currentIndex;
+    progressStart(driveSize, currentIndex);
+    while (currentIndex < driveSize)
+    {
+        std::array<uint64_t, 2> range{
+            currentIndex, std::min(chunkSize, driveSize - currentIndex)};
+        try
+        {
+            fd.ioctl(BLKZEROOUT, range.data());
+        }
+        catch (const std::system_error& e)
+        {
+            if (currentIndex == firstIndex)
+            {
+                lg2::info("Estoraged erase zeros offload rejected, writing "
+                          "zeros: {ERROR}",
+                          "ERROR", e.what());
+                return false;
+            }
+            if (!tolerant())
+            {
+                lg2::error("Estoraged erase zeros offload failed at {OFFSET}",
+                           "OFFSET", currentIndex, "REDFISH_MESSAGE_ID",
+                           std::string("eStorageD.1.0.EraseFailure"));
+                throw InternalFailure();
+            }
+            badRanges->add(BadRangeKind::Write, currentIndex, range[1]);
+        }
+        currentIndex += range[1];
+        progressAdvance(range[1]);
+    }
+    return true;
+}
+
+bool Zero::writeZeroUring(uint64_t driveSize, int fd)
+{
+    std::unique_ptr<Uring> ring = makeEraseUring(options, pool);
+    if (!ring)
+    {
+        return false;
+    }
+
+    const size_t slots = pool.count() - 1;
+    for (size_t i = 0; i < slots; i++)
+    {
+        std::ranges::fill(pool.get(i), std::byte{0});
+    }
+    const uint64_t start = std::min(startOffset, driveSize);
+    uint64_t done = start;
+    progressStart(driveSize, start);
+    try
+    {
+        uringWrite(
+            *ring, fd, pool, slots, driveSize,
+            [](uint64_t, std::span<std::byte>) {},
+            [this, &done](uint64_t written) {
+                progressAdvance(written - done);
+                done = written;
+            },
+            start);
+    }
+    catch (const EraseCancelled&)
+    {
+        throw;
+    }
+    catch (...)
+    {
+        lg2::error("Estoraged erase zeros unable to write size",
+                   "REDFISH_MESSAGE_ID",
+                   std::string("eStorageD.1.0.EraseFailure"));
+        throw InternalFailure();
+    }
+    return true;
+}
+
+bool Zero::verifyZeroUring(uint64_t driveSize, int fd)
+{
+    std::unique_ptr<Uring> ring = makeEraseUring(options, pool);
+    if (!ring)
+    {
+        return false;
+    }
+
+    progressStart(driveSize);
+    uringRead(*ring, fd, pool, pool.count() - 1, driveSize,
+              [this](uint64_t offset, std::span<const std::byte> block) {
+                  size_t nonZero = findNonZero(block);
+                  if (nonZero != block.size())
+                  {
+                      lg2::error(
+                          "Estoraged erase zeros block is not zero at {OFFSET}",
+                          "OFFSET", offset + nonZero, "REDFISH_MESSAGE_ID",
+                          std::string("eStorageD.1.0.EraseFailure"));
+                      throw InternalFailure();
+                  }
+                  progressAdvance(block.size());
+              });
+    return true;
+}
+
+bool Zero::verifyZeroParallel(uint64_t driveSize, int fd)
+{
+    if (options.verifyThreads <= 1)
+    {
+        return false;
+    }
+
+    progressStart(driveSize);
+    std::optional<uint64_t> mismatch = parallelVerify(
+        fd, driveSize, options.verifyThreads, pool,
+        [this](size_t, uint64_t, std::span<const std::byte> block,
+               std::span<std::byte>) {
+            progressAdvance(block.size());
+            return findNonZero(block);
+        });
+    if (mismatch)
+    {
+        lg2::error("Estoraged erase zeros block is not zero at {OFFSET}",
+                   "OFFSET", *mismatch, "REDFISH_MESSAGE_ID",
+                   std::string("eStorageD.1.0.EraseFailure"));
+        throw InternalFailure();
+    }
+    return true;
+}
+
+bool Zero::verifyZeroSampled(uint64_t driveSize, int fd)
+{
+    if (options.verifySampleConfidence <= 0)
+    {
+        return false;
+    }
+
+    SampleResult result = sampledVerify(
+        fd, driveSize, pool, options.verifySampleConfidence,
+        options.verifySampleDefectRate,
+        [](size_t, uint64_t, std::span<const std::byte> block,
+           std::span<std::byte>) { return findNonZero(block); },
+        progress, throttle);
+    lg2::info("Estoraged erase zeros sampled {SAMPLES} of {CHUNKS} chunks, "
+              "{COVERAGE} of the drive",
+              "SAMPLES", result.samples, "CHUNKS", result.chunks, "COVERAGE",
+              result.coverage);
+    if (result.firstMismatch)
+    {
+        lg2::error("Estoraged erase zeros block is not zero at {OFFSET}",
+                   "OFFSET", *result.firstMismatch, "REDFISH_MESSAGE_ID",
+                   std::string("eStorageD.1.0.EraseFailure"));
+        throw InternalFailure();
     }
+    return true;
 }
 
 } // namespace estoraged
@@ -0,0 +1,151 @@
+#include "zeroCheck.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ESTORAGED_ZERO_CHECK_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ESTORAGED_ZERO_CHECK_NEON
+#endif
+
+namespace estoraged
+{
+
+namespace
+{
+
+size_t findNonZeroScalar(std::span<const std::byte> data)
+{
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= data.size(); i += sizeof(uint64_t))
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, &data[i], sizeof(word));
+        if (word != 0)
+        {
+            break;
+        }
+    }
+    for (; i < data.size(); i++)
+    {
+        if (data[i] != std::byte{0})
+        {
+            return i;
+        }
+    }
+    return data.size();
+}
+
+/*
+ * The vector kernels OR a block of vectors together and only test the
+ * result, so the loop is one load and one OR per vector. The block with the
+ * first non-zero byte and the tail are finished by the scalar kernel.
+ */
+
+#ifdef ESTORAGED_ZERO_CHECK_X86
+
+#if defined(__SSE2__)
+size_t findNonZeroSse2(std::span<const std::byte> data)
+{
+    constexpr size_t block = 4 * sizeof(__m128i);
+    const std::byte* ptr = data.data();
+    size_t i = 0;
+    for (; i + block <= data.size(); i += block)
+    {
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+        const auto* vec = reinterpret_cast<const __m128i*>(ptr + i);
+        // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+        __m128i acc = _mm_or_si128(
+            _mm_or_si128(_mm_loadu_si128(vec), _mm_loadu_si128(vec + 1)),
+            _mm_or_si128(_mm_loadu_si128(vec + 2), _mm_loadu_si128(vec + 3)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) !=
+            0xffff)
+        {
+            break;
+        }
+    }
+    return i + findNonZeroScalar(data.subspan(i));
+}
+#endif
+
+__attribute__((target("avx2"))) size_t
+    findNonZeroAvx2(std::span<const std::byte> data)
+{
+    constexpr size_t block = 4 * sizeof(__m256i);
+    const std::byte* ptr = data.data();
+    size_t i = 0;
+    for (; i + block <= data.size(); i += block)
+    {
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+        const auto* vec = reinterpret_cast<const __m256i*>(ptr + i);
+        // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+        __m256i acc = _mm256_or_si256(
+            _mm256_or_si256(_mm256_loadu_si256(vec),
+                            _mm256_loadu_si256(vec + 1)),
+            _mm256_or_si256(_mm256_loadu_si256(vec + 2),
+                            _mm256_loadu_si256(vec + 3)));
+        if (_mm256_testz_si256(acc, acc) == 0)
+        {
+            break;
+        }
+    }
+    return i + findNonZeroScalar(data.subspan(i));
+}
+
+#endif // ESTORAGED_ZERO_CHECK_X86
+
+#ifdef ESTORAGED_ZERO_CHECK_NEON
+size_t findNonZeroNeon(std::span<const std::byte> data)
+{
+    constexpr size_t block = 4 * sizeof(uint8x16_t);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const auto* ptr = reinterpret_cast<const uint8_t*>(data.data());
+    size_t i = 0;
+    for (; i + block <= data.size(); i += block)
+    {
+        uint8x16_t acc = vorrq_u8(vorrq_u8(vld1q_u8(ptr + i),
+                                           vld1q_u8(ptr + i + 16)),
+                                  vorrq_u8(vld1q_u8(ptr + i + 32),
+                                           vld1q_u8(ptr + i + 48)));
+        uint64x2_t words = vreinterpretq_u64_u8(acc);
+        if ((vgetq_lane_u64(words, 0) | vgetq_lane_u64(words, 1)) != 0)
+        {
+            break;
+        }
+    }
+    return i + findNonZeroScalar(data.subspan(i));
+}
+#endif // ESTORAGED_ZERO_CHECK_NEON
+
+} // namespace
+
+std::vector<ZeroCheckKernel> zeroCheckKernels()
+{
+    std::vector<ZeroCheckKernel> kernels{{"scalar", findNonZeroScalar}};
+#ifdef ESTORAGED_ZERO_CHECK_X86
+#if defined(__SSE2__)
+    kernels.push_back({"sse2", findNonZeroSse2});
+#endif
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels.push_back({"avx2", findNonZeroAvx2});
+    }
+#endif
+#ifdef ESTORAGED_ZERO_CHECK_NEON
+    kernels.push_back({"neon", findNonZeroNeon});
+#endif
+    return kernels;
+}
+
+size_t findNonZero(std::span<const std::byte> data)
+{
+    static const auto find = zeroCheckKernels().back().find;
+    return find(data);
+}
+
+} // namespace estoraged
@@ -0,0 +1,236 @@
+#include "eraseJob.hpp"
+
+#include "badRangeMap.hpp"
+#include "deviceWorker.hpp"
+#include "eraseProgress.hpp"
+
+#include <boost/asio/post.hpp>
+#include <phosphor-logging/lg2.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <chrono>
+#include <exception>
+#include <future>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace estoraged
+{
+
+namespace
+{
+
+const std::string operationStatus =
+    "xyz.openbmc_project.Common.Progress.OperationStatus.";
+
+/* Milliseconds since the epoch, as in Common.Progress */
+uint64_t epochMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+EraseJob::EraseJob(boost::asio::io_context& io,
+                   sdbusplus::asio::object_server& server,
+                   const std::string& objectPath, DeviceWorker& worker,
+                   std::function<void()> resume,
+                   std::function<void()> finished) :
+    io(io), objectServer(server), worker(worker), finished(std::move(finished))
+{
+    progressInterface = objectServer.add_interface(
+        objectPath, "xyz.openbmc_project.Common.Progress");
+    progressInterface->register_property("Status",
+                                         operationStatus + "InProgress");
+    progressInterface->register_property("StartTime", uint64_t{0});
+    progressInterface->register_property("CompletedTime", uint64_t{0});
+
+    jobInterface = objectServer.add_interface(
+        objectPath, "xyz.openbmc_project.eStoraged.EraseJob");
+    jobInterface->register_property("EraseMethod", std::string());
+    jobInterface->register_property("BytesProcessed", uint64_t{0});
+    jobInterface->register_property("TotalBytes", uint64_t{0});
+    jobInterface->register_property("Percent", uint8_t{0});
+    jobInterface->register_property("Throughput", double{0});
+    jobInterface->register_property("EstimatedTimeRemaining", uint64_t{0});
+    jobInterface->register_property("DeviceBusy", false);
+    jobInterface->register_property("EraseSteps", std::string());
+    jobInterface->register_property("EstimatedDuration", uint64_t{0});
+    jobInterface->register_property(
+        "BadRanges", std::vector<std::tuple<uint64_t, uint64_t>>());
+    jobInterface->register_property("BadBytes", uint64_t{0});
+    jobInterface->register_property("BadRangesCoarsened", false);
+    jobInterface->register_property("ReadErrors", uint64_t{0});
+    jobInterface->register_property("WriteErrors", uint64_t{0});
+    jobInterface->register_property("Mismatches", uint64_t{0});
+    jobInterface->register_method("Cancel", [this]() { this->cancel(); });
+    jobInterface->register_method("Resume", std::move(resume));
+
+    progressInterface->initialize();
+    jobInterface->initialize();
+}
+
+EraseJob::~EraseJob()
+{
+    // the erase shares its tracker and map, so it stops at its next chunk
+    // boundary on the worker, without holding the D-Bus thread
+    if (progress)
+    {
+        progress->cancel();
+    }
+    objectServer.remove_interface(progressInterface);
+    objectServer.remove_interface(jobInterface);
+}
+
+void EraseJob::start(const std::string& method, Work work,
+                     size_t badRangeLimit)
+{
+    // the previous erase has published its final status, so it is done
+    if (done.valid())
+    {
+        done.wait();
+    }
+
+    // the erase may wait behind other work on the worker, so it publishes
+    // InProgress and its start time once it runs
+    progressInterface->set_property("StartTime", uint64_t{0});
+    progressInterface->set_property("CompletedTime", uint64_t{0});
+    jobInterface->set_property("EraseMethod", method);
+    publish({});
+    badRanges = std::make_shared<BadRangeMap>(badRangeLimit);
+    publishBadRanges();
+
+    std::weak_ptr<EraseJob> weak = weak_from_this();
+    progress = std::make_shared<EraseProgress>(
+        [&io = io, weak](const EraseProgressStatus& status) {
+            boost::asio::post(io, [weak, status]() {
+                if (std::shared_ptr<EraseJob> job = weak.lock())
+                {
+                    job->publish(status);
+                }
+            });
+        },
+        progressInterval);
+
+    running = true;
+    auto task = std::make_shared<std::packaged_task<void()>>(
+        [&io = io, weak, tracker = progress, ranges = badRanges,
+         work = std::move(work)]() {
+            boost::asio::post(io, [weak, startTime = epochMs()]() {
+                if (std::shared_ptr<EraseJob> job = weak.lock())
+                {
+                    job->started(startTime);
+                }
+            });
+            std::string status = "Completed";
+            try
+            {
+                work(*tracker, *ranges);
+            }
+            catch (const EraseCancelled&)
+            {
+                lg2::info("Erase job cancelled");
+                status = "Aborted";
+            }
+            catch (const std::exception& e)
+            {
+                lg2::error("Erase job failed: {ERROR}", "ERROR", e.what(),
+                           "REDFISH_MESSAGE_ID",
+                           std::string("OpenBMC.0.1.DriveEraseFailure"));
+                status = "Failed";
+            }
+            boost::asio::post(io, [weak, status]() {
+                if (std::shared_ptr<EraseJob> job = weak.lock())
+                {
+                    job->complete(status);
+                }
+            });
+        });
+    done = task->get_future();
+    worker.post([task]() { (*task)(); });
+}
+
+void EraseJob::interrupted(const std::string& method,
+                           const EraseProgressStatus& status)
+{
+    progressInterface->set_property("Status", operationStatus + "Aborted");
+    jobInterface->set_property("EraseMethod", method);
+    publish(status);
+}
+
+void EraseJob::cancel()
+{
+    if (!running)
+    {
+        lg2::info("No erase job to cancel");
+        return;
+    }
+    lg2::info("Cancelling erase job");
+    progress->cancel();
+}
+
+bool EraseJob::isRunning() const
+{
+    return running;
+}
+
+void EraseJob::started(uint64_t startTime)
+{
+    progressInterface->set_property("Status", operationStatus + "InProgress");
+    progressInterface->set_property("StartTime", startTime);
+}
+
+void EraseJob::publish(const EraseProgressStatus& status)
+{
+    jobInterface->set_property("BytesProcessed", status.bytesProcessed);
+    jobInterface->set_property("TotalBytes", status.totalBytes);
+    jobInterface->set_property("Percent", status.percent);
+    jobInterface->set_property("Throughput", status.throughput);
+    jobInterface->set_property("EstimatedTimeRemaining",
+                               status.secondsRemaining);
+    jobInterface->set_property("DeviceBusy", status.deviceBusy);
+    jobInterface->set_property("EraseSteps", status.eraseSteps);
+    jobInterface->set_property("EstimatedDuration", status.estimatedSeconds);
+}
+
+void EraseJob::publishBadRanges()
+{
+    std::vector<std::tuple<uint64_t, uint64_t>> ranges;
+    for (const BadRange& range : badRanges->ranges())
+    {
+        ranges.emplace_back(range.offset, range.length);
+    }
+    jobInterface->set_property("BadRanges", ranges);
+    jobInterface->set_property("BadBytes", badRanges->badBytes());
+    jobInterface->set_property("BadRangesCoarsened", badRanges->coarsened());
+    jobInterface->set_property("ReadErrors",
+                               badRanges->count(BadRangeKind::Read));
+    jobInterface->set_property("WriteErrors",
+                               badRanges->count(BadRangeKind::Write));
+    jobInterface->set_property("Mismatches",
+                               badRanges->count(BadRangeKind::Mismatch));
+}
+
+void EraseJob::complete(const std::string& status)
+{
+    publishBadRanges();
+    progressInterface->set_property("CompletedTime", epochMs());
+    progressInterface->set_property("Status", operationStatus + status);
+    if (status == "Completed")
+    {
+        lg2::info("Erase job completed", "REDFISH_MESSAGE_ID",
+                  std::string("OpenBMC.0.1.DriveEraseSuccess"));
+    }
+    running = false;
+    if (finished)
+    {
+        finished();
+    }
+}
+
+} // namespace estoraged
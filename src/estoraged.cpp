@@ -1,9 +1,19 @@
 
 #include "estoraged.hpp"
 
+#include "badRangeMap.hpp"
+#include "bkopsScheduler.hpp"
 #include "cryptErase.hpp"
 #include "cryptsetupInterface.hpp"
+#include "deviceWorker.hpp"
+#include "eraseCheckpoint.hpp"
+#include "eraseJob.hpp"
+#include "erasePriority.hpp"
+#include "eraseProgress.hpp"
+#include "eraseThrottle.hpp"
 #include "estoraged_conf.hpp"
+#include "extCsd.hpp"
+#include "mmcChannel.hpp"
 #include "pattern.hpp"
 #include "sanitize.hpp"
 #include "verifyDriveGeometry.hpp"
@@ -16,15 +26,23 @@
 #include <openssl/rand.h>
 #include <sys/ioctl.h>
 
+#include <boost/asio/post.hpp>
+#include <boost/asio/spawn.hpp>
 #include <phosphor-logging/lg2.hpp>
 #include <sdbusplus/asio/object_server.hpp>
 #include <stdplus/fd/create.hpp>
 #include <stdplus/fd/managed.hpp>
 #include <xyz/openbmc_project/Common/error.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <exception>
 #include <filesystem>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -36,48 +54,127 @@ namespace estoraged
 using Association = std::tuple<std::string, std::string, std::string>;
 using sdbusplus::asio::PropertyPermission;
 using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+using sdbusplus::xyz::openbmc_project::Common::Error::ResourceNotFound;
+using sdbusplus::xyz::openbmc_project::Common::Error::Unavailable;
 using sdbusplus::xyz::openbmc_project::Common::Error::UnsupportedRequest;
 using sdbusplus::xyz::openbmc_project::Inventory::Item::server::Drive;
 using sdbusplus::xyz::openbmc_project::Inventory::Item::server::Volume;
 const char* fsRecoveryError = "Failed to recover filesystem";
 const char* fsMountError = "Failed to mount filesystem";
+const char* eraseCheckpointDir = "/var/lib/estoraged";
+
+namespace
+{
+
+/* The erase methods that take long, which run as erase jobs */
+bool runsAsJob(Volume::EraseMethod eraseType)
+{
+    switch (eraseType)
+    {
+        case Volume::EraseMethod::LogicalOverWrite:
+        case Volume::EraseMethod::LogicalVerify:
+        case Volume::EraseMethod::VendorSanitize:
+        case Volume::EraseMethod::ZeroOverWrite:
+        case Volume::EraseMethod::ZeroVerify:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Runs a pass of an overwrite or verify engine in an erase job, at the
+ * priority and pace of the options */
+void runPass(Erase& engine, const EraseOptions& options,
+             EraseProgress& progress, BadRangeMap& badRanges,
+             const std::function<void()>& pass)
+{
+    engine.setProgress(&progress);
+    if (options.tolerant)
+    {
+        engine.setBadRanges(&badRanges);
+    }
+    EraseThrottle throttle(options);
+    if (throttle.enabled())
+    {
+        engine.setThrottle(&throttle);
+    }
+    ErasePriority priority(options);
+    pass();
+}
+
+} // namespace
 
 EStoraged::EStoraged(
-    std::unique_ptr<stdplus::Fd> fd, sdbusplus::asio::object_server& server,
-    const std::string& configPath, const std::string& devPath,
-    const std::string& luksName, uint64_t size, uint8_t lifeTime,
-    const std::string& partNumber, const std::string& serialNumber,
-    const std::string& locationCode, uint64_t eraseMaxGeometry,
-    uint64_t eraseMinGeometry, const std::string& driveType,
-    const std::string& driveProtocol,
+    std::unique_ptr<stdplus::Fd> fd, boost::asio::io_context& io,
+    sdbusplus::asio::object_server& server, const std::string& configPath,
+    const std::string& devPath, const std::string& luksName, uint64_t size,
+    uint8_t lifeTime, const std::string& partNumber,
+    const std::string& serialNumber, const std::string& locationCode,
+    uint64_t eraseMaxGeometry, uint64_t eraseMinGeometry,
+    const std::string& driveType, const std::string& driveProtocol,
+    const EraseOptions& eraseOptions,
     std::unique_ptr<CryptsetupInterface> cryptInterface,
     std::unique_ptr<FilesystemInterface> fsInterface) :
     devPath(devPath), containerName(luksName),
     mountPoint("/mnt/" + luksName + "_fs"), eraseMaxGeometry(eraseMaxGeometry),
-    eraseMinGeometry(eraseMinGeometry), cryptIface(std::move(cryptInterface)),
+    eraseMinGeometry(eraseMinGeometry), eraseOptions(eraseOptions),
+    cryptIface(std::move(cryptInterface)),
     fsIface(std::move(fsInterface)),
     cryptDevicePath(cryptIface->cryptGetDir() + "/" + luksName),
-    objectServer(server)
+    io(io), objectServer(server),
+    checkpoint(std::filesystem::path(eraseCheckpointDir) /
+                   (std::filesystem::path(devPath).filename().string() +
+                    ".checkpoint"),
+               devPath)
 {
-    try
+    uint8_t lifeLeft = lifeTime;
+    std::string busMode = "Unknown";
+    if (fd != nullptr)
     {
-        changeHsTimingIfNeeded(fd.get(), devPath, partNumber);
-        lg2::info("Change HS_TIMING for {DEV} with {PARTNUMBER}", "DEV",
-                  devPath, "PARTNUMBER", partNumber);
-    }
-    catch (const HsModeError& e)
-    {
-        lg2::error(e.what());
-    }
+        mmc = std::make_shared<MmcChannel>(
+            devPath, std::make_unique<IOCTLWrapperImpl>(std::move(fd)));
 
-    try
-    {
-        enableBackgroundOperation(std::move(fd), devPath);
-    }
-    catch (const BkopsError& e)
-    {
-        lg2::error("Failed to enable background operation for {PATH}: {ERROR}",
-                   "PATH", devPath, "ERROR", e.what());
+        try
+        {
+            if (eraseOptions.emmcMaxBusMode)
+            {
+                negotiateHsTiming(*mmc, devPath, *eraseOptions.emmcMaxBusMode);
+            }
+            else if (changeHsTimingIfNeeded(*mmc, devPath, partNumber))
+            {
+                lg2::info("Change HS_TIMING for {DEV} with {PARTNUMBER}",
+                          "DEV", devPath, "PARTNUMBER", partNumber);
+            }
+        }
+        catch (const HsModeError& e)
+        {
+            lg2::error(e.what());
+        }
+
+        try
+        {
+            enableBackgroundOperation(*mmc, devPath);
+        }
+        catch (const BkopsError& e)
+        {
+            lg2::error(
+                "Failed to enable background operation for {PATH}: {ERROR}",
+                "PATH", devPath, "ERROR", e.what());
+        }
+
+        checkCache(*mmc, devPath, eraseOptions.emmcCachePolicy);
+
+        // sysfs shows the same EXT_CSD estimates, prefer the cached copy
+        std::optional<ExtCsd> extCsd = mmc->extCsd();
+        if (extCsd && extCsd->lifeLeftPercent() != 255)
+        {
+            lifeLeft = extCsd->lifeLeftPercent();
+        }
+        // read back after the switches above
+        if (extCsd)
+        {
+            busMode = hsTimingName(extCsd->hsTiming());
+        }
     }
 
     /* Get the filename of the device (without "/dev/"). */
@@ -85,26 +182,49 @@ EStoraged::EStoraged(
     /* DBus object path */
     std::string objectPath =
         "/xyz/openbmc_project/inventory/storage/" + deviceName;
+    eraseJobPath = objectPath + "/erase";
 
     /* Add Volume interface. */
     volumeInterface = objectServer.add_interface(
         objectPath, "xyz.openbmc_project.Inventory.Item.Volume");
     volumeInterface->register_method(
-        "FormatLuks", [this](const std::vector<uint8_t>& password,
-                             Volume::FilesystemType type) {
-            this->formatLuks(password, type);
+        "FormatLuks",
+        [this](boost::asio::yield_context yield,
+               const std::vector<uint8_t>& password,
+               Volume::FilesystemType type) {
+            runChangingHeader(yield, [this, &password, type]() {
+                this->formatLuks(password, type);
+            });
+        });
+    volumeInterface->register_method(
+        "Erase", [this](boost::asio::yield_context yield,
+                        Volume::EraseMethod eraseType) {
+            if (runsAsJob(eraseType))
+            {
+                this->erase(eraseType);
+                return;
+            }
+            runChangingHeader(
+                yield, [this, eraseType]() { this->eraseNow(eraseType); });
         });
     volumeInterface->register_method(
-        "Erase",
-        [this](Volume::EraseMethod eraseType) { this->erase(eraseType); });
-    volumeInterface->register_method("Lock", [this]() { this->lock(); });
+        "Lock", [this](boost::asio::yield_context yield) {
+            runOnWorker(yield, [this]() { this->lock(); });
+        });
     volumeInterface->register_method(
-        "Unlock",
-        [this](std::vector<uint8_t>& password) { this->unlock(password); });
+        "Unlock", [this](boost::asio::yield_context yield,
+                         std::vector<uint8_t>& password) {
+            runOnWorker(yield, [this, &password]() {
+                this->unlock(std::move(password));
+            });
+        });
     volumeInterface->register_method(
-        "ChangePassword", [this](const std::vector<uint8_t>& oldPassword,
+        "ChangePassword", [this](boost::asio::yield_context yield,
+                                 const std::vector<uint8_t>& oldPassword,
                                  const std::vector<uint8_t>& newPassword) {
-            this->changePassword(oldPassword, newPassword);
+            runChangingHeader(yield, [this, &oldPassword, &newPassword]() {
+                this->changePassword(oldPassword, newPassword);
+            });
         });
     volumeInterface->register_property_r(
         "Locked", lockedProperty, sdbusplus::vtable::property_::emits_change,
@@ -118,7 +238,7 @@ EStoraged::EStoraged(
         objectPath, "xyz.openbmc_project.Inventory.Item.Drive");
     driveInterface->register_property("Capacity", size);
     /* The lifetime property is read/write only for testing purposes. */
-    driveInterface->register_property("PredictedMediaLifeLeftPercent", lifeTime,
+    driveInterface->register_property("PredictedMediaLifeLeftPercent", lifeLeft,
                                       PropertyPermission::readWrite);
     driveInterface->register_property(
         "Type",
@@ -139,10 +259,24 @@ EStoraged::EStoraged(
         "EncryptionStatus", encryptionStatus,
         sdbusplus::vtable::property_::emits_change,
         [this](Drive::DriveEncryptionState& value) {
-            value = this->findEncryptionStatus();
+            // the header is loaded on the first read, then only reloaded by
+            // the methods that may rewrite it
+            if (encryptionStatus == Drive::DriveEncryptionState::Unknown)
+            {
+                encryptionStatus = this->findEncryptionStatus();
+            }
+            value = encryptionStatus;
             return value;
         });
 
+    if (mmc != nullptr)
+    {
+        emmcInterface = objectServer.add_interface(
+            objectPath, "xyz.openbmc_project.eStoraged.Emmc");
+        emmcInterface->register_property("BusMode", busMode);
+        emmcInterface->initialize();
+    }
+
     embeddedLocationInterface = objectServer.add_interface(
         objectPath, "xyz.openbmc_project.Inventory.Connector.Embedded");
 
@@ -174,12 +308,93 @@ EStoraged::EStoraged(
                               std::filesystem::path(configPath).parent_path());
     association->register_property("Associations", associations);
     association->initialize();
+
+    startBkopsScheduler(objectPath);
+
+    /* Offer to resume an overwrite that a restart interrupted. */
+    if (std::optional<CheckpointData> data = checkpoint.load())
+    {
+        lg2::info("Erase {METHOD} of {DEV} was interrupted at {OFFSET}",
+                  "METHOD", data->method, "DEV", devPath, "OFFSET",
+                  data->offset);
+        EraseProgressStatus status;
+        status.bytesProcessed = data->offset;
+        status.totalBytes = data->driveSize;
+        status.percent = data->driveSize == 0
+                             ? 0
+                             : static_cast<uint8_t>(data->offset * 100 /
+                                                    data->driveSize);
+        getEraseJob().interrupted(data->method, status);
+    }
+}
+
+void EStoraged::startBkopsScheduler(const std::string& objectPath)
+{
+    if (mmc == nullptr || eraseOptions.bkopsPollInterval == 0)
+    {
+        return;
+    }
+    std::optional<ExtCsd> extCsd = mmc->extCsd();
+    // in auto mode, the device runs the operations when it is idle itself
+    if (!extCsd || !extCsd->bkopsSupported() ||
+        (extCsd->bkopsEnabled() & EXT_CSD_MANUAL_BKOPS_MASK) == 0 ||
+        (extCsd->bkopsEnabled() & EXT_CSD_AUTO_BKOPS_MASK) != 0)
+    {
+        return;
+    }
+
+    std::filesystem::path statPath = std::filesystem::path("/sys/block") /
+                                     std::filesystem::path(devPath).filename() /
+                                     "stat";
+    bkopsScheduler = std::make_shared<BkopsScheduler>(
+        io, objectServer, objectPath, worker, mmc, statPath,
+        std::chrono::seconds(eraseOptions.bkopsPollInterval),
+        std::chrono::seconds(eraseOptions.bkopsIdleTime));
+    bkopsScheduler->start();
 }
 
 EStoraged::~EStoraged()
 {
+    // stop the erase and the queued operations first, so the final flush
+    // runs once nothing else writes to the device. A sanitize or an erase
+    // command can not be cancelled, and waiting for it would outlast the
+    // stop timeout of systemd. The erase only uses copies of the members,
+    // so it may be left running.
+    bool stopped = true;
+    if (eraseJob && eraseJob->isRunning())
+    {
+        eraseJob->cancel();
+        stopped = worker.stop(workerStopTimeout);
+    }
+    else
+    {
+        worker.stop();
+    }
+    if (!stopped)
+    {
+        lg2::warning("Device {DEV} is still busy with a command, not "
+                     "flushing its cache",
+                     "DEV", devPath);
+    }
+
+    if (stopped && mmc != nullptr)
+    {
+        try
+        {
+            flushCache(*mmc, devPath);
+        }
+        catch (const CacheError& e)
+        {
+            lg2::error(e.what());
+        }
+    }
+
     objectServer.remove_interface(volumeInterface);
     objectServer.remove_interface(driveInterface);
+    if (emmcInterface != nullptr)
+    {
+        objectServer.remove_interface(emmcInterface);
+    }
     objectServer.remove_interface(embeddedLocationInterface);
     objectServer.remove_interface(assetInterface);
     objectServer.remove_interface(association);
@@ -212,51 +427,103 @@ void EStoraged::formatLuks(const std::vector<uint8_t>& password,
 
 void EStoraged::erase(Volume::EraseMethod inEraseMethod)
 {
+    if (eraseJob && eraseJob->isRunning())
+    {
+        lg2::error("An erase is already running on {DEV}", "DEV", devPath,
+                   "REDFISH_MESSAGE_ID",
+                   std::string("OpenBMC.0.1.DriveEraseFailure"));
+        throw Unavailable();
+    }
+
+    if (!runsAsJob(inEraseMethod))
+    {
+        eraseNow(inEraseMethod);
+        return;
+    }
+
     std::cerr << "Erasing encrypted eMMC" << std::endl;
     lg2::info("Starting erase", "REDFISH_MESSAGE_ID",
               std::string("OpenBMC.0.1.DriveErase"));
     switch (inEraseMethod)
     {
-        case Volume::EraseMethod::CryptoErase:
+        case Volume::EraseMethod::LogicalOverWrite:
         {
-            CryptErase myCryptErase(devPath);
-            myCryptErase.doErase();
+            startOverwriteJob(inEraseMethod, eraseOptions, 0);
             break;
         }
-        case Volume::EraseMethod::VerifyGeometry:
+        case Volume::EraseMethod::LogicalVerify:
         {
-            VerifyDriveGeometry myVerifyGeometry(devPath);
-            myVerifyGeometry.geometryOkay(eraseMaxGeometry, eraseMinGeometry);
+            startEraseJob(inEraseMethod,
+                          [devPath = devPath, options = eraseOptions](
+                              EraseProgress& progress, BadRangeMap& badRanges) {
+                Pattern myErasePattern(devPath, options);
+                runPass(myErasePattern, options, progress, badRanges,
+                        [&myErasePattern]() {
+                    myErasePattern.verifyPattern();
+                });
+            });
             break;
         }
-        case Volume::EraseMethod::LogicalOverWrite:
+        case Volume::EraseMethod::VendorSanitize:
         {
-            Pattern myErasePattern(devPath);
-            myErasePattern.writePattern();
+            // the erase chunks report progress, but can not be resumed
+            checkpoint.remove();
+            startEraseJob(inEraseMethod,
+                          [devPath = devPath, mmc = mmc,
+                           options = eraseOptions](EraseProgress& progress,
+                                                   BadRangeMap&) {
+                std::unique_ptr<Sanitize> mySanitize =
+                    mmc ? std::make_unique<Sanitize>(mmc)
+                        : std::make_unique<Sanitize>(devPath);
+                mySanitize->setProgress(&progress);
+                mySanitize->setPolicy(options.emmcErasePolicy);
+                if (options.sanitizePolling)
+                {
+                    mySanitize->setStatusPolling(
+                        std::chrono::seconds(options.sanitizeTimeout));
+                }
+                mySanitize->doSanitize();
+            });
             break;
         }
-        case Volume::EraseMethod::LogicalVerify:
+        case Volume::EraseMethod::ZeroOverWrite:
         {
-            Pattern myErasePattern(devPath);
-            myErasePattern.verifyPattern();
+            startOverwriteJob(inEraseMethod, eraseOptions, 0);
             break;
         }
-        case Volume::EraseMethod::VendorSanitize:
+        case Volume::EraseMethod::ZeroVerify:
         {
-            Sanitize mySanitize(devPath);
-            mySanitize.doSanitize();
+            startEraseJob(inEraseMethod,
+                          [devPath = devPath, options = eraseOptions](
+                              EraseProgress& progress, BadRangeMap& badRanges) {
+                Zero myZero(devPath, options);
+                runPass(myZero, options, progress, badRanges,
+                        [&myZero]() { myZero.verifyZero(); });
+            });
             break;
         }
-        case Volume::EraseMethod::ZeroOverWrite:
+        default:
+            break;
+    }
+}
+
+void EStoraged::eraseNow(Volume::EraseMethod inEraseMethod)
+{
+    lg2::info("Starting erase", "REDFISH_MESSAGE_ID",
+              std::string("OpenBMC.0.1.DriveErase"));
+    switch (inEraseMethod)
+    {
+        case Volume::EraseMethod::CryptoErase:
         {
-            Zero myZero(devPath);
-            myZero.writeZero();
+            checkpoint.remove();
+            CryptErase myCryptErase(devPath);
+            myCryptErase.doErase();
             break;
         }
-        case Volume::EraseMethod::ZeroVerify:
+        case Volume::EraseMethod::VerifyGeometry:
         {
-            Zero myZero(devPath);
-            myZero.verifyZero();
+            VerifyDriveGeometry myVerifyGeometry(devPath);
+            myVerifyGeometry.geometryOkay(eraseMaxGeometry, eraseMinGeometry);
             break;
         }
         case Volume::EraseMethod::SecuredLocked:
@@ -269,7 +536,197 @@ void EStoraged::erase(Volume::EraseMethod inEraseMethod)
             // Until that is done, we can lock using eStoraged::lock()
             break;
         }
+        default:
+            break;
+    }
+}
+
+void EStoraged::resumeErase()
+{
+    if (eraseJob && eraseJob->isRunning())
+    {
+        lg2::error("An erase is already running on {DEV}", "DEV", devPath,
+                   "REDFISH_MESSAGE_ID",
+                   std::string("OpenBMC.0.1.DriveEraseFailure"));
+        throw Unavailable();
+    }
+
+    std::optional<CheckpointData> data = checkpoint.load();
+    if (!data)
+    {
+        lg2::error("No erase to resume on {DEV}", "DEV", devPath,
+                   "REDFISH_MESSAGE_ID",
+                   std::string("OpenBMC.0.1.DriveEraseFailure"));
+        throw ResourceNotFound();
+    }
+
+    /* The checkpoint only holds for the same pattern on the same drive. */
+    Volume::EraseMethod method = Volume::EraseMethod::ZeroOverWrite;
+    bool valid = data->method == Volume::convertEraseMethodToString(method);
+    if (data->method == Volume::convertEraseMethodToString(
+                            Volume::EraseMethod::LogicalOverWrite))
+    {
+        method = Volume::EraseMethod::LogicalOverWrite;
+        valid = data->seed == Pattern::seed;
+    }
+    if (!valid || data->driveSize != util::findSizeOfBlockDevice(devPath))
+    {
+        lg2::error("Erase checkpoint does not match {DEV}", "DEV", devPath,
+                   "REDFISH_MESSAGE_ID",
+                   std::string("OpenBMC.0.1.DriveEraseFailure"));
+        throw ResourceNotFound();
+    }
+
+    lg2::info("Resuming erase {METHOD} of {DEV} at {OFFSET}", "METHOD",
+              data->method, "DEV", devPath, "OFFSET", data->offset,
+              "REDFISH_MESSAGE_ID", std::string("OpenBMC.0.1.DriveErase"));
+    EraseOptions options = eraseOptions;
+    options.patternType = data->patternType;
+    startOverwriteJob(method, options, data->offset);
+}
+
+void EStoraged::runOnWorker(boost::asio::yield_context yield,
+                            const std::function<void()>& operation)
+{
+    if (eraseJob && eraseJob->isRunning())
+    {
+        lg2::error("Device {DEV} is busy with an erase", "DEV", devPath);
+        throw Unavailable();
+    }
+    worker.run(yield, operation);
+}
+
+void EStoraged::runChangingHeader(boost::asio::yield_context yield,
+                                  const std::function<void()>& operation)
+{
+    Drive::DriveEncryptionState status = encryptionStatus;
+    std::exception_ptr error;
+    runOnWorker(yield, [this, &operation, &status, &error]() {
+        try
+        {
+            operation();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        // a failed format may have written the header already
+        status = findEncryptionStatus();
+    });
+    setEncryptionStatus(status);
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void EStoraged::setEncryptionStatus(Drive::DriveEncryptionState status)
+{
+    if (status == encryptionStatus)
+    {
+        return;
     }
+    encryptionStatus = status;
+    driveInterface->signal_property("EncryptionStatus");
+}
+
+void EStoraged::reloadEncryptionStatus()
+{
+    // the queued tasks never run once the worker stopped, but the reply to
+    // io may arrive after this object is gone, and the job goes with it
+    std::weak_ptr<EraseJob> job = eraseJob;
+    worker.post([this, job]() {
+        Drive::DriveEncryptionState status = findEncryptionStatus();
+        boost::asio::post(io, [this, job, status]() {
+            if (!job.expired())
+            {
+                setEncryptionStatus(status);
+            }
+        });
+    });
+}
+
+EraseJob& EStoraged::getEraseJob()
+{
+    if (!eraseJob)
+    {
+        // an overwrite or sanitize destroys the header, even when it stops
+        // early, so it is reloaded once the job is done
+        eraseJob = std::make_shared<EraseJob>(
+            io, objectServer, eraseJobPath, worker, [this]() { resumeErase(); },
+            [this]() { reloadEncryptionStatus(); });
+    }
+    return *eraseJob;
+}
+
+void EStoraged::startEraseJob(Volume::EraseMethod eraseType,
+                              EraseJob::Work work)
+{
+    getEraseJob().start(Volume::convertEraseMethodToString(eraseType),
+                        std::move(work), eraseOptions.badRangeLimit);
+}
+
+void EStoraged::startOverwriteJob(Volume::EraseMethod eraseType,
+                                  const EraseOptions& options,
+                                  uint64_t startOffset)
+{
+    // a new overwrite invalidates the progress of an older one
+    if (startOffset == 0)
+    {
+        checkpoint.remove();
+    }
+
+    CheckpointData data;
+    data.method = Volume::convertEraseMethodToString(eraseType);
+    data.patternType = options.patternType;
+    data.seed =
+        eraseType == Volume::EraseMethod::LogicalOverWrite ? Pattern::seed : 0;
+
+    startEraseJob(eraseType, [eraseType, devPath = devPath, options, data,
+                              checkpoint = checkpoint,
+                              startOffset](EraseProgress& progress,
+                                           BadRangeMap& badRanges) mutable {
+        data.driveSize = util::findSizeOfBlockDevice(devPath);
+        progress.setCheckpoint(
+            [checkpoint, data](uint64_t offset) mutable {
+                data.offset = offset;
+                checkpoint.save(data);
+            },
+            EraseCheckpoint::interval);
+        try
+        {
+            if (eraseType == Volume::EraseMethod::LogicalOverWrite)
+            {
+                Pattern myErasePattern(devPath, options);
+                myErasePattern.setStartOffset(startOffset);
+                runPass(myErasePattern, options, progress, badRanges,
+                        [&myErasePattern]() { myErasePattern.writePattern(); });
+            }
+            else
+            {
+                Zero myZero(devPath, options);
+                myZero.setStartOffset(startOffset);
+                runPass(myZero, options, progress, badRanges,
+                        [&myZero]() { myZero.writeZero(); });
+            }
+        }
+        catch (...)
+        {
+            // cancelled or failed, keep what is done for a resume, unless
+            // a tolerant pass got to the end and failed on its bad ranges
+            data.offset = std::max(startOffset, progress.bytesProcessed());
+            if (data.offset < data.driveSize)
+            {
+                checkpoint.save(data);
+            }
+            else
+            {
+                checkpoint.remove();
+            }
+            throw;
+        }
+        checkpoint.remove();
+    });
 }
 
 void EStoraged::lock()
@@ -279,6 +736,21 @@ void EStoraged::lock()
 
     unmountFilesystem();
     deactivateLuksDev();
+
+    // the writes of the volume may still sit in the eMMC cache
+    if (mmc != nullptr)
+    {
+        try
+        {
+            flushCache(*mmc, devPath);
+        }
+        catch (const CacheError& e)
+        {
+            lg2::error(e.what(), "REDFISH_MESSAGE_ID",
+                       std::string("OpenBMC.0.1.DriveLockFail"));
+            throw InternalFailure();
+        }
+    }
 }
 
 void EStoraged::unlock(std::vector<uint8_t> password)
@@ -592,47 +1064,42 @@ std::string_view EStoraged::getCryptDevicePath() const
 bool EStoraged::enableBackgroundOperation(std::unique_ptr<stdplus::Fd> fd,
                                           std::string_view devPath)
 {
-    struct mmc_ioc_cmd idata{};
-    memset(&idata, 0, sizeof(idata));
-    // Extended Device Specific Data. Contains information about the Device
-    // capabilities and selected modes.
-    std::array<uint8_t, /*EXT_CSD*/ 512> extCsd{};
-    idata.write_flag = 0;
-    idata.opcode = MMC_SEND_EXT_CSD;
-    idata.arg = 0;
-    idata.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
-    idata.blksz = extCsd.size();
-    idata.blocks = 1;
-    mmc_ioc_cmd_set_data(idata, extCsd.data());
-    if (fd->ioctl(MMC_IOC_CMD, &idata) != 0)
+    MmcChannel mmc(devPath, std::make_unique<IOCTLWrapperImpl>(std::move(fd)));
+    return enableBackgroundOperation(mmc, devPath);
+}
+
+bool EStoraged::enableBackgroundOperation(MmcChannel& mmc,
+                                          std::string_view devPath)
+{
+    std::optional<ExtCsd> extCsd = mmc.extCsd();
+    if (!extCsd)
     {
         throw BkopsIoctlFailure(devPath,
                                 "Failed to get Extended Device Specific Data");
     }
 
-    if ((extCsd[EXT_CSD_BKOPS_SUPPORT] & 0x1) == 0)
+    if (!extCsd->bkopsSupported())
     {
         lg2::info("BKOPS is not supported for {DEV}", "DEV", devPath);
         return false;
     }
     lg2::info("BKOPS is supported for {DEV}", "DEV", devPath);
 
-    if ((extCsd[EXT_CSD_BKOPS_EN] &
+    if ((extCsd->bkopsEnabled() &
          (EXT_CSD_MANUAL_BKOPS_MASK | EXT_CSD_AUTO_BKOPS_MASK)) != 0)
     {
         lg2::info("BKOPS is already enabled for {DEV}: Mode: {MODE}", "DEV",
-                  devPath, "MODE", extCsd[EXT_CSD_BKOPS_EN]);
+                  devPath, "MODE", extCsd->bkopsEnabled());
         return false;
     }
 
-    // Clear the input data.
-    memset(&idata, 0, sizeof(idata));
+    struct mmc_ioc_cmd idata = {};
     idata.write_flag = 1;
     idata.opcode = MMC_SWITCH;
     idata.arg = (MMC_SWITCH_MODE_WRITE_BYTE << 24) | (EXT_CSD_BKOPS_EN << 16) |
                 (EXT_CSD_MANUAL_BKOPS_MASK << 8) | EXT_CSD_CMD_SET_NORMAL;
     idata.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
-    if (fd->ioctl(MMC_IOC_CMD, &idata) != 0)
+    if (mmc.command(idata) != 0)
     {
         throw BkopsEnableFailure(devPath);
     }
@@ -647,13 +1114,19 @@ bool EStoraged::changeHsTiming(stdplus::Fd* fd, std::string_view devPath)
     {
         return false;
     }
+    MmcChannel mmc(devPath, std::make_unique<IOCTLWrapperImpl>(*fd));
+    return changeHsTiming(mmc, devPath);
+}
+
+bool EStoraged::changeHsTiming(MmcChannel& mmc, std::string_view devPath)
+{
     struct mmc_ioc_cmd cmd = {};
     cmd.write_flag = 1;
     cmd.opcode = MMC_SWITCH;
     cmd.arg = (MMC_SWITCH_MODE_WRITE_BYTE << 24) | (EXT_CSD_HS_TIMING << 16) |
               (EXT_CSD_TIMING_HS400 << 8);
     cmd.flags = MMC_RSP_R1B | MMC_CMD_AC;
-    if (fd->ioctl(MMC_IOC_CMD, &cmd) != 0)
+    if (mmc.command(cmd) != 0)
     {
         throw HsModeError(devPath);
     }
@@ -674,4 +1147,109 @@ bool EStoraged::changeHsTimingIfNeeded(
     return false;
 }
 
+bool EStoraged::changeHsTimingIfNeeded(MmcChannel& mmc,
+                                       std::string_view devPath,
+                                       std::string_view partNumber)
+{
+    if (std::ranges::contains(highSpeedMMC, partNumber))
+    {
+        return changeHsTiming(mmc, devPath);
+    }
+    return false;
+}
+
+HsTiming EStoraged::negotiateHsTiming(MmcChannel& mmc,
+                                      std::string_view devPath,
+                                      HsTiming hostMax)
+{
+    std::optional<ExtCsd> extCsd = mmc.extCsd();
+    if (!extCsd)
+    {
+        throw HsModeError(devPath);
+    }
+    HsTiming current = extCsd->hsTiming();
+    HsTiming fastest = fastestHsTiming(extCsd->deviceType(), hostMax);
+    if (fastest <= current)
+    {
+        lg2::info("{DEV} keeps bus mode {MODE}", "DEV", devPath, "MODE",
+                  hsTimingName(current));
+        return current;
+    }
+
+    // keep the driver strength in the high nibble
+    uint8_t value = (extCsd->byte(extcsd::hsTiming) & 0xF0) |
+                    static_cast<uint8_t>(fastest);
+    struct mmc_ioc_cmd cmd = {};
+    cmd.write_flag = 1;
+    cmd.opcode = MMC_SWITCH;
+    cmd.arg = (MMC_SWITCH_MODE_WRITE_BYTE << 24) | (EXT_CSD_HS_TIMING << 16) |
+              (value << 8);
+    cmd.flags = MMC_RSP_R1B | MMC_CMD_AC;
+    if (mmc.command(cmd) != 0)
+    {
+        throw HsModeError(devPath);
+    }
+
+    // the SWITCH dropped the cached copy, this reads what the device took
+    extCsd = mmc.extCsd();
+    if (!extCsd || extCsd->hsTiming() != fastest)
+    {
+        throw HsModeError(devPath);
+    }
+    lg2::info("{DEV} switched from bus mode {OLD} to {MODE}", "DEV", devPath,
+              "OLD", hsTimingName(current), "MODE", hsTimingName(fastest));
+    return fastest;
+}
+
+bool EStoraged::checkCache(MmcChannel& mmc, std::string_view devPath,
+                           EmmcCachePolicy policy)
+{
+    std::optional<ExtCsd> extCsd = mmc.extCsd();
+    bool enabled = false;
+    if (!extCsd || extCsd->cacheSize() == 0)
+    {
+        lg2::info("{DEV} has no volatile cache", "DEV", devPath);
+    }
+    else
+    {
+        enabled = extCsd->cacheEnabled();
+        lg2::info("{DEV} has a {SIZE} byte volatile cache, enabled: {ENABLED}",
+                  "DEV", devPath, "SIZE", extCsd->cacheSize(), "ENABLED",
+                  enabled);
+    }
+
+    if (policy == EmmcCachePolicy::Keep ||
+        enabled == (policy == EmmcCachePolicy::Enable))
+    {
+        return true;
+    }
+    lg2::warning("The cache of {DEV} is not in the state of the "
+                 "EmmcCachePolicy, enabled: {ENABLED}",
+                 "DEV", devPath, "ENABLED", enabled);
+    return false;
+}
+
+bool EStoraged::flushCache(MmcChannel& mmc, std::string_view devPath)
+{
+    std::optional<ExtCsd> extCsd = mmc.extCsd();
+    if (!extCsd || extCsd->cacheSize() == 0 || !extCsd->cacheEnabled())
+    {
+        return false;
+    }
+
+    struct mmc_ioc_cmd idata = {};
+    idata.write_flag = 1;
+    idata.opcode = MMC_SWITCH;
+    idata.arg = (MMC_SWITCH_MODE_WRITE_BYTE << 24) |
+                (EXT_CSD_FLUSH_CACHE << 16) | (1 << 8) |
+                EXT_CSD_CMD_SET_NORMAL;
+    idata.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+    idata.cmd_timeout_ms = cacheFlushTimeoutMs;
+    if (mmc.command(idata) != 0)
+    {
+        throw CacheFlushFailure(devPath);
+    }
+    return true;
+}
+
 } // namespace estoraged
@@ -1,10 +1,13 @@
 
 #include "estoraged.hpp"
+#include "estoraged_conf.hpp"
 #include "getConfig.hpp"
+#include "partProfile.hpp"
 #include "util.hpp"
 
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/post.hpp>
+#include <boost/asio/signal_set.hpp>
 #include <boost/asio/steady_timer.hpp>
 #include <boost/container/flat_map.hpp>
 #include <boost/container/throw_exception.hpp>
@@ -15,6 +18,7 @@
 #include <sdbusplus/bus/match.hpp>
 #include <util.hpp>
 
+#include <csignal>
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
@@ -32,14 +36,15 @@
  * more types of storage devices.
  */
 void createStorageObjects(
-    sdbusplus::asio::object_server& objectServer,
+    boost::asio::io_context& io, sdbusplus::asio::object_server& objectServer,
     boost::container::flat_map<
         std::string, std::unique_ptr<estoraged::EStoraged>>& storageObjects,
-    std::shared_ptr<sdbusplus::asio::connection>& dbusConnection)
+    std::shared_ptr<sdbusplus::asio::connection>& dbusConnection,
+    const estoraged::PartProfileTable& profiles)
 {
     auto getter = std::make_shared<estoraged::GetStorageConfiguration>(
         dbusConnection,
-        [&objectServer, &storageObjects](
+        [&io, &objectServer, &storageObjects, &profiles](
             const estoraged::ManagedStorageType& storageConfigurations) {
             size_t numConfigObj = storageConfigurations.size();
             if (numConfigObj > 1)
@@ -72,7 +77,7 @@ void createStorageObjects(
                 /* Look for the device file. */
                 const std::filesystem::path blockDevDir{"/sys/block"};
                 auto deviceInfo =
-                    estoraged::util::findDevice(data, blockDevDir);
+                    estoraged::util::findDevice(data, blockDevDir, profiles);
                 if (!deviceInfo)
                 {
                     lg2::error(
@@ -124,10 +129,10 @@ void createStorageObjects(
                 }
 
                 storageObjects[path] = std::make_unique<estoraged::EStoraged>(
-                    std::move(fd), objectServer, path, deviceFile, luksName,
-                    size, lifeleft, partNumber, serialNumber, locationCode,
-                    eraseMaxGeometry, eraseMinGeometry, driveType,
-                    driveProtocol);
+                    std::move(fd), io, objectServer, path, deviceFile,
+                    luksName, size, lifeleft, partNumber, serialNumber,
+                    locationCode, eraseMaxGeometry, eraseMinGeometry,
+                    driveType, driveProtocol, deviceInfo->eraseOptions);
                 lg2::info("Created eStoraged object for path {PATH}", "PATH",
                           path, "REDFISH_MESSAGE_ID",
                           std::string("OpenBMC.0.1.CreateStorageObjects"));
@@ -150,8 +155,12 @@ int main(void)
                                    std::unique_ptr<estoraged::EStoraged>>
             storageObjects;
 
+        /* The tuning profiles of the eMMC parts, read once. */
+        const estoraged::PartProfileTable profiles =
+            estoraged::PartProfileTable::load(PART_PROFILES_PATH);
+
         boost::asio::post(io, [&]() {
-            createStorageObjects(server, storageObjects, conn);
+            createStorageObjects(io, server, storageObjects, conn, profiles);
         });
 
         /*
@@ -186,7 +195,8 @@ int main(void)
                             lg2::error("timer error");
                             return;
                         }
-                        createStorageObjects(server, storageObjects, conn);
+                        createStorageObjects(io, server, storageObjects, conn,
+                                             profiles);
                     });
             };
 
@@ -197,6 +207,21 @@ int main(void)
                 "',arg0namespace='" + estoraged::emmcConfigInterface + "'",
             eventHandler);
 
+        /*
+         * Stop on SIGTERM, so the storage objects are destroyed and flush
+         * the device caches before the service exits.
+         */
+        boost::asio::signal_set signals(io, SIGINT, SIGTERM);
+        signals.async_wait(
+            [&io](const boost::system::error_code& ec, int signal) {
+                if (ec)
+                {
+                    return;
+                }
+                lg2::info("Stopping on signal {SIGNAL}", "SIGNAL", signal);
+                io.stop();
+            });
+
         lg2::info("Storage management service is running", "REDFISH_MESSAGE_ID",
                   std::string("OpenBMC.1.0.ServiceStarted"));
 
@@ -0,0 +1,223 @@
+#include "partProfile.hpp"
+
+#include "eraseOptions.hpp"
+#include "extCsd.hpp"
+
+#include <nlohmann/json.hpp>
+#include <phosphor-logging/lg2.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+namespace estoraged
+{
+
+namespace
+{
+
+/** @brief Reads an unsigned value of a profile, nullopt if it is missing or
+ *  not a number.
+ */
+std::optional<uint64_t> readUnsigned(const nlohmann::json& profile,
+                                     const char* key)
+{
+    auto it = profile.find(key);
+    if (it == profile.end())
+    {
+        return std::nullopt;
+    }
+    if (!it->is_number_unsigned())
+    {
+        lg2::error("Part profile {KEY} is not an unsigned number", "KEY",
+                   key);
+        return std::nullopt;
+    }
+    return it->get<uint64_t>();
+}
+
+/** @brief Reads a string value of a profile, nullopt if it is missing or
+ *  not a string.
+ */
+std::optional<std::string> readString(const nlohmann::json& profile,
+                                      const char* key)
+{
+    auto it = profile.find(key);
+    if (it == profile.end())
+    {
+        return std::nullopt;
+    }
+    if (!it->is_string())
+    {
+        lg2::error("Part profile {KEY} is not a string", "KEY", key);
+        return std::nullopt;
+    }
+    return it->get<std::string>();
+}
+
+std::optional<HsTiming> parseBusMode(const std::string& mode)
+{
+    for (HsTiming timing : {HsTiming::Legacy, HsTiming::HighSpeed,
+                            HsTiming::Hs200, HsTiming::Hs400})
+    {
+        if (mode == hsTimingName(timing))
+        {
+            return timing;
+        }
+    }
+    lg2::error("Unsupported eMMC bus mode {MODE} in part profile", "MODE",
+               mode);
+    return std::nullopt;
+}
+
+std::optional<EmmcCachePolicy> parseCachePolicy(const std::string& policy)
+{
+    if (policy == "Keep")
+    {
+        return EmmcCachePolicy::Keep;
+    }
+    if (policy == "Enable")
+    {
+        return EmmcCachePolicy::Enable;
+    }
+    if (policy == "Disable")
+    {
+        return EmmcCachePolicy::Disable;
+    }
+    lg2::error("Unsupported eMMC cache policy {POLICY} in part profile",
+               "POLICY", policy);
+    return std::nullopt;
+}
+
+} // namespace
+
+void PartProfile::apply(EraseOptions& options) const
+{
+    if (emmcMaxBusMode)
+    {
+        options.emmcMaxBusMode = emmcMaxBusMode;
+    }
+    options.chunkSize = chunkSize.value_or(options.chunkSize);
+    options.queueDepth = queueDepth.value_or(options.queueDepth);
+    options.bkopsPollInterval =
+        bkopsPollInterval.value_or(options.bkopsPollInterval);
+    options.bkopsIdleTime = bkopsIdleTime.value_or(options.bkopsIdleTime);
+    options.emmcCachePolicy =
+        emmcCachePolicy.value_or(options.emmcCachePolicy);
+}
+
+PartProfileTable PartProfileTable::parse(std::string_view json)
+{
+    PartProfileTable table;
+    nlohmann::json root = nlohmann::json::parse(json, nullptr, false);
+    if (root.is_discarded() || !root.is_object())
+    {
+        lg2::error("Part profiles are not a valid JSON object");
+        return table;
+    }
+    auto profiles = root.find("Profiles");
+    if (profiles == root.end() || !profiles->is_array())
+    {
+        lg2::error("Part profiles have no Profiles array");
+        return table;
+    }
+
+    for (const nlohmann::json& profile : *profiles)
+    {
+        std::optional<std::string> name;
+        if (profile.is_object())
+        {
+            name = readString(profile, "Name");
+        }
+        if (!name)
+        {
+            lg2::error("Skipping a part profile without a Name");
+            continue;
+        }
+
+        Entry entry;
+        entry.name = std::move(*name);
+        entry.manufacturer = readString(profile, "Manufacturer").value_or("");
+        PartProfile& part = entry.profile;
+        if (std::optional<std::string> mode =
+                readString(profile, "EmmcMaxBusMode"))
+        {
+            part.emmcMaxBusMode = parseBusMode(*mode);
+        }
+        part.chunkSize = readUnsigned(profile, "EraseChunkSize");
+        part.queueDepth = readUnsigned(profile, "EraseQueueDepth");
+        part.bkopsPollInterval = readUnsigned(profile, "BkopsPollInterval");
+        part.bkopsIdleTime = readUnsigned(profile, "BkopsIdleTime");
+        if (std::optional<std::string> policy =
+                readString(profile, "EmmcCachePolicy"))
+        {
+            part.emmcCachePolicy = parseCachePolicy(*policy);
+        }
+        part.eraseMaxGeometry = readUnsigned(profile, "EraseMaxGeometry");
+        part.eraseMinGeometry = readUnsigned(profile, "EraseMinGeometry");
+        table.entries.push_back(std::move(entry));
+    }
+
+    // the first of two profiles for the same part wins
+    std::ranges::stable_sort(table.entries, {}, [](const Entry& entry) {
+        return std::tie(entry.name, entry.manufacturer);
+    });
+    auto duplicates = std::ranges::unique(
+        table.entries, {}, [](const Entry& entry) {
+            return std::tie(entry.name, entry.manufacturer);
+        });
+    if (!duplicates.empty())
+    {
+        lg2::error("Ignoring {COUNT} duplicate part profiles", "COUNT",
+                   duplicates.size());
+    }
+    table.entries.erase(duplicates.begin(), duplicates.end());
+    table.entries.shrink_to_fit();
+    return table;
+}
+
+PartProfileTable PartProfileTable::load(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        lg2::info("No part profiles at {PATH}", "PATH", path);
+        return {};
+    }
+    std::string text((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+    PartProfileTable table = parse(text);
+    lg2::info("Loaded {COUNT} part profiles from {PATH}", "COUNT",
+              table.size(), "PATH", path);
+    return table;
+}
+
+const PartProfile* PartProfileTable::find(std::string_view manufacturer,
+                                          std::string_view name) const
+{
+    auto [first, last] = std::ranges::equal_range(
+        entries, name, {}, [](const Entry& entry) -> std::string_view {
+            return entry.name;
+        });
+    const PartProfile* anyManufacturer = nullptr;
+    for (auto it = first; it != last; it++)
+    {
+        if (it->manufacturer == manufacturer)
+        {
+            return &it->profile;
+        }
+        if (it->manufacturer.empty())
+        {
+            anyManufacturer = &it->profile;
+        }
+    }
+    return anyManufacturer;
+}
+
+} // namespace estoraged
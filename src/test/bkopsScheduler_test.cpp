@@ -0,0 +1,203 @@
+#include "bkopsScheduler.hpp"
+#include "deviceWorker.hpp"
+#include "extCsd.hpp"
+#include "mmcChannel.hpp"
+
+#include <linux/mmc/core.h>
+#include <linux/mmc/ioctl.h>
+#include <linux/mmc/mmc.h>
+
+#include <boost/asio/io_context.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+#include <stdplus/fd/gmock.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <optional>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::BkopsScheduler;
+using estoraged::BkopsStatus;
+using estoraged::BlockStat;
+using estoraged::DeviceWorker;
+using estoraged::IdleDetector;
+using estoraged::IOCTLWrapperImpl;
+using estoraged::MmcChannel;
+using stdplus::fd::FdMock;
+using ::testing::_;
+using ::testing::Invoke;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+TEST(bkopsScheduler, parseBlockStat)
+{
+    /* kernel 5.5 and later, with discard and flush counters */
+    std::optional<BlockStat> stat = estoraged::parseBlockStat(
+        "    1200      30   45000     600      800      20   64000    "
+        "1500        2     900    2100       40       0    8000      60"
+        "        5      10\n");
+    ASSERT_TRUE(stat);
+    EXPECT_EQ(1200U + 800U + 40U, stat->ios);
+    EXPECT_EQ(2U, stat->inFlight);
+
+    /* older kernels without discard counters */
+    stat = estoraged::parseBlockStat(
+        "1200 30 45000 600 800 20 64000 1500 0 900 2100\n");
+    ASSERT_TRUE(stat);
+    EXPECT_EQ(2000U, stat->ios);
+    EXPECT_EQ(0U, stat->inFlight);
+
+    EXPECT_FALSE(estoraged::parseBlockStat(""));
+    EXPECT_FALSE(estoraged::parseBlockStat("1200 30 45000"));
+    EXPECT_FALSE(estoraged::parseBlockStat("1200 30 x 600 800 20 64000"));
+}
+
+TEST(bkopsScheduler, idleAfterQuietTime)
+{
+    IdleDetector detector(seconds(30));
+    IdleDetector::Clock::time_point start;
+
+    /* the first sample has no history */
+    EXPECT_FALSE(detector.update({100, 0}, start));
+    EXPECT_FALSE(detector.update({100, 0}, start + seconds(29)));
+    EXPECT_TRUE(detector.update({100, 0}, start + seconds(30)));
+
+    /* a completed request restarts the quiet time */
+    EXPECT_FALSE(detector.update({101, 0}, start + seconds(40)));
+    EXPECT_FALSE(detector.update({101, 0}, start + seconds(60)));
+    EXPECT_TRUE(detector.update({101, 0}, start + seconds(70)));
+
+    /* so does a request still in flight */
+    EXPECT_FALSE(detector.update({101, 1}, start + seconds(80)));
+    EXPECT_FALSE(detector.update({101, 0}, start + seconds(100)));
+    EXPECT_TRUE(detector.update({101, 0}, start + seconds(110)));
+}
+
+TEST(bkopsScheduler, startPolicy)
+{
+    EXPECT_FALSE(estoraged::shouldStartBkops(BkopsStatus::None, true));
+    EXPECT_FALSE(estoraged::shouldStartBkops(BkopsStatus::None, false));
+    EXPECT_TRUE(estoraged::shouldStartBkops(BkopsStatus::NonCritical, true));
+    EXPECT_FALSE(
+        estoraged::shouldStartBkops(BkopsStatus::NonCritical, false));
+    EXPECT_TRUE(
+        estoraged::shouldStartBkops(BkopsStatus::PerformanceImpacted, true));
+    EXPECT_FALSE(
+        estoraged::shouldStartBkops(BkopsStatus::PerformanceImpacted, false));
+    EXPECT_TRUE(estoraged::shouldStartBkops(BkopsStatus::Critical, true));
+    EXPECT_TRUE(estoraged::shouldStartBkops(BkopsStatus::Critical, false));
+}
+
+/* Reports a BKOPS level on SEND_EXT_CSD and counts the BKOPS_START */
+struct FakeDevice
+{
+    BkopsStatus level;
+    std::atomic<int> starts{0};
+
+    int ioctl(unsigned long, void* data)
+    {
+        auto* idata = static_cast<struct mmc_ioc_cmd*>(data);
+        if (idata->opcode == MMC_SEND_EXT_CSD)
+        {
+            // NOLINTNEXTLINE(performance-no-int-to-ptr)
+            auto* extCsd = reinterpret_cast<uint8_t*>(idata->data_ptr);
+            extCsd[estoraged::extcsd::bkopsSupport] = 1;
+            extCsd[estoraged::extcsd::bkopsEn] = EXT_CSD_MANUAL_BKOPS_MASK;
+            extCsd[estoraged::extcsd::bkopsStatus] =
+                static_cast<uint8_t>(level);
+        }
+        else if (idata->opcode == MMC_SWITCH &&
+                 ((idata->arg >> 16) & 0xff) == EXT_CSD_BKOPS_START)
+        {
+            EXPECT_EQ(1U, (idata->arg >> 8) & 0xff);
+            EXPECT_EQ(BkopsScheduler::bkopsTimeoutMs, idata->cmd_timeout_ms);
+            starts++;
+        }
+        return 0;
+    }
+};
+
+class BkopsSchedulerRun : public testing::Test
+{
+  public:
+    const char* statPath = "/tmp/bkops_test_stat";
+    boost::asio::io_context io;
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    std::unique_ptr<sdbusplus::asio::object_server> objectServer;
+    DeviceWorker worker;
+
+    void SetUp() override
+    {
+        conn = std::make_shared<sdbusplus::asio::connection>(io);
+        conn->request_name("xyz.openbmc_project.eStoraged.test");
+        objectServer = std::make_unique<sdbusplus::asio::object_server>(conn);
+
+        std::ofstream stat(statPath, std::ios::out | std::ios::trunc);
+        stat << "1200 30 45000 600 800 20 64000 1500 0 900 2100\n";
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove(statPath);
+    }
+
+    /* Polls every ms until the device saw a BKOPS_START or a second passed,
+     * and returns the number of starts.
+     */
+    int runScheduler(FakeDevice& device, milliseconds idleTime)
+    {
+        auto fd = std::make_unique<FdMock>();
+        EXPECT_CALL(*fd, ioctl(MMC_IOC_CMD, _))
+            .WillRepeatedly(Invoke(&device, &FakeDevice::ioctl));
+        auto mmc = std::make_shared<MmcChannel>(
+            "/dev/test", std::make_unique<IOCTLWrapperImpl>(std::move(fd)));
+
+        auto scheduler = std::make_shared<BkopsScheduler>(
+            io, *objectServer, "/xyz/openbmc_project/inventory/storage/test",
+            worker, mmc, statPath, milliseconds(1), idleTime);
+        scheduler->start();
+        auto deadline = std::chrono::steady_clock::now() + seconds(1);
+        while (device.starts == 0 &&
+               std::chrono::steady_clock::now() < deadline)
+        {
+            io.run_for(milliseconds(10));
+        }
+
+        /* a poll still on the worker must not outlive the device */
+        scheduler.reset();
+        std::promise<void> drained;
+        worker.post([&drained]() { drained.set_value(); });
+        drained.get_future().wait();
+        return device.starts;
+    }
+};
+
+/* An idle device runs the pending operations */
+TEST_F(BkopsSchedulerRun, startsWhenIdle)
+{
+    FakeDevice device{BkopsStatus::NonCritical};
+    EXPECT_LE(1, runScheduler(device, milliseconds(0)));
+}
+
+/* A busy device only runs them once they are critical */
+TEST_F(BkopsSchedulerRun, waitsForIdle)
+{
+    FakeDevice device{BkopsStatus::PerformanceImpacted};
+    EXPECT_EQ(0, runScheduler(device, seconds(3600)));
+
+    FakeDevice critical{BkopsStatus::Critical};
+    EXPECT_LE(1, runScheduler(critical, seconds(3600)));
+}
+
+} // namespace estoraged_test
@@ -0,0 +1,199 @@
+#include "deviceWorker.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/spawn.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::DeviceWorker;
+
+TEST(deviceWorker, runsOffTheCallingThread)
+{
+    boost::asio::io_context io;
+    DeviceWorker worker;
+    std::thread::id caller;
+    std::thread::id runner;
+    bool done = false;
+
+    boost::asio::spawn(io, [&](boost::asio::yield_context yield) {
+        caller = std::this_thread::get_id();
+        worker.run(yield,
+                   [&runner]() { runner = std::this_thread::get_id(); });
+        /* the coroutine resumes on the io_context */
+        EXPECT_EQ(caller, std::this_thread::get_id());
+        done = true;
+    });
+    io.run();
+
+    EXPECT_TRUE(done);
+    EXPECT_NE(std::thread::id(), runner);
+    EXPECT_NE(caller, runner);
+}
+
+TEST(deviceWorker, exceptionReachesTheCaller)
+{
+    boost::asio::io_context io;
+    DeviceWorker worker;
+    bool caught = false;
+
+    boost::asio::spawn(io, [&](boost::asio::yield_context yield) {
+        try
+        {
+            worker.run(yield, []() { throw std::runtime_error("failed"); });
+        }
+        catch (const std::runtime_error& e)
+        {
+            caught = std::string(e.what()) == "failed";
+        }
+    });
+    io.run();
+
+    EXPECT_TRUE(caught);
+}
+
+/* The io_context serves other handlers while an operation blocks */
+TEST(deviceWorker, callerStaysResponsive)
+{
+    boost::asio::io_context io;
+    DeviceWorker worker;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    bool served = false;
+
+    boost::asio::spawn(io, [&](boost::asio::yield_context yield) {
+        worker.run(yield, [released]() { released.wait(); });
+        EXPECT_TRUE(served);
+    });
+    boost::asio::post(io, [&]() {
+        served = true;
+        release.set_value();
+    });
+    io.run();
+
+    EXPECT_TRUE(served);
+}
+
+TEST(deviceWorker, operationsDoNotInterleave)
+{
+    boost::asio::io_context io;
+    DeviceWorker worker;
+    std::atomic<int> active{0};
+    std::atomic<int> maxActive{0};
+    std::vector<int> order;
+
+    auto operation = [&](int id) {
+        int now = ++active;
+        maxActive = std::max(maxActive.load(), now);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        order.push_back(id);
+        --active;
+    };
+    for (int i = 0; i < 3; i++)
+    {
+        boost::asio::spawn(io, [&, i](boost::asio::yield_context yield) {
+            worker.run(yield, [&operation, i]() { operation(i); });
+        });
+    }
+    std::promise<void> posted;
+    boost::asio::post(io, [&worker, &operation, &posted]() {
+        worker.post([&operation, &posted]() {
+            operation(3);
+            posted.set_value();
+        });
+    });
+    io.run();
+    posted.get_future().wait();
+
+    EXPECT_EQ(1, maxActive);
+    EXPECT_THAT(order, testing::ElementsAre(0, 1, 2, 3));
+}
+
+/* stop waits for the running operation and drops the queued ones */
+TEST(deviceWorker, stopDrainsTheWorker)
+{
+    DeviceWorker worker;
+    std::promise<void> started;
+    std::promise<void> release;
+    std::atomic<bool> finished = false;
+    std::atomic<bool> queuedRan = false;
+    worker.post([&started, &release, &finished]() {
+        started.set_value();
+        release.get_future().wait();
+        finished = true;
+    });
+    worker.post([&queuedRan]() { queuedRan = true; });
+    started.get_future().wait();
+
+    std::thread stopper([&worker]() { worker.stop(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    release.set_value();
+    stopper.join();
+
+    EXPECT_TRUE(finished);
+    EXPECT_FALSE(queuedRan);
+    worker.post([&queuedRan]() { queuedRan = true; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(queuedRan);
+}
+
+/* A stop with a timeout gives up on an operation that does not return */
+TEST(deviceWorker, stopGivesUp)
+{
+    auto started = std::make_shared<std::promise<void>>();
+    auto release = std::make_shared<std::promise<void>>();
+    auto finished = std::make_shared<std::promise<void>>();
+    {
+        DeviceWorker worker;
+        worker.post([started, release, finished]() {
+            started->set_value();
+            release->get_future().wait();
+            finished->set_value();
+        });
+        started->get_future().wait();
+
+        auto before = std::chrono::steady_clock::now();
+        EXPECT_FALSE(worker.stop(std::chrono::milliseconds(20)));
+        EXPECT_LT(std::chrono::steady_clock::now() - before,
+                  std::chrono::seconds(5));
+        /* the destructor does not wait either */
+    }
+
+    /* the operation goes on after the worker is gone */
+    release->set_value();
+    finished->get_future().wait();
+}
+
+/* A stop with a timeout waits for an operation that returns in time */
+TEST(deviceWorker, stopWithTimeout)
+{
+    DeviceWorker worker;
+    std::promise<void> started;
+    std::atomic<bool> finished = false;
+    worker.post([&started, &finished]() {
+        started.set_value();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        finished = true;
+    });
+    started.get_future().wait();
+
+    EXPECT_TRUE(worker.stop(std::chrono::seconds(5)));
+    EXPECT_TRUE(finished);
+}
+
+} // namespace estoraged_test
@@ -0,0 +1,181 @@
+#include "badRangeMap.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::BadRange;
+using estoraged::BadRangeKind;
+using estoraged::BadRangeMap;
+using estoraged::recordMismatches;
+using testing::ElementsAre;
+
+TEST(badRangeMap, startsEmpty)
+{
+    BadRangeMap map;
+    EXPECT_TRUE(map.empty());
+    EXPECT_TRUE(map.ranges().empty());
+    EXPECT_EQ(0U, map.badBytes());
+    EXPECT_FALSE(map.coarsened());
+}
+
+/* Overlapping and touching ranges become one, in any order */
+TEST(badRangeMap, joinsNeighbours)
+{
+    BadRangeMap map;
+    map.add(BadRangeKind::Mismatch, 4096, 512);
+    map.add(BadRangeKind::Write, 0, 1024);
+    map.add(BadRangeKind::Read, 1024, 512);
+    map.add(BadRangeKind::Mismatch, 4000, 200);
+    map.add(BadRangeKind::Mismatch, 8192, 512);
+
+    EXPECT_THAT(map.ranges(),
+                ElementsAre(BadRange{0, 1536}, BadRange{4000, 608},
+                            BadRange{8192, 512}));
+    EXPECT_EQ(1536U + 608U + 512U, map.badBytes());
+    EXPECT_EQ(1U, map.count(BadRangeKind::Read));
+    EXPECT_EQ(1U, map.count(BadRangeKind::Write));
+    EXPECT_EQ(3U, map.count(BadRangeKind::Mismatch));
+    EXPECT_FALSE(map.coarsened());
+}
+
+/* One range covering several others replaces them */
+TEST(badRangeMap, swallowsContainedRanges)
+{
+    BadRangeMap map;
+    map.add(BadRangeKind::Mismatch, 100, 10);
+    map.add(BadRangeKind::Mismatch, 200, 10);
+    map.add(BadRangeKind::Mismatch, 300, 10);
+    map.add(BadRangeKind::Read, 50, 1000);
+    EXPECT_THAT(map.ranges(), ElementsAre(BadRange{50, 1000}));
+}
+
+/* Past the limit the closest ranges are joined, still covering every bad
+ * byte
+ */
+TEST(badRangeMap, staysWithinLimit)
+{
+    BadRangeMap map(3);
+    map.add(BadRangeKind::Mismatch, 0, 512);
+    map.add(BadRangeKind::Mismatch, 10000, 512);
+    map.add(BadRangeKind::Mismatch, 20000, 512);
+    EXPECT_FALSE(map.coarsened());
+
+    /* closest to the first range */
+    map.add(BadRangeKind::Mismatch, 1024, 512);
+    EXPECT_THAT(map.ranges(),
+                ElementsAre(BadRange{0, 1536}, BadRange{10000, 512},
+                            BadRange{20000, 512}));
+    EXPECT_TRUE(map.coarsened());
+    EXPECT_EQ(4U, map.count(BadRangeKind::Mismatch));
+
+    for (uint64_t offset = 30000; offset < 1000000; offset += 4096)
+    {
+        map.add(BadRangeKind::Read, offset, 1);
+    }
+    EXPECT_EQ(3U, map.ranges().size());
+}
+
+/* A failure without a range still counts */
+TEST(badRangeMap, countOnly)
+{
+    BadRangeMap map;
+    map.add(BadRangeKind::Write, 4096, 0);
+    EXPECT_FALSE(map.empty());
+    EXPECT_TRUE(map.ranges().empty());
+    EXPECT_EQ(1U, map.count(BadRangeKind::Write));
+}
+
+TEST(badRangeMap, concurrentAdds)
+{
+    BadRangeMap map;
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&map, t]() {
+            for (uint64_t i = 0; i < 1000; i++)
+            {
+                map.add(BadRangeKind::Mismatch, (i * 4 + t) * 512, 512);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_THAT(map.ranges(), ElementsAre(BadRange{0, 4000 * 512}));
+    EXPECT_EQ(4000U, map.count(BadRangeKind::Mismatch));
+}
+
+/* Runs of wrong sectors are recorded as one range each */
+TEST(badRangeMap, recordMismatchesBySector)
+{
+    std::vector<std::byte> data(8 * 512 + 100);
+    data[700] = std::byte{1};
+    data[1024] = std::byte{1};
+    data[2047] = std::byte{1};
+    data[3 * 512 + 3] = std::byte{1};
+    data[6 * 512] = std::byte{1};
+    data[8 * 512 + 99] = std::byte{1};
+
+    auto findNonZero = [](uint64_t, std::span<const std::byte> part) {
+        size_t i = 0;
+        while (i < part.size() && part[i] == std::byte{0})
+        {
+            i++;
+        }
+        return i;
+    };
+    BadRangeMap map;
+    recordMismatches(map, 1 << 20, data, 700, findNonZero, 512);
+
+    EXPECT_THAT(map.ranges(),
+                ElementsAre(BadRange{(1 << 20) + 512, 3 * 512},
+                            BadRange{(1 << 20) + 6 * 512, 512},
+                            BadRange{(1 << 20) + 8 * 512, 100}));
+    EXPECT_EQ(3U, map.count(BadRangeKind::Mismatch));
+}
+
+/* Every check starts after the previous one, so a generator behind the
+ * finder never seeks back */
+TEST(badRangeMap, recordMismatchesOnlyMovesForward)
+{
+    std::vector<std::byte> data(8 * 512);
+    data[100] = std::byte{1};
+    data[4 * 512] = std::byte{1};
+
+    /* offset of each check and of the end of the bytes it looked at */
+    std::vector<std::pair<uint64_t, uint64_t>> checks;
+    auto findNonZero = [&checks](uint64_t at,
+                                 std::span<const std::byte> part) {
+        size_t i = 0;
+        while (i < part.size() && part[i] == std::byte{0})
+        {
+            i++;
+        }
+        checks.emplace_back(at, at + std::min(i + 1, part.size()));
+        return i;
+    };
+    BadRangeMap map;
+    recordMismatches(map, 0, data, 100, findNonZero, 512);
+
+    EXPECT_THAT(map.ranges(),
+                ElementsAre(BadRange{0, 512}, BadRange{4 * 512, 512}));
+    for (size_t i = 1; i < checks.size(); i++)
+    {
+        EXPECT_LE(checks[i - 1].second, checks[i].first);
+    }
+}
+
+} // namespace estoraged_test
@@ -0,0 +1,78 @@
+#include "bufferPool.hpp"
+#include "eraseOptions.hpp"
+#include "util.hpp"
+
+#include <cstdint>
+#include <span>
+
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::BufferPool;
+using estoraged::EraseOptions;
+using estoraged::util::BlockGeometry;
+
+TEST(bufferPool, buffersAreAlignedAndZeroed)
+{
+    BufferPool pool(3, 8192, 4096);
+    EXPECT_EQ(3U, pool.count());
+    EXPECT_EQ(8192U, pool.bufferSize());
+    for (size_t i = 0; i < pool.count(); i++)
+    {
+        std::span<std::byte> buffer = pool.get(i);
+        EXPECT_EQ(8192U, buffer.size());
+        EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(buffer.data()) % 4096);
+        for (std::byte b : buffer)
+        {
+            ASSERT_EQ(std::byte{0}, b);
+        }
+    }
+}
+
+TEST(bufferPool, bufferedChunkSize)
+{
+    EraseOptions options;
+    BlockGeometry geometry;
+    EXPECT_EQ(4096U, estoraged::eraseChunkSize(options, geometry, 4096));
+
+    options.chunkSize = 12345;
+    EXPECT_EQ(12345U, estoraged::eraseChunkSize(options, geometry, 4096));
+}
+
+TEST(bufferPool, directChunkSize)
+{
+    EraseOptions options;
+    options.directIo = true;
+    BlockGeometry geometry{512, 4096, 0};
+    EXPECT_EQ(estoraged::minDirectIoChunk,
+              estoraged::eraseChunkSize(options, geometry, 4096));
+
+    /* A larger optimal I/O size is honored. */
+    geometry.optimalIoSize = 4 * 1024 * 1024;
+    EXPECT_EQ(4U * 1024 * 1024,
+              estoraged::eraseChunkSize(options, geometry, 4096));
+
+    /* An explicit chunk size is rounded up to the alignment. */
+    options.chunkSize = 1000;
+    EXPECT_EQ(4096U, estoraged::eraseChunkSize(options, geometry, 4096));
+
+    geometry.physicalBlockSize = 16384;
+    EXPECT_EQ(16384U, estoraged::directIoAlignment(geometry));
+    EXPECT_EQ(16384U, estoraged::eraseChunkSize(options, geometry, 4096));
+}
+
+TEST(bufferPool, erasePoolSize)
+{
+    EraseOptions options;
+    EXPECT_EQ(2U, estoraged::erasePoolSize(options));
+    options.queueDepth = 8;
+    EXPECT_EQ(9U, estoraged::erasePoolSize(options));
+    options.verifyThreads = 6;
+    EXPECT_EQ(12U, estoraged::erasePoolSize(options));
+}
+
+} // namespace estoraged_test
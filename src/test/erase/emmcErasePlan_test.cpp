@@ -0,0 +1,159 @@
+#include "emmcErasePlan.hpp"
+#include "eraseOptions.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::EmmcEraseCapabilities;
+using estoraged::EmmcErasePlan;
+using estoraged::EmmcErasePolicy;
+using estoraged::EmmcEraseStep;
+using estoraged::extCsdSize;
+using std::chrono::milliseconds;
+using ::testing::ElementsAre;
+
+/* Capabilities of a device with 512 KiB erase groups that take up to 30 s
+ * each to erase and 300 ms to trim
+ */
+EmmcEraseCapabilities capabilities()
+{
+    EmmcEraseCapabilities caps;
+    caps.geometry.groupSize = 512 * 1024;
+    caps.geometry.groupTimeoutMs = 30000;
+    caps.trimTimeoutMs = 300;
+    caps.secureEraseMult = 2;
+    caps.secureTrimMult = 4;
+    return caps;
+}
+
+constexpr uint64_t driveSize = 4 << 20;
+
+TEST(emmcErasePlan, parseCapabilities)
+{
+    std::array<uint8_t, extCsdSize> extCsd{};
+    extCsd[175] = 1;                             // ERASE_GROUP_DEF
+    extCsd[192] = 7;                             // EXT_CSD_REV
+    extCsd[223] = 100;                           // ERASE_TIMEOUT_MULT
+    extCsd[224] = 8;                             // HC_ERASE_GRP_SIZE
+    extCsd[229] = 4;                             // SEC_TRIM_MULT
+    extCsd[230] = 2;                             // SEC_ERASE_MULT
+    extCsd[231] = (1 << 0) | (1 << 4) | (1 << 6); // SEC_FEATURE_SUPPORT
+    extCsd[232] = 3;                             // TRIM_MULT
+
+    EmmcEraseCapabilities caps = estoraged::parseEraseCapabilities(extCsd);
+    EXPECT_EQ(4U << 20, caps.geometry.groupSize);
+    EXPECT_EQ(30000U, caps.geometry.groupTimeoutMs);
+    EXPECT_TRUE(caps.trim);
+    EXPECT_TRUE(caps.discard);
+    EXPECT_TRUE(caps.secureErase);
+    EXPECT_TRUE(caps.sanitize);
+    EXPECT_EQ(900U, caps.trimTimeoutMs);
+    EXPECT_EQ(2U, caps.secureEraseMult);
+    EXPECT_EQ(4U, caps.secureTrimMult);
+
+    /* eMMC 4.41, without the security features */
+    extCsd[192] = 5;
+    extCsd[231] = 0;
+    caps = estoraged::parseEraseCapabilities(extCsd);
+    EXPECT_FALSE(caps.trim);
+    EXPECT_FALSE(caps.discard);
+    EXPECT_FALSE(caps.secureErase);
+    EXPECT_FALSE(caps.sanitize);
+}
+
+TEST(emmcErasePlan, stepArgsAndTimeouts)
+{
+    EXPECT_THAT(estoraged::eraseStepArgs(EmmcEraseStep::Discard),
+                ElementsAre(3U));
+    EXPECT_THAT(estoraged::eraseStepArgs(EmmcEraseStep::SecureTrim),
+                ElementsAre(0x80000001U, 0x80008000U));
+    EXPECT_TRUE(estoraged::eraseStepArgs(EmmcEraseStep::Sanitize).empty());
+
+    EmmcEraseCapabilities caps = capabilities();
+    EXPECT_EQ(300U, estoraged::eraseStepGroupTimeoutMs(
+                        caps, EmmcEraseStep::Discard));
+    EXPECT_EQ(60000U, estoraged::eraseStepGroupTimeoutMs(
+                          caps, EmmcEraseStep::SecureErase));
+    EXPECT_EQ(1200U, estoraged::eraseStepGroupTimeoutMs(
+                         caps, EmmcEraseStep::SecureTrim));
+}
+
+/* Legacy ignores the capabilities */
+TEST(emmcErasePlan, legacy)
+{
+    std::optional<EmmcErasePlan> plan = estoraged::planErase(
+        EmmcEraseCapabilities{}, EmmcErasePolicy::Legacy, driveSize);
+    ASSERT_TRUE(plan);
+    EXPECT_EQ("Erase+Sanitize", plan->name());
+    EXPECT_EQ(milliseconds(0), plan->estimate);
+
+    plan = estoraged::planErase(capabilities(), EmmcErasePolicy::Legacy,
+                                driveSize);
+    ASSERT_TRUE(plan);
+    EXPECT_EQ("Erase+Sanitize", plan->name());
+    EXPECT_EQ(milliseconds(8 * 30000) + estoraged::sanitizeEstimate,
+              plan->estimate);
+}
+
+TEST(emmcErasePlan, purgePicksFastest)
+{
+    EmmcEraseCapabilities caps = capabilities();
+    caps.sanitize = true;
+    caps.trim = true;
+    caps.discard = true;
+    caps.secureErase = true;
+
+    /* 8 groups of secure trim, 2 passes of 1.2 s, beat 240 s of sanitize */
+    std::optional<EmmcErasePlan> plan =
+        estoraged::planErase(caps, EmmcErasePolicy::Purge, driveSize);
+    ASSERT_TRUE(plan);
+    EXPECT_THAT(plan->steps, ElementsAre(EmmcEraseStep::SecureTrim));
+    EXPECT_EQ(milliseconds(8 * 2 * 1200), plan->estimate);
+
+    /* on a larger device sanitize wins, after the quickest unmap */
+    plan = estoraged::planErase(caps, EmmcErasePolicy::Purge, 1ULL << 40);
+    ASSERT_TRUE(plan);
+    EXPECT_EQ("Discard+Sanitize", plan->name());
+}
+
+TEST(emmcErasePlan, clearAcceptsTrim)
+{
+    EmmcEraseCapabilities caps = capabilities();
+    caps.trim = true;
+
+    std::optional<EmmcErasePlan> plan =
+        estoraged::planErase(caps, EmmcErasePolicy::Clear, driveSize);
+    ASSERT_TRUE(plan);
+    EXPECT_EQ("Trim", plan->name());
+    EXPECT_EQ(milliseconds(8 * 300), plan->estimate);
+
+    /* without trim, the plain erase */
+    caps.trim = false;
+    plan = estoraged::planErase(caps, EmmcErasePolicy::Clear, driveSize);
+    ASSERT_TRUE(plan);
+    EXPECT_EQ("Erase", plan->name());
+}
+
+TEST(emmcErasePlan, noPlan)
+{
+    /* nothing purges */
+    EXPECT_FALSE(estoraged::planErase(capabilities(), EmmcErasePolicy::Purge,
+                                      driveSize));
+
+    /* no erase group, so no estimate */
+    EmmcEraseCapabilities caps = capabilities();
+    caps.geometry.groupSize = 0;
+    EXPECT_FALSE(
+        estoraged::planErase(caps, EmmcErasePolicy::Clear, driveSize));
+}
+
+} // namespace estoraged_test
@@ -0,0 +1,250 @@
+#include "eraseCheckpoint.hpp"
+#include "eraseOptions.hpp"
+#include "eraseProgress.hpp"
+#include "pattern.hpp"
+#include "patternGenerator.hpp"
+#include "zero.hpp"
+
+#include <stdplus/fd/create.hpp>
+#include <stdplus/fd/managed.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::CheckpointData;
+using estoraged::EraseCancelled;
+using estoraged::EraseCheckpoint;
+using estoraged::EraseOptions;
+using estoraged::EraseProgress;
+using estoraged::EraseProgressStatus;
+using estoraged::Pattern;
+using estoraged::PatternType;
+using estoraged::Zero;
+
+/* Creates a file of the given size filled with a non-zero byte */
+void makeFile(const std::string& name, size_t size)
+{
+    std::ofstream testFile(name,
+                           std::ios::out | std::ios::binary | std::ios::trunc);
+    std::vector<char> data(size, '\x5a');
+    testFile.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+std::vector<char> readFile(const std::string& name)
+{
+    std::ifstream testFile(name, std::ios::in | std::ios::binary);
+    return {std::istreambuf_iterator<char>(testFile),
+            std::istreambuf_iterator<char>()};
+}
+
+TEST(eraseCheckpoint, saveLoadRemove)
+{
+    std::string device = "checkpointDevice";
+    makeFile(device, 4096);
+    std::filesystem::path file = "checkpointDir/device.checkpoint";
+    std::filesystem::remove_all("checkpointDir");
+    EraseCheckpoint checkpoint(file, device);
+    EXPECT_FALSE(checkpoint.load());
+
+    CheckpointData data;
+    data.method = "xyz.openbmc_project.Inventory.Item.Volume.EraseMethod."
+                  "LogicalOverWrite";
+    data.patternType = PatternType::Minstd;
+    data.seed = Pattern::seed;
+    data.driveSize = 1 << 30;
+    data.offset = 123456789;
+    EXPECT_TRUE(checkpoint.save(data));
+    EXPECT_TRUE(std::filesystem::exists(file));
+    EXPECT_FALSE(
+        std::filesystem::exists("checkpointDir/device.checkpoint.tmp"));
+
+    std::optional<CheckpointData> loaded = checkpoint.load();
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(data, *loaded);
+
+    /* a later save replaces the offset */
+    data.offset = 223456789;
+    EXPECT_TRUE(checkpoint.save(data));
+    EXPECT_EQ(data, checkpoint.load());
+
+    checkpoint.remove();
+    EXPECT_FALSE(checkpoint.load());
+}
+
+TEST(eraseCheckpoint, invalidFileIgnored)
+{
+    std::string device = "checkpointDevice";
+    makeFile(device, 4096);
+    std::string file = "invalid.checkpoint";
+    EraseCheckpoint checkpoint(file, device);
+
+    {
+        std::ofstream out(file, std::ios::trunc);
+        out << "method=zero\nsize=100\noffset=abc\n";
+    }
+    EXPECT_FALSE(checkpoint.load());
+
+    /* the offset is past the end of the drive */
+    {
+        std::ofstream out(file, std::ios::trunc);
+        out << "method=zero\nsize=100\noffset=200\n";
+    }
+    EXPECT_FALSE(checkpoint.load());
+
+    {
+        std::ofstream out(file, std::ios::trunc);
+        out << "method=zero\nsize=100\n";
+    }
+    EXPECT_FALSE(checkpoint.load());
+
+    {
+        std::ofstream out(file, std::ios::trunc);
+        out << "method=zero\npattern=Fibonacci\nsize=100\noffset=50\n";
+    }
+    EXPECT_FALSE(checkpoint.load());
+    checkpoint.remove();
+}
+
+/* A device that can't be synced gets no checkpoint */
+TEST(eraseCheckpoint, saveFailsWithoutDevice)
+{
+    std::string file = "nodevice.checkpoint";
+    EraseCheckpoint checkpoint(file, "/dev/not_a_device");
+    CheckpointData data;
+    data.method = "zero";
+    EXPECT_FALSE(checkpoint.save(data));
+    EXPECT_FALSE(std::filesystem::exists(file));
+}
+
+TEST(eraseCheckpoint, checkpointHookIsBounded)
+{
+    std::vector<uint64_t> saved;
+    EraseProgress progress([](const EraseProgressStatus&) {},
+                           std::chrono::seconds(0));
+    progress.setCheckpoint(
+        [&saved](uint64_t offset) { saved.push_back(offset); },
+        std::chrono::hours(1));
+    progress.start(1000);
+    progress.advance(500);
+    progress.finish();
+    EXPECT_TRUE(saved.empty());
+
+    progress.setCheckpoint(
+        [&saved](uint64_t offset) { saved.push_back(offset); },
+        std::chrono::seconds(0));
+    progress.start(1000, 200);
+    progress.advance(300);
+    EXPECT_THAT(saved, testing::ElementsAre(200, 500));
+}
+
+TEST(eraseCheckpoint, zeroResumesFromOffset)
+{
+    std::string testFileName = "resumeZero";
+    uint64_t size = 100000;
+    makeFile(testFileName, size);
+
+    std::vector<EraseProgressStatus> reports;
+    EraseProgress progress(
+        [&reports](const EraseProgressStatus& s) { reports.push_back(s); });
+
+    Zero zero(testFileName);
+    zero.setProgress(&progress);
+    /* rounded down to 40960 */
+    zero.setStartOffset(41000);
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    zero.writeZero(size, write);
+
+    std::vector<char> data = readFile(testFileName);
+    ASSERT_EQ(size, data.size());
+    EXPECT_EQ(std::vector<char>(40960, '\x5a'),
+              std::vector<char>(data.begin(), data.begin() + 40960));
+    EXPECT_EQ(std::vector<char>(size - 40960, '\0'),
+              std::vector<char>(data.begin() + 40960, data.end()));
+
+    /* the first report counts the resumed part as done */
+    ASSERT_FALSE(reports.empty());
+    EXPECT_EQ(40960U, reports.front().bytesProcessed);
+    EXPECT_EQ(40U, reports.front().percent);
+    EXPECT_EQ(size, progress.bytesProcessed());
+}
+
+TEST(eraseCheckpoint, patternResumeMatchesFullWrite)
+{
+    std::string testFileName = "resumePattern";
+    uint64_t size = 100000;
+    makeFile(testFileName, size);
+
+    EraseOptions options;
+    options.chunkSize = 12345;
+    Pattern resumed(testFileName, options);
+    resumed.setStartOffset(50000);
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    resumed.writePattern(size, write);
+    std::vector<char> data = readFile(testFileName);
+
+    /* the first part is untouched */
+    EXPECT_EQ(std::vector<char>(49152, '\x5a'),
+              std::vector<char>(data.begin(), data.begin() + 49152));
+
+    /* the rest is what a full write puts there */
+    std::string fullFileName = "resumePatternFull";
+    makeFile(fullFileName, 0);
+    Pattern full(fullFileName, options);
+    stdplus::fd::ManagedFd fullWrite =
+        stdplus::fd::open(fullFileName, stdplus::fd::OpenAccess::WriteOnly);
+    full.writePattern(size, fullWrite);
+    std::vector<char> expected = readFile(fullFileName);
+    EXPECT_EQ(std::vector<char>(expected.begin() + 49152, expected.end()),
+              std::vector<char>(data.begin() + 49152, data.end()));
+}
+
+TEST(eraseCheckpoint, cancelStopsAtChunkBoundary)
+{
+    std::string testFileName = "cancelZero";
+    uint64_t size = 100000;
+    makeFile(testFileName, size);
+
+    EraseOptions options;
+    options.chunkSize = 8192;
+    EraseProgress* tracker = nullptr;
+    EraseProgress progress(
+        [&tracker](const EraseProgressStatus& s) {
+            if (s.bytesProcessed >= 3 * 8192)
+            {
+                tracker->cancel();
+            }
+        },
+        std::chrono::seconds(0));
+    tracker = &progress;
+
+    Zero zero(testFileName, options);
+    zero.setProgress(&progress);
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    EXPECT_THROW(zero.writeZero(size, write), EraseCancelled);
+    EXPECT_TRUE(progress.isCancelled());
+    EXPECT_EQ(3U * 8192, progress.bytesProcessed());
+
+    /* the fourth chunk was written, but not yet counted */
+    std::vector<char> data = readFile(testFileName);
+    EXPECT_EQ(std::vector<char>(4 * 8192, '\0'),
+              std::vector<char>(data.begin(), data.begin() + 4 * 8192));
+    EXPECT_EQ('\x5a', data[4 * 8192]);
+}
+
+} // namespace estoraged_test
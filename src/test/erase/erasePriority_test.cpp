@@ -0,0 +1,88 @@
+#include "eraseOptions.hpp"
+#include "erasePriority.hpp"
+
+#include <linux/ioprio.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::EraseOptions;
+using estoraged::ErasePriority;
+using estoraged::IoClass;
+
+int ioPriority()
+{
+    return static_cast<int>(syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0));
+}
+
+int niceValue()
+{
+    return getpriority(PRIO_PROCESS, static_cast<id_t>(gettid()));
+}
+
+/* Each test runs on its own thread, the priority is per thread */
+TEST(erasePriority, appliesAndRestores)
+{
+    std::thread([]() {
+        int oldIoPriority = ioPriority();
+        int oldPolicy = sched_getscheduler(0);
+        int oldNice = niceValue();
+
+        EraseOptions options;
+        options.ioClass = IoClass::Idle;
+        options.schedIdle = true;
+        options.nice = 10;
+        {
+            ErasePriority priority(options);
+            EXPECT_EQ(IOPRIO_CLASS_IDLE, IOPRIO_PRIO_CLASS(ioPriority()));
+            EXPECT_EQ(SCHED_IDLE, sched_getscheduler(0));
+            EXPECT_EQ(10, niceValue());
+        }
+
+        EXPECT_EQ(oldIoPriority, ioPriority());
+        /* only a privileged thread gets its CPU priority back */
+        if (geteuid() == 0)
+        {
+            EXPECT_EQ(oldPolicy, sched_getscheduler(0));
+            EXPECT_EQ(oldNice, niceValue());
+        }
+    }).join();
+}
+
+TEST(erasePriority, bestEffortLevel)
+{
+    std::thread([]() {
+        EraseOptions options;
+        options.ioClass = IoClass::BestEffort;
+        options.ioLevel = 6;
+        ErasePriority priority(options);
+        EXPECT_EQ(IOPRIO_CLASS_BE, IOPRIO_PRIO_CLASS(ioPriority()));
+        EXPECT_EQ(6, IOPRIO_PRIO_DATA(ioPriority()));
+    }).join();
+}
+
+TEST(erasePriority, defaultsChangeNothing)
+{
+    std::thread([]() {
+        int oldIoPriority = ioPriority();
+        int oldPolicy = sched_getscheduler(0);
+        int oldNice = niceValue();
+        {
+            ErasePriority priority(EraseOptions{});
+            EXPECT_EQ(oldIoPriority, ioPriority());
+            EXPECT_EQ(oldPolicy, sched_getscheduler(0));
+            EXPECT_EQ(oldNice, niceValue());
+        }
+    }).join();
+}
+
+} // namespace estoraged_test
@@ -0,0 +1,195 @@
+#include "eraseOptions.hpp"
+#include "eraseProgress.hpp"
+#include "pattern.hpp"
+#include "zero.hpp"
+
+#include <stdplus/fd/create.hpp>
+#include <stdplus/fd/managed.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::EraseOptions;
+using estoraged::EraseProgress;
+using estoraged::EraseProgressStatus;
+using estoraged::Pattern;
+using estoraged::Zero;
+
+TEST(eraseProgress, startReportsZero)
+{
+    std::vector<EraseProgressStatus> reports;
+    EraseProgress progress(
+        [&reports](const EraseProgressStatus& s) { reports.push_back(s); });
+    progress.start(1000);
+
+    ASSERT_EQ(1U, reports.size());
+    EXPECT_EQ(0U, reports[0].bytesProcessed);
+    EXPECT_EQ(1000U, reports[0].totalBytes);
+    EXPECT_EQ(0U, reports[0].percent);
+    EXPECT_EQ(0U, reports[0].secondsRemaining);
+}
+
+TEST(eraseProgress, reportsAreBoundedByInterval)
+{
+    std::vector<EraseProgressStatus> reports;
+    EraseProgress progress(
+        [&reports](const EraseProgressStatus& s) { reports.push_back(s); },
+        std::chrono::hours(1));
+    progress.start(1000);
+    for (int i = 0; i < 10; i++)
+    {
+        progress.advance(100);
+    }
+    EXPECT_EQ(1U, reports.size());
+    EXPECT_EQ(1000U, progress.bytesProcessed());
+
+    progress.finish();
+    ASSERT_EQ(2U, reports.size());
+    EXPECT_EQ(1000U, reports[1].bytesProcessed);
+    EXPECT_EQ(100U, reports[1].percent);
+    EXPECT_EQ(0U, reports[1].secondsRemaining);
+}
+
+TEST(eraseProgress, reportsPercentThroughputAndEta)
+{
+    std::vector<EraseProgressStatus> reports;
+    EraseProgress progress(
+        [&reports](const EraseProgressStatus& s) { reports.push_back(s); },
+        std::chrono::seconds(0));
+    progress.start(4000000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    progress.advance(1000000);
+
+    ASSERT_EQ(2U, reports.size());
+    EXPECT_EQ(1000000U, reports[1].bytesProcessed);
+    EXPECT_EQ(25U, reports[1].percent);
+    EXPECT_GT(reports[1].throughput, 0);
+    /* three times the elapsed time remains, which is well under a minute */
+    EXPECT_LT(reports[1].secondsRemaining, 60U);
+}
+
+TEST(eraseProgress, processedIsClampedToTotal)
+{
+    std::vector<EraseProgressStatus> reports;
+    EraseProgress progress(
+        [&reports](const EraseProgressStatus& s) { reports.push_back(s); });
+    progress.start(100);
+    progress.advance(150);
+    progress.finish();
+
+    EXPECT_EQ(100U, reports.back().bytesProcessed);
+    EXPECT_EQ(100U, reports.back().percent);
+}
+
+TEST(eraseProgress, advanceFromThreads)
+{
+    EraseProgress progress([](const EraseProgressStatus&) {},
+                           std::chrono::seconds(0));
+    progress.start(4 * 1000 * 512);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&progress]() {
+            for (int i = 0; i < 1000; i++)
+            {
+                progress.advance(512);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_EQ(4U * 1000 * 512, progress.bytesProcessed());
+}
+
+/* The engines report every byte they write and verify */
+TEST(eraseProgress, enginesReportEveryChunk)
+{
+    std::string testFileName = "progressEngines";
+    uint64_t size = 100000;
+    {
+        std::ofstream testFile(testFileName, std::ios::out | std::ios::binary |
+                                                 std::ios::trunc);
+    }
+
+    std::vector<EraseProgressStatus> reports;
+    EraseProgress progress(
+        [&reports](const EraseProgressStatus& s) { reports.push_back(s); },
+        std::chrono::seconds(0));
+
+    EraseOptions options;
+    options.chunkSize = 8192;
+    Pattern pattern(testFileName, options);
+    pattern.setProgress(&progress);
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    pattern.writePattern(size, write);
+
+    /* one start report and one per chunk */
+    ASSERT_EQ(1 + (size + options.chunkSize - 1) / options.chunkSize,
+              reports.size());
+    EXPECT_EQ(size, reports.back().bytesProcessed);
+    EXPECT_EQ(100U, reports.back().percent);
+
+    reports.clear();
+    Zero zero(testFileName, options);
+    zero.setProgress(&progress);
+    stdplus::fd::ManagedFd read =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_ANY_THROW(zero.verifyZero(size, read));
+    /* the failed verify only got through the first chunk */
+    EXPECT_EQ(1U, reports.size());
+    EXPECT_EQ(0U, reports.back().bytesProcessed);
+}
+
+/* Busy changes are reported right away, and kept in later reports */
+TEST(eraseProgress, deviceBusy)
+{
+    std::vector<EraseProgressStatus> reports;
+    EraseProgress progress(
+        [&reports](const EraseProgressStatus& s) { reports.push_back(s); },
+        std::chrono::hours(1));
+    progress.start(1000);
+    progress.setDeviceBusy(true);
+    progress.finish();
+    progress.setDeviceBusy(false);
+
+    ASSERT_EQ(4U, reports.size());
+    EXPECT_FALSE(reports[0].deviceBusy);
+    EXPECT_TRUE(reports[1].deviceBusy);
+    EXPECT_TRUE(reports[2].deviceBusy);
+    EXPECT_FALSE(reports[3].deviceBusy);
+}
+
+/* The plan is reported right away, and kept across passes */
+TEST(eraseProgress, plan)
+{
+    std::vector<EraseProgressStatus> reports;
+    EraseProgress progress(
+        [&reports](const EraseProgressStatus& s) { reports.push_back(s); },
+        std::chrono::hours(1));
+    progress.setPlan("Discard+Sanitize", 240);
+    progress.start(1000);
+    progress.finish();
+
+    ASSERT_EQ(3U, reports.size());
+    for (const EraseProgressStatus& report : reports)
+    {
+        EXPECT_EQ("Discard+Sanitize", report.eraseSteps);
+        EXPECT_EQ(240U, report.estimatedSeconds);
+    }
+}
+
+} // namespace estoraged_test
@@ -0,0 +1,196 @@
+#include "eraseOptions.hpp"
+#include "eraseThrottle.hpp"
+#include "zero.hpp"
+
+#include <stdplus/fd/create.hpp>
+#include <stdplus/fd/managed.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::EraseOptions;
+using estoraged::EraseThrottle;
+using estoraged::Zero;
+using std::chrono::milliseconds;
+using testing::ElementsAre;
+using Clock = EraseThrottle::Clock;
+
+/* A clock that only moves when told to or when slept on */
+struct FakeTimer
+{
+    Clock::time_point now;
+    std::vector<Clock::duration> sleeps;
+
+    EraseThrottle::Timer timer()
+    {
+        return {[this]() { return now; },
+                [this](Clock::duration duration) {
+                    sleeps.push_back(duration);
+                    now += duration;
+                }};
+    }
+
+    Clock::duration slept() const
+    {
+        Clock::duration total{};
+        for (Clock::duration duration : sleeps)
+        {
+            total += duration;
+        }
+        return total;
+    }
+};
+
+/* Writes a PSI file with the given "some" stall total */
+void writePressure(const std::string& name, uint64_t total)
+{
+    std::ofstream file(name, std::ios::out | std::ios::trunc);
+    file << "some avg10=1.00 avg60=0.50 avg300=0.10 total=" << total << "\n"
+         << "full avg10=0.00 avg60=0.00 avg300=0.00 total=999999999\n";
+}
+
+TEST(eraseThrottle, offByDefault)
+{
+    FakeTimer fake;
+    EraseThrottle throttle(EraseOptions{}, fake.timer());
+    EXPECT_FALSE(throttle.enabled());
+    for (int i = 0; i < 100; i++)
+    {
+        throttle.pace(1 << 20);
+    }
+    EXPECT_TRUE(fake.sleeps.empty());
+}
+
+TEST(eraseThrottle, capsThroughput)
+{
+    EraseOptions options;
+    options.maxThroughput = 10;
+    FakeTimer fake;
+    EraseThrottle throttle(options, fake.timer());
+    EXPECT_TRUE(throttle.enabled());
+
+    for (int i = 0; i < 100; i++)
+    {
+        throttle.pace(100000);
+    }
+    /* 10 MB at 10 MB/s */
+    EXPECT_NEAR(1.0, std::chrono::duration<double>(fake.slept()).count(),
+                0.001);
+}
+
+/* A pause in the erase only earns a burst of credit */
+TEST(eraseThrottle, burstIsBounded)
+{
+    EraseOptions options;
+    options.maxThroughput = 10;
+    FakeTimer fake;
+    EraseThrottle throttle(options, fake.timer());
+
+    fake.now += std::chrono::seconds(10);
+    for (int i = 0; i < 100; i++)
+    {
+        throttle.pace(100000);
+    }
+    EXPECT_NEAR(1.0 - std::chrono::duration<double>(EraseThrottle::burst)
+                          .count(),
+                std::chrono::duration<double>(fake.slept()).count(), 0.001);
+}
+
+TEST(eraseThrottle, backsOffUnderPressure)
+{
+    const std::string pressureFile = "eraseThrottlePressure";
+    EraseOptions options;
+    options.ioPressureLimit = 10;
+    options.ioPressurePath = pressureFile;
+    FakeTimer fake;
+    EraseThrottle throttle(options, fake.timer());
+
+    /* the first read is the baseline */
+    writePressure(pressureFile, 1000);
+    throttle.pace(4096);
+    EXPECT_TRUE(fake.sleeps.empty());
+
+    /* reads are at most every pressureInterval */
+    fake.now += milliseconds(100);
+    writePressure(pressureFile, 1000000);
+    throttle.pace(4096);
+    EXPECT_TRUE(fake.sleeps.empty());
+
+    /* stalled most of the time, the pause doubles */
+    fake.now += EraseThrottle::pressureInterval;
+    throttle.pace(4096);
+    fake.now += EraseThrottle::pressureInterval;
+    writePressure(pressureFile, 2000000);
+    throttle.pace(4096);
+    EXPECT_THAT(fake.sleeps, ElementsAre(milliseconds(50), milliseconds(100)));
+    EXPECT_EQ(2U, throttle.backoffs());
+
+    /* no stalls, the pause halves away */
+    fake.sleeps.clear();
+    for (int i = 0; i < 3; i++)
+    {
+        fake.now += EraseThrottle::pressureInterval;
+        throttle.pace(4096);
+    }
+    EXPECT_TRUE(fake.sleeps.empty());
+
+    /* the next pause starts over */
+    fake.now += EraseThrottle::pressureInterval;
+    writePressure(pressureFile, 3000000);
+    throttle.pace(4096);
+    EXPECT_THAT(fake.sleeps, ElementsAre(milliseconds(50)));
+
+    EXPECT_TRUE(std::filesystem::remove(pressureFile));
+}
+
+/* Without a pressure file, the erase goes on at full speed */
+TEST(eraseThrottle, missingPressureFile)
+{
+    EraseOptions options;
+    options.ioPressureLimit = 10;
+    options.ioPressurePath = "eraseThrottleMissing";
+    FakeTimer fake;
+    EraseThrottle throttle(options, fake.timer());
+
+    throttle.pace(4096);
+    EXPECT_FALSE(throttle.enabled());
+    EXPECT_TRUE(fake.sleeps.empty());
+}
+
+/* The engines pace every byte they write */
+TEST(eraseThrottle, pacesZeroWrite)
+{
+    const std::string testFileName = "eraseThrottleZero";
+    const uint64_t size = 4 << 20;
+    {
+        std::ofstream testFile(testFileName, std::ios::out | std::ios::trunc);
+    }
+    EraseOptions options;
+    options.maxThroughput = 1;
+    FakeTimer fake;
+    EraseThrottle throttle(options, fake.timer());
+
+    stdplus::fd::ManagedFd fd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    Zero zero(testFileName, options);
+    zero.setThrottle(&throttle);
+    zero.writeZero(size, fd);
+
+    /* 4 MiB at 1 MB/s */
+    EXPECT_NEAR(static_cast<double>(size) / 1e6,
+                std::chrono::duration<double>(fake.slept()).count(), 0.001);
+    EXPECT_TRUE(std::filesystem::remove(testFileName));
+}
+
+} // namespace estoraged_test
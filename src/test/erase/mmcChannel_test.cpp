@@ -0,0 +1,151 @@
+#include "extCsd.hpp"
+#include "mmcChannel.hpp"
+
+#include <linux/mmc/core.h>
+#include <linux/mmc/ioctl.h>
+#include <linux/mmc/mmc.h>
+
+#include <stdplus/fd/gmock.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::BkopsStatus;
+using estoraged::ExtCsd;
+using estoraged::HsTiming;
+using estoraged::IOCTLWrapperImpl;
+using estoraged::MmcChannel;
+using estoraged::PreEolInfo;
+using stdplus::fd::FdMock;
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Return;
+
+/* Answers SEND_EXT_CSD with a 16 GB eMMC 5.1 in HS400, and everything else
+ * with success
+ */
+int answerExtCsd(unsigned long, void* data)
+{
+    auto* idata = static_cast<struct mmc_ioc_cmd*>(data);
+    if (idata->opcode != MMC_SEND_EXT_CSD)
+    {
+        return 0;
+    }
+    // NOLINTNEXTLINE(performance-no-int-to-ptr)
+    auto* extCsd = reinterpret_cast<uint8_t*>(idata->data_ptr);
+    extCsd[estoraged::extcsd::rev] = 8;
+    extCsd[estoraged::extcsd::hsTiming] = 0x13;
+    extCsd[estoraged::extcsd::secCount + 1] = 0x80;
+    extCsd[estoraged::extcsd::secCount + 2] = 0xD3;
+    extCsd[estoraged::extcsd::secCount + 3] = 0x01;
+    extCsd[estoraged::extcsd::bkopsStatus] = 2;
+    extCsd[estoraged::extcsd::preEolInfo] = 1;
+    extCsd[estoraged::extcsd::lifeTimeEstA] = 0x02;
+    extCsd[estoraged::extcsd::lifeTimeEstB] = 0x03;
+    extCsd[estoraged::extcsd::bkopsSupport] = 1;
+    return 0;
+}
+
+TEST(mmcChannel, decodesExtCsd)
+{
+    FdMock fd;
+    EXPECT_CALL(fd, ioctl(MMC_IOC_CMD, _)).WillOnce(Invoke(answerExtCsd));
+    MmcChannel mmc("/dev/test", std::make_unique<IOCTLWrapperImpl>(fd));
+
+    std::optional<ExtCsd> extCsd = mmc.extCsd();
+    ASSERT_TRUE(extCsd);
+    EXPECT_EQ(8, extCsd->revision());
+    EXPECT_EQ(HsTiming::Hs400, extCsd->hsTiming());
+    EXPECT_EQ(0x01D38000U, extCsd->sectorCount());
+    EXPECT_EQ(0x01D38000ULL * 512, extCsd->capacity());
+    EXPECT_TRUE(extCsd->bkopsSupported());
+    EXPECT_EQ(BkopsStatus::PerformanceImpacted, extCsd->bkopsStatus());
+    EXPECT_EQ(PreEolInfo::Normal, extCsd->preEolInfo());
+    EXPECT_EQ(80, extCsd->lifeLeftPercent());
+}
+
+/* Every reader shares one read of the register */
+TEST(mmcChannel, cachesExtCsd)
+{
+    FdMock fd;
+    EXPECT_CALL(fd, ioctl(MMC_IOC_CMD, _)).WillOnce(Invoke(answerExtCsd));
+    MmcChannel mmc("/dev/test", std::make_unique<IOCTLWrapperImpl>(fd));
+
+    EXPECT_TRUE(mmc.extCsd());
+    EXPECT_TRUE(mmc.extCsd());
+    EXPECT_EQ(1U, mmc.extCsdReads());
+}
+
+/* A SWITCH changes EXT_CSD, so the next use reads it again */
+TEST(mmcChannel, switchRefreshes)
+{
+    FdMock fd;
+    EXPECT_CALL(fd, ioctl(MMC_IOC_CMD, _))
+        .WillRepeatedly(Invoke(answerExtCsd));
+    MmcChannel mmc("/dev/test", std::make_unique<IOCTLWrapperImpl>(fd));
+
+    EXPECT_TRUE(mmc.extCsd());
+    struct mmc_ioc_cmd status = {};
+    status.opcode = MMC_SEND_STATUS;
+    EXPECT_EQ(0, mmc.commandResponse(status));
+    EXPECT_TRUE(mmc.extCsd());
+    EXPECT_EQ(1U, mmc.extCsdReads());
+
+    struct mmc_ioc_cmd cmd = {};
+    cmd.opcode = MMC_SWITCH;
+    EXPECT_EQ(0, mmc.command(cmd));
+    EXPECT_TRUE(mmc.extCsd());
+    EXPECT_EQ(2U, mmc.extCsdReads());
+}
+
+/* A failed read is not cached */
+TEST(mmcChannel, readFailure)
+{
+    FdMock fd;
+    EXPECT_CALL(fd, ioctl(MMC_IOC_CMD, _))
+        .WillOnce(Return(1))
+        .WillOnce(Invoke(answerExtCsd));
+    MmcChannel mmc("/dev/test", std::make_unique<IOCTLWrapperImpl>(fd));
+
+    EXPECT_FALSE(mmc.extCsd());
+    EXPECT_TRUE(mmc.extCsd());
+    EXPECT_EQ(2U, mmc.extCsdReads());
+}
+
+TEST(mmcChannel, lifeLeftPercent)
+{
+    EXPECT_EQ(100, estoraged::lifeLeftPercent(0x01, 0x01));
+    EXPECT_EQ(10, estoraged::lifeLeftPercent(0x01, 0x0A));
+    EXPECT_EQ(0, estoraged::lifeLeftPercent(0x0B, 0x01));
+    EXPECT_EQ(255, estoraged::lifeLeftPercent(0x00, 0x01));
+    EXPECT_EQ(255, estoraged::lifeLeftPercent(0x01, 0x0C));
+}
+
+TEST(mmcChannel, fastestHsTiming)
+{
+    constexpr uint8_t hs = EXT_CSD_CARD_TYPE_HS_26 | EXT_CSD_CARD_TYPE_HS_52;
+    constexpr uint8_t hs200 = hs | EXT_CSD_CARD_TYPE_HS200_1_8V;
+    constexpr uint8_t hs400 = hs200 | EXT_CSD_CARD_TYPE_HS400_1_8V;
+
+    EXPECT_EQ(HsTiming::Hs400,
+              estoraged::fastestHsTiming(hs400, HsTiming::Hs400));
+    EXPECT_EQ(HsTiming::Hs200,
+              estoraged::fastestHsTiming(hs400, HsTiming::Hs200));
+    EXPECT_EQ(HsTiming::Hs200,
+              estoraged::fastestHsTiming(hs200, HsTiming::Hs400));
+    EXPECT_EQ(HsTiming::HighSpeed,
+              estoraged::fastestHsTiming(hs, HsTiming::Hs400));
+    EXPECT_EQ(HsTiming::Legacy, estoraged::fastestHsTiming(hs400,
+                                                           HsTiming::Legacy));
+    EXPECT_EQ(HsTiming::Legacy, estoraged::fastestHsTiming(0, HsTiming::Hs400));
+    EXPECT_EQ("HS400", estoraged::hsTimingName(HsTiming::Hs400));
+}
+
+} // namespace estoraged_test
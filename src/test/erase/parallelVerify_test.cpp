@@ -0,0 +1,172 @@
+#include "bufferPool.hpp"
+#include "parallelVerify.hpp"
+#include "pattern.hpp"
+#include "zero.hpp"
+
+#include <stdplus/fd/create.hpp>
+#include <stdplus/fd/managed.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
+#include <atomic>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::BufferPool;
+using estoraged::EraseOptions;
+using estoraged::parallelVerify;
+using estoraged::Pattern;
+using estoraged::Zero;
+using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+
+/* Creates a file of zeros, with the given bytes set to one */
+void makeZeroFile(const std::string& name, size_t size,
+                  const std::vector<size_t>& nonZero = {})
+{
+    std::vector<char> data(size, 0);
+    for (size_t offset : nonZero)
+    {
+        data[offset] = 1;
+    }
+    std::ofstream testFile(name,
+                           std::ios::out | std::ios::binary | std::ios::trunc);
+    testFile.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+size_t checkZero(size_t, uint64_t, std::span<const std::byte> data,
+                 std::span<std::byte>)
+{
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        if (data[i] != std::byte{0})
+        {
+            return i;
+        }
+    }
+    return data.size();
+}
+
+TEST(parallelVerify, allRangesPass)
+{
+    std::string testFileName = "parallelVerifyPass";
+    uint64_t size = 100001;
+    makeZeroFile(testFileName, size);
+    stdplus::fd::ManagedFd fd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+
+    /* every byte is checked exactly once, by some worker */
+    std::vector<std::atomic<int>> seen(size);
+    BufferPool pool(8, 4096, 4096);
+    std::optional<uint64_t> result = parallelVerify(
+        fd.get(), size, 4, pool,
+        [&seen](size_t worker, uint64_t offset,
+                std::span<const std::byte> data, std::span<std::byte> scratch) {
+            EXPECT_LT(worker, 4U);
+            EXPECT_EQ(data.size(), scratch.size());
+            for (size_t i = 0; i < data.size(); i++)
+            {
+                seen[offset + i]++;
+            }
+            return checkZero(worker, offset, data, scratch);
+        });
+    EXPECT_FALSE(result);
+    for (size_t i = 0; i < size; i++)
+    {
+        ASSERT_EQ(1, seen[i]) << "offset " << i;
+    }
+}
+
+/* Mismatches in several ranges merge into the lowest offset */
+TEST(parallelVerify, firstMismatchReported)
+{
+    std::string testFileName = "parallelVerifyMismatch";
+    uint64_t size = 1 << 20;
+    makeZeroFile(testFileName, size, {900000, 300001, 700000});
+    stdplus::fd::ManagedFd fd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+
+    BufferPool pool(8, 4096, 4096);
+    std::optional<uint64_t> result =
+        parallelVerify(fd.get(), size, 4, pool, checkZero);
+    ASSERT_TRUE(result);
+    EXPECT_EQ(300001U, *result);
+}
+
+/* More threads than chunks */
+TEST(parallelVerify, moreThreadsThanChunks)
+{
+    std::string testFileName = "parallelVerifySmall";
+    uint64_t size = 5000;
+    makeZeroFile(testFileName, size, {4999});
+    stdplus::fd::ManagedFd fd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+
+    BufferPool pool(16, 4096, 4096);
+    std::optional<uint64_t> result =
+        parallelVerify(fd.get(), size, 8, pool, checkZero);
+    ASSERT_TRUE(result);
+    EXPECT_EQ(4999U, *result);
+}
+
+TEST(parallelVerify, shortReadFail)
+{
+    std::string testFileName = "parallelVerifyShort";
+    makeZeroFile(testFileName, 4096);
+    stdplus::fd::ManagedFd fd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+
+    BufferPool pool(4, 4096, 4096);
+    EXPECT_THROW(parallelVerify(fd.get(), 65536, 2, pool, checkZero),
+                 InternalFailure);
+}
+
+TEST(parallelVerify, zeroVerify)
+{
+    std::string testFileName = "parallelVerifyZero";
+    uint64_t size = 100000;
+    makeZeroFile(testFileName, size);
+    EraseOptions options;
+    options.verifyThreads = 3;
+    Zero zero(testFileName, options);
+
+    stdplus::fd::ManagedFd fd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_TRUE(zero.verifyZeroParallel(size, fd.get()));
+
+    makeZeroFile(testFileName, size, {77777});
+    EXPECT_THROW(zero.verifyZeroParallel(size, fd.get()), InternalFailure);
+
+    Zero single(testFileName);
+    EXPECT_FALSE(single.verifyZeroParallel(size, fd.get()));
+}
+
+TEST(parallelVerify, patternVerify)
+{
+    std::string testFileName = "parallelVerifyPattern";
+    uint64_t size = 100003;
+    makeZeroFile(testFileName, 0);
+    for (auto type :
+         {estoraged::PatternType::Philox, estoraged::PatternType::Minstd})
+    {
+        EraseOptions options;
+        options.verifyThreads = 4;
+        options.patternType = type;
+        Pattern pattern(testFileName, options);
+
+        stdplus::fd::ManagedFd writeFd = stdplus::fd::open(
+            testFileName, stdplus::fd::OpenAccess::WriteOnly);
+        pattern.writePattern(size, writeFd);
+
+        stdplus::fd::ManagedFd fd =
+            stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+        EXPECT_TRUE(pattern.verifyPatternParallel(size, fd.get()));
+    }
+}
+
+} // namespace estoraged_test
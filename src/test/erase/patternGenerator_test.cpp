@@ -0,0 +1,219 @@
+#include "patternGenerator.hpp"
+
+#include <array>
+#include <cstring>
+#include <random>
+#include <span>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::makePatternGenerator;
+using estoraged::philoxKernels;
+using estoraged::MinstdGenerator;
+using estoraged::PatternType;
+using estoraged::PhiloxGenerator;
+
+/* Known answers from the Random123 kat_vectors for philox4x32_10 */
+TEST(patternGenerator, philoxKnownAnswers)
+{
+    EXPECT_EQ((std::array<uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c,
+                                       0x9b00dbd8}),
+              PhiloxGenerator::block({0, 0, 0, 0}, {0, 0}));
+    EXPECT_EQ((std::array<uint32_t, 4>{0x408f276d, 0x41c83b0e, 0xa20bc7c6,
+                                       0x6d5451fd}),
+              PhiloxGenerator::block(
+                  {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                  {0xffffffff, 0xffffffff}));
+    EXPECT_EQ((std::array<uint32_t, 4>{0xd16cfe09, 0x94fdcceb, 0x5001e420,
+                                       0x24126ea1}),
+              PhiloxGenerator::block(
+                  {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+                  {0xa4093822, 0x299f31d0}));
+}
+
+/* Block n of the output is the block function of counter n */
+TEST(patternGenerator, philoxCounterLayout)
+{
+    PhiloxGenerator generator(0x1234567890abcdef);
+    std::vector<std::byte> data(1000 * PhiloxGenerator::blockSize);
+    generator.fill(0, data);
+    for (uint32_t n : {0U, 1U, 7U, 8U, 999U})
+    {
+        std::array<uint32_t, 4> expected =
+            PhiloxGenerator::block({n, 0, 0, 0}, {0x90abcdef, 0x12345678});
+        EXPECT_EQ(0, std::memcmp(expected.data(),
+                                 &data[n * PhiloxGenerator::blockSize],
+                                 PhiloxGenerator::blockSize))
+            << "block " << n;
+    }
+}
+
+/* Every kernel matches the block function, including the blocks after the
+ * last full vector
+ */
+TEST(patternGenerator, philoxKernelsMatch)
+{
+    auto kernels = philoxKernels();
+    ASSERT_FALSE(kernels.empty());
+    EXPECT_EQ("scalar", kernels.front().name);
+
+    std::array<uint32_t, 2> key{0x6a656272, 0x5eed};
+    uint64_t index = 0xfffffffa; // the counters carry into the high word
+    for (const auto& kernel : kernels)
+    {
+        std::vector<std::byte> data(37 * PhiloxGenerator::blockSize + 5);
+        kernel.fill(index, key, data);
+        for (uint64_t n = 0; n < 37; n++)
+        {
+            uint64_t counter = index + n;
+            std::array<uint32_t, 4> expected = PhiloxGenerator::block(
+                {static_cast<uint32_t>(counter),
+                 static_cast<uint32_t>(counter >> 32), 0, 0},
+                key);
+            EXPECT_EQ(0, std::memcmp(expected.data(),
+                                     &data[n * PhiloxGenerator::blockSize],
+                                     PhiloxGenerator::blockSize))
+                << kernel.name << " block " << n;
+        }
+        /* the trailing partial block is not touched */
+        EXPECT_EQ(std::byte{0}, data.back()) << kernel.name;
+    }
+}
+
+/* Any offset and length gives the same bytes as one large fill */
+void expectSeekable(PatternType type)
+{
+    auto generator = makePatternGenerator(type, 0x6a656272);
+    std::vector<std::byte> whole(10000);
+    generator->fill(0, whole);
+
+    for (size_t offset : {0U, 1U, 15U, 16U, 17U, 4095U, 4096U, 9000U, 3U})
+    {
+        for (size_t length : {0U, 1U, 3U, 16U, 129U, 1000U})
+        {
+            length = std::min(length, whole.size() - offset);
+            std::vector<std::byte> part(length);
+            generator->fill(offset, part);
+            EXPECT_EQ(0, std::memcmp(part.data(), &whole[offset], length))
+                << "offset " << offset << " length " << length;
+        }
+    }
+}
+
+TEST(patternGenerator, philoxSeekable)
+{
+    expectSeekable(PatternType::Philox);
+}
+
+TEST(patternGenerator, minstdSeekable)
+{
+    expectSeekable(PatternType::Minstd);
+}
+
+/* The legacy generator writes the sequence older versions wrote */
+TEST(patternGenerator, minstdMatchesLegacy)
+{
+    constexpr uint32_t seed = 0x6a656272;
+    MinstdGenerator generator(seed);
+    std::vector<std::byte> data(8192);
+    generator.fill(0, data);
+
+    std::minstd_rand0 legacy(seed);
+    std::vector<uint32_t> words(data.size() / sizeof(uint32_t));
+    for (uint32_t& word : words)
+    {
+        word = legacy();
+    }
+    EXPECT_EQ(0, std::memcmp(words.data(), data.data(), data.size()));
+}
+
+/* Every find kernel stops at the first wrong block, in a vector or in the
+ * blocks after the last full one
+ */
+TEST(patternGenerator, philoxFindKernels)
+{
+    std::array<uint32_t, 2> key{0x6a656272, 0x5eed};
+    uint64_t index = 0xfffffffa;
+    for (const auto& kernel : philoxKernels())
+    {
+        std::vector<std::byte> data(37 * PhiloxGenerator::blockSize + 5);
+        kernel.fill(index, key, data);
+        EXPECT_EQ(37U, kernel.find(index, key, data)) << kernel.name;
+
+        for (size_t wrong : {0U, 3U, 8U, 9U, 31U, 32U, 36U})
+        {
+            std::vector<std::byte> copy = data;
+            copy[wrong * PhiloxGenerator::blockSize + 7] ^= std::byte{1};
+            EXPECT_EQ(wrong, kernel.find(index, key, copy))
+                << kernel.name << " block " << wrong;
+        }
+    }
+}
+
+/* mismatch finds the first wrong byte at any offset and length */
+void expectMismatch(PatternType type)
+{
+    auto generator = makePatternGenerator(type, 0x6a656272);
+    std::vector<std::byte> whole(10000);
+    generator->fill(0, whole);
+
+    for (size_t offset : {0U, 1U, 15U, 16U, 17U, 4095U, 3U})
+    {
+        for (size_t length : {0U, 1U, 3U, 16U, 129U, 1000U, 5000U})
+        {
+            std::span<std::byte> part(&whole[offset], length);
+            EXPECT_EQ(length, generator->mismatch(offset, part))
+                << "offset " << offset << " length " << length;
+
+            for (size_t wrong : {0UL, 1UL, 14UL, 15UL, 16UL, 200UL, 999UL,
+                                 length - 1})
+            {
+                if (wrong >= length)
+                {
+                    continue;
+                }
+                part[wrong] ^= std::byte{0x80};
+                EXPECT_EQ(wrong, generator->mismatch(offset, part))
+                    << "offset " << offset << " length " << length
+                    << " wrong " << wrong;
+                part[wrong] ^= std::byte{0x80};
+            }
+        }
+    }
+}
+
+TEST(patternGenerator, philoxMismatch)
+{
+    expectMismatch(PatternType::Philox);
+}
+
+TEST(patternGenerator, minstdMismatch)
+{
+    expectMismatch(PatternType::Minstd);
+}
+
+/* Only the first of several wrong bytes is reported */
+TEST(patternGenerator, mismatchReportsFirst)
+{
+    PhiloxGenerator generator(0x6a656272);
+    std::vector<std::byte> data(4096);
+    generator.fill(4096, data);
+    data[3000] = ~data[3000];
+    data[1234] = ~data[1234];
+    EXPECT_EQ(1234U, generator.mismatch(4096, data));
+}
+
+TEST(patternGenerator, seedsDiffer)
+{
+    std::vector<std::byte> first(4096);
+    std::vector<std::byte> second(4096);
+    PhiloxGenerator(1).fill(0, first);
+    PhiloxGenerator(2).fill(0, second);
+    EXPECT_NE(first, second);
+}
+
+} // namespace estoraged_test
@@ -1,3 +1,4 @@
+#include "badRangeMap.hpp"
 #include "estoraged_conf.hpp"
 #include "pattern.hpp"
 
@@ -10,6 +11,7 @@
 #include <xyz/openbmc_project/Common/error.hpp>
 
 #include <fstream>
+#include <iterator>
 #include <span>
 #include <system_error>
 
@@ -20,11 +22,16 @@
 namespace estoraged_test
 {
 
+using estoraged::BadRange;
+using estoraged::BadRangeKind;
+using estoraged::BadRangeMap;
 using estoraged::Pattern;
 using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
 using testing::_;
+using testing::ElementsAre;
 using testing::Invoke;
 using testing::Return;
+using testing::Throw;
 
 TEST(pattern, patternPass)
 {
@@ -71,6 +78,31 @@ TEST(pattern, patternNotDivisible)
     EXPECT_NO_THROW(pass.verifyPattern(size, readFd));
 }
 
+/* This test that a pattern written in large chunks can be verified with the
+ * default chunk size, since the pattern only depends on the offset
+ */
+TEST(pattern, patternLargeChunk)
+{
+    std::string testFileName = "largeChunk";
+    uint64_t size = 200000;
+    std::ofstream testFile;
+    testFile.open(testFileName,
+                  std::ios::out | std::ios::binary | std::ios::trunc);
+    testFile.close();
+
+    estoraged::EraseOptions options;
+    options.chunkSize = 65536;
+    stdplus::fd::Fd&& writeFd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    Pattern writer(testFileName, options);
+    EXPECT_NO_THROW(writer.writePattern(size, writeFd));
+
+    stdplus::fd::Fd&& readFd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    Pattern verifier(testFileName);
+    EXPECT_NO_THROW(verifier.verifyPattern(size, readFd));
+}
+
 TEST(pattern, patternsDontMatch)
 {
     std::string testFileName = "patternsDontMatch";
@@ -220,4 +252,135 @@ TEST(pattern, driveIsSmaller)
     EXPECT_THROW(tryPattern.verifyPattern(size, mocks), InternalFailure);
 }
 
+/* The pipelined write and verify see the same pattern as the plain ones */
+TEST(pattern, pipelinedPass)
+{
+    uint64_t size = 100000;
+    estoraged::EraseOptions options;
+    options.chunkSize = 4096;
+    options.pipelineDepth = 3;
+
+    std::string plainFileName = "pipelinePlain";
+    std::string testFileName = "pipelinePass";
+    for (const std::string& name : {plainFileName, testFileName})
+    {
+        std::ofstream testFile(name, std::ios::out | std::ios::binary |
+                                         std::ios::trunc);
+    }
+
+    stdplus::fd::ManagedFd plainFd =
+        stdplus::fd::open(plainFileName, stdplus::fd::OpenAccess::WriteOnly);
+    Pattern(plainFileName).writePattern(size, plainFd);
+
+    stdplus::fd::ManagedFd writeFd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    Pattern pipelined(testFileName, options);
+    EXPECT_NO_THROW(pipelined.writePattern(size, writeFd));
+
+    std::ifstream plain(plainFileName, std::ios::binary);
+    std::ifstream written(testFileName, std::ios::binary);
+    std::vector<char> expected{std::istreambuf_iterator<char>(plain),
+                               std::istreambuf_iterator<char>()};
+    std::vector<char> actual{std::istreambuf_iterator<char>(written),
+                             std::istreambuf_iterator<char>()};
+    EXPECT_EQ(size, actual.size());
+    EXPECT_EQ(expected, actual);
+
+    stdplus::fd::ManagedFd readFd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_NO_THROW(pipelined.verifyPattern(size, readFd));
+
+    /* a wrong byte in the last, partial chunk */
+    {
+        std::fstream corrupt(testFileName,
+                             std::ios::in | std::ios::out | std::ios::binary);
+        corrupt.seekp(static_cast<std::streamoff>(size - 10));
+        corrupt.put(static_cast<char>(~actual[size - 10]));
+    }
+    stdplus::fd::ManagedFd rereadFd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_THROW(pipelined.verifyPattern(size, rereadFd), InternalFailure);
+}
+
+/* Write and read failures on the pipeline threads reach the caller */
+TEST(pattern, pipelinedFail)
+{
+    std::string testFileName = "testfile_pipelinedFail";
+    uint64_t size = 4096 * 8;
+    estoraged::EraseOptions options;
+    options.chunkSize = 4096;
+    options.pipelineDepth = 2;
+    Pattern tryPattern(testFileName, options);
+
+    stdplus::fd::FdMock mocks;
+    EXPECT_CALL(mocks, write(_))
+        .WillRepeatedly(Return(std::span<std::byte>{}));
+    EXPECT_THROW(tryPattern.writePattern(size, mocks), InternalFailure);
+
+    EXPECT_CALL(mocks, read(_)).WillRepeatedly(Return(std::span<std::byte>{}));
+    EXPECT_THROW(tryPattern.verifyPattern(size, mocks), InternalFailure);
+}
+
+/* A tolerant write records the chunk that failed and writes the rest */
+TEST(pattern, tolerantWrite)
+{
+    Pattern pattern("patternTolerant");
+    BadRangeMap badRanges;
+    pattern.setBadRanges(&badRanges);
+
+    stdplus::fd::FdMock mock;
+    testing::InSequence s;
+    auto full = [](std::span<const std::byte> data) { return data; };
+    EXPECT_CALL(mock, write(_))
+        .WillOnce(Throw(std::system_error(EIO, std::generic_category())));
+    EXPECT_CALL(mock, lseek(4096, stdplus::fd::Whence::Set))
+        .WillOnce(Return(4096));
+    EXPECT_CALL(mock, write(_)).WillOnce(Invoke(full));
+
+    EXPECT_NO_THROW(pattern.writePattern(2 * 4096, mock));
+    EXPECT_THAT(badRanges.ranges(), ElementsAre(BadRange{0, 4096}));
+    EXPECT_EQ(1U, badRanges.count(BadRangeKind::Write));
+}
+
+/* A tolerant verify records every wrong sector, also when the options ask
+ * for a pipeline, which can't keep going
+ */
+TEST(pattern, tolerantVerify)
+{
+    std::string testFileName = "patternTolerantVerify";
+    uint64_t size = 4 * 4096;
+    std::ofstream testFile(testFileName, std::ios::binary | std::ios::trunc);
+    testFile.close();
+    {
+        stdplus::fd::ManagedFd writeFd = stdplus::fd::open(
+            testFileName, stdplus::fd::OpenAccess::WriteOnly);
+        Pattern(testFileName).writePattern(size, writeFd);
+    }
+    std::fstream file(testFileName,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    for (std::streamoff offset : {600, 4096 + 511, 4096 + 512, 3 * 4096})
+    {
+        file.seekg(offset);
+        char byte = 0;
+        file.read(&byte, 1);
+        byte = static_cast<char>(~byte);
+        file.seekp(offset);
+        file.write(&byte, 1);
+    }
+    file.close();
+
+    estoraged::EraseOptions options;
+    options.pipelineDepth = 3;
+    Pattern pattern(testFileName, options);
+    BadRangeMap badRanges;
+    pattern.setBadRanges(&badRanges);
+    stdplus::fd::ManagedFd readFd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_NO_THROW(pattern.verifyPattern(size, readFd));
+    EXPECT_THAT(badRanges.ranges(),
+                ElementsAre(BadRange{512, 512}, BadRange{4096, 1024},
+                            BadRange{3 * 4096, 512}));
+    EXPECT_EQ(3U, badRanges.count(BadRangeKind::Mismatch));
+}
+
 } // namespace estoraged_test
@@ -0,0 +1,117 @@
+#include "bufferPool.hpp"
+#include "pipeline.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::BufferPool;
+using estoraged::pipelinedPass;
+using testing::ElementsAre;
+
+TEST(pipeline, stagesSeeEveryChunkInOrder)
+{
+    BufferPool pool(3, 100, 64);
+    std::vector<std::pair<uint64_t, size_t>> produced;
+    std::vector<std::pair<uint64_t, size_t>> consumed;
+    pipelinedPass(
+        pool, 3, 50, 380,
+        [&produced](uint64_t offset, std::span<std::byte> chunk) {
+            produced.emplace_back(offset, chunk.size());
+            /* tag the buffer with the chunk */
+            chunk[0] = static_cast<std::byte>(offset / 10);
+        },
+        [&consumed](uint64_t offset, std::span<std::byte> chunk) {
+            EXPECT_EQ(static_cast<std::byte>(offset / 10), chunk[0]);
+            consumed.emplace_back(offset, chunk.size());
+        });
+
+    EXPECT_THAT(produced, ElementsAre(std::pair<uint64_t, size_t>(50, 100),
+                                      std::pair<uint64_t, size_t>(150, 100),
+                                      std::pair<uint64_t, size_t>(250, 100),
+                                      std::pair<uint64_t, size_t>(350, 30)));
+    EXPECT_EQ(produced, consumed);
+}
+
+/* The producer never gets more than slots chunks ahead */
+TEST(pipeline, producerIsBounded)
+{
+    BufferPool pool(2, 16, 16);
+    std::atomic<uint64_t> produced{0};
+    std::atomic<uint64_t> consumed{0};
+    std::atomic<uint64_t> maxAhead{0};
+    pipelinedPass(
+        pool, 2, 0, 16 * 50,
+        [&](uint64_t, std::span<std::byte>) {
+            uint64_t ahead = ++produced - consumed;
+            maxAhead = std::max(maxAhead.load(), ahead);
+        },
+        [&](uint64_t, std::span<std::byte>) { ++consumed; });
+
+    EXPECT_EQ(50U, consumed);
+    EXPECT_LE(maxAhead, 2U);
+}
+
+/* Chunks produced before a failure are still consumed */
+TEST(pipeline, producerErrorIsRethrown)
+{
+    BufferPool pool(4, 10, 16);
+    std::vector<uint64_t> consumed;
+    EXPECT_THROW(pipelinedPass(
+                     pool, 4, 0, 100,
+                     [](uint64_t offset, std::span<std::byte>) {
+                         if (offset == 30)
+                         {
+                             throw std::runtime_error("read failed");
+                         }
+                     },
+                     [&consumed](uint64_t offset, std::span<std::byte>) {
+                         consumed.push_back(offset);
+                     }),
+                 std::runtime_error);
+    EXPECT_THAT(consumed, ElementsAre(0, 10, 20));
+}
+
+TEST(pipeline, consumerErrorStopsProducer)
+{
+    BufferPool pool(2, 10, 16);
+    std::atomic<uint64_t> produced{0};
+    EXPECT_THROW(pipelinedPass(
+                     pool, 2, 0, 1000,
+                     [&produced](uint64_t, std::span<std::byte>) {
+                         produced++;
+                     },
+                     [](uint64_t offset, std::span<std::byte>) {
+                         if (offset == 20)
+                         {
+                             throw std::runtime_error("mismatch");
+                         }
+                     }),
+                 std::runtime_error);
+    /* chunks 0 to 2 and at most the two slots after them */
+    EXPECT_LE(produced, 5U);
+}
+
+TEST(pipeline, emptyRange)
+{
+    BufferPool pool(2, 10, 16);
+    bool called = false;
+    pipelinedPass(
+        pool, 2, 100, 100,
+        [&called](uint64_t, std::span<std::byte>) { called = true; },
+        [&called](uint64_t, std::span<std::byte>) { called = true; });
+    EXPECT_FALSE(called);
+}
+
+} // namespace estoraged_test
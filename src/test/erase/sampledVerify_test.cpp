@@ -0,0 +1,139 @@
+#include "bufferPool.hpp"
+#include "pattern.hpp"
+#include "sampledVerify.hpp"
+#include "zero.hpp"
+
+#include <stdplus/fd/create.hpp>
+#include <stdplus/fd/managed.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::BufferPool;
+using estoraged::EraseOptions;
+using estoraged::sampleChunks;
+using estoraged::sampledVerify;
+using estoraged::sampleSize;
+using estoraged::SampleResult;
+using estoraged::Zero;
+using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+
+TEST(sampledVerify, sampleSizeFromConfidence)
+{
+    /* ceil(ln(0.01) / ln(0.999)) = 4603 */
+    EXPECT_EQ(4603U, sampleSize(0.99, 0.001, 1000000));
+    /* ceil(ln(0.05) / ln(0.99)) = 299 */
+    EXPECT_EQ(299U, sampleSize(0.95, 0.01, 1000000));
+    /* never more than the device */
+    EXPECT_EQ(100U, sampleSize(0.99, 0.001, 100));
+    /* out of range parameters read everything */
+    EXPECT_EQ(500U, sampleSize(1.0, 0.001, 500));
+    EXPECT_EQ(500U, sampleSize(0.99, 0, 500));
+}
+
+TEST(sampledVerify, chunksAreDistinctAndSorted)
+{
+    std::vector<uint64_t> chunks = sampleChunks(1000, 5000);
+    ASSERT_EQ(1000U, chunks.size());
+    EXPECT_TRUE(std::ranges::is_sorted(chunks));
+    EXPECT_EQ(1000U, std::set<uint64_t>(chunks.begin(), chunks.end()).size());
+    EXPECT_LT(chunks.back(), 5000U);
+
+    /* two samples are not the same */
+    EXPECT_NE(chunks, sampleChunks(1000, 5000));
+
+    /* asking for everything gives every chunk */
+    std::vector<uint64_t> all = sampleChunks(10, 10);
+    EXPECT_EQ((std::vector<uint64_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), all);
+}
+
+/* Creates a file of zeros, or of ones if bad is set */
+void makeSampleFile(const std::string& name, size_t size, bool bad = false)
+{
+    std::vector<char> data(size, bad ? 1 : 0);
+    std::ofstream testFile(name,
+                           std::ios::out | std::ios::binary | std::ios::trunc);
+    testFile.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+TEST(sampledVerify, reportsCoverage)
+{
+    std::string testFileName = "sampledVerifyCoverage";
+    uint64_t size = 4096 * 1000;
+    makeSampleFile(testFileName, size);
+    stdplus::fd::ManagedFd fd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+
+    BufferPool pool(2, 4096, 4096);
+    size_t calls = 0;
+    SampleResult result = sampledVerify(
+        fd.get(), size, pool, 0.95, 0.01,
+        [&calls](size_t, uint64_t offset, std::span<const std::byte> data,
+                 std::span<std::byte>) {
+            EXPECT_EQ(0U, offset % 4096);
+            calls++;
+            return data.size();
+        });
+    EXPECT_EQ(299U, result.samples);
+    EXPECT_EQ(299U, calls);
+    EXPECT_EQ(1000U, result.chunks);
+    EXPECT_DOUBLE_EQ(0.299, result.coverage);
+    EXPECT_FALSE(result.firstMismatch);
+}
+
+TEST(sampledVerify, zeroSampled)
+{
+    std::string testFileName = "sampledVerifyZero";
+    uint64_t size = 4096 * 1000;
+    makeSampleFile(testFileName, size);
+    EraseOptions options;
+    options.verifySampleConfidence = 0.99;
+    options.verifySampleDefectRate = 0.01;
+    Zero zero(testFileName, options);
+
+    stdplus::fd::ManagedFd fd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_TRUE(zero.verifyZeroSampled(size, fd.get()));
+
+    /* every chunk is bad, so any sample finds it */
+    makeSampleFile(testFileName, size, true);
+    EXPECT_THROW(zero.verifyZeroSampled(size, fd.get()), InternalFailure);
+
+    Zero full(testFileName);
+    EXPECT_FALSE(full.verifyZeroSampled(size, fd.get()));
+}
+
+TEST(sampledVerify, patternSampled)
+{
+    std::string testFileName = "sampledVerifyPattern";
+    uint64_t size = 4096 * 500 + 100;
+    makeSampleFile(testFileName, 0);
+    for (auto type :
+         {estoraged::PatternType::Philox, estoraged::PatternType::Minstd})
+    {
+        EraseOptions options;
+        options.verifySampleConfidence = 0.9;
+        options.verifySampleDefectRate = 0.05;
+        options.patternType = type;
+        estoraged::Pattern pattern(testFileName, options);
+
+        stdplus::fd::ManagedFd writeFd = stdplus::fd::open(
+            testFileName, stdplus::fd::OpenAccess::WriteOnly);
+        pattern.writePattern(size, writeFd);
+
+        stdplus::fd::ManagedFd fd =
+            stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+        EXPECT_TRUE(pattern.verifyPatternSampled(size, fd.get()));
+    }
+}
+
+} // namespace estoraged_test
@@ -1,13 +1,23 @@
+#include "eraseProgress.hpp"
 #include "estoraged_conf.hpp"
 #include "sanitize.hpp"
 
+#include <linux/mmc/core.h>
+#include <linux/mmc/mmc.h>
 #include <sys/ioctl.h>
 
 #include <stdplus/fd/managed.hpp>
 #include <xyz/openbmc_project/Common/error.hpp>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <vector>
 
 #include <gmock/gmock-matchers.h>
 #include <gmock/gmock.h>
@@ -16,8 +26,16 @@
 namespace estoraged_test
 {
 
+using estoraged::EmmcEraseGeometry;
+using estoraged::EraseCancelled;
+using estoraged::EraseProgress;
+using estoraged::EraseProgressStatus;
+using estoraged::extCsdSize;
+using estoraged::MmcIoMultiCmdErase;
 using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
 using ::testing::_;
+using ::testing::ElementsAre;
+using ::testing::Invoke;
 using ::testing::Return;
 
 class IOCTLWrapperMock : public estoraged::IOCTLWrapperInterface
@@ -28,6 +46,11 @@ class IOCTLWrapperMock : public estoraged::IOCTLWrapperInterface
                  struct mmc_ioc_cmd idata),
                 (override));
 
+    MOCK_METHOD(int, doIoctlResponse,
+                (std::string_view devPath, unsigned long request,
+                 struct mmc_ioc_cmd& idata),
+                (override));
+
     MOCK_METHOD(int, doIoctlMulti,
                 (std::string_view devPath, unsigned long request,
                  struct estoraged::MmcIoMultiCmdErase),
@@ -69,4 +92,390 @@ TEST(Sanitize, Sanitize_emmcSanitize)
     EXPECT_THROW(ioctlSanitize.doSanitize(4000000000), InternalFailure);
 }
 
+/* EXT_CSD of an 8 GB device with 512 KiB erase groups that take up to
+ * 30 s each
+ */
+std::array<uint8_t, extCsdSize> highCapacityExtCsd()
+{
+    std::array<uint8_t, extCsdSize> extCsd{};
+    uint32_t sectors = 16777216;
+    for (size_t i = 0; i < 4; i++)
+    {
+        extCsd[212 + i] = static_cast<uint8_t>(sectors >> (8 * i));
+    }
+    extCsd[175] = 1;   // ERASE_GROUP_DEF
+    extCsd[223] = 100; // ERASE_TIMEOUT_MULT
+    extCsd[224] = 1;   // HC_ERASE_GRP_SIZE
+    return extCsd;
+}
+
+/* Answers SEND_EXT_CSD with the given register, and everything else with
+ * success
+ */
+auto answerExtCsd(const std::array<uint8_t, extCsdSize>& extCsd)
+{
+    return [extCsd](std::string_view, unsigned long, struct mmc_ioc_cmd idata) {
+        if (idata.opcode == MMC_SEND_EXT_CSD)
+        {
+            std::ranges::copy(extCsd, reinterpret_cast<uint8_t*>(
+                                          static_cast<uintptr_t>(
+                                              idata.data_ptr)));
+        }
+        return 0;
+    };
+}
+
+/* First and last address and timeout of every erase */
+using EraseCall = std::tuple<uint32_t, uint32_t, uint32_t>;
+
+auto recordErase(std::vector<EraseCall>& calls)
+{
+    return [&calls](std::string_view, unsigned long, MmcIoMultiCmdErase cmd) {
+        calls.emplace_back(cmd.cmds[0].arg, cmd.cmds[1].arg,
+                           cmd.cmds[2].cmd_timeout_ms);
+        return 0;
+    };
+}
+
+TEST(Sanitize, parseEraseGeometry)
+{
+    EmmcEraseGeometry geometry =
+        estoraged::parseEraseGeometry(highCapacityExtCsd());
+    EXPECT_EQ(512U, geometry.addressUnit);
+    EXPECT_EQ(512U * 1024, geometry.groupSize);
+    EXPECT_EQ(30000U, geometry.groupTimeoutMs);
+
+    /* no high capacity erase groups, and byte addressing */
+    std::array<uint8_t, extCsdSize> extCsd{};
+    extCsd[223] = 100;
+    extCsd[224] = 1;
+    geometry = estoraged::parseEraseGeometry(extCsd);
+    EXPECT_EQ(1U, geometry.addressUnit);
+    EXPECT_EQ(0U, geometry.groupSize);
+    EXPECT_EQ(0U, geometry.groupTimeoutMs);
+}
+
+/* Chunks of whole erase groups, each with the timeout of its groups */
+TEST(Sanitize, chunkedErase)
+{
+    std::unique_ptr<IOCTLWrapperMock> mockIOCTL =
+        std::make_unique<IOCTLWrapperMock>();
+    IOCTLWrapperMock* mockPtr = mockIOCTL.get();
+    std::vector<EraseCall> calls;
+    EXPECT_CALL(*mockPtr, doIoctl(_, _, _))
+        .WillRepeatedly(Invoke(answerExtCsd(highCapacityExtCsd())));
+    EXPECT_CALL(*mockPtr, doIoctlMulti(_, _, _))
+        .WillRepeatedly(Invoke(recordErase(calls)));
+
+    std::vector<EraseProgressStatus> reports;
+    EraseProgress progress(
+        [&reports](const EraseProgressStatus& status) {
+            reports.push_back(status);
+        },
+        std::chrono::seconds(0));
+    estoraged::Sanitize sanitize("/dev/null", std::move(mockIOCTL));
+    sanitize.setProgress(&progress);
+    EXPECT_NO_THROW(sanitize.doSanitize((2 << 20) + 4096));
+
+    /* 2 groups of 1024 sectors fit in maxEraseCommandMs */
+    EXPECT_THAT(calls, ElementsAre(EraseCall{0, 2047, 60000},
+                                   EraseCall{2048, 4095, 60000},
+                                   EraseCall{4096, 4103, 30000}));
+    ASSERT_FALSE(reports.empty());
+    EXPECT_EQ(100, reports.back().percent);
+    EXPECT_EQ((2U << 20) + 4096, reports.back().bytesProcessed);
+}
+
+/* Without EXT_CSD, the whole device is erased in one command */
+TEST(Sanitize, eraseWithoutExtCsd)
+{
+    std::unique_ptr<IOCTLWrapperMock> mockIOCTL =
+        std::make_unique<IOCTLWrapperMock>();
+    IOCTLWrapperMock* mockPtr = mockIOCTL.get();
+    std::vector<EraseCall> calls;
+    EXPECT_CALL(*mockPtr, doIoctl(_, _, _))
+        .WillRepeatedly(
+            Invoke([](std::string_view, unsigned long,
+                      struct mmc_ioc_cmd idata) {
+                return idata.opcode == MMC_SEND_EXT_CSD ? -1 : 0;
+            }));
+    EXPECT_CALL(*mockPtr, doIoctlMulti(_, _, _))
+        .WillRepeatedly(Invoke(recordErase(calls)));
+
+    estoraged::Sanitize sanitize("/dev/null", std::move(mockIOCTL));
+    EXPECT_NO_THROW(sanitize.doSanitize(4000000000));
+    EXPECT_THAT(calls,
+                ElementsAre(EraseCall{
+                    0, 4000000000 / 512 - 1,
+                    estoraged::Sanitize::legacyEraseTimeoutMs}));
+}
+
+/* Without EXT_CSD, nothing shows the device can clear or purge */
+TEST(Sanitize, noExtCsdForPolicy)
+{
+    for (auto policy : {estoraged::EmmcErasePolicy::Clear,
+                        estoraged::EmmcErasePolicy::Purge})
+    {
+        std::unique_ptr<IOCTLWrapperMock> mockIOCTL =
+            std::make_unique<IOCTLWrapperMock>();
+        IOCTLWrapperMock* mockPtr = mockIOCTL.get();
+        EXPECT_CALL(*mockPtr, doIoctl(_, _, _))
+            .WillRepeatedly(
+                Invoke([](std::string_view, unsigned long,
+                          struct mmc_ioc_cmd idata) {
+                    EXPECT_EQ(MMC_SEND_EXT_CSD, idata.opcode);
+                    return -1;
+                }));
+        EXPECT_CALL(*mockPtr, doIoctlMulti(_, _, _)).Times(0);
+
+        estoraged::Sanitize sanitize("/dev/null", std::move(mockIOCTL));
+        sanitize.setPolicy(policy);
+        EXPECT_THROW(sanitize.doSanitize(4000000000), InternalFailure);
+    }
+}
+
+/* A cancel stops the erase at the next chunk, and is not a failure */
+TEST(Sanitize, cancelBetweenChunks)
+{
+    std::unique_ptr<IOCTLWrapperMock> mockIOCTL =
+        std::make_unique<IOCTLWrapperMock>();
+    IOCTLWrapperMock* mockPtr = mockIOCTL.get();
+    std::vector<EraseCall> calls;
+    EXPECT_CALL(*mockPtr, doIoctl(_, _, _))
+        .WillRepeatedly(Invoke(answerExtCsd(highCapacityExtCsd())));
+    EXPECT_CALL(*mockPtr, doIoctlMulti(_, _, _))
+        .WillRepeatedly(Invoke(recordErase(calls)));
+
+    EraseProgress progress([](const EraseProgressStatus&) {});
+    estoraged::Sanitize sanitize("/dev/null", std::move(mockIOCTL));
+    sanitize.setProgress(&progress);
+    progress.cancel();
+    EXPECT_THROW(sanitize.doSanitize(64 << 20), EraseCancelled);
+    EXPECT_EQ(1U, calls.size());
+}
+
+/* The purge policy picks discard, the fastest, then sanitizes */
+TEST(Sanitize, purgePlan)
+{
+    std::array<uint8_t, extCsdSize> extCsd = highCapacityExtCsd();
+    extCsd[192] = 6;      // EXT_CSD_REV, DISCARD
+    extCsd[231] = 1 << 6; // SEC_FEATURE_SUPPORT, SEC_SANITIZE
+    extCsd[232] = 1;      // TRIM_MULT
+
+    std::unique_ptr<IOCTLWrapperMock> mockIOCTL =
+        std::make_unique<IOCTLWrapperMock>();
+    IOCTLWrapperMock* mockPtr = mockIOCTL.get();
+    std::vector<uint32_t> opcodes;
+    EXPECT_CALL(*mockPtr, doIoctl(_, _, _))
+        .WillRepeatedly(Invoke([&opcodes, answer = answerExtCsd(extCsd)](
+                                   std::string_view devPath,
+                                   unsigned long request,
+                                   struct mmc_ioc_cmd idata) {
+            opcodes.push_back(idata.opcode);
+            return answer(devPath, request, idata);
+        }));
+    std::vector<uint32_t> eraseArgs;
+    std::vector<EraseCall> calls;
+    EXPECT_CALL(*mockPtr, doIoctlMulti(_, _, _))
+        .WillRepeatedly(Invoke([&eraseArgs, &calls](std::string_view,
+                                                    unsigned long,
+                                                    MmcIoMultiCmdErase cmd) {
+            eraseArgs.push_back(cmd.cmds[2].arg);
+            calls.emplace_back(cmd.cmds[0].arg, cmd.cmds[1].arg,
+                               cmd.cmds[2].cmd_timeout_ms);
+            return 0;
+        }));
+
+    std::vector<EraseProgressStatus> reports;
+    EraseProgress progress(
+        [&reports](const EraseProgressStatus& status) {
+            reports.push_back(status);
+        },
+        std::chrono::seconds(0));
+    estoraged::Sanitize sanitize("/dev/null", std::move(mockIOCTL));
+    sanitize.setProgress(&progress);
+    sanitize.setPolicy(estoraged::EmmcErasePolicy::Purge);
+    EXPECT_NO_THROW(sanitize.doSanitize(1 << 20));
+
+    /* 2 groups of 300 ms fit in one command */
+    EXPECT_THAT(eraseArgs, ElementsAre(3U));
+    EXPECT_THAT(calls, ElementsAre(EraseCall{0, 2047, 600}));
+    EXPECT_THAT(opcodes, ElementsAre(MMC_SEND_EXT_CSD, MMC_SWITCH));
+    ASSERT_FALSE(reports.empty());
+    EXPECT_EQ("Discard+Sanitize", reports.back().eraseSteps);
+    EXPECT_EQ(240U, reports.back().estimatedSeconds);
+    EXPECT_EQ(100, reports.back().percent);
+}
+
+/* A device without a purging erase fails the purge policy untouched */
+TEST(Sanitize, noPlanForPolicy)
+{
+    std::unique_ptr<IOCTLWrapperMock> mockIOCTL =
+        std::make_unique<IOCTLWrapperMock>();
+    IOCTLWrapperMock* mockPtr = mockIOCTL.get();
+    EXPECT_CALL(*mockPtr, doIoctl(_, _, _))
+        .WillRepeatedly(Invoke(answerExtCsd(highCapacityExtCsd())));
+    EXPECT_CALL(*mockPtr, doIoctlMulti(_, _, _)).Times(0);
+
+    estoraged::Sanitize sanitize("/dev/null", std::move(mockIOCTL));
+    sanitize.setPolicy(estoraged::EmmcErasePolicy::Purge);
+    EXPECT_THROW(sanitize.doSanitize(1 << 20), InternalFailure);
+}
+
+/* Card status answers to CMD13 */
+constexpr uint32_t statusPrg = 7 << 9;
+constexpr uint32_t statusTran = (4 << 9) | (1 << 8);
+constexpr uint32_t statusSwitchError = 1 << 7;
+
+auto answerStatus(std::vector<uint32_t> statuses)
+{
+    // gmock copies the action, so the position is shared
+    auto next = std::make_shared<size_t>(0);
+    return [statuses, next](std::string_view, unsigned long,
+                            struct mmc_ioc_cmd& idata) {
+        EXPECT_EQ(13U, idata.opcode);
+        EXPECT_EQ(1U << 16, idata.arg);
+        idata.response[0] =
+            statuses[std::min((*next)++, statuses.size() - 1)];
+        return 0;
+    };
+}
+
+/* The sanitize is started without busy wait, then polled until done */
+TEST(Sanitize, pollingSanitize)
+{
+    std::unique_ptr<IOCTLWrapperMock> mockIOCTL =
+        std::make_unique<IOCTLWrapperMock>();
+    IOCTLWrapperMock* mockPtr = mockIOCTL.get();
+    EXPECT_CALL(*mockPtr, doIoctl(_, _, _))
+        .WillRepeatedly(Invoke([](std::string_view, unsigned long,
+                                  struct mmc_ioc_cmd idata) {
+            if (idata.opcode == MMC_SWITCH)
+            {
+                EXPECT_EQ(0U, idata.flags & MMC_RSP_BUSY);
+            }
+            return 0;
+        }));
+    EXPECT_CALL(*mockPtr, doIoctlMulti(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*mockPtr, doIoctlResponse(_, _, _))
+        .Times(3)
+        .WillRepeatedly(
+            Invoke(answerStatus({statusPrg, statusPrg, statusTran})));
+
+    std::vector<bool> busy;
+    EraseProgress progress([&busy](const EraseProgressStatus& status) {
+        busy.push_back(status.deviceBusy);
+    });
+    estoraged::Sanitize sanitize("/dev/null", std::move(mockIOCTL));
+    sanitize.setProgress(&progress);
+    sanitize.setStatusPolling(std::chrono::seconds(10),
+                              std::chrono::milliseconds(1));
+    EXPECT_NO_THROW(sanitize.doSanitize(52428800));
+
+    /* busy from the start of the sanitize to its end */
+    ASSERT_GE(busy.size(), 3U);
+    EXPECT_TRUE(busy.at(busy.size() - 3));
+    EXPECT_FALSE(busy.at(busy.size() - 2));
+    EXPECT_FALSE(busy.back());
+}
+
+/* The kernel waits for the sanitize inside the ioctl for cmd_timeout_ms */
+TEST(Sanitize, sanitizeTimeoutPassed)
+{
+    for (auto [timeout, expected] :
+         {std::make_tuple(std::chrono::milliseconds(0),
+                          estoraged::Sanitize::sanitizeTimeoutMs),
+          std::make_tuple(std::chrono::milliseconds(600000), 600000U)})
+    {
+        std::unique_ptr<IOCTLWrapperMock> mockIOCTL =
+            std::make_unique<IOCTLWrapperMock>();
+        IOCTLWrapperMock* mockPtr = mockIOCTL.get();
+        uint32_t switchTimeout = 0;
+        EXPECT_CALL(*mockPtr, doIoctl(_, _, _))
+            .WillRepeatedly(Invoke([&switchTimeout](std::string_view,
+                                                    unsigned long,
+                                                    struct mmc_ioc_cmd idata) {
+                if (idata.opcode == MMC_SWITCH)
+                {
+                    switchTimeout = idata.cmd_timeout_ms;
+                }
+                return 0;
+            }));
+        EXPECT_CALL(*mockPtr, doIoctlMulti(_, _, _)).WillRepeatedly(Return(0));
+        EXPECT_CALL(*mockPtr, doIoctlResponse(_, _, _))
+            .WillRepeatedly(Invoke(answerStatus({statusTran})));
+
+        estoraged::Sanitize sanitize("/dev/null", std::move(mockIOCTL));
+        sanitize.setStatusPolling(timeout, std::chrono::milliseconds(1));
+        EXPECT_NO_THROW(sanitize.doSanitize(52428800));
+        EXPECT_EQ(expected, switchTimeout);
+    }
+}
+
+TEST(Sanitize, pollingTimeout)
+{
+    std::unique_ptr<IOCTLWrapperMock> mockIOCTL =
+        std::make_unique<IOCTLWrapperMock>();
+    IOCTLWrapperMock* mockPtr = mockIOCTL.get();
+    EXPECT_CALL(*mockPtr, doIoctl(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*mockPtr, doIoctlMulti(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*mockPtr, doIoctlResponse(_, _, _))
+        .WillRepeatedly(Invoke(answerStatus({statusPrg})));
+
+    std::vector<bool> busy;
+    EraseProgress progress([&busy](const EraseProgressStatus& status) {
+        busy.push_back(status.deviceBusy);
+    });
+    estoraged::Sanitize sanitize("/dev/null", std::move(mockIOCTL));
+    sanitize.setProgress(&progress);
+    sanitize.setStatusPolling(std::chrono::milliseconds(20),
+                              std::chrono::milliseconds(1));
+    EXPECT_THROW(sanitize.doSanitize(52428800), InternalFailure);
+
+    /* the device is no longer reported busy once the wait gave up */
+    ASSERT_FALSE(busy.empty());
+    EXPECT_FALSE(busy.back());
+}
+
+TEST(Sanitize, pollingStatusError)
+{
+    std::unique_ptr<IOCTLWrapperMock> mockIOCTL =
+        std::make_unique<IOCTLWrapperMock>();
+    IOCTLWrapperMock* mockPtr = mockIOCTL.get();
+    EXPECT_CALL(*mockPtr, doIoctl(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*mockPtr, doIoctlMulti(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*mockPtr, doIoctlResponse(_, _, _))
+        .Times(2)
+        .WillRepeatedly(Invoke(
+            answerStatus({statusPrg, statusTran | statusSwitchError})));
+
+    estoraged::Sanitize sanitize("/dev/null", std::move(mockIOCTL));
+    sanitize.setStatusPolling(std::chrono::seconds(10),
+                              std::chrono::milliseconds(1));
+    EXPECT_THROW(sanitize.doSanitize(52428800), InternalFailure);
+}
+
+/* A failed status read fails the sanitize */
+TEST(Sanitize, pollingReadFailure)
+{
+    std::unique_ptr<IOCTLWrapperMock> mockIOCTL =
+        std::make_unique<IOCTLWrapperMock>();
+    IOCTLWrapperMock* mockPtr = mockIOCTL.get();
+    EXPECT_CALL(*mockPtr, doIoctl(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*mockPtr, doIoctlMulti(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*mockPtr, doIoctlResponse(_, _, _)).WillOnce(Return(-1));
+
+    std::vector<bool> busy;
+    EraseProgress progress([&busy](const EraseProgressStatus& status) {
+        busy.push_back(status.deviceBusy);
+    });
+    estoraged::Sanitize sanitize("/dev/null", std::move(mockIOCTL));
+    sanitize.setProgress(&progress);
+    sanitize.setStatusPolling(std::chrono::seconds(10),
+                              std::chrono::milliseconds(1));
+    EXPECT_THROW(sanitize.doSanitize(52428800), InternalFailure);
+    ASSERT_FALSE(busy.empty());
+    EXPECT_FALSE(busy.back());
+}
+
 } // namespace estoraged_test
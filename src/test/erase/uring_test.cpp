@@ -0,0 +1,330 @@
+#include "bufferPool.hpp"
+#include "eraseProgress.hpp"
+#include "estoraged_conf.hpp"
+#include "pattern.hpp"
+#include "uring.hpp"
+#include "zero.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <stdplus/fd/create.hpp>
+#include <stdplus/fd/managed.hpp>
+#include <xyz/openbmc_project/Common/error.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::BufferPool;
+using estoraged::EraseOptions;
+using estoraged::Pattern;
+using estoraged::Uring;
+using estoraged::Zero;
+using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
+
+/* io_uring may be disabled by the kernel or a seccomp filter */
+bool uringAvailable()
+{
+    try
+    {
+        Uring ring(4);
+        return true;
+    }
+    catch (const std::system_error&)
+    {
+        return false;
+    }
+}
+
+/* Creates a file of the given size filled with a non-zero byte */
+void makeFile(const std::string& name, size_t size)
+{
+    std::ofstream testFile(name,
+                           std::ios::out | std::ios::binary | std::ios::trunc);
+    std::vector<char> data(size, '\x5a');
+    testFile.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+/* Overwrites one byte of the file */
+void corruptFile(const std::string& name, size_t offset)
+{
+    std::fstream testFile(name, std::ios::in | std::ios::out |
+                                    std::ios::binary);
+    testFile.seekp(static_cast<std::streamoff>(offset));
+    testFile.put('\x01');
+}
+
+EraseOptions uringOptions()
+{
+    EraseOptions options;
+    options.chunkSize = 8192;
+    options.queueDepth = 4;
+    return options;
+}
+
+TEST(Uring, zeroPass)
+{
+    if (!uringAvailable())
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    std::string testFileName = "uringZeroPass";
+    uint64_t size = 100000;
+    makeFile(testFileName, size);
+
+    Zero pass(testFileName, uringOptions());
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    EXPECT_TRUE(pass.writeZeroUring(size, write.get()));
+
+    stdplus::fd::ManagedFd read =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_TRUE(pass.verifyZeroUring(size, read.get()));
+
+    /* the synchronous path agrees with what io_uring wrote */
+    stdplus::fd::ManagedFd syncRead =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_NO_THROW(pass.verifyZero(size, syncRead));
+}
+
+TEST(Uring, zeroVerifyFail)
+{
+    if (!uringAvailable())
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    std::string testFileName = "uringZeroVerifyFail";
+    uint64_t size = 100000;
+    makeFile(testFileName, size);
+
+    Zero zero(testFileName, uringOptions());
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    EXPECT_TRUE(zero.writeZeroUring(size, write.get()));
+    corruptFile(testFileName, 50000);
+
+    stdplus::fd::ManagedFd read =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_THROW(zero.verifyZeroUring(size, read.get()), InternalFailure);
+}
+
+/* Reading past the end of the file only returns short reads */
+TEST(Uring, shortReadFail)
+{
+    if (!uringAvailable())
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    std::string testFileName = "uringShortRead";
+    makeFile(testFileName, 4096);
+
+    Zero zero(testFileName, uringOptions());
+    stdplus::fd::ManagedFd read =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_THROW(zero.verifyZeroUring(65536, read.get()), InternalFailure);
+}
+
+TEST(Uring, patternPass)
+{
+    if (!uringAvailable())
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    std::string testFileName = "uringPatternPass";
+    uint64_t size = 100001;
+    makeFile(testFileName, 0);
+
+    Pattern pass(testFileName, uringOptions());
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    EXPECT_TRUE(pass.writePatternUring(size, write.get()));
+
+    stdplus::fd::ManagedFd read =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_TRUE(pass.verifyPatternUring(size, read.get()));
+
+    /* the synchronous path generates the same sequence */
+    stdplus::fd::ManagedFd syncRead =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_NO_THROW(pass.verifyPattern(size, syncRead));
+}
+
+TEST(Uring, patternVerifyFail)
+{
+    if (!uringAvailable())
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    std::string testFileName = "uringPatternVerifyFail";
+    uint64_t size = 100000;
+    makeFile(testFileName, 0);
+
+    Pattern pattern(testFileName, uringOptions());
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    EXPECT_TRUE(pattern.writePatternUring(size, write.get()));
+    corruptFile(testFileName, 99999);
+
+    stdplus::fd::ManagedFd read =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_THROW(pattern.verifyPatternUring(size, read.get()),
+                 InternalFailure);
+}
+
+/* A resumed write leaves the part before the offset alone */
+TEST(Uring, zeroResumePass)
+{
+    if (!uringAvailable())
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    std::string testFileName = "uringZeroResume";
+    uint64_t size = 100000;
+    makeFile(testFileName, size);
+
+    estoraged::EraseProgress progress(
+        [](const estoraged::EraseProgressStatus&) {});
+    Zero zero(testFileName, uringOptions());
+    zero.setProgress(&progress);
+    zero.setStartOffset(16384);
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    EXPECT_TRUE(zero.writeZeroUring(size, write.get()));
+    EXPECT_EQ(size, progress.bytesProcessed());
+
+    std::ifstream testFile(testFileName, std::ios::binary);
+    std::vector<char> data(size);
+    testFile.read(data.data(), static_cast<std::streamsize>(size));
+    EXPECT_EQ(std::vector<char>(16384, '\x5a'),
+              std::vector<char>(data.begin(), data.begin() + 16384));
+    EXPECT_EQ(std::vector<char>(size - 16384, '\0'),
+              std::vector<char>(data.begin() + 16384, data.end()));
+}
+
+/* Progress only counts chunks below the oldest write in flight */
+TEST(Uring, cancelKeepsWrittenPrefix)
+{
+    if (!uringAvailable())
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    std::string testFileName = "uringPatternCancel";
+    uint64_t size = 100000;
+    makeFile(testFileName, size);
+
+    estoraged::EraseProgress* tracker = nullptr;
+    estoraged::EraseProgress progress(
+        [&tracker](const estoraged::EraseProgressStatus& s) {
+            if (s.bytesProcessed >= 16384)
+            {
+                tracker->cancel();
+            }
+        },
+        std::chrono::seconds(0));
+    tracker = &progress;
+
+    Pattern pattern(testFileName, uringOptions());
+    pattern.setProgress(&progress);
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    EXPECT_THROW(pattern.writePatternUring(size, write.get()),
+                 estoraged::EraseCancelled);
+    uint64_t done = progress.bytesProcessed();
+    EXPECT_GE(done, 16384U);
+    EXPECT_LT(done, size);
+    EXPECT_EQ(0U, done % uringOptions().chunkSize);
+}
+
+/* More slots than the ring holds only keep entries() requests in flight */
+TEST(Uring, slotsLimitedToRing)
+{
+    if (!uringAvailable())
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    std::string testFileName = "uringSlotsLimited";
+    uint64_t size = 100000;
+    makeFile(testFileName, size);
+
+    Uring ring(4);
+    BufferPool pool(10, 8192, 4096);
+    ring.registerBuffers(pool);
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    estoraged::uringWrite(ring, write.get(), pool, 9, size,
+                          [](uint64_t offset, std::span<std::byte> chunk) {
+        std::ranges::fill(chunk, static_cast<std::byte>(offset / 8192 + 1));
+    });
+
+    std::ifstream testFile(testFileName, std::ios::binary);
+    std::vector<char> data(size);
+    testFile.read(data.data(), static_cast<std::streamsize>(size));
+    for (uint64_t offset = 0; offset < size; offset += 8192)
+    {
+        EXPECT_EQ(static_cast<char>(offset / 8192 + 1), data[offset]);
+    }
+}
+
+/* A cancel with writes in flight waits for them, and leaves the ring empty
+ * for the next erase */
+TEST(Uring, cancelDrainsWrites)
+{
+    if (!uringAvailable())
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    std::string testFileName = "uringCancelDrains";
+    uint64_t size = 100000;
+    makeFile(testFileName, size);
+
+    Uring ring(4);
+    BufferPool pool(5, 8192, 4096);
+    ring.registerBuffers(pool);
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    auto zeros = [](uint64_t, std::span<std::byte> chunk) {
+        std::ranges::fill(chunk, std::byte{0});
+    };
+    EXPECT_THROW(estoraged::uringWrite(
+                     ring, write.get(), pool, 4, size, zeros,
+                     [](uint64_t) { throw estoraged::EraseCancelled(); }),
+                 estoraged::EraseCancelled);
+    EXPECT_EQ(0U, ring.pending());
+
+    EXPECT_NO_THROW(
+        estoraged::uringWrite(ring, write.get(), pool, 4, size, zeros));
+    EXPECT_EQ(0U, ring.pending());
+    std::ifstream testFile(testFileName, std::ios::binary);
+    std::vector<char> data(size);
+    testFile.read(data.data(), static_cast<std::streamsize>(size));
+    EXPECT_EQ(std::vector<char>(size, '\0'), data);
+}
+
+/* A queue depth of one keeps the synchronous path */
+TEST(Uring, queueDepthOneDisabled)
+{
+    std::string testFileName = "uringDisabled";
+    uint64_t size = 4096;
+    makeFile(testFileName, size);
+
+    Zero zero(testFileName);
+    stdplus::fd::ManagedFd write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::WriteOnly);
+    EXPECT_FALSE(zero.writeZeroUring(size, write.get()));
+
+    Pattern pattern(testFileName);
+    EXPECT_FALSE(pattern.writePatternUring(size, write.get()));
+}
+
+} // namespace estoraged_test
@@ -0,0 +1,70 @@
+#include "zeroCheck.hpp"
+
+#include <cstddef>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::findNonZero;
+using estoraged::zeroCheckKernels;
+
+TEST(zeroCheck, scalarAlwaysAvailable)
+{
+    auto kernels = zeroCheckKernels();
+    ASSERT_FALSE(kernels.empty());
+    EXPECT_EQ("scalar", kernels.front().name);
+}
+
+TEST(zeroCheck, allZeros)
+{
+    std::vector<std::byte> data(4096 + 67, std::byte{0});
+    for (const auto& kernel : zeroCheckKernels())
+    {
+        for (size_t size = 0; size <= data.size(); size += 13)
+        {
+            EXPECT_EQ(size, kernel.find(std::span(data).first(size)))
+                << kernel.name << " size " << size;
+        }
+    }
+    EXPECT_EQ(data.size(), findNonZero(data));
+}
+
+/* Every position, with starts that are not vector aligned */
+TEST(zeroCheck, firstNonZeroOffset)
+{
+    constexpr size_t size = 300;
+    std::vector<std::byte> data(size + 8, std::byte{0});
+    for (const auto& kernel : zeroCheckKernels())
+    {
+        for (size_t start = 0; start < 8; start++)
+        {
+            std::span<std::byte> buf = std::span(data).subspan(start, size);
+            for (size_t pos = 0; pos < size; pos++)
+            {
+                buf[pos] = std::byte{0x10};
+                EXPECT_EQ(pos, kernel.find(buf))
+                    << kernel.name << " start " << start << " pos " << pos;
+                buf[pos] = std::byte{0};
+            }
+        }
+    }
+}
+
+/* Only the first of several non-zero bytes is reported */
+TEST(zeroCheck, largeBufferFirstOfMany)
+{
+    std::vector<std::byte> data(4 * 1024 * 1024, std::byte{0});
+    data[3 * 1024 * 1024 + 5] = std::byte{1};
+    data[3 * 1024 * 1024 + 200] = std::byte{0x80};
+    data.back() = std::byte{0xff};
+    for (const auto& kernel : zeroCheckKernels())
+    {
+        EXPECT_EQ(3U * 1024 * 1024 + 5, kernel.find(data)) << kernel.name;
+    }
+    EXPECT_EQ(3U * 1024 * 1024 + 5, findNonZero(data));
+}
+
+} // namespace estoraged_test
@@ -1,7 +1,9 @@
+#include "badRangeMap.hpp"
 #include "estoraged_conf.hpp"
 #include "zero.hpp"
 
 #include <fcntl.h>
+#include <linux/fs.h>
 #include <unistd.h>
 
 #include <stdplus/fd/create.hpp>
@@ -9,8 +11,13 @@
 #include <stdplus/fd/managed.hpp>
 #include <xyz/openbmc_project/Common/error.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
 #include <fstream>
 #include <system_error>
+#include <utility>
+#include <vector>
 
 #include <gmock/gmock-matchers.h>
 #include <gmock/gmock.h>
@@ -19,10 +26,17 @@
 namespace estoraged_test
 {
 
+using estoraged::BadRange;
+using estoraged::BadRangeKind;
+using estoraged::BadRangeMap;
 using estoraged::Zero;
 using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
 using testing::_;
+using testing::ElementsAre;
+using testing::Eq;
+using testing::Invoke;
 using testing::Return;
+using testing::Throw;
 
 TEST(Zeros, zeroPass)
 {
@@ -66,6 +80,30 @@ TEST(Zeros, notDivisible)
     EXPECT_NO_THROW(pass.verifyZero(size, read));
 }
 
+/* This test that zero writes and verifies in chunks larger than the block
+ * size, with a drive size that is not a multiple of the chunk size
+ */
+TEST(Zeros, largeChunkPass)
+{
+    std::string testFileName = "testfile_largeChunk";
+    std::ofstream testFile;
+
+    testFile.open(testFileName,
+                  std::ios::out | std::ios::binary | std::ios::trunc);
+    testFile.close();
+
+    uint64_t size = 200000;
+    estoraged::EraseOptions options;
+    options.chunkSize = 65536;
+    Zero pass(testFileName, options);
+    stdplus::fd::Fd&& write =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadWrite);
+    EXPECT_NO_THROW(pass.writeZero(size, write));
+    stdplus::fd::Fd&& read =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadWrite);
+    EXPECT_NO_THROW(pass.verifyZero(size, read));
+}
+
 TEST(Zeros, notZeroStart)
 {
     std::string testFileName = "testfile_notZeroStart";
@@ -210,4 +248,157 @@ TEST(Zeros, driveIsSmaller)
     EXPECT_THROW(tryZero.verifyZero(size, mocks), InternalFailure);
 }
 
+/* BLKZEROOUT requests are split at the device limit, on erase group
+ * boundaries, and cover the whole drive
+ */
+TEST(Zeros, offloadZeroOut)
+{
+    Zero zero("testfile_offload");
+    estoraged::util::ZeroOffload offload;
+    offload.writeZeroesMaxBytes = 1280 * 1024;
+    offload.discardGranularity = 512 * 1024;
+    uint64_t size = 2560 * 1024;
+
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    stdplus::fd::FdMock mock;
+    EXPECT_CALL(mock, ioctl(Eq(BLKZEROOUT), _))
+        .WillRepeatedly(Invoke([&ranges](unsigned long, void* data) {
+            auto* range = static_cast<uint64_t*>(data);
+            ranges.emplace_back(range[0], range[1]); // NOLINT
+            return 0;
+        }));
+    EXPECT_CALL(mock, write(_)).Times(0);
+
+    EXPECT_TRUE(zero.writeZeroOffload(size, mock, offload));
+    std::vector<std::pair<uint64_t, uint64_t>> expected{
+        {0, 1024 * 1024},
+        {1024 * 1024, 1024 * 1024},
+        {2048 * 1024, 512 * 1024}};
+    EXPECT_EQ(expected, ranges);
+}
+
+/* Without an offload, or if the first request is rejected, nothing is done
+ * and the caller writes zeros instead
+ */
+TEST(Zeros, offloadFallback)
+{
+    Zero zero("testfile_offload");
+    uint64_t size = 4096;
+    stdplus::fd::FdMock mock;
+
+    EXPECT_CALL(mock, ioctl(_, _)).Times(0);
+    EXPECT_FALSE(zero.writeZeroOffload(size, mock, {}));
+
+    /* a device that only discards has no offload */
+    estoraged::util::ZeroOffload discardOnly;
+    discardOnly.discardGranularity = 512 * 1024;
+    EXPECT_FALSE(zero.writeZeroOffload(size, mock, discardOnly));
+
+    estoraged::util::ZeroOffload offload;
+    offload.writeZeroesMaxBytes = 1024 * 1024;
+    testing::Mock::VerifyAndClearExpectations(&mock);
+    EXPECT_CALL(mock, ioctl(Eq(BLKZEROOUT), _))
+        .WillOnce(
+            Throw(std::system_error(EOPNOTSUPP, std::generic_category())));
+    EXPECT_FALSE(zero.writeZeroOffload(size, mock, offload));
+}
+
+TEST(Zeros, offloadFailAfterStart)
+{
+    Zero zero("testfile_offload");
+    estoraged::util::ZeroOffload offload;
+    offload.writeZeroesMaxBytes = 4096;
+    uint64_t size = 8192;
+
+    stdplus::fd::FdMock mock;
+    EXPECT_CALL(mock, ioctl(Eq(BLKZEROOUT), _))
+        .WillOnce(Return(0))
+        .WillOnce(Throw(std::system_error(EIO, std::generic_category())));
+
+    EXPECT_THROW(zero.writeZeroOffload(size, mock, offload), InternalFailure);
+}
+
+/* A tolerant write records the chunk that failed and writes the rest */
+TEST(Zeros, tolerantWrite)
+{
+    Zero zero("testfile_tolerant");
+    BadRangeMap badRanges;
+    zero.setBadRanges(&badRanges);
+
+    stdplus::fd::FdMock mock;
+    testing::InSequence s;
+    auto full = [](std::span<const std::byte> data) { return data; };
+    EXPECT_CALL(mock, write(_)).WillOnce(Invoke(full));
+    EXPECT_CALL(mock, write(_))
+        .WillOnce(Throw(std::system_error(EIO, std::generic_category())));
+    EXPECT_CALL(mock, lseek(8192, stdplus::fd::Whence::Set))
+        .WillOnce(Return(8192));
+    EXPECT_CALL(mock, write(_)).Times(2).WillRepeatedly(Invoke(full));
+
+    EXPECT_NO_THROW(zero.writeZero(4 * 4096, mock));
+    EXPECT_THAT(badRanges.ranges(), ElementsAre(BadRange{4096, 4096}));
+    EXPECT_EQ(1U, badRanges.count(BadRangeKind::Write));
+}
+
+/* A tolerant verify records unreadable chunks and every wrong sector */
+TEST(Zeros, tolerantVerify)
+{
+    std::string testFileName = "testfile_tolerantVerify";
+    std::vector<char> data(4 * 4096, 0);
+    data[100] = 1;
+    data[1024 + 3] = 1;
+    data[1536 + 5] = 1;
+    data[3 * 4096 + 4095] = 1;
+    std::ofstream testFile(testFileName, std::ios::binary | std::ios::trunc);
+    testFile.write(data.data(), static_cast<std::streamsize>(data.size()));
+    testFile.close();
+
+    Zero zero(testFileName);
+    BadRangeMap badRanges;
+    zero.setBadRanges(&badRanges);
+    stdplus::fd::ManagedFd fd =
+        stdplus::fd::open(testFileName, stdplus::fd::OpenAccess::ReadOnly);
+    EXPECT_NO_THROW(zero.verifyZero(data.size(), fd));
+    EXPECT_THAT(badRanges.ranges(),
+                ElementsAre(BadRange{0, 512}, BadRange{1024, 1024},
+                            BadRange{4 * 4096 - 512, 512}));
+    EXPECT_EQ(3U, badRanges.count(BadRangeKind::Mismatch));
+
+    stdplus::fd::FdMock mock;
+    testing::InSequence s;
+    auto zeros = [](std::span<std::byte> buf) {
+        std::ranges::fill(buf, std::byte{0});
+        return buf;
+    };
+    EXPECT_CALL(mock, read(_))
+        .WillOnce(Throw(std::system_error(EIO, std::generic_category())));
+    EXPECT_CALL(mock, lseek(4096, stdplus::fd::Whence::Set))
+        .WillOnce(Return(4096));
+    EXPECT_CALL(mock, read(_)).WillOnce(Invoke(zeros));
+    BadRangeMap readRanges;
+    zero.setBadRanges(&readRanges);
+    EXPECT_NO_THROW(zero.verifyZero(2 * 4096, mock));
+    EXPECT_THAT(readRanges.ranges(), ElementsAre(BadRange{0, 4096}));
+    EXPECT_EQ(1U, readRanges.count(BadRangeKind::Read));
+}
+
+/* The offload records a failed request and goes on with the next one */
+TEST(Zeros, tolerantOffload)
+{
+    Zero zero("testfile_offload");
+    BadRangeMap badRanges;
+    zero.setBadRanges(&badRanges);
+    estoraged::util::ZeroOffload offload;
+    offload.writeZeroesMaxBytes = 4096;
+
+    stdplus::fd::FdMock mock;
+    EXPECT_CALL(mock, ioctl(Eq(BLKZEROOUT), _))
+        .WillOnce(Return(0))
+        .WillOnce(Throw(std::system_error(EIO, std::generic_category())))
+        .WillOnce(Return(0));
+
+    EXPECT_TRUE(zero.writeZeroOffload(3 * 4096, mock, offload));
+    EXPECT_THAT(badRanges.ranges(), ElementsAre(BadRange{4096, 4096}));
+}
+
 } // namespace estoraged_test
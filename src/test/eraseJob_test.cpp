@@ -0,0 +1,231 @@
+#include "badRangeMap.hpp"
+#include "deviceWorker.hpp"
+#include "eraseJob.hpp"
+#include "eraseProgress.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+#include <sdbusplus/asio/property.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::BadRangeKind;
+using estoraged::BadRangeMap;
+using estoraged::DeviceWorker;
+using estoraged::EraseJob;
+using estoraged::EraseProgress;
+using std::chrono::milliseconds;
+
+const std::string serviceName = "xyz.openbmc_project.eStoraged.test";
+const std::string jobPath = "/xyz/openbmc_project/inventory/storage/test/erase";
+const std::string progressInterface = "xyz.openbmc_project.Common.Progress";
+const std::string jobInterface = "xyz.openbmc_project.eStoraged.EraseJob";
+const std::string operationStatus =
+    "xyz.openbmc_project.Common.Progress.OperationStatus.";
+
+class EraseJobTest : public testing::Test
+{
+  public:
+    boost::asio::io_context io;
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    std::unique_ptr<sdbusplus::asio::object_server> objectServer;
+    DeviceWorker worker;
+    std::shared_ptr<EraseJob> job;
+    int finished = 0;
+
+    void SetUp() override
+    {
+        conn = std::make_shared<sdbusplus::asio::connection>(io);
+        conn->request_name(serviceName.c_str());
+        objectServer = std::make_unique<sdbusplus::asio::object_server>(conn);
+        job = std::make_shared<EraseJob>(
+            io, *objectServer, jobPath, worker, []() {},
+            [this]() { finished++; });
+    }
+
+    /* Runs the io_context until the job published count final statuses, or
+     * five seconds passed.
+     */
+    void waitFinished(int count)
+    {
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::seconds(5);
+        while (finished < count && std::chrono::steady_clock::now() < deadline)
+        {
+            io.restart();
+            io.run_for(milliseconds(10));
+        }
+        EXPECT_EQ(count, finished);
+    }
+
+    /* Reads a property of the job through the bus */
+    template <typename T>
+    T getProperty(const std::string& interface, const std::string& name)
+    {
+        std::optional<T> value;
+        sdbusplus::asio::getProperty<T>(
+            *conn, serviceName, jobPath, interface, name,
+            [&value](const boost::system::error_code& ec, const T& result) {
+                EXPECT_FALSE(ec);
+                value = result;
+            });
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::seconds(5);
+        while (!value && std::chrono::steady_clock::now() < deadline)
+        {
+            io.restart();
+            io.run_for(milliseconds(10));
+        }
+        EXPECT_TRUE(value);
+        return value.value_or(T{});
+    }
+};
+
+TEST_F(EraseJobTest, completes)
+{
+    job->start("ZeroOverWrite", [](EraseProgress& progress, BadRangeMap&) {
+        progress.start(4096);
+        progress.advance(4096);
+        progress.finish();
+    });
+    EXPECT_TRUE(job->isRunning());
+    waitFinished(1);
+
+    EXPECT_FALSE(job->isRunning());
+    EXPECT_EQ(operationStatus + "Completed",
+              getProperty<std::string>(progressInterface, "Status"));
+    EXPECT_NE(0U, getProperty<uint64_t>(progressInterface, "StartTime"));
+    EXPECT_NE(0U, getProperty<uint64_t>(progressInterface, "CompletedTime"));
+    EXPECT_EQ("ZeroOverWrite",
+              getProperty<std::string>(jobInterface, "EraseMethod"));
+    EXPECT_EQ(4096U, getProperty<uint64_t>(jobInterface, "BytesProcessed"));
+    EXPECT_EQ(100U, getProperty<uint8_t>(jobInterface, "Percent"));
+}
+
+/* The erase publishes InProgress and StartTime once the worker runs it */
+TEST_F(EraseJobTest, startsOnWorker)
+{
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    worker.post([released]() { released.wait(); });
+    job->start("ZeroOverWrite", [](EraseProgress&, BadRangeMap&) {});
+
+    EXPECT_TRUE(job->isRunning());
+    EXPECT_EQ(0U, getProperty<uint64_t>(progressInterface, "StartTime"));
+
+    release.set_value();
+    waitFinished(1);
+    EXPECT_NE(0U, getProperty<uint64_t>(progressInterface, "StartTime"));
+}
+
+TEST_F(EraseJobTest, fails)
+{
+    job->start("LogicalVerify", [](EraseProgress&, BadRangeMap&) {
+        throw std::runtime_error("mismatch");
+    });
+    waitFinished(1);
+
+    EXPECT_FALSE(job->isRunning());
+    EXPECT_EQ(operationStatus + "Failed",
+              getProperty<std::string>(progressInterface, "Status"));
+}
+
+/* A tolerant erase publishes its bad ranges once it ends */
+TEST_F(EraseJobTest, publishesBadRanges)
+{
+    job->start("ZeroVerify", [](EraseProgress&, BadRangeMap& badRanges) {
+        badRanges.add(BadRangeKind::Read, 0, 512);
+        badRanges.add(BadRangeKind::Mismatch, 8192, 1024);
+        throw std::runtime_error("bad ranges");
+    });
+    waitFinished(1);
+
+    EXPECT_EQ(operationStatus + "Failed",
+              getProperty<std::string>(progressInterface, "Status"));
+    EXPECT_EQ(1536U, getProperty<uint64_t>(jobInterface, "BadBytes"));
+    EXPECT_EQ(1U, getProperty<uint64_t>(jobInterface, "ReadErrors"));
+    EXPECT_EQ(0U, getProperty<uint64_t>(jobInterface, "WriteErrors"));
+    EXPECT_EQ(1U, getProperty<uint64_t>(jobInterface, "Mismatches"));
+}
+
+TEST_F(EraseJobTest, cancel)
+{
+    std::promise<void> started;
+    job->start("ZeroOverWrite",
+               [&started](EraseProgress& progress, BadRangeMap&) {
+        progress.start(UINT64_MAX);
+        started.set_value();
+        while (true)
+        {
+            progress.advance(1);
+            std::this_thread::sleep_for(milliseconds(1));
+        }
+    });
+    started.get_future().wait();
+    job->cancel();
+    waitFinished(1);
+
+    EXPECT_FALSE(job->isRunning());
+    EXPECT_EQ(operationStatus + "Aborted",
+              getProperty<std::string>(progressInterface, "Status"));
+}
+
+/* A new erase resets the status of the previous one */
+TEST_F(EraseJobTest, restarts)
+{
+    job->start("LogicalVerify", [](EraseProgress&, BadRangeMap&) {
+        throw std::runtime_error("mismatch");
+    });
+    waitFinished(1);
+    job->start("ZeroOverWrite", [](EraseProgress&, BadRangeMap&) {});
+    waitFinished(2);
+
+    EXPECT_EQ(operationStatus + "Completed",
+              getProperty<std::string>(progressInterface, "Status"));
+    EXPECT_EQ("ZeroOverWrite",
+              getProperty<std::string>(jobInterface, "EraseMethod"));
+}
+
+/* Destroying the job cancels the erase without waiting for it */
+TEST_F(EraseJobTest, destroyWhileRunning)
+{
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    job->start("ZeroOverWrite", [&started, released](EraseProgress& progress,
+                                                     BadRangeMap&) {
+        progress.start(4096);
+        started.set_value();
+        released.wait();
+        progress.advance(4096);
+    });
+    started.get_future().wait();
+
+    /* the erase is blocked, so this would hang if the job waited for it */
+    job.reset();
+    release.set_value();
+
+    /* the erase ends on the worker, without publishing anything */
+    std::promise<void> drained;
+    worker.post([&drained]() { drained.set_value(); });
+    drained.get_future().wait();
+    io.restart();
+    io.run_for(milliseconds(10));
+    EXPECT_EQ(0, finished);
+}
+
+} // namespace estoraged_test
@@ -11,16 +11,24 @@
 #include <boost/asio/io_context.hpp>
 #include <sdbusplus/asio/connection.hpp>
 #include <sdbusplus/asio/object_server.hpp>
+#include <sdbusplus/asio/property.hpp>
+#include <sdbusplus/bus/match.hpp>
 #include <stdplus/fd/gmock.hpp>
 #include <xyz/openbmc_project/Common/error.hpp>
+#include <xyz/openbmc_project/Inventory/Item/Drive/server.hpp>
 #include <xyz/openbmc_project/Inventory/Item/Volume/server.hpp>
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <exception>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iterator>
 #include <memory>
+#include <optional>
 #include <span>
 #include <string>
 #include <vector>
@@ -31,9 +39,11 @@
 namespace estoraged_test
 {
 
+using sdbusplus::server::xyz::openbmc_project::inventory::item::Drive;
 using sdbusplus::server::xyz::openbmc_project::inventory::item::Volume;
 using sdbusplus::xyz::openbmc_project::Common::Error::InternalFailure;
 using sdbusplus::xyz::openbmc_project::Common::Error::ResourceNotFound;
+using sdbusplus::xyz::openbmc_project::Common::Error::Unavailable;
 using std::filesystem::path;
 using stdplus::fd::FdMock;
 using ::testing::_;
@@ -101,17 +111,102 @@ class EStoragedTest : public testing::Test
 
         std::unique_ptr<FdMock> mockFd = std::make_unique<FdMock>();
         esObject = std::make_unique<estoraged::EStoraged>(
-            std::move(mockFd), *objectServer, testConfigPath, testFileName,
+            std::move(mockFd), io, *objectServer, testConfigPath, testFileName,
             testLuksDevName, testSize, testLifeTime, testPartNumber,
             testSerialNumber, testLocationCode, ERASE_MAX_GEOMETRY,
             ERASE_MIN_GEOMETRY, testDriveType, testDriveProtocol,
-            std::move(cryptIface), std::move(fsIface));
+            estoraged::EraseOptions{}, std::move(cryptIface),
+            std::move(fsIface));
     }
 
     void TearDown() override
     {
         EXPECT_EQ(0, unlink(testFileName));
     }
+
+    /* Replaces esObject with an eMMC drive, whose ioctls all run ioctl */
+    void makeEmmcObject(const std::function<int(unsigned long, void*)>& ioctl)
+    {
+        esObject.reset();
+
+        std::unique_ptr<MockCryptsetupInterface> cryptIface =
+            std::make_unique<MockCryptsetupInterface>();
+        mockCryptIface = cryptIface.get();
+        std::unique_ptr<MockFilesystemInterface> fsIface =
+            std::make_unique<MockFilesystemInterface>();
+        mockFsIface = fsIface.get();
+        EXPECT_CALL(*cryptIface, cryptGetDir).WillOnce(Return(testCryptDir));
+
+        std::unique_ptr<FdMock> mockFd = std::make_unique<FdMock>();
+        EXPECT_CALL(*mockFd, ioctl(_, _)).WillRepeatedly(ioctl);
+        esObject = std::make_unique<estoraged::EStoraged>(
+            std::move(mockFd), io, *objectServer, testConfigPath, testFileName,
+            testLuksDevName, testSize, testLifeTime, testPartNumber,
+            testSerialNumber, testLocationCode, ERASE_MAX_GEOMETRY,
+            ERASE_MIN_GEOMETRY, testDriveType, testDriveProtocol,
+            estoraged::EraseOptions{}, std::move(cryptIface),
+            std::move(fsIface));
+    }
+
+    /* Calls a method of the volume through the bus, and returns its error */
+    template <typename... Args>
+    boost::system::error_code callVolume(const std::string& method,
+                                         const Args&... args)
+    {
+        std::optional<boost::system::error_code> result;
+        conn->async_method_call(
+            [&result](const boost::system::error_code& ec) { result = ec; },
+            "xyz.openbmc_project.eStoraged.test", drivePath(),
+            "xyz.openbmc_project.Inventory.Item.Volume", method, args...);
+        runUntil([&result]() { return result.has_value(); });
+        EXPECT_TRUE(result);
+        return result.value_or(boost::system::error_code{});
+    }
+
+    /* Reads EncryptionStatus through the bus */
+    Drive::DriveEncryptionState getEncryptionStatus()
+    {
+        std::optional<Drive::DriveEncryptionState> status;
+        sdbusplus::asio::getProperty<Drive::DriveEncryptionState>(
+            *conn, "xyz.openbmc_project.eStoraged.test", drivePath(),
+            "xyz.openbmc_project.Inventory.Item.Drive", "EncryptionStatus",
+            [&status](const boost::system::error_code& ec,
+                      const Drive::DriveEncryptionState& value) {
+            EXPECT_FALSE(ec);
+            status = value;
+        });
+        runUntil([&status]() { return status.has_value(); });
+        EXPECT_TRUE(status);
+        return status.value_or(Drive::DriveEncryptionState::Unknown);
+    }
+
+    /* Counts the PropertiesChanged signals of the drive in changes */
+    std::unique_ptr<sdbusplus::bus::match_t> watchDrive(int& changes)
+    {
+        return std::make_unique<sdbusplus::bus::match_t>(
+            *conn,
+            sdbusplus::bus::match::rules::propertiesChanged(
+                drivePath(), "xyz.openbmc_project.Inventory.Item.Drive"),
+            [&changes](sdbusplus::message_t&) { changes++; });
+    }
+
+    /* Runs the io_context until done returns true, or five seconds passed */
+    void runUntil(const std::function<bool()>& done)
+    {
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::seconds(5);
+        while (!done() && std::chrono::steady_clock::now() < deadline)
+        {
+            io.restart();
+            io.run_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    std::string drivePath() const
+    {
+        return std::string("/xyz/openbmc_project/inventory/storage/") +
+               testFileName;
+    }
 };
 
 const char* mappedDevicePath = "/tmp/testfile_luksDev";
@@ -676,6 +771,111 @@ TEST_F(EStoragedTest, ChangePasswordFail)
                  InternalFailure);
 }
 
+/*
+ * Test case where an erase runs as a job: the handler returns once the job
+ * is queued, and the other methods are unavailable until it ends.
+ */
+TEST_F(EStoragedTest, EraseJobUnavailable)
+{
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<bool> blocking = false;
+    /* Reads of EXT_CSD fail, so the sanitize reads it again on the worker,
+     * and blocks there. */
+    makeEmmcObject([&blocking, released](unsigned long, void*) {
+        if (blocking)
+        {
+            released.wait();
+        }
+        return -1;
+    });
+    blocking = true;
+
+    EXPECT_FALSE(callVolume("Erase", Volume::EraseMethod::VendorSanitize));
+
+    EXPECT_CALL(*mockCryptIface, cryptFormat(_, _, _, _, _, _, _, _))
+        .Times(0);
+    EXPECT_TRUE(callVolume("FormatLuks", password,
+                           Volume::FilesystemType::ext4));
+    EXPECT_TRUE(callVolume("Erase", Volume::EraseMethod::ZeroOverWrite));
+    EXPECT_THROW(esObject->erase(Volume::EraseMethod::ZeroOverWrite),
+                 Unavailable);
+    EXPECT_THROW(esObject->resumeErase(), Unavailable);
+
+    /* The sanitize ends on the worker before the drive is destroyed. */
+    release.set_value();
+    esObject.reset();
+}
+
+/* Test case where the header is loaded once, for the first read of
+ * EncryptionStatus. */
+TEST_F(EStoragedTest, EncryptionStatusCached)
+{
+    EXPECT_CALL(*mockCryptIface, cryptLoad(_, _, _)).WillOnce(Return(0));
+
+    EXPECT_EQ(Drive::DriveEncryptionState::Encrypted, getEncryptionStatus());
+    EXPECT_EQ(Drive::DriveEncryptionState::Encrypted, getEncryptionStatus());
+}
+
+/* Test case where a failed FormatLuks wrote the header anyway. */
+TEST_F(EStoragedTest, EncryptionStatusAfterFormatLuks)
+{
+    int changes = 0;
+    auto match = watchDrive(changes);
+    EXPECT_CALL(*mockCryptIface, cryptLoad(_, _, _))
+        .WillOnce(Return(-1))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*mockCryptIface, cryptFormat(_, _, _, _, _, _, _, _))
+        .WillOnce(Return(-1));
+
+    EXPECT_EQ(Drive::DriveEncryptionState::Unencrypted,
+              getEncryptionStatus());
+    EXPECT_TRUE(callVolume("FormatLuks", password,
+                           Volume::FilesystemType::ext4));
+    EXPECT_EQ(1, changes);
+    EXPECT_EQ(Drive::DriveEncryptionState::Encrypted, getEncryptionStatus());
+}
+
+/* Test case where ChangePassword reloads the header, and the status does not
+ * change. */
+TEST_F(EStoragedTest, EncryptionStatusAfterChangePassword)
+{
+    std::string newPasswordString("newPassword");
+    std::vector<uint8_t> newPassword(newPasswordString.begin(),
+                                     newPasswordString.end());
+    int changes = 0;
+    auto match = watchDrive(changes);
+    EXPECT_CALL(*mockCryptIface, cryptLoad(_, _, _))
+        .Times(3)
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(*mockCryptIface,
+                cryptKeyslotChangeByPassphrase(_, _, _, _, _, _, _))
+        .WillOnce(Return(0));
+
+    EXPECT_EQ(Drive::DriveEncryptionState::Encrypted, getEncryptionStatus());
+    EXPECT_FALSE(callVolume("ChangePassword", password, newPassword));
+    EXPECT_EQ(0, changes);
+    EXPECT_EQ(Drive::DriveEncryptionState::Encrypted, getEncryptionStatus());
+}
+
+/* Test case where the header is reloaded once an erase job ends, even if the
+ * erase failed. */
+TEST_F(EStoragedTest, EncryptionStatusAfterErase)
+{
+    int changes = 0;
+    auto match = watchDrive(changes);
+    EXPECT_CALL(*mockCryptIface, cryptLoad(_, _, _))
+        .WillOnce(Return(0))
+        .WillOnce(Return(-1));
+
+    EXPECT_EQ(Drive::DriveEncryptionState::Encrypted, getEncryptionStatus());
+    EXPECT_FALSE(callVolume("Erase", Volume::EraseMethod::ZeroVerify));
+    runUntil([&changes]() { return changes > 0; });
+    EXPECT_EQ(1, changes);
+    EXPECT_EQ(Drive::DriveEncryptionState::Unencrypted,
+              getEncryptionStatus());
+}
+
 TEST(EMMCBackgroundOperation, IoCtlFailure)
 {
     std::unique_ptr<FdMock> mockFd = std::make_unique<FdMock>();
@@ -819,4 +1019,199 @@ TEST(HSMode, Null)
         nullptr, "/dev/test", "TestPart"));
 }
 
+/* Answers SEND_EXT_CSD with the given DEVICE_TYPE and HS_TIMING */
+auto answerBusMode(uint8_t deviceType, uint8_t hsTiming)
+{
+    return [deviceType, hsTiming](unsigned long, void* data) {
+        struct mmc_ioc_cmd* idata = static_cast<struct mmc_ioc_cmd*>(data);
+        EXPECT_EQ(idata->opcode, MMC_SEND_EXT_CSD);
+        // NOLINTNEXTLINE(performance-no-int-to-ptr)
+        auto* extCsd = reinterpret_cast<uint8_t*>(idata->data_ptr);
+        extCsd[estoraged::extcsd::deviceType] = deviceType;
+        extCsd[EXT_CSD_HS_TIMING] = hsTiming;
+        return 0;
+    };
+}
+
+/* Checks a SWITCH of HS_TIMING to value */
+auto expectHsTiming(uint8_t value)
+{
+    return [value](unsigned long, void* data) {
+        struct mmc_ioc_cmd* idata = static_cast<struct mmc_ioc_cmd*>(data);
+        EXPECT_EQ(idata->opcode, MMC_SWITCH);
+        EXPECT_EQ(idata->arg, (MMC_SWITCH_MODE_WRITE_BYTE << 24) |
+                                  (EXT_CSD_HS_TIMING << 16) | (value << 8));
+        EXPECT_EQ(idata->flags, MMC_RSP_R1B | MMC_CMD_AC);
+        return 0;
+    };
+}
+
+/* DEVICE_TYPE of an eMMC 5.1 with every mode at 1.8V */
+constexpr uint8_t allModes =
+    EXT_CSD_CARD_TYPE_HS_26 | EXT_CSD_CARD_TYPE_HS_52 |
+    EXT_CSD_CARD_TYPE_HS200_1_8V | EXT_CSD_CARD_TYPE_HS400_1_8V;
+
+TEST(HSMode, NegotiateHs400)
+{
+    std::unique_ptr<FdMock> mockFd = std::make_unique<FdMock>();
+    EXPECT_CALL(*mockFd, ioctl(MMC_IOC_CMD, testing::_))
+        .WillOnce(testing::Invoke(answerBusMode(allModes, 0x11)))
+        .WillOnce(testing::Invoke(expectHsTiming(0x13)))
+        .WillOnce(testing::Invoke(answerBusMode(allModes, 0x13)));
+    estoraged::MmcChannel mmc("/dev/test",
+                              std::make_unique<estoraged::IOCTLWrapperImpl>(
+                                  std::move(mockFd)));
+
+    EXPECT_EQ(estoraged::HsTiming::Hs400,
+              estoraged::EStoraged::negotiateHsTiming(
+                  mmc, "/dev/test", estoraged::HsTiming::Hs400));
+}
+
+TEST(HSMode, NegotiateHostLimit)
+{
+    std::unique_ptr<FdMock> mockFd = std::make_unique<FdMock>();
+    EXPECT_CALL(*mockFd, ioctl(MMC_IOC_CMD, testing::_))
+        .WillOnce(testing::Invoke(answerBusMode(allModes, 0x01)))
+        .WillOnce(testing::Invoke(expectHsTiming(0x02)))
+        .WillOnce(testing::Invoke(answerBusMode(allModes, 0x02)));
+    estoraged::MmcChannel mmc("/dev/test",
+                              std::make_unique<estoraged::IOCTLWrapperImpl>(
+                                  std::move(mockFd)));
+
+    EXPECT_EQ(estoraged::HsTiming::Hs200,
+              estoraged::EStoraged::negotiateHsTiming(
+                  mmc, "/dev/test", estoraged::HsTiming::Hs200));
+}
+
+TEST(HSMode, NegotiateKeepsFaster)
+{
+    std::unique_ptr<FdMock> mockFd = std::make_unique<FdMock>();
+    EXPECT_CALL(*mockFd, ioctl(MMC_IOC_CMD, testing::_))
+        .WillOnce(testing::Invoke(answerBusMode(allModes, 0x03)));
+    estoraged::MmcChannel mmc("/dev/test",
+                              std::make_unique<estoraged::IOCTLWrapperImpl>(
+                                  std::move(mockFd)));
+
+    EXPECT_EQ(estoraged::HsTiming::Hs400,
+              estoraged::EStoraged::negotiateHsTiming(
+                  mmc, "/dev/test", estoraged::HsTiming::Hs200));
+}
+
+TEST(HSMode, NegotiateNotApplied)
+{
+    std::unique_ptr<FdMock> mockFd = std::make_unique<FdMock>();
+    EXPECT_CALL(*mockFd, ioctl(MMC_IOC_CMD, testing::_))
+        .WillOnce(testing::Invoke(answerBusMode(allModes, 0x01)))
+        .WillOnce(testing::Invoke(expectHsTiming(0x03)))
+        .WillOnce(testing::Invoke(answerBusMode(allModes, 0x01)));
+    estoraged::MmcChannel mmc("/dev/test",
+                              std::make_unique<estoraged::IOCTLWrapperImpl>(
+                                  std::move(mockFd)));
+
+    EXPECT_THROW(estoraged::EStoraged::negotiateHsTiming(
+                     mmc, "/dev/test", estoraged::HsTiming::Hs400),
+                 estoraged::HsModeError);
+}
+
+/* Answers SEND_EXT_CSD with a 512 KiB cache in the given CACHE_CTRL state */
+auto answerCache(uint8_t cacheCtrl)
+{
+    return [cacheCtrl](unsigned long, void* data) {
+        struct mmc_ioc_cmd* idata = static_cast<struct mmc_ioc_cmd*>(data);
+        EXPECT_EQ(idata->opcode, MMC_SEND_EXT_CSD);
+        // NOLINTNEXTLINE(performance-no-int-to-ptr)
+        auto* extCsd = reinterpret_cast<uint8_t*>(idata->data_ptr);
+        extCsd[EXT_CSD_CACHE_SIZE + 1] = 0x10; // 4096 kilobits
+        extCsd[EXT_CSD_CACHE_CTRL] = cacheCtrl;
+        return 0;
+    };
+}
+
+/* Checks a SWITCH writing value to the EXT_CSD byte at index */
+auto expectSwitch(uint8_t index, uint8_t value, int result)
+{
+    return [index, value, result](unsigned long, void* data) {
+        struct mmc_ioc_cmd* idata = static_cast<struct mmc_ioc_cmd*>(data);
+        EXPECT_EQ(idata->opcode, MMC_SWITCH);
+        EXPECT_EQ(idata->arg, (MMC_SWITCH_MODE_WRITE_BYTE << 24) |
+                                  (index << 16) | (value << 8) |
+                                  EXT_CSD_CMD_SET_NORMAL);
+        EXPECT_EQ(idata->flags, MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC);
+        return result;
+    };
+}
+
+TEST(EMMCCache, NoCache)
+{
+    std::unique_ptr<FdMock> mockFd = std::make_unique<FdMock>();
+    EXPECT_CALL(*mockFd, ioctl(MMC_IOC_CMD, testing::_)).WillOnce(Return(0));
+    estoraged::MmcChannel mmc("/dev/test",
+                              std::make_unique<estoraged::IOCTLWrapperImpl>(
+                                  std::move(mockFd)));
+
+    EXPECT_FALSE(estoraged::EStoraged::checkCache(
+        mmc, "/dev/test", estoraged::EmmcCachePolicy::Enable));
+    EXPECT_TRUE(estoraged::EStoraged::checkCache(
+        mmc, "/dev/test", estoraged::EmmcCachePolicy::Disable));
+    EXPECT_FALSE(estoraged::EStoraged::flushCache(mmc, "/dev/test"));
+}
+
+/* A cache in the other state is only reported, the kernel owns CACHE_CTRL */
+TEST(EMMCCache, EnableMismatch)
+{
+    std::unique_ptr<FdMock> mockFd = std::make_unique<FdMock>();
+    EXPECT_CALL(*mockFd, ioctl(MMC_IOC_CMD, testing::_))
+        .WillOnce(testing::Invoke(answerCache(0)));
+    estoraged::MmcChannel mmc("/dev/test",
+                              std::make_unique<estoraged::IOCTLWrapperImpl>(
+                                  std::move(mockFd)));
+
+    EXPECT_FALSE(estoraged::EStoraged::checkCache(
+        mmc, "/dev/test", estoraged::EmmcCachePolicy::Enable));
+}
+
+TEST(EMMCCache, Keep)
+{
+    std::unique_ptr<FdMock> mockFd = std::make_unique<FdMock>();
+    EXPECT_CALL(*mockFd, ioctl(MMC_IOC_CMD, testing::_))
+        .WillOnce(testing::Invoke(answerCache(0)));
+    estoraged::MmcChannel mmc("/dev/test",
+                              std::make_unique<estoraged::IOCTLWrapperImpl>(
+                                  std::move(mockFd)));
+
+    EXPECT_TRUE(estoraged::EStoraged::checkCache(
+        mmc, "/dev/test", estoraged::EmmcCachePolicy::Keep));
+    /* a disabled cache holds nothing to flush */
+    EXPECT_FALSE(estoraged::EStoraged::flushCache(mmc, "/dev/test"));
+}
+
+TEST(EMMCCache, DisableMismatch)
+{
+    std::unique_ptr<FdMock> mockFd = std::make_unique<FdMock>();
+    EXPECT_CALL(*mockFd, ioctl(MMC_IOC_CMD, testing::_))
+        .WillOnce(testing::Invoke(answerCache(1)));
+    estoraged::MmcChannel mmc("/dev/test",
+                              std::make_unique<estoraged::IOCTLWrapperImpl>(
+                                  std::move(mockFd)));
+
+    EXPECT_FALSE(estoraged::EStoraged::checkCache(
+        mmc, "/dev/test", estoraged::EmmcCachePolicy::Disable));
+    EXPECT_TRUE(estoraged::EStoraged::checkCache(
+        mmc, "/dev/test", estoraged::EmmcCachePolicy::Enable));
+}
+
+TEST(EMMCCache, FlushFailure)
+{
+    std::unique_ptr<FdMock> mockFd = std::make_unique<FdMock>();
+    EXPECT_CALL(*mockFd, ioctl(MMC_IOC_CMD, testing::_))
+        .WillOnce(testing::Invoke(answerCache(1)))
+        .WillOnce(testing::Invoke(expectSwitch(EXT_CSD_FLUSH_CACHE, 1, 1)));
+    estoraged::MmcChannel mmc("/dev/test",
+                              std::make_unique<estoraged::IOCTLWrapperImpl>(
+                                  std::move(mockFd)));
+
+    EXPECT_THROW(estoraged::EStoraged::flushCache(mmc, "/dev/test"),
+                 estoraged::CacheFlushFailure);
+}
+
 } // namespace estoraged_test
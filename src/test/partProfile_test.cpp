@@ -0,0 +1,123 @@
+#include "eraseOptions.hpp"
+#include "extCsd.hpp"
+#include "partProfile.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace estoraged_test
+{
+
+using estoraged::EmmcCachePolicy;
+using estoraged::EraseOptions;
+using estoraged::HsTiming;
+using estoraged::PartProfile;
+using estoraged::PartProfileTable;
+
+const char* profilesJson = R"({
+    "Profiles": [
+        {
+            "Name": "8GTF4R",
+            "Manufacturer": "0x000015",
+            "EmmcMaxBusMode": "HS400",
+            "EraseChunkSize": 4194304,
+            "EraseQueueDepth": 8,
+            "BkopsPollInterval": 5,
+            "BkopsIdleTime": 60,
+            "EmmcCachePolicy": "Disable",
+            "EraseMaxGeometry": 10000000000,
+            "EraseMinGeometry": 1000
+        },
+        {
+            "Name": "8GTF4R",
+            "EmmcMaxBusMode": "HS200"
+        },
+        {
+            "Name": "DG4016",
+            "EraseQueueDepth": "deep",
+            "EmmcCachePolicy": "Sometimes",
+            "BkopsIdleTime": 10
+        },
+        {
+            "Manufacturer": "0x000045"
+        }
+    ]
+})";
+
+TEST(partProfile, parse)
+{
+    PartProfileTable table = PartProfileTable::parse(profilesJson);
+    EXPECT_EQ(3U, table.size());
+
+    const PartProfile* profile = table.find("0x000015", "8GTF4R");
+    ASSERT_NE(nullptr, profile);
+    EXPECT_EQ(HsTiming::Hs400, profile->emmcMaxBusMode);
+    EXPECT_EQ(4194304U, profile->chunkSize);
+    EXPECT_EQ(8U, profile->queueDepth);
+    EXPECT_EQ(5U, profile->bkopsPollInterval);
+    EXPECT_EQ(60U, profile->bkopsIdleTime);
+    EXPECT_EQ(EmmcCachePolicy::Disable, profile->emmcCachePolicy);
+    EXPECT_EQ(10000000000U, profile->eraseMaxGeometry);
+    EXPECT_EQ(1000U, profile->eraseMinGeometry);
+
+    /* invalid values are skipped, the rest of the profile is kept */
+    profile = table.find("0x000045", "DG4016");
+    ASSERT_NE(nullptr, profile);
+    EXPECT_FALSE(profile->queueDepth);
+    EXPECT_FALSE(profile->emmcCachePolicy);
+    EXPECT_EQ(10U, profile->bkopsIdleTime);
+}
+
+/* A profile of the manufacturer and name wins over the name only */
+TEST(partProfile, findPrefersManufacturer)
+{
+    PartProfileTable table = PartProfileTable::parse(profilesJson);
+
+    const PartProfile* profile = table.find("0x000015", "8GTF4R");
+    ASSERT_NE(nullptr, profile);
+    EXPECT_EQ(HsTiming::Hs400, profile->emmcMaxBusMode);
+
+    profile = table.find("0x000013", "8GTF4R");
+    ASSERT_NE(nullptr, profile);
+    EXPECT_EQ(HsTiming::Hs200, profile->emmcMaxBusMode);
+
+    EXPECT_EQ(nullptr, table.find("0x000015", "unknown"));
+}
+
+TEST(partProfile, apply)
+{
+    PartProfileTable table = PartProfileTable::parse(profilesJson);
+    EraseOptions options;
+    table.find("0x000045", "DG4016")->apply(options);
+
+    /* only the values in the profile change */
+    EXPECT_EQ(10U, options.bkopsIdleTime);
+    EXPECT_EQ(EraseOptions{}.queueDepth, options.queueDepth);
+    EXPECT_EQ(EraseOptions{}.emmcCachePolicy, options.emmcCachePolicy);
+    EXPECT_FALSE(options.emmcMaxBusMode);
+}
+
+TEST(partProfile, invalidFiles)
+{
+    EXPECT_EQ(0U, PartProfileTable::parse("").size());
+    EXPECT_EQ(0U, PartProfileTable::parse("{\"Profiles\": [").size());
+    EXPECT_EQ(0U, PartProfileTable::parse("[]").size());
+    EXPECT_EQ(0U, PartProfileTable::parse("{\"Profiles\": {}}").size());
+    EXPECT_EQ(0U, PartProfileTable::load("/nonexistent/profiles.json").size());
+}
+
+TEST(partProfile, load)
+{
+    const char* path = "part_profiles.json";
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    file << profilesJson;
+    file.close();
+
+    EXPECT_EQ(3U, PartProfileTable::load(path).size());
+    EXPECT_TRUE(std::filesystem::remove(path));
+}
+
+} // namespace estoraged_test
@@ -4,8 +4,10 @@
 #include <boost/container/flat_map.hpp>
 #include <util.hpp>
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <thread>
 
 #include <gmock/gmock-matchers.h>
 #include <gmock/gmock.h>
@@ -15,6 +17,7 @@ namespace estoraged_test
 {
 using estoraged::util::findPredictedMediaLifeLeftPercent;
 using estoraged::util::getPartNumber;
+using estoraged::util::findZeroOffload;
 using estoraged::util::getSerialNumber;
 
 TEST(utilTest, passFindPredictedMediaLife)
@@ -99,6 +102,27 @@ TEST(utilTest, getSerialNumberPass)
     EXPECT_TRUE(std::filesystem::remove(testFileName));
 }
 
+TEST(utilTest, findZeroOffloadPass)
+{
+    std::filesystem::create_directories("zeroOffload/queue");
+    std::ofstream("zeroOffload/queue/write_zeroes_max_bytes") << "33554432\n";
+    std::ofstream("zeroOffload/queue/discard_granularity") << "524288\n";
+
+    auto offload = findZeroOffload("zeroOffload/queue");
+    EXPECT_EQ(33554432U, offload.writeZeroesMaxBytes);
+    EXPECT_EQ(524288U, offload.discardGranularity);
+
+    EXPECT_TRUE(std::filesystem::remove_all("zeroOffload"));
+}
+
+TEST(utilTest, findZeroOffloadNotAvailable)
+{
+    /* None of the queue files exist for this test. */
+    auto offload = findZeroOffload("zeroOffloadMissing/queue");
+    EXPECT_EQ(0U, offload.writeZeroesMaxBytes);
+    EXPECT_EQ(0U, offload.discardGranularity);
+}
+
 /* Test case where we successfully find the device file. */
 TEST(utilTest, findDevicePass)
 {
@@ -145,6 +169,30 @@ TEST(utilTest, findDevicePass)
     EXPECT_EQ(ERASE_MIN_GEOMETRY, result->eraseMinGeometry);
     EXPECT_EQ("SSD", result->driveType);
     EXPECT_EQ("eMMC", result->driveProtocol);
+    EXPECT_FALSE(result->eraseOptions.directIo);
+    EXPECT_EQ(0U, result->eraseOptions.chunkSize);
+    EXPECT_EQ(1U, result->eraseOptions.queueDepth);
+    EXPECT_EQ(1U, result->eraseOptions.pipelineDepth);
+    EXPECT_FALSE(result->eraseOptions.zeroOffload);
+    EXPECT_EQ(estoraged::PatternType::Philox, result->eraseOptions.patternType);
+    EXPECT_EQ(1U, result->eraseOptions.verifyThreads);
+    EXPECT_DOUBLE_EQ(0, result->eraseOptions.verifySampleConfidence);
+    EXPECT_FALSE(result->eraseOptions.tolerant);
+    EXPECT_EQ(1024U, result->eraseOptions.badRangeLimit);
+    EXPECT_EQ(estoraged::IoClass::Unchanged, result->eraseOptions.ioClass);
+    EXPECT_FALSE(result->eraseOptions.schedIdle);
+    EXPECT_EQ(0, result->eraseOptions.nice);
+    EXPECT_DOUBLE_EQ(0, result->eraseOptions.maxThroughput);
+    EXPECT_DOUBLE_EQ(0, result->eraseOptions.ioPressureLimit);
+    EXPECT_FALSE(result->eraseOptions.sanitizePolling);
+    EXPECT_EQ(3600U, result->eraseOptions.sanitizeTimeout);
+    EXPECT_EQ(estoraged::EmmcErasePolicy::Legacy,
+              result->eraseOptions.emmcErasePolicy);
+    EXPECT_EQ(10U, result->eraseOptions.bkopsPollInterval);
+    EXPECT_EQ(30U, result->eraseOptions.bkopsIdleTime);
+    EXPECT_EQ(estoraged::EmmcCachePolicy::Keep,
+              result->eraseOptions.emmcCachePolicy);
+    EXPECT_FALSE(result->eraseOptions.emmcMaxBusMode);
 
     /* Delete the dummy files. */
     EXPECT_EQ(3U, std::filesystem::remove_all("mmcblk0"));
@@ -210,6 +258,231 @@ TEST(utilTest, findDeviceWithMaxAndMinGeometryPass)
     EXPECT_EQ(2U, std::filesystem::remove_all("def"));
 }
 
+/* Test case where the erase I/O options are provided. */
+TEST(utilTest, findDeviceWithEraseOptionsPass)
+{
+    estoraged::StorageData data;
+
+    /* Set up the map of properties. */
+    data.emplace(std::string("Type"),
+                 estoraged::BasicVariantType("EmmcDevice"));
+    data.emplace(std::string("Name"), estoraged::BasicVariantType("emmc"));
+    data.emplace(std::string("EraseDirectIo"),
+                 estoraged::BasicVariantType(true));
+    data.emplace(std::string("EraseChunkSize"),
+                 estoraged::BasicVariantType((uint64_t)4194304));
+    data.emplace(std::string("EraseQueueDepth"),
+                 estoraged::BasicVariantType((uint64_t)8));
+    data.emplace(std::string("ErasePipelineDepth"),
+                 estoraged::BasicVariantType((uint64_t)3));
+    data.emplace(std::string("EraseZeroOffload"),
+                 estoraged::BasicVariantType(true));
+    data.emplace(std::string("ErasePattern"),
+                 estoraged::BasicVariantType("Minstd"));
+    data.emplace(std::string("EraseVerifyThreads"),
+                 estoraged::BasicVariantType((uint64_t)4));
+    data.emplace(std::string("EraseVerifySampleConfidence"),
+                 estoraged::BasicVariantType(0.99));
+    data.emplace(std::string("EraseVerifySampleDefectRate"),
+                 estoraged::BasicVariantType(0.0001));
+    data.emplace(std::string("EraseTolerant"),
+                 estoraged::BasicVariantType(true));
+    data.emplace(std::string("EraseBadRangeLimit"),
+                 estoraged::BasicVariantType((uint64_t)64));
+    data.emplace(std::string("EraseIoClass"),
+                 estoraged::BasicVariantType("BestEffort"));
+    data.emplace(std::string("EraseIoLevel"),
+                 estoraged::BasicVariantType((uint64_t)7));
+    data.emplace(std::string("EraseSchedIdle"),
+                 estoraged::BasicVariantType(true));
+    data.emplace(std::string("EraseNice"),
+                 estoraged::BasicVariantType((uint64_t)10));
+    data.emplace(std::string("EraseMaxThroughput"),
+                 estoraged::BasicVariantType((uint64_t)20));
+    data.emplace(std::string("EraseIoPressureLimit"),
+                 estoraged::BasicVariantType(12.5));
+    data.emplace(std::string("EraseIoPressurePath"),
+                 estoraged::BasicVariantType(
+                     "/sys/fs/cgroup/system.slice/io.pressure"));
+    data.emplace(std::string("EraseSanitizePolling"),
+                 estoraged::BasicVariantType(true));
+    data.emplace(std::string("EraseSanitizeTimeout"),
+                 estoraged::BasicVariantType((uint64_t)600));
+    data.emplace(std::string("EraseEmmcPolicy"),
+                 estoraged::BasicVariantType("Purge"));
+    data.emplace(std::string("BkopsPollInterval"),
+                 estoraged::BasicVariantType((uint64_t)0));
+    data.emplace(std::string("BkopsIdleTime"),
+                 estoraged::BasicVariantType((uint64_t)5));
+    data.emplace(std::string("EmmcCachePolicy"),
+                 estoraged::BasicVariantType("Disable"));
+    data.emplace(std::string("EmmcMaxBusMode"),
+                 estoraged::BasicVariantType("HS200"));
+
+    /* Create a dummy eMMC device. */
+    std::filesystem::create_directories("mmcblk0/device");
+    const std::string typeFileName("mmcblk0/device/type");
+    std::ofstream typeFile(typeFileName, std::ios::out | std::ios::trunc);
+    typeFile << "MMC";
+    typeFile.close();
+
+    /* Look for the device file. */
+    auto result =
+        estoraged::util::findDevice(data, std::filesystem::path("./"));
+    EXPECT_TRUE(result.has_value());
+
+    /* Validate the results. */
+    EXPECT_EQ("/dev/mmcblk0", result->deviceFile.string());
+    EXPECT_TRUE(result->eraseOptions.directIo);
+    EXPECT_EQ(4194304U, result->eraseOptions.chunkSize);
+    EXPECT_EQ(8U, result->eraseOptions.queueDepth);
+    EXPECT_EQ(3U, result->eraseOptions.pipelineDepth);
+    EXPECT_TRUE(result->eraseOptions.zeroOffload);
+    EXPECT_EQ(estoraged::PatternType::Minstd, result->eraseOptions.patternType);
+    EXPECT_EQ(std::min(std::max(std::thread::hardware_concurrency(), 1U), 4U),
+              result->eraseOptions.verifyThreads);
+    EXPECT_DOUBLE_EQ(0.99, result->eraseOptions.verifySampleConfidence);
+    EXPECT_DOUBLE_EQ(0.0001, result->eraseOptions.verifySampleDefectRate);
+    EXPECT_TRUE(result->eraseOptions.tolerant);
+    EXPECT_EQ(64U, result->eraseOptions.badRangeLimit);
+    EXPECT_EQ(estoraged::IoClass::BestEffort, result->eraseOptions.ioClass);
+    EXPECT_EQ(7, result->eraseOptions.ioLevel);
+    EXPECT_TRUE(result->eraseOptions.schedIdle);
+    EXPECT_EQ(10, result->eraseOptions.nice);
+    EXPECT_DOUBLE_EQ(20, result->eraseOptions.maxThroughput);
+    EXPECT_DOUBLE_EQ(12.5, result->eraseOptions.ioPressureLimit);
+    EXPECT_EQ("/sys/fs/cgroup/system.slice/io.pressure",
+              result->eraseOptions.ioPressurePath);
+    EXPECT_TRUE(result->eraseOptions.sanitizePolling);
+    EXPECT_EQ(600U, result->eraseOptions.sanitizeTimeout);
+    EXPECT_EQ(estoraged::EmmcErasePolicy::Purge,
+              result->eraseOptions.emmcErasePolicy);
+    EXPECT_EQ(0U, result->eraseOptions.bkopsPollInterval);
+    EXPECT_EQ(5U, result->eraseOptions.bkopsIdleTime);
+    EXPECT_EQ(estoraged::EmmcCachePolicy::Disable,
+              result->eraseOptions.emmcCachePolicy);
+    EXPECT_EQ(estoraged::HsTiming::Hs200,
+              result->eraseOptions.emmcMaxBusMode);
+
+    /* Delete the dummy files. */
+    EXPECT_EQ(3U, std::filesystem::remove_all("mmcblk0"));
+}
+
+/* Test case where the erase options are out of range. */
+TEST(utilTest, findDeviceWithInvalidEraseOptions)
+{
+    estoraged::StorageData data;
+
+    /* Set up the map of properties. */
+    data.emplace(std::string("Type"),
+                 estoraged::BasicVariantType("EmmcDevice"));
+    data.emplace(std::string("Name"), estoraged::BasicVariantType("emmc"));
+    data.emplace(std::string("EraseChunkSize"),
+                 estoraged::BasicVariantType((uint64_t)1000));
+    data.emplace(std::string("EraseQueueDepth"),
+                 estoraged::BasicVariantType((uint64_t)100000));
+    data.emplace(std::string("EraseVerifyThreads"),
+                 estoraged::BasicVariantType((uint64_t)0));
+    data.emplace(std::string("ErasePipelineDepth"),
+                 estoraged::BasicVariantType((uint64_t)100000));
+
+    /* Create a dummy eMMC device. */
+    std::filesystem::create_directories("mmcblk0/device");
+    std::ofstream typeFile("mmcblk0/device/type",
+                           std::ios::out | std::ios::trunc);
+    typeFile << "MMC";
+    typeFile.close();
+
+    /* Look for the device file. */
+    auto result =
+        estoraged::util::findDevice(data, std::filesystem::path("./"));
+    EXPECT_TRUE(result.has_value());
+
+    /* The invalid values are replaced. */
+    EXPECT_EQ(0U, result->eraseOptions.chunkSize);
+    EXPECT_EQ(estoraged::EraseOptions::maxQueueDepth,
+              result->eraseOptions.queueDepth);
+    EXPECT_EQ(1U, result->eraseOptions.verifyThreads);
+    EXPECT_EQ(estoraged::EraseOptions::maxPipelineDepth,
+              result->eraseOptions.pipelineDepth);
+
+    /* An explicit 0 keeps the chunk size of the profile. */
+    data.erase("EraseChunkSize");
+    data.emplace(std::string("EraseChunkSize"),
+                 estoraged::BasicVariantType((uint64_t)0));
+    estoraged::PartProfileTable profiles =
+        estoraged::PartProfileTable::parse(R"({"Profiles": [{
+            "Name": "emmc",
+            "EraseChunkSize": 1048576
+        }]})");
+    std::ofstream nameFile("mmcblk0/device/name",
+                           std::ios::out | std::ios::trunc);
+    nameFile << "emmc";
+    nameFile.close();
+    result = estoraged::util::findDevice(data, std::filesystem::path("./"),
+                                         profiles);
+    EXPECT_TRUE(result.has_value());
+    EXPECT_EQ(1048576U, result->eraseOptions.chunkSize);
+
+    /* Delete the dummy files. */
+    EXPECT_EQ(4U, std::filesystem::remove_all("mmcblk0"));
+}
+
+/* Test case where the profile of the part sets the defaults. */
+TEST(utilTest, findDeviceWithPartProfilePass)
+{
+    estoraged::StorageData data;
+
+    /* Set up the map of properties, overriding one value of the profile. */
+    data.emplace(std::string("Type"),
+                 estoraged::BasicVariantType("EmmcDevice"));
+    data.emplace(std::string("Name"), estoraged::BasicVariantType("emmc"));
+    data.emplace(std::string("EraseQueueDepth"),
+                 estoraged::BasicVariantType((uint64_t)2));
+
+    estoraged::PartProfileTable profiles =
+        estoraged::PartProfileTable::parse(R"({"Profiles": [{
+            "Name": "8GTF4R",
+            "Manufacturer": "0x000015",
+            "EmmcMaxBusMode": "HS200",
+            "EraseChunkSize": 1048576,
+            "EraseQueueDepth": 8,
+            "EraseMaxGeometry": 10000000000
+        }]})");
+
+    /* Create a dummy eMMC device of the part. */
+    std::filesystem::create_directories("mmcblk0/device");
+    std::ofstream typeFile("mmcblk0/device/type",
+                           std::ios::out | std::ios::trunc);
+    typeFile << "MMC";
+    typeFile.close();
+    std::ofstream nameFile("mmcblk0/device/name",
+                           std::ios::out | std::ios::trunc);
+    nameFile << "8GTF4R";
+    nameFile.close();
+    std::ofstream manfidFile("mmcblk0/device/manfid",
+                             std::ios::out | std::ios::trunc);
+    manfidFile << "0x000015";
+    manfidFile.close();
+
+    /* Look for the device file. */
+    auto result = estoraged::util::findDevice(
+        data, std::filesystem::path("./"), profiles);
+    EXPECT_TRUE(result.has_value());
+
+    /* Validate the results. */
+    EXPECT_EQ("/dev/mmcblk0", result->deviceFile.string());
+    EXPECT_EQ(10000000000U, result->eraseMaxGeometry);
+    EXPECT_EQ(ERASE_MIN_GEOMETRY, result->eraseMinGeometry);
+    EXPECT_EQ(1048576U, result->eraseOptions.chunkSize);
+    EXPECT_EQ(2U, result->eraseOptions.queueDepth);
+    EXPECT_EQ(estoraged::HsTiming::Hs200,
+              result->eraseOptions.emmcMaxBusMode);
+
+    /* Delete the dummy files. */
+    EXPECT_EQ(5U, std::filesystem::remove_all("mmcblk0"));
+}
+
 /* Test case where the "Type" property doesn't exist. */
 TEST(utilTest, findDeviceNoTypeFail)
 {
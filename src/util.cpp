@@ -1,7 +1,9 @@
 #include "util.hpp"
 
 #include "estoraged_conf.hpp"
+#include "extCsd.hpp"
 #include "getConfig.hpp"
+#include "partProfile.hpp"
 
 #include <linux/fs.h>
 
@@ -11,11 +13,13 @@
 #include <stdplus/handle/managed.hpp>
 #include <xyz/openbmc_project/Common/error.hpp>
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <optional>
 #include <string>
+#include <thread>
 
 namespace estoraged
 {
@@ -45,6 +49,61 @@ uint64_t findSizeOfBlockDevice(const std::string& devPath)
     return bytes;
 }
 
+BlockGeometry findBlockGeometry(const std::string& devPath)
+{
+    BlockGeometry geometry;
+    try
+    {
+        ManagedFd fd =
+            stdplus::fd::open(devPath, stdplus::fd::OpenAccess::ReadOnly);
+        int logicalBlockSize = 0;
+        unsigned int physicalBlockSize = 0;
+        fd.ioctl(BLKSSZGET, &logicalBlockSize);
+        fd.ioctl(BLKPBSZGET, &physicalBlockSize);
+        geometry.logicalBlockSize = static_cast<size_t>(logicalBlockSize);
+        geometry.physicalBlockSize = physicalBlockSize;
+    }
+    catch (...)
+    {
+        lg2::error("erase unable to get block geometry", "REDFISH_MESSAGE_ID",
+                   std::string("OpenBMC.0.1.DriveEraseFailure"),
+                   "REDFISH_MESSAGE_ARGS", devPath);
+        throw InternalFailure();
+    }
+
+    /* The optimal I/O size is optional, most eMMCs don't report one. */
+    std::filesystem::path optimalIoPath("/sys/class/block");
+    optimalIoPath /= std::filesystem::path(devPath).filename();
+    optimalIoPath /= "queue/optimal_io_size";
+    std::ifstream optimalIoFile(optimalIoPath, std::ios_base::in);
+    size_t optimalIoSize = 0;
+    if (optimalIoFile >> optimalIoSize)
+    {
+        geometry.optimalIoSize = optimalIoSize;
+    }
+
+    return geometry;
+}
+
+ZeroOffload findZeroOffload(const std::filesystem::path& queueDir)
+{
+    /* Missing files, e.g. on older kernels, mean no support. */
+    auto readValue = [&queueDir](const char* name) {
+        std::ifstream file(queueDir / name, std::ios_base::in);
+        uint64_t value = 0;
+        if (!(file >> value))
+        {
+            return uint64_t{0};
+        }
+        return value;
+    };
+
+    ZeroOffload offload;
+    offload.writeZeroesMaxBytes = readValue("write_zeroes_max_bytes");
+    offload.discardGranularity = readValue("discard_granularity");
+    return offload;
+}
+
 uint8_t findPredictedMediaLifeLeftPercent(const std::string& sysfsPath)
 {
     // The eMMC spec defines two estimates for the life span of the device
@@ -80,18 +139,8 @@ uint8_t findPredictedMediaLifeLeftPercent(const std::string& sysfsPath)
         return 255;
     }
     lifeTimeFile.close();
-    // we are returning lowest LifeLeftPercent
-    uint8_t maxLifeUsed = 0;
-    if (estA > estB)
-    {
-        maxLifeUsed = estA;
-    }
-    else
-    {
-        maxLifeUsed = estB;
-    }
-
-    return static_cast<uint8_t>(11 - maxLifeUsed) * 10;
+    return lifeLeftPercent(static_cast<uint8_t>(estA),
+                           static_cast<uint8_t>(estB));
 }
 
 std::string getPartNumber(const std::filesystem::path& sysfsPath)
@@ -144,8 +193,124 @@ std::string getSerialNumber(const std::filesystem::path& sysfsPath)
     return serialNumber;
 }
 
+std::string getManufacturerId(const std::filesystem::path& sysfsPath)
+{
+    std::ifstream manfidFile;
+    std::string manufacturerId;
+    try
+    {
+        std::filesystem::path manfidPath(sysfsPath);
+        manfidPath /= "manfid";
+        manfidFile.open(manfidPath, std::ios_base::in);
+        manfidFile >> manufacturerId;
+    }
+    catch (...)
+    {
+        lg2::error("Unable to read sysfs", "REDFISH_MESSAGE_ID",
+                   std::string("OpenBMC.0.1.ManufacturerIdFailure"));
+    }
+    manfidFile.close();
+    if (manufacturerId.empty())
+    {
+        manufacturerId = "unknown";
+    }
+
+    return manufacturerId;
+}
+
+namespace
+{
+
+/** @brief EraseChunkSize must be a multiple of the smallest logical block,
+ *  so that every chunk holds whole sectors and pattern words.
+ */
+constexpr size_t chunkSizeAlignment = 512;
+
+/** @brief Clamps a count of the erase options to [1, max], logging an
+ *  error if it is out of range.
+ */
+size_t clampCount(const char* key, size_t value, size_t max)
+{
+    size_t clamped = std::clamp<size_t>(value, 1, max);
+    if (clamped != value)
+    {
+        lg2::error("{KEY} {VALUE} is out of range, using {CLAMPED}", "KEY",
+                   key, "VALUE", value, "CLAMPED", clamped);
+    }
+    return clamped;
+}
+
+/** @brief Resets the erase options the engines can not run with, logging
+ *  an error for each. The values may come from the part profile or the
+ *  config.
+ */
+void checkEraseOptions(EraseOptions& options)
+{
+    if (options.chunkSize % chunkSizeAlignment != 0)
+    {
+        lg2::error("EraseChunkSize {SIZE} is not a multiple of {ALIGN} "
+                   "bytes, deriving it from the device",
+                   "SIZE", options.chunkSize, "ALIGN", chunkSizeAlignment);
+        options.chunkSize = 0;
+    }
+    options.queueDepth = clampCount("EraseQueueDepth", options.queueDepth,
+                                    EraseOptions::maxQueueDepth);
+    options.pipelineDepth =
+        clampCount("ErasePipelineDepth", options.pipelineDepth,
+                   EraseOptions::maxPipelineDepth);
+    // more threads than CPUs only add contention on the device
+    options.verifyThreads =
+        clampCount("EraseVerifyThreads", options.verifyThreads,
+                   std::max(std::thread::hardware_concurrency(), 1U));
+}
+
+/** @brief Finds the block device directory of the eMMC in searchDir. */
+std::optional<std::filesystem::path> findMmcBlockDir(
+    const std::filesystem::path& searchDir)
+{
+    for (const auto& dirEntry : std::filesystem::directory_iterator{searchDir})
+    {
+        /*
+         * We will look at the 'type' file to determine if this is an MMC
+         * device.
+         */
+        std::filesystem::path curPath(dirEntry.path());
+        curPath /= "device/type";
+        if (!std::filesystem::exists(curPath))
+        {
+            /* The 'type' file doesn't exist. This must not be an eMMC. */
+            continue;
+        }
+
+        try
+        {
+            std::ifstream typeFile(curPath, std::ios_base::in);
+            std::string devType;
+            typeFile >> devType;
+            if (devType.compare("MMC") == 0 || devType.compare("SD") == 0)
+            {
+                return dirEntry.path();
+            }
+        }
+        catch (...)
+        {
+            lg2::error("Failed to read device type for {PATH}", "PATH", curPath,
+                       "REDFISH_MESSAGE_ID",
+                       std::string("OpenBMC.0.1.FindDeviceFail"));
+            /*
+             * We will still continue searching, though. Maybe this wasn't the
+             * device we were looking for, anyway.
+             */
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
 std::optional<DeviceInfo> findDevice(const StorageData& data,
-                                     const std::filesystem::path& searchDir)
+                                     const std::filesystem::path& searchDir,
+                                     const PartProfileTable& profiles)
 {
     /* Check what type of storage device this is. */
     estoraged::BasicVariantType typeVariant;
@@ -174,8 +339,26 @@ std::optional<DeviceInfo> findDevice(const StorageData& data,
         }
     }
 
+    /* Start from the profile of the part, the config below overrides it. */
+    std::optional<std::filesystem::path> blockDir = findMmcBlockDir(searchDir);
+    PartProfile profile;
+    if (blockDir && profiles.size() != 0)
+    {
+        std::filesystem::path sysfsDir = *blockDir / "device";
+        std::string manufacturer = getManufacturerId(sysfsDir);
+        std::string partNumber = getPartNumber(sysfsDir);
+        const PartProfile* found = profiles.find(manufacturer, partNumber);
+        if (found != nullptr)
+        {
+            lg2::info("Using the profile of part {PART} from {MANUFACTURER}",
+                      "PART", partNumber, "MANUFACTURER", manufacturer);
+            profile = *found;
+        }
+    }
+
     /* Check if EraseMaxGeometry is provided. */
-    uint64_t eraseMaxGeometry = ERASE_MAX_GEOMETRY;
+    uint64_t eraseMaxGeometry =
+        profile.eraseMaxGeometry.value_or(ERASE_MAX_GEOMETRY);
     auto findEraseMaxGeometry = data.find("EraseMaxGeometry");
     if (findEraseMaxGeometry != data.end())
     {
@@ -189,7 +372,8 @@ std::optional<DeviceInfo> findDevice(const StorageData& data,
     }
 
     /* Check if EraseMinGeometry is provided. */
-    uint64_t eraseMinGeometry = ERASE_MIN_GEOMETRY;
+    uint64_t eraseMinGeometry =
+        profile.eraseMinGeometry.value_or(ERASE_MIN_GEOMETRY);
     auto findEraseMinGeometry = data.find("EraseMinGeometry");
     if (findEraseMinGeometry != data.end())
     {
@@ -202,6 +386,378 @@ std::optional<DeviceInfo> findDevice(const StorageData& data,
         }
     }
 
+    /* Check if the erase engines should bypass the page cache. */
+    EraseOptions eraseOptions;
+    profile.apply(eraseOptions);
+    auto findEraseDirectIo = data.find("EraseDirectIo");
+    if (findEraseDirectIo != data.end())
+    {
+        const auto* eraseDirectIoPtr =
+            std::get_if<bool>(&findEraseDirectIo->second);
+        if (eraseDirectIoPtr != nullptr)
+        {
+            eraseOptions.directIo = *eraseDirectIoPtr;
+        }
+    }
+
+    /* Check if EraseChunkSize is provided. */
+    auto findEraseChunkSize = data.find("EraseChunkSize");
+    if (findEraseChunkSize != data.end())
+    {
+        const auto* eraseChunkSizePtr =
+            std::get_if<uint64_t>(&findEraseChunkSize->second);
+        if (eraseChunkSizePtr != nullptr && *eraseChunkSizePtr == 0)
+        {
+            lg2::error("EraseChunkSize must not be 0, ignoring it");
+        }
+        else if (eraseChunkSizePtr != nullptr)
+        {
+            eraseOptions.chunkSize = *eraseChunkSizePtr;
+        }
+    }
+
+    /* Check if EraseZeroOffload is provided. */
+    auto findEraseZeroOffload = data.find("EraseZeroOffload");
+    if (findEraseZeroOffload != data.end())
+    {
+        const auto* eraseZeroOffloadPtr =
+            std::get_if<bool>(&findEraseZeroOffload->second);
+        if (eraseZeroOffloadPtr != nullptr)
+        {
+            eraseOptions.zeroOffload = *eraseZeroOffloadPtr;
+        }
+    }
+
+    /* Check if ErasePattern is provided. */
+    auto findErasePattern = data.find("ErasePattern");
+    if (findErasePattern != data.end())
+    {
+        const auto* erasePatternPtr =
+            std::get_if<std::string>(&findErasePattern->second);
+        if (erasePatternPtr != nullptr && *erasePatternPtr == "Minstd")
+        {
+            eraseOptions.patternType = PatternType::Minstd;
+        }
+        else if (erasePatternPtr != nullptr && *erasePatternPtr != "Philox")
+        {
+            lg2::error("Unsupported erase pattern {PATTERN}, using Philox",
+                       "PATTERN", *erasePatternPtr);
+        }
+    }
+
+    /* Check if EraseVerifyThreads is provided. */
+    auto findEraseVerifyThreads = data.find("EraseVerifyThreads");
+    if (findEraseVerifyThreads != data.end())
+    {
+        const auto* eraseVerifyThreadsPtr =
+            std::get_if<uint64_t>(&findEraseVerifyThreads->second);
+        if (eraseVerifyThreadsPtr != nullptr)
+        {
+            eraseOptions.verifyThreads = *eraseVerifyThreadsPtr;
+        }
+    }
+
+    /* Check if sampled verify is configured. */
+    auto findSampleConfidence = data.find("EraseVerifySampleConfidence");
+    if (findSampleConfidence != data.end())
+    {
+        const auto* sampleConfidencePtr =
+            std::get_if<double>(&findSampleConfidence->second);
+        if (sampleConfidencePtr != nullptr)
+        {
+            eraseOptions.verifySampleConfidence = *sampleConfidencePtr;
+        }
+    }
+    auto findSampleDefectRate = data.find("EraseVerifySampleDefectRate");
+    if (findSampleDefectRate != data.end())
+    {
+        const auto* sampleDefectRatePtr =
+            std::get_if<double>(&findSampleDefectRate->second);
+        if (sampleDefectRatePtr != nullptr)
+        {
+            eraseOptions.verifySampleDefectRate = *sampleDefectRatePtr;
+        }
+    }
+
+    /* Check if EraseQueueDepth is provided. */
+    auto findEraseQueueDepth = data.find("EraseQueueDepth");
+    if (findEraseQueueDepth != data.end())
+    {
+        const auto* eraseQueueDepthPtr =
+            std::get_if<uint64_t>(&findEraseQueueDepth->second);
+        if (eraseQueueDepthPtr != nullptr)
+        {
+            eraseOptions.queueDepth = *eraseQueueDepthPtr;
+        }
+    }
+
+    /* Check if ErasePipelineDepth is provided. */
+    auto findErasePipelineDepth = data.find("ErasePipelineDepth");
+    if (findErasePipelineDepth != data.end())
+    {
+        const auto* erasePipelineDepthPtr =
+            std::get_if<uint64_t>(&findErasePipelineDepth->second);
+        if (erasePipelineDepthPtr != nullptr)
+        {
+            eraseOptions.pipelineDepth = *erasePipelineDepthPtr;
+        }
+    }
+
+    /* Check if the erase should keep going past bad ranges. */
+    auto findEraseTolerant = data.find("EraseTolerant");
+    if (findEraseTolerant != data.end())
+    {
+        const auto* eraseTolerantPtr =
+            std::get_if<bool>(&findEraseTolerant->second);
+        if (eraseTolerantPtr != nullptr)
+        {
+            eraseOptions.tolerant = *eraseTolerantPtr;
+        }
+    }
+    auto findEraseBadRangeLimit = data.find("EraseBadRangeLimit");
+    if (findEraseBadRangeLimit != data.end())
+    {
+        const auto* eraseBadRangeLimitPtr =
+            std::get_if<uint64_t>(&findEraseBadRangeLimit->second);
+        if (eraseBadRangeLimitPtr != nullptr)
+        {
+            eraseOptions.badRangeLimit = *eraseBadRangeLimitPtr;
+        }
+    }
+
+    /* Check if the erase should yield the device to other services. */
+    auto findEraseIoClass = data.find("EraseIoClass");
+    if (findEraseIoClass != data.end())
+    {
+        const auto* eraseIoClassPtr =
+            std::get_if<std::string>(&findEraseIoClass->second);
+        if (eraseIoClassPtr != nullptr && *eraseIoClassPtr == "Idle")
+        {
+            eraseOptions.ioClass = IoClass::Idle;
+        }
+        else if (eraseIoClassPtr != nullptr && *eraseIoClassPtr == "BestEffort")
+        {
+            eraseOptions.ioClass = IoClass::BestEffort;
+        }
+        else if (eraseIoClassPtr != nullptr)
+        {
+            lg2::error("Unsupported erase I/O class {CLASS}, keeping the "
+                       "daemon's",
+                       "CLASS", *eraseIoClassPtr);
+        }
+    }
+    auto findEraseIoLevel = data.find("EraseIoLevel");
+    if (findEraseIoLevel != data.end())
+    {
+        const auto* eraseIoLevelPtr =
+            std::get_if<uint64_t>(&findEraseIoLevel->second);
+        if (eraseIoLevelPtr != nullptr)
+        {
+            eraseOptions.ioLevel =
+                static_cast<int>(std::min<uint64_t>(*eraseIoLevelPtr, 7));
+        }
+    }
+    auto findEraseSchedIdle = data.find("EraseSchedIdle");
+    if (findEraseSchedIdle != data.end())
+    {
+        const auto* eraseSchedIdlePtr =
+            std::get_if<bool>(&findEraseSchedIdle->second);
+        if (eraseSchedIdlePtr != nullptr)
+        {
+            eraseOptions.schedIdle = *eraseSchedIdlePtr;
+        }
+    }
+    auto findEraseNice = data.find("EraseNice");
+    if (findEraseNice != data.end())
+    {
+        /* positive JSON numbers come as unsigned */
+        const auto* eraseNicePtr = std::get_if<int64_t>(&findEraseNice->second);
+        const auto* eraseNiceUnsignedPtr =
+            std::get_if<uint64_t>(&findEraseNice->second);
+        if (eraseNicePtr != nullptr)
+        {
+            eraseOptions.nice =
+                static_cast<int>(std::clamp<int64_t>(*eraseNicePtr, -20, 19));
+        }
+        else if (eraseNiceUnsignedPtr != nullptr)
+        {
+            eraseOptions.nice =
+                static_cast<int>(std::min<uint64_t>(*eraseNiceUnsignedPtr, 19));
+        }
+    }
+
+    /* Check if the erase is throttled. */
+    auto findEraseMaxThroughput = data.find("EraseMaxThroughput");
+    if (findEraseMaxThroughput != data.end())
+    {
+        const auto* eraseMaxThroughputPtr =
+            std::get_if<double>(&findEraseMaxThroughput->second);
+        const auto* eraseMaxThroughputIntPtr =
+            std::get_if<uint64_t>(&findEraseMaxThroughput->second);
+        if (eraseMaxThroughputPtr != nullptr)
+        {
+            eraseOptions.maxThroughput = *eraseMaxThroughputPtr;
+        }
+        else if (eraseMaxThroughputIntPtr != nullptr)
+        {
+            eraseOptions.maxThroughput =
+                static_cast<double>(*eraseMaxThroughputIntPtr);
+        }
+    }
+    auto findEraseIoPressureLimit = data.find("EraseIoPressureLimit");
+    if (findEraseIoPressureLimit != data.end())
+    {
+        const auto* eraseIoPressureLimitPtr =
+            std::get_if<double>(&findEraseIoPressureLimit->second);
+        const auto* eraseIoPressureLimitIntPtr =
+            std::get_if<uint64_t>(&findEraseIoPressureLimit->second);
+        if (eraseIoPressureLimitPtr != nullptr)
+        {
+            eraseOptions.ioPressureLimit = *eraseIoPressureLimitPtr;
+        }
+        else if (eraseIoPressureLimitIntPtr != nullptr)
+        {
+            eraseOptions.ioPressureLimit =
+                static_cast<double>(*eraseIoPressureLimitIntPtr);
+        }
+    }
+    auto findEraseIoPressurePath = data.find("EraseIoPressurePath");
+    if (findEraseIoPressurePath != data.end())
+    {
+        const auto* eraseIoPressurePathPtr =
+            std::get_if<std::string>(&findEraseIoPressurePath->second);
+        if (eraseIoPressurePathPtr != nullptr)
+        {
+            eraseOptions.ioPressurePath = *eraseIoPressurePathPtr;
+        }
+    }
+
+    /* Check if the sanitize polls the card status. */
+    auto findEraseSanitizePolling = data.find("EraseSanitizePolling");
+    if (findEraseSanitizePolling != data.end())
+    {
+        const auto* eraseSanitizePollingPtr =
+            std::get_if<bool>(&findEraseSanitizePolling->second);
+        if (eraseSanitizePollingPtr != nullptr)
+        {
+            eraseOptions.sanitizePolling = *eraseSanitizePollingPtr;
+        }
+    }
+    auto findEraseSanitizeTimeout = data.find("EraseSanitizeTimeout");
+    if (findEraseSanitizeTimeout != data.end())
+    {
+        const auto* eraseSanitizeTimeoutPtr =
+            std::get_if<uint64_t>(&findEraseSanitizeTimeout->second);
+        if (eraseSanitizeTimeoutPtr != nullptr && *eraseSanitizeTimeoutPtr != 0)
+        {
+            eraseOptions.sanitizeTimeout = *eraseSanitizeTimeoutPtr;
+        }
+    }
+    auto findEraseEmmcPolicy = data.find("EraseEmmcPolicy");
+    if (findEraseEmmcPolicy != data.end())
+    {
+        const auto* eraseEmmcPolicyPtr =
+            std::get_if<std::string>(&findEraseEmmcPolicy->second);
+        if (eraseEmmcPolicyPtr != nullptr && *eraseEmmcPolicyPtr == "Legacy")
+        {
+            eraseOptions.emmcErasePolicy = EmmcErasePolicy::Legacy;
+        }
+        else if (eraseEmmcPolicyPtr != nullptr &&
+                 *eraseEmmcPolicyPtr == "Clear")
+        {
+            eraseOptions.emmcErasePolicy = EmmcErasePolicy::Clear;
+        }
+        else if (eraseEmmcPolicyPtr != nullptr &&
+                 *eraseEmmcPolicyPtr == "Purge")
+        {
+            eraseOptions.emmcErasePolicy = EmmcErasePolicy::Purge;
+        }
+        else if (eraseEmmcPolicyPtr != nullptr)
+        {
+            lg2::error("Unsupported eMMC erase policy {POLICY}, keeping "
+                       "Legacy",
+                       "POLICY", *eraseEmmcPolicyPtr);
+        }
+    }
+    auto findBkopsPollInterval = data.find("BkopsPollInterval");
+    if (findBkopsPollInterval != data.end())
+    {
+        const auto* bkopsPollIntervalPtr =
+            std::get_if<uint64_t>(&findBkopsPollInterval->second);
+        if (bkopsPollIntervalPtr != nullptr)
+        {
+            eraseOptions.bkopsPollInterval = *bkopsPollIntervalPtr;
+        }
+    }
+    auto findBkopsIdleTime = data.find("BkopsIdleTime");
+    if (findBkopsIdleTime != data.end())
+    {
+        const auto* bkopsIdleTimePtr =
+            std::get_if<uint64_t>(&findBkopsIdleTime->second);
+        if (bkopsIdleTimePtr != nullptr)
+        {
+            eraseOptions.bkopsIdleTime = *bkopsIdleTimePtr;
+        }
+    }
+    auto findEmmcCachePolicy = data.find("EmmcCachePolicy");
+    if (findEmmcCachePolicy != data.end())
+    {
+        const auto* emmcCachePolicyPtr =
+            std::get_if<std::string>(&findEmmcCachePolicy->second);
+        if (emmcCachePolicyPtr != nullptr && *emmcCachePolicyPtr == "Keep")
+        {
+            eraseOptions.emmcCachePolicy = EmmcCachePolicy::Keep;
+        }
+        else if (emmcCachePolicyPtr != nullptr &&
+                 *emmcCachePolicyPtr == "Enable")
+        {
+            eraseOptions.emmcCachePolicy = EmmcCachePolicy::Enable;
+        }
+        else if (emmcCachePolicyPtr != nullptr &&
+                 *emmcCachePolicyPtr == "Disable")
+        {
+            eraseOptions.emmcCachePolicy = EmmcCachePolicy::Disable;
+        }
+        else if (emmcCachePolicyPtr != nullptr)
+        {
+            lg2::error("Unsupported eMMC cache policy {POLICY}, keeping "
+                       "the current policy",
+                       "POLICY", *emmcCachePolicyPtr);
+        }
+    }
+    auto findEmmcMaxBusMode = data.find("EmmcMaxBusMode");
+    if (findEmmcMaxBusMode != data.end())
+    {
+        const auto* emmcMaxBusModePtr =
+            std::get_if<std::string>(&findEmmcMaxBusMode->second);
+        if (emmcMaxBusModePtr != nullptr && *emmcMaxBusModePtr == "Legacy")
+        {
+            eraseOptions.emmcMaxBusMode = HsTiming::Legacy;
+        }
+        else if (emmcMaxBusModePtr != nullptr && *emmcMaxBusModePtr == "HS")
+        {
+            eraseOptions.emmcMaxBusMode = HsTiming::HighSpeed;
+        }
+        else if (emmcMaxBusModePtr != nullptr &&
+                 *emmcMaxBusModePtr == "HS200")
+        {
+            eraseOptions.emmcMaxBusMode = HsTiming::Hs200;
+        }
+        else if (emmcMaxBusModePtr != nullptr &&
+                 *emmcMaxBusModePtr == "HS400")
+        {
+            eraseOptions.emmcMaxBusMode = HsTiming::Hs400;
+        }
+        else if (emmcMaxBusModePtr != nullptr)
+        {
+            lg2::error("Unsupported eMMC bus mode {MODE}, keeping the "
+                       "built-in parts",
+                       "MODE", *emmcMaxBusModePtr);
+        }
+    }
+
+    checkEraseOptions(eraseOptions);
+
     /*
      * Determine the drive type and protocol to report for this device. Note
      * that we only support eMMC currently, so report an error for any other
@@ -224,58 +780,20 @@ std::optional<DeviceInfo> findDevice(const StorageData& data,
         return std::nullopt;
     }
 
-    /* Look for the eMMC in the specified searchDir directory. */
-    for (const auto& dirEntry : std::filesystem::directory_iterator{searchDir})
+    if (!blockDir)
     {
-        /*
-         * We will look at the 'type' file to determine if this is an MMC
-         * device.
-         */
-        std::filesystem::path curPath(dirEntry.path());
-        curPath /= "device/type";
-        if (!std::filesystem::exists(curPath))
-        {
-            /* The 'type' file doesn't exist. This must not be an eMMC. */
-            continue;
-        }
-
-        try
-        {
-            std::ifstream typeFile(curPath, std::ios_base::in);
-            std::string devType;
-            typeFile >> devType;
-            if (devType.compare("MMC") == 0 || devType.compare("SD") == 0)
-            {
-                /* Found it. Get the sysfs directory and device file. */
-                std::filesystem::path deviceName(dirEntry.path().filename());
-
-                std::filesystem::path sysfsDir = dirEntry.path();
-                sysfsDir /= "device";
-
-                std::filesystem::path deviceFile = "/dev";
-                deviceFile /= deviceName;
-
-                std::string luksName = "luks-" + deviceName.string();
-                return DeviceInfo{deviceFile,       sysfsDir,
-                                  luksName,         locationCode,
-                                  eraseMaxGeometry, eraseMinGeometry,
-                                  driveType,        driveProtocol};
-            }
-        }
-        catch (...)
-        {
-            lg2::error("Failed to read device type for {PATH}", "PATH", curPath,
-                       "REDFISH_MESSAGE_ID",
-                       std::string("OpenBMC.0.1.FindDeviceFail"));
-            /*
-             * We will still continue searching, though. Maybe this wasn't the
-             * device we were looking for, anyway.
-             */
-        }
+        /* Device wasn't found. */
+        return std::nullopt;
     }
 
-    /* Device wasn't found. */
-    return std::nullopt;
+    std::filesystem::path deviceName(blockDir->filename());
+    std::filesystem::path sysfsDir = *blockDir / "device";
+    std::filesystem::path deviceFile = "/dev";
+    deviceFile /= deviceName;
+    std::string luksName = "luks-" + deviceName.string();
+    return DeviceInfo{deviceFile,       sysfsDir,         luksName,
+                      locationCode,     eraseMaxGeometry, eraseMinGeometry,
+                      driveType,        driveProtocol,    eraseOptions};
 }
 
 } // namespace util